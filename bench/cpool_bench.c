@@ -0,0 +1,392 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * A microbenchmark for the layout of the constant pool.  It builds the
+ * same synthetic constant pool in two layouts and times resolving every
+ * Methodref down to its UTF8 strings, which is what "readjcf -d" does:
+ *
+ *   pointers  An array of pointers to separately malloc()ed packed
+ *             constants, with each UTF8 constant's bytes in a separate
+ *             malloc()ed block.  This is how readjcf used to hold the
+ *             pool.
+ *
+ *   soa       Dense arrays of tags, offsets and operands indexed by
+ *             constant pool index, with the UTF8 bytes in one blob.
+ *             This is how readjcf holds the pool now.
+ *
+ * Each layout is resolved in pool order and in a random order.  Cache
+ * misses are counted with perf_event_open() where the kernel allows it.
+ *
+ * usage: cpool_bench [<constants> [<rounds>]]
+ */
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Define the tags of the constants that the benchmark uses.
+enum {
+	TAG_Utf8 = 1,
+	TAG_Class = 7,
+	TAG_Methodref = 10,
+	TAG_NameAndType = 12
+};
+
+// Define the packed constants of the pointer layout.
+struct ptr_info {
+	uint8_t		tag;
+} __attribute__((packed));
+
+struct ptr_info_2u2 {
+	uint8_t		tag;
+	uint16_t	u2_1;
+	uint16_t	u2_2;
+} __attribute__((packed));
+
+struct ptr_utf8_info {
+	uint8_t		tag;
+	uint16_t	length;
+	uint8_t		*bytes;
+} __attribute__((packed));
+
+// Define the pointer layout.
+struct ptr_pool {
+	uint16_t	count;
+	struct ptr_info	**pool;
+};
+
+// Define the structure of arrays layout.
+struct soa_pool {
+	uint16_t	count;
+	uint8_t		*tags;
+	uint32_t	*offsets;
+	uint16_t	*operand1;
+	uint16_t	*operand2;
+	uint8_t		*blob;
+};
+
+static uint64_t	rng_state = 0x9e3779b97f4a7c15;
+
+static uint32_t	bench_random(void);
+static void	build_pools(uint16_t count, struct ptr_pool *ptr,
+		    struct soa_pool *soa);
+static uint64_t	hash_bytes(uint64_t h, const uint8_t *bytes, size_t len);
+static uint64_t	resolve_ptr(const struct ptr_pool *ptr,
+		    const uint16_t *order, size_t norder);
+static uint64_t	resolve_soa(const struct soa_pool *soa,
+		    const uint16_t *order, size_t norder);
+static int	open_cache_counter(void);
+static uint64_t	now_ns(void);
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Returns the next value of a fixed xorshift sequence, so that every
+ *   run builds the same pools.
+ */
+static uint32_t
+bench_random(void)
+{
+
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 7;
+	rng_state ^= rng_state << 17;
+	return ((uint32_t)(rng_state >> 32));
+}
+
+/*
+ * Requires:
+ *   "count" must be at least 16.
+ *
+ * Effects:
+ *   Builds a constant pool of "count" slots in both layouts.  The first
+ *   half of the pool holds UTF8 constants, followed by Class,
+ *   NameAndType and Methodref constants whose operands refer to random
+ *   earlier constants, as a large class's pool would.
+ */
+static void
+build_pools(uint16_t count, struct ptr_pool *ptr, struct soa_pool *soa)
+{
+	struct ptr_info_2u2 *info_2u2;
+	struct ptr_utf8_info *utf8_info;
+	size_t blob_used = 0, blob_size;
+	uint16_t i, nutf8, nclass, nnat;
+	uint16_t u2_1, u2_2;
+	uint8_t tag;
+	int len;
+
+	nutf8 = count / 2;
+	nclass = nutf8 + count / 8;
+	nnat = nclass + count / 8;
+	blob_size = (size_t)count * 48;
+
+	ptr->count = soa->count = count;
+	ptr->pool = calloc(count, sizeof(*ptr->pool));
+	soa->tags = calloc(count, 1);
+	soa->offsets = calloc(count, sizeof(uint32_t));
+	soa->operand1 = calloc(count, sizeof(uint16_t));
+	soa->operand2 = calloc(count, sizeof(uint16_t));
+	soa->blob = malloc(blob_size);
+	if (ptr->pool == NULL || soa->tags == NULL || soa->offsets == NULL ||
+	    soa->operand1 == NULL || soa->operand2 == NULL ||
+	    soa->blob == NULL) {
+		perror("cpool_bench");
+		exit(1);
+	}
+	for (i = 1; i < count; i++) {
+		if (i < nutf8) {
+			// Make a name or descriptor of 8 to 40 bytes.
+			len = 8 + bench_random() % 33;
+			utf8_info = malloc(sizeof(*utf8_info));
+			utf8_info->tag = TAG_Utf8;
+			utf8_info->length = len;
+			utf8_info->bytes = malloc(len);
+			for (int k = 0; k < len; k++)
+				utf8_info->bytes[k] = 'a' + bench_random() % 26;
+			ptr->pool[i] = (struct ptr_info *)utf8_info;
+			soa->tags[i] = TAG_Utf8;
+			soa->offsets[i] = blob_used;
+			soa->operand1[i] = len;
+			memcpy(soa->blob + blob_used, utf8_info->bytes, len);
+			blob_used += len;
+			continue;
+		}
+		if (i < nclass) {
+			tag = TAG_Class;
+			u2_1 = 1 + bench_random() % (nutf8 - 1);
+			u2_2 = 0;
+		} else if (i < nnat) {
+			tag = TAG_NameAndType;
+			u2_1 = 1 + bench_random() % (nutf8 - 1);
+			u2_2 = 1 + bench_random() % (nutf8 - 1);
+		} else {
+			tag = TAG_Methodref;
+			u2_1 = nutf8 + bench_random() % (nclass - nutf8);
+			u2_2 = nclass + bench_random() % (nnat - nclass);
+		}
+		info_2u2 = malloc(sizeof(*info_2u2));
+		info_2u2->tag = tag;
+		info_2u2->u2_1 = u2_1;
+		info_2u2->u2_2 = u2_2;
+		ptr->pool[i] = (struct ptr_info *)info_2u2;
+		soa->tags[i] = tag;
+		soa->operand1[i] = u2_1;
+		soa->operand2[i] = u2_2;
+	}
+}
+
+/*
+ * Requires:
+ *   "bytes" must point to "len" bytes.
+ *
+ * Effects:
+ *   Folds "bytes" into the FNV-1a hash "h".  This stands in for
+ *   printing the bytes.
+ */
+static uint64_t
+hash_bytes(uint64_t h, const uint8_t *bytes, size_t len)
+{
+
+	for (size_t k = 0; k < len; k++)
+		h = (h ^ bytes[k]) * 0x100000001b3;
+	return (h);
+}
+
+/*
+ * Requires:
+ *   "order" must hold "norder" indices into "ptr".
+ *
+ * Effects:
+ *   Resolves each Methodref in "order" to its class name, member name
+ *   and descriptor in the pointer layout.  Returns a hash of the bytes.
+ */
+static uint64_t
+resolve_ptr(const struct ptr_pool *ptr, const uint16_t *order, size_t norder)
+{
+	struct ptr_info_2u2 *ref, *class, *nat;
+	struct ptr_utf8_info *utf8;
+	uint64_t h = 0xcbf29ce484222325;
+
+	for (size_t k = 0; k < norder; k++) {
+		ref = (struct ptr_info_2u2 *)ptr->pool[order[k]];
+		if (ref->tag != TAG_Methodref)
+			continue;
+		class = (struct ptr_info_2u2 *)ptr->pool[ref->u2_1];
+		utf8 = (struct ptr_utf8_info *)ptr->pool[class->u2_1];
+		h = hash_bytes(h, utf8->bytes, utf8->length);
+		nat = (struct ptr_info_2u2 *)ptr->pool[ref->u2_2];
+		utf8 = (struct ptr_utf8_info *)ptr->pool[nat->u2_1];
+		h = hash_bytes(h, utf8->bytes, utf8->length);
+		utf8 = (struct ptr_utf8_info *)ptr->pool[nat->u2_2];
+		h = hash_bytes(h, utf8->bytes, utf8->length);
+	}
+	return (h);
+}
+
+/*
+ * Requires:
+ *   "order" must hold "norder" indices into "soa".
+ *
+ * Effects:
+ *   Resolves each Methodref in "order" to its class name, member name
+ *   and descriptor in the structure of arrays layout.  Returns a hash of
+ *   the bytes.
+ */
+static uint64_t
+resolve_soa(const struct soa_pool *soa, const uint16_t *order, size_t norder)
+{
+	uint16_t index, class, nat, utf8;
+	uint64_t h = 0xcbf29ce484222325;
+
+	for (size_t k = 0; k < norder; k++) {
+		index = order[k];
+		if (soa->tags[index] != TAG_Methodref)
+			continue;
+		class = soa->operand1[index];
+		utf8 = soa->operand1[class];
+		h = hash_bytes(h, soa->blob + soa->offsets[utf8],
+		    soa->operand1[utf8]);
+		nat = soa->operand2[index];
+		utf8 = soa->operand1[nat];
+		h = hash_bytes(h, soa->blob + soa->offsets[utf8],
+		    soa->operand1[utf8]);
+		utf8 = soa->operand2[nat];
+		h = hash_bytes(h, soa->blob + soa->offsets[utf8],
+		    soa->operand1[utf8]);
+	}
+	return (h);
+}
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Opens a counter of this thread's hardware cache misses.  Returns its
+ *   file descriptor, or -1 if the kernel does not allow it.
+ */
+static int
+open_cache_counter(void)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return ((int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Returns the monotonic time in nanoseconds.
+ */
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Runs the benchmark and prints one line per layout and access order.
+ */
+int
+main(int argc, char **argv)
+{
+	static const char *const orders[] = { "sequential", "random" };
+	struct ptr_pool ptr;
+	struct soa_pool soa;
+	uint64_t start, elapsed, misses, h, sink = 0;
+	uint16_t *order, tmp;
+	long count = 65535, rounds = 20, nrefs;
+	int fd, layout, o;
+	size_t j;
+
+	if (argc > 1)
+		count = strtol(argv[1], NULL, 10);
+	if (argc > 2)
+		rounds = strtol(argv[2], NULL, 10);
+	if (count < 16 || count > 65535 || rounds < 1) {
+		fprintf(stderr, "usage: %s [<constants> [<rounds>]]\n", argv[0]);
+		return (1);
+	}
+	build_pools(count, &ptr, &soa);
+	nrefs = count - (count / 2 + 2 * (count / 8));
+	order = malloc(count * sizeof(*order));
+	if (order == NULL) {
+		perror("cpool_bench");
+		return (1);
+	}
+	fd = open_cache_counter();
+
+	printf("%ld constants, %ld Methodrefs, %ld rounds\n", count, nrefs,
+	    rounds);
+	printf("%-10s %-8s %10s %14s\n", "order", "layout", "ns/ref",
+	    "misses/ref");
+	for (o = 0; o < 2; o++) {
+		for (j = 0; j < (size_t)count - 1; j++)
+			order[j] = j + 1;
+		if (o == 1) {
+			for (j = count - 2; j > 0; j--) {
+				size_t r = bench_random() % (j + 1);
+				tmp = order[j];
+				order[j] = order[r];
+				order[r] = tmp;
+			}
+		}
+		for (layout = 0; layout < 2; layout++) {
+			if (fd >= 0) {
+				ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+				ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+			}
+			start = now_ns();
+			for (long r = 0; r < rounds; r++) {
+				h = layout == 0 ?
+				    resolve_ptr(&ptr, order, count - 1) :
+				    resolve_soa(&soa, order, count - 1);
+				sink += h;
+			}
+			elapsed = now_ns() - start;
+			printf("%-10s %-8s %10.1f ", orders[o],
+			    layout == 0 ? "pointers" : "soa",
+			    (double)elapsed / (rounds * nrefs));
+			if (fd >= 0) {
+				ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+				if (read(fd, &misses, sizeof(misses)) ==
+				    sizeof(misses)) {
+					printf("%14.2f\n", (double)misses /
+					    (rounds * nrefs));
+					continue;
+				}
+			}
+			printf("%14s\n", "n/a");
+		}
+	}
+
+	// Keep the resolution from being optimized away.
+	fprintf(stderr, "checksum %016" PRIx64 "\n", sink);
+	return (0);
+}
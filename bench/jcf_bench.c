@@ -0,0 +1,938 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * A benchmark of the parser library over generated class files.  It
+ * generates a set of well-formed class files of a given shape from a
+ * fixed seed, so that every run with the same options parses the same
+ * bytes, and then parses the whole set several times:
+ *
+ *   phases    with the parser's statistics kept and a callback that
+ *             does nothing, which times each phase of the parse
+ *
+ *   bare      without statistics, with the same callback
+ *
+ *   strict    the same, with every UTF8 constant checked to be valid
+ *             Modified UTF-8
+ *
+ *   full      without statistics, with a callback that formats each
+ *             event as readjcf prints it
+ *
+ * The events are those of "readjcf -d -e -a -m".  The output phase is
+ * the time of a full pass less that of a bare pass.  Each figure is the
+ * median over the rounds, after a first round that warms the caches and
+ * is not counted.  How far apart the rounds of bare passes were is
+ * printed with their throughput: a difference between two runs that is
+ * smaller than that is noise.  Allocations are counted by wrapping
+ * malloc(), calloc() and realloc() at link time, so they cover the
+ * library.
+ *
+ * With "-o", the class files are also written to the named directory,
+ * so that readjcf itself can be run over them.
+ *
+ * usage: jcf_bench [-a <bytes>] [-c <constants>] [-d <references>]
+ *            [-f <fields>] [-i <instructions>] [-m <methods>]
+ *            [-n <files>] [-o <directory>] [-r <rounds>] [-s <seed>]
+ *            [-u <percent>] [-w <percent>] [-x <percent>]
+ */
+
+#include <sys/stat.h>
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "jcf_out.h"
+#include "jcf_parse.h"
+
+// Define the tags of the constants that the generator writes.
+enum {
+	TAG_Utf8 = 1,
+	TAG_Integer = 3,
+	TAG_Long = 5,
+	TAG_Double = 6,
+	TAG_Class = 7,
+	TAG_String = 8,
+	TAG_Fieldref = 9,
+	TAG_Methodref = 10,
+	TAG_InterfaceMethodref = 11,
+	TAG_NameAndType = 12
+};
+
+// Define the shape of the generated class files.
+struct bench_shape {
+	long		files;
+	long		constants;	// the constant pool count to aim for
+	long		utf8;		// percent of the filler that is UTF8
+	long		wide;		// percent that is long or double
+	long		non_ascii;	// percent of the UTF8 that is not ASCII
+	long		references;	// field and method references
+	long		fields;
+	long		methods;
+	long		instructions;	// per method's code
+	long		attribute;	// bytes of each member's extra attribute
+	uint64_t	seed;
+};
+
+// Define a growing buffer of bytes.
+struct bench_buf {
+	uint8_t		*p;
+	size_t		len;
+	size_t		cap;
+};
+
+// Define the generated class files, which are kept back to back.
+struct bench_set {
+	struct bench_buf bytes;
+	size_t		*offsets;	// "count" + 1 offsets into "bytes"
+	long		count;
+	uint64_t	constants;	// summed over the class files
+};
+
+// Define the figures of one round.
+struct bench_round {
+	struct jcf_parse_stats stats;
+	uint64_t	bare_nsec;
+	uint64_t	strict_nsec;
+	uint64_t	full_nsec;
+	uint64_t	allocations;
+	uint64_t	output_bytes;
+};
+
+// Define the state of the formatting callback.
+struct bench_output {
+	struct jcf_out	out;
+	uint64_t	bytes;
+};
+
+static const char *const phase_names[JCF_PARSE_PHASES] = {
+	[JCF_PARSE_PHASE_HEADER] = "header",
+	[JCF_PARSE_PHASE_CONSTANT_POOL] = "constant pool",
+	[JCF_PARSE_PHASE_FIELDS] = "fields",
+	[JCF_PARSE_PHASE_METHODS] = "methods",
+	[JCF_PARSE_PHASE_ATTRIBUTES] = "attributes"
+};
+
+static const char *const field_descriptors[] = {
+	"I", "J", "Ljava/lang/String;", "[B"
+};
+
+static const char *const method_descriptors[] = {
+	"()V", "(I)I", "(Ljava/lang/String;)V", "(JD)Ljava/lang/Object;"
+};
+
+static uint64_t	rng_state;
+static uint64_t	allocations;
+
+void		*__real_malloc(size_t size);
+void		*__real_calloc(size_t count, size_t size);
+void		*__real_realloc(void *ptr, size_t size);
+void		*__wrap_malloc(size_t size);
+void		*__wrap_calloc(size_t count, size_t size);
+void		*__wrap_realloc(void *ptr, size_t size);
+
+static uint32_t	bench_random(void);
+static void	buf_bytes(struct bench_buf *buf, const void *p, size_t len);
+static void	buf_u1(struct bench_buf *buf, uint8_t value);
+static void	buf_u2(struct bench_buf *buf, uint16_t value);
+static void	buf_u4(struct bench_buf *buf, uint32_t value);
+static uint16_t	pool_utf8(struct bench_buf *pool, uint16_t *count,
+		    const char *text);
+static uint16_t	pool_2u2(struct bench_buf *pool, uint16_t *count,
+		    uint8_t tag, uint16_t operand1, uint16_t operand2);
+static void	put_extra_attribute(struct bench_buf *buf, uint16_t name,
+		    long size);
+static void	generate_class(const struct bench_shape *shape, long n,
+		    struct bench_set *set);
+static int	ignore_event(void *arg, const struct jcf_parse_event *event);
+static int	format_event(void *arg, const struct jcf_parse_event *event);
+static uint64_t	run_pass(struct jcf_parser *parser,
+		    const struct bench_set *set, jcf_parse_callback *callback,
+		    void *arg);
+static int	write_set(const struct bench_set *set, const char *dir);
+static int	compare_u64(const void *a, const void *b);
+static uint64_t	median(uint64_t *values, long count);
+static uint64_t	now_ns(void);
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Counts an allocation and makes it.  The library's calls to malloc()
+ *   are bound to this function when the benchmark is linked.
+ */
+void *
+__wrap_malloc(size_t size)
+{
+	allocations++;
+	return (__real_malloc(size));
+}
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Counts an allocation and makes it, like __wrap_malloc().
+ */
+void *
+__wrap_calloc(size_t count, size_t size)
+{
+	allocations++;
+	return (__real_calloc(count, size));
+}
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Counts an allocation and makes it, like __wrap_malloc().
+ */
+void *
+__wrap_realloc(void *ptr, size_t size)
+{
+	allocations++;
+	return (__real_realloc(ptr, size));
+}
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Returns the next value of a xorshift sequence that starts from the
+ *   seed, so that every run with the same seed generates the same files.
+ */
+static uint32_t
+bench_random(void)
+{
+
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 7;
+	rng_state ^= rng_state << 17;
+	return ((uint32_t)(rng_state >> 32));
+}
+
+/*
+ * Requires:
+ *   "p" must point to "len" bytes.
+ *
+ * Effects:
+ *   Appends the bytes to "buf", growing it as needed.  Exits if memory
+ *   cannot be allocated.
+ */
+static void
+buf_bytes(struct bench_buf *buf, const void *p, size_t len)
+{
+	uint8_t *grown;
+	size_t cap;
+
+	if (len > buf->cap - buf->len) {
+		cap = buf->cap > 0 ? buf->cap : 4096;
+		while (len > cap - buf->len)
+			cap *= 2;
+		if ((grown = realloc(buf->p, cap)) == NULL) {
+			perror("jcf_bench");
+			exit(1);
+		}
+		buf->p = grown;
+		buf->cap = cap;
+	}
+	memcpy(buf->p + buf->len, p, len);
+	buf->len += len;
+}
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Appends a byte to "buf".
+ */
+static void
+buf_u1(struct bench_buf *buf, uint8_t value)
+{
+	buf_bytes(buf, &value, 1);
+}
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Appends a big-endian u2 to "buf".
+ */
+static void
+buf_u2(struct bench_buf *buf, uint16_t value)
+{
+	uint8_t bytes[2] = { value >> 8, value };
+
+	buf_bytes(buf, bytes, sizeof(bytes));
+}
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Appends a big-endian u4 to "buf".
+ */
+static void
+buf_u4(struct bench_buf *buf, uint32_t value)
+{
+	uint8_t bytes[4] = { value >> 24, value >> 16, value >> 8, value };
+
+	buf_bytes(buf, bytes, sizeof(bytes));
+}
+
+/*
+ * Requires:
+ *   "*count" must be the constant pool count so far.
+ *
+ * Effects:
+ *   Appends a UTF8 constant holding "text" to "pool" and returns its
+ *   index.
+ */
+static uint16_t
+pool_utf8(struct bench_buf *pool, uint16_t *count, const char *text)
+{
+	size_t len = strlen(text);
+
+	buf_u1(pool, TAG_Utf8);
+	buf_u2(pool, len);
+	buf_bytes(pool, text, len);
+	return ((*count)++);
+}
+
+/*
+ * Requires:
+ *   "*count" must be the constant pool count so far.  "tag" must be
+ *   that of a constant with one or two u2 operands.
+ *
+ * Effects:
+ *   Appends the constant to "pool" and returns its index.  A constant
+ *   with one operand ignores "operand2".
+ */
+static uint16_t
+pool_2u2(struct bench_buf *pool, uint16_t *count, uint8_t tag,
+    uint16_t operand1, uint16_t operand2)
+{
+	buf_u1(pool, tag);
+	buf_u2(pool, operand1);
+	if (tag != TAG_Class && tag != TAG_String)
+		buf_u2(pool, operand2);
+	return ((*count)++);
+}
+
+/*
+ * Requires:
+ *   "name" must be the index of a UTF8 constant.
+ *
+ * Effects:
+ *   Appends an attribute of "size" random bytes to "buf".
+ */
+static void
+put_extra_attribute(struct bench_buf *buf, uint16_t name, long size)
+{
+	long k;
+
+	buf_u2(buf, name);
+	buf_u4(buf, size);
+	for (k = 0; k < size; k++)
+		buf_u1(buf, bench_random());
+}
+
+/*
+ * Requires:
+ *   The shape's counts must be within the limits that main() checks.
+ *
+ * Effects:
+ *   Appends class file "n" of the given shape to "set".  Its pool holds
+ *   the class and superclass, the names and descriptors of its members,
+ *   "references" field and method references to other generated
+ *   classes, and then filler constants up to the constant pool count.
+ *   Every method has a Code attribute whose instructions use the
+ *   references, and every member and the class have an extra attribute
+ *   of "attribute" bytes.
+ */
+static void
+generate_class(const struct bench_shape *shape, long n, struct bench_set *set)
+{
+	static const char charset[] =
+	    "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ/$_;()[";
+	struct bench_buf pool = { NULL, 0, 0 }, *out = &set->bytes;
+	uint16_t count = 1, this_class, super_class, code, extra, source;
+	uint16_t *field_names, *method_names, *refs, *classes, file_name;
+	uint16_t field_descs[4], method_descs[4], nat, index;
+	uint8_t *ref_tags, tag;
+	long k, j, nclasses, len, target;
+	uint32_t roll;
+	bool non_ascii;
+	char text[160];
+
+	field_names = malloc((shape->fields + 1) * sizeof(*field_names));
+	method_names = malloc((shape->methods + 1) * sizeof(*method_names));
+	refs = malloc((shape->references + 1) * sizeof(*refs));
+	ref_tags = malloc((shape->references + 1) * sizeof(*ref_tags));
+	nclasses = shape->references / 4 + 1;
+	classes = malloc(nclasses * sizeof(*classes));
+	if (field_names == NULL || method_names == NULL || refs == NULL ||
+	    ref_tags == NULL || classes == NULL) {
+		perror("jcf_bench");
+		exit(1);
+	}
+
+	// Add the class, its superclass and the attribute names.
+	snprintf(text, sizeof(text), "bench/p%ld/C%ld", n % 16, n);
+	this_class = pool_2u2(&pool, &count, TAG_Class,
+	    pool_utf8(&pool, &count, text), 0);
+	super_class = pool_2u2(&pool, &count, TAG_Class,
+	    pool_utf8(&pool, &count, "java/lang/Object"), 0);
+	code = pool_utf8(&pool, &count, "Code");
+	extra = pool_utf8(&pool, &count, "BenchData");
+	source = pool_utf8(&pool, &count, "SourceFile");
+	snprintf(text, sizeof(text), "C%ld.java", n);
+	file_name = pool_utf8(&pool, &count, text);
+
+	// Add the members' names and descriptors.
+	for (k = 0; k < 4; k++) {
+		field_descs[k] = pool_utf8(&pool, &count,
+		    field_descriptors[k]);
+		method_descs[k] = pool_utf8(&pool, &count,
+		    method_descriptors[k]);
+	}
+	for (k = 0; k < shape->fields; k++) {
+		snprintf(text, sizeof(text), "field%ld", k);
+		field_names[k] = pool_utf8(&pool, &count, text);
+	}
+	for (k = 0; k < shape->methods; k++) {
+		snprintf(text, sizeof(text), "method%ld", k);
+		method_names[k] = pool_utf8(&pool, &count, text);
+	}
+
+	/*
+	 * Add references to the members of other generated classes, which
+	 * are named like this class' members.  Half are method references,
+	 * a quarter field references and a quarter interface method
+	 * references.
+	 */
+	for (k = 0; k < nclasses; k++) {
+		j = bench_random() % shape->files;
+		snprintf(text, sizeof(text), "bench/p%ld/C%ld", j % 16, j);
+		classes[k] = pool_2u2(&pool, &count, TAG_Class,
+		    pool_utf8(&pool, &count, text), 0);
+	}
+	for (k = 0; k < shape->references; k++) {
+		roll = bench_random() % 4;
+		if (roll == 0 && shape->fields > 0) {
+			ref_tags[k] = TAG_Fieldref;
+			nat = pool_2u2(&pool, &count, TAG_NameAndType,
+			    field_names[bench_random() % shape->fields],
+			    field_descs[bench_random() % 4]);
+		} else {
+			ref_tags[k] = roll == 1 ? TAG_InterfaceMethodref :
+			    TAG_Methodref;
+			nat = pool_2u2(&pool, &count, TAG_NameAndType,
+			    shape->methods > 0 ? method_names[bench_random() %
+			    shape->methods] : code,
+			    method_descs[bench_random() % 4]);
+		}
+		refs[k] = pool_2u2(&pool, &count, ref_tags[k],
+		    classes[bench_random() % nclasses], nat);
+	}
+
+	// Fill the rest of the pool.
+	target = shape->constants;
+	while (count < target) {
+		roll = bench_random() % 100;
+		if (roll < shape->wide && count + 2 <= target) {
+			buf_u1(&pool, roll % 2 == 0 ? TAG_Long : TAG_Double);
+			buf_u4(&pool, bench_random());
+			buf_u4(&pool, bench_random());
+			count += 2;
+		} else if (roll < shape->wide + shape->utf8) {
+			len = 4 + bench_random() % 45;
+			non_ascii = shape->non_ascii > 0 &&
+			    (long)(bench_random() % 100) < shape->non_ascii;
+			for (k = 0, j = 0; k < len; k++) {
+				// Make every fourth character or so two or
+				// three bytes long.
+				roll = non_ascii ? bench_random() % 8 : 2;
+				if (roll == 0)
+					j += sprintf(text + j, "\u00e9");
+				else if (roll == 1)
+					j += sprintf(text + j, "\u8a9e");
+				else
+					text[j++] = charset[bench_random() %
+					    (sizeof(charset) - 1)];
+			}
+			text[j] = '\0';
+			pool_utf8(&pool, &count, text);
+		} else if (roll % 2 == 0) {
+			buf_u1(&pool, TAG_Integer);
+			buf_u4(&pool, bench_random());
+			count++;
+		} else
+			pool_2u2(&pool, &count, TAG_String, file_name, 0);
+	}
+	set->constants += count;
+
+	// Write the header, the pool and the body.
+	set->offsets[n] = out->len;
+	buf_u4(out, 0xCAFEBABE);
+	buf_u2(out, 0);
+	buf_u2(out, 52);
+	buf_u2(out, count);
+	buf_bytes(out, pool.p, pool.len);
+	buf_u2(out, 0x0021);
+	buf_u2(out, this_class);
+	buf_u2(out, super_class);
+	buf_u2(out, 0);
+
+	// Write the fields, every other one public.
+	buf_u2(out, shape->fields);
+	for (k = 0; k < shape->fields; k++) {
+		buf_u2(out, k % 2 == 0 ? 0x0001 : 0x0002);
+		buf_u2(out, field_names[k]);
+		buf_u2(out, field_descs[k % 4]);
+		buf_u2(out, 1);
+		put_extra_attribute(out, extra, shape->attribute);
+	}
+
+	// Write the methods, with code that uses the references.
+	buf_u2(out, shape->methods);
+	for (k = 0; k < shape->methods; k++) {
+		buf_u2(out, k % 2 == 0 ? 0x0001 : 0x0002);
+		buf_u2(out, method_names[k]);
+		buf_u2(out, method_descs[k % 4]);
+		buf_u2(out, 2);
+		for (j = 0, len = 1; j < shape->instructions; j++) {
+			tag = shape->references > 0 ?
+			    ref_tags[(k + j) % shape->references] : 0;
+			len += tag == TAG_InterfaceMethodref ? 5 :
+			    tag == 0 ? 1 : 3;
+		}
+		buf_u2(out, code);
+		buf_u4(out, 12 + len);
+		buf_u2(out, 4);
+		buf_u2(out, 4);
+		buf_u4(out, len);
+		for (j = 0; j < shape->instructions; j++) {
+			if (shape->references == 0) {
+				buf_u1(out, 0x00);	// nop
+				continue;
+			}
+			index = refs[(k + j) % shape->references];
+			switch (ref_tags[(k + j) % shape->references]) {
+			case TAG_Fieldref:
+				buf_u1(out, 0xb2);	// getstatic
+				buf_u2(out, index);
+				break;
+			case TAG_InterfaceMethodref:
+				buf_u1(out, 0xb9);	// invokeinterface
+				buf_u2(out, index);
+				buf_u1(out, 1);
+				buf_u1(out, 0);
+				break;
+			default:
+				buf_u1(out, 0xb6);	// invokevirtual
+				buf_u2(out, index);
+			}
+		}
+		buf_u1(out, 0xb1);			// return
+		buf_u2(out, 0);
+		buf_u2(out, 0);
+		put_extra_attribute(out, extra, shape->attribute);
+	}
+
+	// Write the class' attributes.
+	buf_u2(out, 2);
+	buf_u2(out, source);
+	buf_u4(out, 2);
+	buf_u2(out, file_name);
+	put_extra_attribute(out, extra, shape->attribute);
+	set->offsets[n + 1] = out->len;
+
+	free(pool.p);
+	free(field_names);
+	free(method_names);
+	free(refs);
+	free(ref_tags);
+	free(classes);
+}
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Ignores the event, so that a pass times only the parser.
+ */
+static int
+ignore_event(void *arg, const struct jcf_parse_event *event)
+{
+	(void)arg;
+	(void)event;
+	return (0);
+}
+
+/*
+ * Requires:
+ *   "arg" must point to a struct bench_output.
+ *
+ * Effects:
+ *   Formats the event into the output buffer as readjcf prints it.
+ */
+static int
+format_event(void *arg, const struct jcf_parse_event *event)
+{
+	static const char *const kinds[] = {
+		[JCF_PARSE_DEPENDENCY] = "Dependency - ",
+		[JCF_PARSE_EXPORT] = "Export - ",
+		[JCF_PARSE_ATTRIBUTE] = "Attribute - ",
+		[JCF_PARSE_REFERENCE] = "Reference - "
+	};
+	struct bench_output *output = arg;
+	struct jcf_out *out = &output->out;
+
+	jcf_out_str(out, kinds[event->kind]);
+	if (event->kind == JCF_PARSE_REFERENCE) {
+		jcf_out_bytes(out, event->member, event->member_length);
+		jcf_out_char(out, ' ');
+		jcf_out_u32(out, event->value);
+		jcf_out_char(out, ' ');
+		jcf_out_str(out, event->mnemonic);
+		jcf_out_char(out, ' ');
+	}
+	jcf_out_bytes(out, event->text, event->length);
+	if (event->kind == JCF_PARSE_ATTRIBUTE) {
+		jcf_out_char(out, ' ');
+		jcf_out_u32(out, event->value);
+	}
+	jcf_out_char(out, '\n');
+	return (out->err);
+}
+
+/*
+ * Requires:
+ *   "parser" must have been returned by jcf_parser_create().
+ *
+ * Effects:
+ *   Parses every class file of "set" once with the events of "readjcf
+ *   -d -e -a -m".  Returns the elapsed time in nanoseconds.  Exits if a
+ *   class file fails to parse, which would make the figures meaningless.
+ */
+static uint64_t
+run_pass(struct jcf_parser *parser, const struct bench_set *set,
+    jcf_parse_callback *callback, void *arg)
+{
+	unsigned int events = JCF_PARSE_EVENT(JCF_PARSE_DEPENDENCY) |
+	    JCF_PARSE_EVENT(JCF_PARSE_EXPORT) |
+	    JCF_PARSE_EVENT(JCF_PARSE_ATTRIBUTE) |
+	    JCF_PARSE_EVENT(JCF_PARSE_REFERENCE);
+	struct bench_output *output = callback == format_event ? arg : NULL;
+	uint64_t start;
+	long n;
+
+	start = now_ns();
+	for (n = 0; n < set->count; n++) {
+		if (output != NULL) {
+			output->bytes += output->out.len;
+			jcf_out_reset(&output->out);
+		}
+		if (jcf_parse(parser, set->bytes.p + set->offsets[n],
+		    set->offsets[n + 1] - set->offsets[n], events, callback,
+		    arg) != 0) {
+			fprintf(stderr, "jcf_bench: class file %ld failed to "
+			    "parse\n", n);
+			exit(1);
+		}
+	}
+	if (output != NULL) {
+		output->bytes += output->out.len;
+		jcf_out_reset(&output->out);
+	}
+	return (now_ns() - start);
+}
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Writes each class file of "set" to "dir/C<n>.class", creating the
+ *   directory if needed.  Returns 0 on success and -1 on failure.
+ */
+static int
+write_set(const struct bench_set *set, const char *dir)
+{
+	char path[4096];
+	FILE *fp;
+	size_t len;
+	long n;
+
+	if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+		return (-1);
+	for (n = 0; n < set->count; n++) {
+		snprintf(path, sizeof(path), "%s/C%ld.class", dir, n);
+		if ((fp = fopen(path, "wb")) == NULL)
+			return (-1);
+		len = set->offsets[n + 1] - set->offsets[n];
+		if (fwrite(set->bytes.p + set->offsets[n], 1, len, fp) != len) {
+			fclose(fp);
+			return (-1);
+		}
+		if (fclose(fp) != 0)
+			return (-1);
+	}
+	return (0);
+}
+
+/*
+ * Requires:
+ *   "a" and "b" must point to uint64_ts.
+ *
+ * Effects:
+ *   Compares the numbers for qsort().
+ */
+static int
+compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x < y ? -1 : x > y);
+}
+
+/*
+ * Requires:
+ *   "values" must hold "count" numbers, and "count" must be at least 1.
+ *
+ * Effects:
+ *   Sorts the numbers and returns their median.
+ */
+static uint64_t
+median(uint64_t *values, long count)
+{
+	qsort(values, count, sizeof(*values), compare_u64);
+	return (count % 2 == 1 ? values[count / 2] :
+	    (values[count / 2 - 1] + values[count / 2]) / 2);
+}
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Returns the monotonic time in nanoseconds.
+ */
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Generates the class files, runs the benchmark, and prints a line
+ *   per phase followed by the totals.
+ */
+int
+main(int argc, char **argv)
+{
+	struct bench_shape shape = { 2000, 256, 50, 10, 0, 32, 8, 16, 8, 16,
+	    1 };
+	struct bench_set set = { { NULL, 0, 0 }, NULL, 0, 0 };
+	struct bench_round *rounds;
+	struct bench_output output;
+	struct jcf_parser *parser;
+	const char *dir = NULL;
+	uint64_t *values, phase_nsec[JCF_PARSE_PHASES], parse_nsec;
+	uint64_t bare, strict, full, output_nsec, allocs, total_nsec, spread;
+	long nrounds = 7, r, n, *option;
+	double files, mb;
+	char *end;
+	int c, p;
+
+	while ((c = getopt(argc, argv, "a:c:d:f:i:m:n:o:r:s:u:w:x:")) != -1) {
+		switch (c) {
+		case 'a':
+			option = &shape.attribute;
+			break;
+		case 'c':
+			option = &shape.constants;
+			break;
+		case 'd':
+			option = &shape.references;
+			break;
+		case 'f':
+			option = &shape.fields;
+			break;
+		case 'i':
+			option = &shape.instructions;
+			break;
+		case 'm':
+			option = &shape.methods;
+			break;
+		case 'n':
+			option = &shape.files;
+			break;
+		case 'r':
+			option = &nrounds;
+			break;
+		case 'u':
+			option = &shape.utf8;
+			break;
+		case 'w':
+			option = &shape.wide;
+			break;
+		case 'x':
+			option = &shape.non_ascii;
+			break;
+		case 'o':
+			dir = optarg;
+			continue;
+		case 's':
+			shape.seed = strtoull(optarg, &end, 10);
+			if (*end != '\0' || shape.seed == 0)
+				goto usage;
+			continue;
+		default:
+			goto usage;
+		}
+		*option = strtol(optarg, &end, 10);
+		if (*end != '\0' || *option < 0)
+			goto usage;
+	}
+
+	/*
+	 * Keep the pool within its 16-bit count, even when the members
+	 * and references alone would fill it.
+	 */
+	if (optind != argc || shape.files < 1 || nrounds < 1 ||
+	    shape.utf8 + shape.wide > 100 || shape.non_ascii > 100 ||
+	    shape.constants > 65535 ||
+	    shape.fields > 4096 || shape.methods > 4096 ||
+	    shape.references > 8192 || shape.instructions > 4096 ||
+	    shape.attribute > 65536 || 16 + shape.fields + shape.methods +
+	    4 * shape.references > 65535) {
+usage:
+		fprintf(stderr, "usage: %s [-a <bytes>] [-c <constants>] "
+		    "[-d <references>] [-f <fields>] [-i <instructions>] "
+		    "[-m <methods>] [-n <files>] [-o <directory>] "
+		    "[-r <rounds>] [-s <seed>] [-u <percent>] "
+		    "[-w <percent>] [-x <percent>]\n", argv[0]);
+		return (1);
+	}
+
+	// Generate the class files.
+	rng_state = shape.seed * 0x9e3779b97f4a7c15;
+	set.count = shape.files;
+	set.offsets = malloc((shape.files + 1) * sizeof(*set.offsets));
+	rounds = calloc(nrounds + 1, sizeof(*rounds));
+	values = malloc((nrounds + 1) * sizeof(*values));
+	parser = jcf_parser_create();
+	if (set.offsets == NULL || rounds == NULL || values == NULL ||
+	    parser == NULL) {
+		perror("jcf_bench");
+		return (1);
+	}
+	for (n = 0; n < shape.files; n++)
+		generate_class(&shape, n, &set);
+	if (dir != NULL && write_set(&set, dir) != 0) {
+		perror(dir);
+		return (1);
+	}
+
+	// Run the rounds, the first of which warms up and is not counted.
+	jcf_out_init(&output.out, -1);
+	for (r = 0; r <= nrounds; r++) {
+		jcf_parser_stats(parser, &rounds[r].stats);
+		run_pass(parser, &set, ignore_event, NULL);
+		jcf_parser_stats(parser, NULL);
+		rounds[r].bare_nsec = run_pass(parser, &set, ignore_event,
+		    NULL);
+		jcf_parser_strict(parser, true);
+		rounds[r].strict_nsec = run_pass(parser, &set, ignore_event,
+		    NULL);
+		jcf_parser_strict(parser, false);
+		output.bytes = 0;
+		allocs = allocations;
+		rounds[r].full_nsec = run_pass(parser, &set, format_event,
+		    &output);
+		rounds[r].allocations = allocations - allocs;
+		rounds[r].output_bytes = output.bytes;
+	}
+
+	// Take the median of each figure over the counted rounds.
+	for (p = 0; p < JCF_PARSE_PHASES; p++) {
+		for (r = 0; r < nrounds; r++)
+			values[r] = rounds[r + 1].stats.nsec[p];
+		phase_nsec[p] = median(values, nrounds);
+	}
+	for (r = 0; r < nrounds; r++)
+		values[r] = rounds[r + 1].bare_nsec;
+	bare = median(values, nrounds);
+	spread = values[nrounds - 1] - values[0];
+	for (r = 0; r < nrounds; r++)
+		values[r] = rounds[r + 1].strict_nsec;
+	strict = median(values, nrounds);
+	for (r = 0; r < nrounds; r++)
+		values[r] = rounds[r + 1].full_nsec;
+	full = median(values, nrounds);
+	for (r = 0; r < nrounds; r++)
+		values[r] = rounds[r + 1].allocations;
+	allocs = median(values, nrounds);
+	output_nsec = full > bare ? full - bare : 0;
+	for (p = 0, parse_nsec = 0; p < JCF_PARSE_PHASES; p++)
+		parse_nsec += phase_nsec[p];
+	total_nsec = parse_nsec + output_nsec;
+
+	files = set.count;
+	mb = set.bytes.len / 1e6;
+	printf("%ld files, %.2f MB, %.0f constants/file, %ld fields, "
+	    "%ld methods, %ld rounds, seed %" PRIu64 "\n", set.count, mb,
+	    set.constants / files, shape.fields, shape.methods, nrounds,
+	    shape.seed);
+	printf("%-14s %12s %8s %12s\n", "phase", "ns/file", "share",
+	    "bytes/file");
+	for (p = 0; p < JCF_PARSE_PHASES; p++) {
+		printf("%-14s %12.1f %7.1f%% %12.1f\n", phase_names[p],
+		    phase_nsec[p] / files, total_nsec > 0 ? 100.0 *
+		    phase_nsec[p] / total_nsec : 0.0,
+		    rounds[1].stats.bytes[p] / files);
+	}
+	printf("%-14s %12.1f %7.1f%% %12.1f\n", "output",
+	    output_nsec / files, total_nsec > 0 ? 100.0 * output_nsec /
+	    total_nsec : 0.0, rounds[1].output_bytes / files);
+	printf("parse only:       %10.0f files/s %10.1f MB/s "
+	    "(rounds within %.1f%%)\n", files * 1e9 / bare, mb * 1e9 / bare,
+	    100.0 * spread / bare);
+	printf("strict parse:     %10.0f files/s %10.1f MB/s "
+	    "(%+.1f ns/file)\n", files * 1e9 / strict, mb * 1e9 / strict,
+	    ((double)strict - bare) / files);
+	printf("parse and output: %10.0f files/s %10.1f MB/s\n",
+	    files * 1e9 / full, mb * 1e9 / full);
+	printf("allocations/file: %10.3f (%.3f in the first round)\n",
+	    allocs / files, rounds[0].allocations / files);
+
+	jcf_out_destroy(&output.out);
+	jcf_parser_destroy(parser);
+	free(set.bytes.p);
+	free(set.offsets);
+	free(rounds);
+	free(values);
+	return (0);
+}
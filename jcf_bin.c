@@ -0,0 +1,287 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * A binary form of the output lines, written in one pass and mapped to
+ * be read.
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "jcf_bin.h"
+
+// Define the initial number of slots of the hash index.
+#define JCF_BIN_SLOTS		1024
+
+static uint64_t	jcf_bin_hash(const char *bytes, size_t length);
+static int	jcf_bin_grow(struct jcf_bin_writer *writer);
+static bool	jcf_bin_fits(uint64_t offset, uint64_t length,
+		    uint64_t size);
+
+/*
+ * Requires:
+ *   "bytes" must point to "length" bytes.
+ *
+ * Effects:
+ *   Returns the 64-bit FNV-1a hash of the string.
+ */
+static uint64_t
+jcf_bin_hash(const char *bytes, size_t length)
+{
+	uint64_t hash = 0xcbf29ce484222325;
+	size_t i;
+
+	for (i = 0; i < length; i++)
+		hash = (hash ^ (uint8_t)bytes[i]) * 0x100000001b3;
+	return (hash);
+}
+
+/*
+ * Requires:
+ *   "writer" must have been started by jcf_bin_create().
+ *
+ * Effects:
+ *   Doubles the writer's hash index, rehashing its strings by the upper
+ *   half of their hashes, which their slots keep.  Returns 0 on success
+ *   and -1 on failure.
+ */
+static int
+jcf_bin_grow(struct jcf_bin_writer *writer)
+{
+	uint64_t *slots;
+	size_t i, j, mask = writer->mask * 2 + 1;
+
+	slots = calloc(mask + 1, sizeof(*slots));
+	if (slots == NULL)
+		return (-1);
+	for (i = 0; i <= writer->mask; i++) {
+		if (writer->slots[i] == 0)
+			continue;
+		for (j = (writer->slots[i] >> 32) & mask; slots[j] != 0;
+		    j = (j + 1) & mask)
+			;
+		slots[j] = writer->slots[i];
+	}
+	free(writer->slots);
+	writer->slots = slots;
+	writer->mask = mask;
+	return (0);
+}
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Returns true if "length" bytes at "offset" lie within "size" bytes.
+ */
+static bool
+jcf_bin_fits(uint64_t offset, uint64_t length, uint64_t size)
+{
+	return (offset <= size && length <= size - offset);
+}
+
+int
+jcf_bin_create(struct jcf_bin_writer *writer, const char *path)
+{
+	struct jcf_bin_header header;
+
+	writer->path = strdup(path);
+	writer->tmp = malloc(strlen(path) + sizeof(".tmp-XXXXXX"));
+	writer->slots = calloc(JCF_BIN_SLOTS, sizeof(*writer->slots));
+	if (writer->path == NULL || writer->tmp == NULL ||
+	    writer->slots == NULL)
+		goto fail;
+	sprintf(writer->tmp, "%s.tmp-XXXXXX", path);
+	if ((writer->fd = mkstemp(writer->tmp)) < 0)
+		goto fail;
+	writer->mask = JCF_BIN_SLOTS - 1;
+	writer->nstrings = 0;
+	writer->nrecords = 0;
+	writer->err = 0;
+	jcf_out_init(&writer->out, writer->fd);
+	jcf_out_init(&writer->strings, -1);
+	jcf_out_init(&writer->bytes, -1);
+
+	memset(&header, 0, sizeof(header));
+	header.magic = JCF_BIN_MAGIC;
+	header.version = JCF_BIN_VERSION;
+	header.record_size = sizeof(struct jcf_bin_record);
+	jcf_out_bytes(&writer->out, &header, sizeof(header));
+	return (0);
+
+fail:
+	free(writer->path);
+	free(writer->tmp);
+	free(writer->slots);
+	return (-1);
+}
+
+int
+jcf_bin_intern(struct jcf_bin_writer *writer, const char *bytes,
+    size_t length, uint32_t *idp)
+{
+	struct jcf_bin_string entry;
+	uint64_t hash = jcf_bin_hash(bytes, length);
+	uint64_t tag = hash & ~(uint64_t)0xffffffff;
+	uint32_t index;
+	size_t i;
+
+	if (length > UINT32_MAX || writer->bytes.len > UINT32_MAX - length ||
+	    writer->nstrings == UINT32_MAX - 1)
+		goto fail;
+
+	// Keep the index at most half full, counting a string to be added.
+	if (2 * ((size_t)writer->nstrings + 1) > writer->mask + 1 &&
+	    jcf_bin_grow(writer) != 0)
+		goto fail;
+
+	// Look the string up.
+	for (i = (hash >> 32) & writer->mask; writer->slots[i] != 0;
+	    i = (i + 1) & writer->mask) {
+		if ((writer->slots[i] & ~(uint64_t)0xffffffff) != tag)
+			continue;
+		index = (writer->slots[i] & 0xffffffff) - 1;
+		memcpy(&entry, writer->strings.buf + (size_t)index *
+		    sizeof(entry), sizeof(entry));
+		if (entry.length == length && memcmp(writer->bytes.buf +
+		    entry.offset, bytes, length) == 0) {
+			*idp = index;
+			return (0);
+		}
+	}
+
+	// Add the string.
+	entry.offset = writer->bytes.len;
+	entry.length = length;
+	jcf_out_bytes(&writer->strings, &entry, sizeof(entry));
+	jcf_out_bytes(&writer->bytes, bytes, length);
+	if (writer->strings.err != 0 || writer->bytes.err != 0)
+		goto fail;
+	index = writer->nstrings++;
+	writer->slots[i] = tag | (index + 1);
+	*idp = index;
+	return (0);
+
+fail:
+	writer->err = -1;
+	return (-1);
+}
+
+void
+jcf_bin_add(struct jcf_bin_writer *writer,
+    const struct jcf_bin_record *record)
+{
+	jcf_out_bytes(&writer->out, record, sizeof(*record));
+	writer->nrecords++;
+}
+
+int
+jcf_bin_finish(struct jcf_bin_writer *writer)
+{
+	struct jcf_bin_trailer trailer;
+	static const char padding[sizeof(uint64_t)];
+	int err = writer->err;
+
+	/*
+	 * The tables follow the records, and the trailer is aligned so that
+	 * it can be read in place.
+	 */
+	trailer.records = sizeof(struct jcf_bin_header);
+	trailer.nrecords = writer->nrecords;
+	trailer.strings = trailer.records + writer->nrecords *
+	    sizeof(struct jcf_bin_record);
+	trailer.nstrings = writer->nstrings;
+	trailer.bytes = trailer.strings + writer->strings.len;
+	trailer.bytes_length = writer->bytes.len;
+	trailer.version = JCF_BIN_VERSION;
+	trailer.magic = JCF_BIN_MAGIC;
+	jcf_out_bytes(&writer->out, writer->strings.buf, writer->strings.len);
+	jcf_out_bytes(&writer->out, writer->bytes.buf, writer->bytes.len);
+	jcf_out_bytes(&writer->out, padding, -(trailer.bytes +
+	    trailer.bytes_length) % sizeof(padding));
+	jcf_out_bytes(&writer->out, &trailer, sizeof(trailer));
+	if (fchmod(writer->fd, 0644) != 0 || jcf_out_flush(&writer->out) != 0)
+		err = -1;
+	if (close(writer->fd) != 0 || (err == 0 && rename(writer->tmp,
+	    writer->path) != 0))
+		err = -1;
+	if (err != 0)
+		unlink(writer->tmp);
+	jcf_out_destroy(&writer->out);
+	jcf_out_destroy(&writer->strings);
+	jcf_out_destroy(&writer->bytes);
+	free(writer->slots);
+	free(writer->path);
+	free(writer->tmp);
+	return (err);
+}
+
+int
+jcf_bin_open(struct jcf_bin *bin, const char *path)
+{
+	const struct jcf_bin_header *header;
+	const struct jcf_bin_trailer *trailer;
+	struct stat sb;
+	void *base;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return (-1);
+	if (fstat(fd, &sb) != 0 || !S_ISREG(sb.st_mode) ||
+	    (uint64_t)sb.st_size < sizeof(*header) + sizeof(*trailer) ||
+	    sb.st_size % sizeof(uint64_t) != 0) {
+		close(fd);
+		return (-1);
+	}
+	base = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+		return (-1);
+
+	// Check that the tables are where they can be read in place.
+	header = base;
+	trailer = (const void *)((const uint8_t *)base + sb.st_size -
+	    sizeof(*trailer));
+	if (header->magic != JCF_BIN_MAGIC ||
+	    header->version != JCF_BIN_VERSION ||
+	    header->record_size != sizeof(struct jcf_bin_record) ||
+	    trailer->magic != JCF_BIN_MAGIC ||
+	    trailer->version != JCF_BIN_VERSION ||
+	    trailer->records % sizeof(uint32_t) != 0 ||
+	    trailer->strings % sizeof(uint32_t) != 0 ||
+	    trailer->nrecords > sb.st_size / sizeof(struct jcf_bin_record) ||
+	    trailer->nstrings > sb.st_size / sizeof(struct jcf_bin_string) ||
+	    !jcf_bin_fits(trailer->records, trailer->nrecords *
+	    sizeof(struct jcf_bin_record), sb.st_size) ||
+	    !jcf_bin_fits(trailer->strings, trailer->nstrings *
+	    sizeof(struct jcf_bin_string), sb.st_size) ||
+	    !jcf_bin_fits(trailer->bytes, trailer->bytes_length,
+	    sb.st_size)) {
+		munmap(base, sb.st_size);
+		return (-1);
+	}
+	bin->base = base;
+	bin->len = sb.st_size;
+	bin->records = (const void *)(bin->base + trailer->records);
+	bin->nrecords = trailer->nrecords;
+	bin->strings = (const void *)(bin->base + trailer->strings);
+	bin->nstrings = trailer->nstrings;
+	bin->bytes = (const char *)bin->base + trailer->bytes;
+	bin->bytes_length = trailer->bytes_length;
+	return (0);
+}
+
+void
+jcf_bin_close(struct jcf_bin *bin)
+{
+	munmap((void *)bin->base, bin->len);
+	bin->base = NULL;
+	bin->len = 0;
+}
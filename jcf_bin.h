@@ -0,0 +1,201 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * A binary form of the "Dependency" and "Export" lines, written in one
+ * sequential pass and mapped, not parsed, by the programs that read it.
+ * Each line is a fixed-size record that names its strings by their
+ * indices in a string table, which holds each distinct string once.
+ *
+ * The file starts with a header, which is followed by the records, in
+ * the order in which the lines would have been printed, the string
+ * table, the bytes of the strings, and a trailer.  The strings are
+ * numbered in the order in which the records first name them.  Because
+ * the tables' sizes are not known until the last record is written,
+ * their offsets and counts are in the trailer, which is the last bytes
+ * of the file.  The file is in host byte order.
+ */
+
+#ifndef JCF_BIN_H
+#define JCF_BIN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "jcf_out.h"
+
+// Define the magic number, which reads "JCFB" in little-endian order.
+#define JCF_BIN_MAGIC		0x4246434a
+
+// Define the version of the file format.
+#define JCF_BIN_VERSION		1
+
+// Define an enumeration of the kinds of records.
+enum jcf_bin_kind {
+	JCF_BIN_DEPENDENCY,	// a field or method that the class references
+	JCF_BIN_EXPORT		// a public field or method of the class
+};
+
+// Define the header of a binary file.
+struct jcf_bin_header {
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	record_size;	// sizeof(struct jcf_bin_record)
+	uint32_t	reserved;	// 0
+};
+
+/*
+ * Define a record.  The strings are indices into the string table.  The
+ * file is the class file's path, as the line's prefix names it, and the
+ * class, name and descriptor are the parts of "class.name descriptor"
+ * as the class file gives them, so a name or descriptor may hold spaces.
+ */
+struct jcf_bin_record {
+	uint32_t	kind;		// an enum jcf_bin_kind
+	uint32_t	file;
+	uint32_t	class;
+	uint32_t	name;
+	uint32_t	descriptor;
+};
+
+// Define an entry of the string table.  The offset is into the bytes.
+struct jcf_bin_string {
+	uint32_t	offset;
+	uint32_t	length;
+};
+
+// Define the trailer of a binary file.  Offsets are from its start.
+struct jcf_bin_trailer {
+	uint64_t	records;	// offset of the records
+	uint64_t	nrecords;
+	uint64_t	strings;	// offset of the string table
+	uint64_t	nstrings;
+	uint64_t	bytes;		// offset of the strings' bytes
+	uint64_t	bytes_length;
+	uint32_t	version;
+	uint32_t	magic;		// last, to catch a file cut short
+};
+
+// Define a binary file that is being written.
+struct jcf_bin_writer {
+	char		*path;
+	char		*tmp;		// written and renamed over "path"
+	int		fd;
+	struct jcf_out	out;		// the header and records
+	struct jcf_out	strings;	// the string table
+	struct jcf_out	bytes;		// the strings' bytes
+	uint64_t	*slots;		// hash and one more than an index
+	size_t		mask;
+	uint32_t	nstrings;
+	uint64_t	nrecords;
+	int		err;		// set once anything fails
+};
+
+// Define a binary file that has been opened.
+struct jcf_bin {
+	const uint8_t	*base;
+	size_t		len;
+	const struct jcf_bin_record *records;
+	uint64_t	nrecords;
+	const struct jcf_bin_string *strings;
+	uint64_t	nstrings;
+	const char	*bytes;
+	uint64_t	bytes_length;
+};
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Starts writing a binary file that will replace the file "path"
+ *   whole, through a temporary file that is renamed over it by
+ *   jcf_bin_finish(), and writes its header.  Returns 0 on success and
+ *   -1 on failure.
+ */
+int	jcf_bin_create(struct jcf_bin_writer *writer, const char *path);
+
+/*
+ * Requires:
+ *   "writer" must have been started by jcf_bin_create().  "bytes" must
+ *   point to "length" bytes.
+ *
+ * Effects:
+ *   Stores in "*idp" the index of the string in the string table,
+ *   adding it if it is not there already.  Returns 0 on success and -1
+ *   on failure.
+ */
+int	jcf_bin_intern(struct jcf_bin_writer *writer, const char *bytes,
+	    size_t length, uint32_t *idp);
+
+/*
+ * Requires:
+ *   "writer" must have been started by jcf_bin_create().  The strings of
+ *   "record" must have been interned by jcf_bin_intern().
+ *
+ * Effects:
+ *   Appends the record to the file.  A failure is reported by
+ *   jcf_bin_finish().
+ */
+void	jcf_bin_add(struct jcf_bin_writer *writer,
+	    const struct jcf_bin_record *record);
+
+/*
+ * Requires:
+ *   "writer" must have been started by jcf_bin_create().
+ *
+ * Effects:
+ *   Writes the string table and the trailer, renames the file into
+ *   place, and frees the writer's memory.  If anything failed since the
+ *   writer was started, removes the temporary file instead.  Returns 0
+ *   on success and -1 on failure.
+ */
+int	jcf_bin_finish(struct jcf_bin_writer *writer);
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Maps the binary file "path" into "bin" and checks its header, its
+ *   trailer and the bounds of its tables.  Returns 0 on success and -1
+ *   if the file cannot be mapped or is not a binary file of this
+ *   version.
+ */
+int	jcf_bin_open(struct jcf_bin *bin, const char *path);
+
+/*
+ * Requires:
+ *   "bin" must have been opened by jcf_bin_open().
+ *
+ * Effects:
+ *   Unmaps the binary file.
+ */
+void	jcf_bin_close(struct jcf_bin *bin);
+
+/*
+ * Requires:
+ *   "bin" must have been opened by jcf_bin_open().
+ *
+ * Effects:
+ *   Returns string "id" of the string table, which is not NUL
+ *   terminated and stays valid until the file is closed, and stores
+ *   its length in "*lengthp".  Returns NULL if there is no such string
+ *   or its bytes lie outside the file.
+ */
+static inline const char *
+jcf_bin_string(const struct jcf_bin *bin, uint32_t id, size_t *lengthp)
+{
+	const struct jcf_bin_string *string;
+
+	if (id >= bin->nstrings)
+		return (NULL);
+	string = &bin->strings[id];
+	if (string->offset > bin->bytes_length ||
+	    string->length > bin->bytes_length - string->offset)
+		return (NULL);
+	*lengthp = string->length;
+	return (bin->bytes + string->offset);
+}
+
+#endif /* JCF_BIN_H */
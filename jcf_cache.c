@@ -0,0 +1,342 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * A persistent cache of the results of processing class files, kept as
+ * one entry file per class file.
+ */
+
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "jcf_cache.h"
+
+// Define the magic number and version of an entry.
+#define JCF_CACHE_MAGIC		"JCFC"
+#define JCF_CACHE_VERSION	1
+
+// Define the largest entry that is read.
+#define JCF_CACHE_MAX_ENTRY	(64 * 1024 * 1024)
+
+// Define the primes of the hash function, which follows xxHash64.
+#define JCF_CACHE_PRIME1	0x9e3779b185ebca87
+#define JCF_CACHE_PRIME2	0xc2b2ae3d27d4eb4f
+#define JCF_CACHE_PRIME3	0x165667b19e3779f9
+#define JCF_CACHE_PRIME4	0x85ebca77c2b2ae63
+#define JCF_CACHE_PRIME5	0x27d4eb2f165667c5
+
+/*
+ * Define the header of an entry, which is followed by the class file's
+ * path and then the results.  Fields are in host byte order; an entry
+ * written on a machine of the other byte order fails the version check.
+ */
+struct jcf_cache_header {
+	char		magic[4];
+	uint32_t	version;
+	uint64_t	options;
+	uint64_t	size;
+	int64_t		mtime_sec;
+	int64_t		mtime_nsec;
+	uint64_t	hash;		// of the class file's contents
+	uint32_t	path_length;
+	uint32_t	results_length;
+	uint64_t	check;		// of the results, seeded by the path's
+};
+
+static uint64_t	jcf_cache_rotl(uint64_t x, int r);
+static uint64_t	jcf_cache_round(uint64_t acc, uint64_t input);
+static char	*jcf_cache_path(const struct jcf_cache *cache, const char *path);
+static int	jcf_cache_read(int fd, void *buf, size_t len);
+
+/*
+ * Requires:
+ *   "r" must be between 1 and 63.
+ *
+ * Effects:
+ *   Returns "x" rotated left by "r" bits.
+ */
+static uint64_t
+jcf_cache_rotl(uint64_t x, int r)
+{
+	return ((x << r) | (x >> (64 - r)));
+}
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Returns the accumulator "acc" after mixing in the word "input".
+ */
+static uint64_t
+jcf_cache_round(uint64_t acc, uint64_t input)
+{
+	acc += input * JCF_CACHE_PRIME2;
+	return (jcf_cache_rotl(acc, 31) * JCF_CACHE_PRIME1);
+}
+
+/*
+ * Requires:
+ *   "path" must be a NUL-terminated path.
+ *
+ * Effects:
+ *   Returns the malloc()ed path of the entry for the class file "path",
+ *   or NULL if memory could not be allocated.
+ */
+static char *
+jcf_cache_path(const struct jcf_cache *cache, const char *path)
+{
+	uint64_t hash;
+	size_t len;
+	char *name;
+
+	hash = jcf_cache_hash(cache->options, path, strlen(path));
+	len = strlen(cache->dir) + 1 + 16 + 1;
+	if ((name = malloc(len)) == NULL)
+		return (NULL);
+	snprintf(name, len, "%s/%016llx", cache->dir,
+	    (unsigned long long)hash);
+	return (name);
+}
+
+/*
+ * Requires:
+ *   "fd" must be an open file descriptor.  "buf" must point to at least
+ *   "len" bytes.
+ *
+ * Effects:
+ *   Reads exactly "len" bytes, retrying after short reads and
+ *   interrupted calls.  Returns 0 on success and -1 on failure or if
+ *   the file ends first.
+ */
+static int
+jcf_cache_read(int fd, void *buf, size_t len)
+{
+	ssize_t n;
+
+	while (len > 0) {
+		n = read(fd, buf, len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return (-1);
+		buf = (char *)buf + n;
+		len -= n;
+	}
+	return (0);
+}
+
+int
+jcf_cache_open(struct jcf_cache *cache, const char *dir, uint64_t options)
+{
+	struct stat sb;
+
+	if (mkdir(dir, 0777) != 0 && errno != EEXIST)
+		return (-1);
+	if (stat(dir, &sb) != 0 || !S_ISDIR(sb.st_mode))
+		return (-1);
+	if ((cache->dir = strdup(dir)) == NULL)
+		return (-1);
+	cache->options = options;
+	atomic_init(&cache->hits, 0);
+	atomic_init(&cache->misses, 0);
+	return (0);
+}
+
+void
+jcf_cache_close(struct jcf_cache *cache)
+{
+	free(cache->dir);
+	cache->dir = NULL;
+}
+
+uint64_t
+jcf_cache_hash(uint64_t seed, const void *p, size_t len)
+{
+	const uint8_t *bytes = p, *end = bytes + len;
+	uint64_t hash, v[4], word;
+	uint32_t half;
+	int i;
+
+	// Hash 32-byte blocks in four independent lanes.
+	if (len >= 32) {
+		v[0] = seed + JCF_CACHE_PRIME1 + JCF_CACHE_PRIME2;
+		v[1] = seed + JCF_CACHE_PRIME2;
+		v[2] = seed;
+		v[3] = seed - JCF_CACHE_PRIME1;
+		do {
+			for (i = 0; i < 4; i++) {
+				memcpy(&word, bytes + 8 * i, sizeof(word));
+				v[i] = jcf_cache_round(v[i], word);
+			}
+			bytes += 32;
+		} while (end - bytes >= 32);
+		hash = jcf_cache_rotl(v[0], 1) + jcf_cache_rotl(v[1], 7) +
+		    jcf_cache_rotl(v[2], 12) + jcf_cache_rotl(v[3], 18);
+		for (i = 0; i < 4; i++) {
+			hash ^= jcf_cache_round(0, v[i]);
+			hash = hash * JCF_CACHE_PRIME1 + JCF_CACHE_PRIME4;
+		}
+	} else
+		hash = seed + JCF_CACHE_PRIME5;
+	hash += len;
+
+	// Hash the remaining bytes.
+	for (; end - bytes >= 8; bytes += 8) {
+		memcpy(&word, bytes, sizeof(word));
+		hash ^= jcf_cache_round(0, word);
+		hash = jcf_cache_rotl(hash, 27) * JCF_CACHE_PRIME1 +
+		    JCF_CACHE_PRIME4;
+	}
+	if (end - bytes >= 4) {
+		memcpy(&half, bytes, sizeof(half));
+		hash ^= half * JCF_CACHE_PRIME1;
+		hash = jcf_cache_rotl(hash, 23) * JCF_CACHE_PRIME2 +
+		    JCF_CACHE_PRIME3;
+		bytes += 4;
+	}
+	for (; bytes < end; bytes++) {
+		hash ^= (uint64_t)*bytes * JCF_CACHE_PRIME5;
+		hash = jcf_cache_rotl(hash, 11) * JCF_CACHE_PRIME1;
+	}
+
+	// Mix the final bits.
+	hash ^= hash >> 33;
+	hash *= JCF_CACHE_PRIME2;
+	hash ^= hash >> 29;
+	hash *= JCF_CACHE_PRIME3;
+	hash ^= hash >> 32;
+	return (hash);
+}
+
+enum jcf_cache_status
+jcf_cache_find(struct jcf_cache *cache, const struct jcf_cache_key *key,
+    struct jcf_out *results)
+{
+	struct jcf_cache_header *header;
+	enum jcf_cache_status status = JCF_CACHE_MISS;
+	struct stat sb;
+	size_t path_length = strlen(key->path);
+	char *name, *buf = NULL, *body;
+	int fd = -1;
+
+	// Read the whole entry.
+	if ((name = jcf_cache_path(cache, key->path)) != NULL)
+		fd = open(name, O_RDONLY);
+	free(name);
+	if (fd < 0 || fstat(fd, &sb) != 0 ||
+	    sb.st_size < (off_t)sizeof(*header) ||
+	    sb.st_size > JCF_CACHE_MAX_ENTRY ||
+	    (buf = malloc(sb.st_size)) == NULL ||
+	    jcf_cache_read(fd, buf, sb.st_size) != 0)
+		goto done;
+	header = (struct jcf_cache_header *)buf;
+	body = buf + sizeof(*header);
+
+	/*
+	 * Check that the entry is whole and is for this path and these
+	 * options.  Two paths can share an entry file only if their hashes
+	 * collide, and then the path does not match.
+	 */
+	if (memcmp(header->magic, JCF_CACHE_MAGIC, 4) != 0 ||
+	    header->version != JCF_CACHE_VERSION ||
+	    header->options != cache->options ||
+	    header->path_length != path_length ||
+	    sizeof(*header) + (size_t)header->path_length +
+	    header->results_length != (size_t)sb.st_size ||
+	    memcmp(body, key->path, path_length) != 0 ||
+	    header->check != jcf_cache_hash(jcf_cache_hash(0, body,
+	    path_length), body + path_length, header->results_length))
+		goto done;
+
+	if (header->size != key->size)
+		goto done;
+	if (key->hashed)
+		status = header->hash == key->hash ? JCF_CACHE_HIT :
+		    JCF_CACHE_MISS;
+	else if (header->mtime_sec != key->mtime_sec ||
+	    header->mtime_nsec != key->mtime_nsec)
+		status = JCF_CACHE_VERIFY;
+	else {
+		/*
+		 * A file that was modified no earlier than the entry was
+		 * written could have been modified again within the same
+		 * tick of the clock, so its time proves nothing.
+		 */
+		status = key->mtime_sec < sb.st_mtim.tv_sec ||
+		    (key->mtime_sec == sb.st_mtim.tv_sec &&
+		    key->mtime_nsec < sb.st_mtim.tv_nsec) ? JCF_CACHE_HIT :
+		    JCF_CACHE_VERIFY;
+	}
+	if (status == JCF_CACHE_HIT)
+		jcf_out_bytes(results, body + header->path_length,
+		    header->results_length);
+
+done:
+	if (fd >= 0)
+		close(fd);
+	free(buf);
+	if (status == JCF_CACHE_HIT)
+		atomic_fetch_add(&cache->hits, 1);
+	else if (status == JCF_CACHE_MISS)
+		atomic_fetch_add(&cache->misses, 1);
+	return (status);
+}
+
+int
+jcf_cache_store(struct jcf_cache *cache, const struct jcf_cache_key *key,
+    const void *results, size_t len)
+{
+	struct jcf_cache_header header;
+	struct iovec iov[3];
+	size_t path_length = strlen(key->path);
+	char *name, *tmp;
+	int err = -1, fd;
+
+	if (path_length > UINT32_MAX || len > JCF_CACHE_MAX_ENTRY)
+		return (-1);
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, JCF_CACHE_MAGIC, 4);
+	header.version = JCF_CACHE_VERSION;
+	header.options = cache->options;
+	header.size = key->size;
+	header.mtime_sec = key->mtime_sec;
+	header.mtime_nsec = key->mtime_nsec;
+	header.hash = key->hash;
+	header.path_length = path_length;
+	header.results_length = len;
+	header.check = jcf_cache_hash(jcf_cache_hash(0, key->path,
+	    path_length), results, len);
+
+	// Write a temporary file and rename it over the entry.
+	name = jcf_cache_path(cache, key->path);
+	tmp = malloc(strlen(cache->dir) + sizeof("/.tmp-XXXXXX"));
+	if (name == NULL || tmp == NULL)
+		goto done;
+	sprintf(tmp, "%s/.tmp-XXXXXX", cache->dir);
+	if ((fd = mkstemp(tmp)) < 0)
+		goto done;
+	iov[0].iov_base = &header;
+	iov[0].iov_len = sizeof(header);
+	iov[1].iov_base = (void *)key->path;
+	iov[1].iov_len = path_length;
+	iov[2].iov_base = (void *)results;
+	iov[2].iov_len = len;
+	if (fchmod(fd, 0644) == 0 && jcf_out_writev(fd, iov, 3) == 0)
+		err = 0;
+	if (close(fd) != 0 || (err == 0 && rename(tmp, name) != 0))
+		err = -1;
+	if (err != 0)
+		unlink(tmp);
+
+done:
+	free(name);
+	free(tmp);
+	return (err);
+}
@@ -0,0 +1,125 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * A persistent cache of the results of processing class files, so that
+ * a rescan of a mostly unchanged tree only processes the files that
+ * changed.  Each class file's results are kept in an entry file of its
+ * own in the cache directory, named by a hash of the class file's path
+ * and of the options that shaped the results.  An entry records the
+ * class file's size, modification time and content hash, and is used
+ * only while they still match.
+ *
+ * Entries are written to a temporary file and renamed into place, so
+ * that concurrent readers, in this process or another, see either the
+ * old entry or the new one and never a partial one.  Concurrent writers
+ * of the same entry are harmless: the last rename wins.  An entry also
+ * carries a hash of its contents, so one that was damaged is treated as
+ * missing.
+ */
+
+#ifndef JCF_CACHE_H
+#define JCF_CACHE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "jcf_out.h"
+
+// Define a cache.
+struct jcf_cache {
+	char		*dir;
+	uint64_t	options;	// hash of the options
+	atomic_size_t	hits;
+	atomic_size_t	misses;
+};
+
+/*
+ * Define the key of a class file.  A file is identified by its size and
+ * modification time, and by its content hash once that is known.  An
+ * archive entry has no modification time of its own, so it is identified
+ * by its size and CRC instead.
+ */
+struct jcf_cache_key {
+	const char	*path;
+	uint64_t	size;
+	int64_t		mtime_sec;
+	int64_t		mtime_nsec;
+	uint64_t	hash;		// of the contents, if "hashed"
+	bool		hashed;
+};
+
+// Define an enumeration of the outcomes of a lookup.
+enum jcf_cache_status {
+	JCF_CACHE_MISS,
+	JCF_CACHE_HIT,
+	JCF_CACHE_VERIFY	// retry with the content hash
+};
+
+/*
+ * Requires:
+ *   "dir" must be a NUL-terminated path.
+ *
+ * Effects:
+ *   Opens the cache in the directory "dir", creating the directory if
+ *   it does not exist.  Only entries that were stored with the same
+ *   "options" are found.  Returns 0 on success and -1 on failure.
+ */
+int	jcf_cache_open(struct jcf_cache *cache, const char *dir,
+	    uint64_t options);
+
+/*
+ * Requires:
+ *   "cache" must have been opened by jcf_cache_open().
+ *
+ * Effects:
+ *   Frees the memory held by "cache".  The entries stay on disk.
+ */
+void	jcf_cache_close(struct jcf_cache *cache);
+
+/*
+ * Requires:
+ *   "p" must point to "len" bytes.
+ *
+ * Effects:
+ *   Returns a 64-bit hash of the bytes, starting from "seed".  The hash
+ *   reads eight bytes at a time, so it is cheap next to parsing.
+ */
+uint64_t jcf_cache_hash(uint64_t seed, const void *p, size_t len);
+
+/*
+ * Requires:
+ *   "cache" must have been opened by jcf_cache_open().  "results" must
+ *   be a memory buffer initialized by jcf_out_init().
+ *
+ * Effects:
+ *   Looks up the entry for "key".  If "key" has no content hash, the
+ *   entry is used if the size and modification time match and the file
+ *   was not modified so soon before the entry was written that a later
+ *   change could have kept the same time.  Otherwise, if the size
+ *   matches, JCF_CACHE_VERIFY is returned, asking the caller to hash
+ *   the contents and look up again.  If "key" has a content hash, the
+ *   entry is used if the size and hash match.  Appends the entry's
+ *   results to "results" and returns JCF_CACHE_HIT if the entry is
+ *   used, and returns JCF_CACHE_MISS if not.  Counts hits and misses in
+ *   "cache", and is safe to call from several threads.
+ */
+enum jcf_cache_status jcf_cache_find(struct jcf_cache *cache,
+	    const struct jcf_cache_key *key, struct jcf_out *results);
+
+/*
+ * Requires:
+ *   "cache" must have been opened by jcf_cache_open().  "key" must have
+ *   a content hash.  "results" must point to "len" bytes.
+ *
+ * Effects:
+ *   Stores "results" as the entry for "key", replacing any entry for
+ *   the same path.  Is safe to call from several threads and processes.
+ *   Returns 0 on success and -1 on failure, in which case the cache is
+ *   unchanged.
+ */
+int	jcf_cache_store(struct jcf_cache *cache, const struct jcf_cache_key *key,
+	    const void *results, size_t len);
+
+#endif /* JCF_CACHE_H */
@@ -0,0 +1,468 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * A class dependency graph in compressed sparse row form, with its
+ * strongly connected components and bitset reachability queries.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jcf_graph.h"
+
+/*
+ * Define a share of the words of a reachability query, which one thread
+ * computes.
+ */
+struct jcf_graph_task {
+	pthread_t	thread;
+	const struct jcf_graph *dag;
+	bool		reverse;
+	const uint32_t	*sources;
+	size_t		nsources;
+	uint64_t	*reach;
+	size_t		first;		// the first word of the share
+	size_t		last;		// one past the last word
+};
+
+static int	jcf_graph_build(struct jcf_graph *graph, uint32_t nnodes,
+		    const uint32_t *from, const uint32_t *to, size_t nedges);
+static void	*jcf_graph_reach_words(void *arg);
+
+/*
+ * Requires:
+ *   "from" and "to" must each hold "nedges" nodes less than "nnodes".
+ *
+ * Effects:
+ *   Builds "graph" from the edges from "from[i]" to "to[i]", dropping
+ *   edges from a node to itself and repeated edges.  The edges are put
+ *   in order by two stable counting sorts, first by target and then by
+ *   source, so each node's targets come out sorted and repeats are
+ *   adjacent.  Returns 0 on success and -1 on failure.
+ */
+static int
+jcf_graph_build(struct jcf_graph *graph, uint32_t nnodes,
+    const uint32_t *from, const uint32_t *to, size_t nedges)
+{
+	uint32_t *by_from = NULL, *by_to = NULL, *counts = NULL, previous, v;
+	size_t i, m = 0, kept;
+	int err = -1;
+
+	graph->nnodes = nnodes;
+	graph->starts = NULL;
+	graph->targets = NULL;
+	for (i = 0; i < nedges; i++) {
+		if (from[i] != to[i])
+			m++;
+	}
+	if (m >= UINT32_MAX)
+		return (-1);
+	graph->starts = calloc((size_t)nnodes + 1, sizeof(*graph->starts));
+	graph->targets = malloc(m * sizeof(*graph->targets));
+	by_from = malloc(m * sizeof(*by_from));
+	by_to = malloc(m * sizeof(*by_to));
+	counts = malloc(((size_t)nnodes + 1) * sizeof(*counts));
+	if (graph->starts == NULL || counts == NULL || (m > 0 &&
+	    (graph->targets == NULL || by_from == NULL || by_to == NULL)))
+		goto done;
+
+	// Sort the edges by target.
+	memset(counts, 0, ((size_t)nnodes + 1) * sizeof(*counts));
+	for (i = 0; i < nedges; i++) {
+		if (from[i] != to[i])
+			counts[to[i] + 1]++;
+	}
+	for (v = 0; v < nnodes; v++)
+		counts[v + 1] += counts[v];
+	for (i = 0; i < nedges; i++) {
+		if (from[i] == to[i])
+			continue;
+		by_from[counts[to[i]]] = from[i];
+		by_to[counts[to[i]]++] = to[i];
+	}
+
+	// Sort them by source, keeping each source's targets in order.
+	for (i = 0; i < m; i++)
+		graph->starts[by_from[i] + 1]++;
+	for (v = 0; v < nnodes; v++)
+		graph->starts[v + 1] += graph->starts[v];
+	memcpy(counts, graph->starts, ((size_t)nnodes + 1) * sizeof(*counts));
+	for (i = 0; i < m; i++)
+		graph->targets[counts[by_from[i]]++] = by_to[i];
+
+	// Drop the repeated edges, compacting the rows.
+	kept = 0;
+	for (v = 0; v < nnodes; v++) {
+		i = graph->starts[v];
+		graph->starts[v] = kept;
+		for (previous = JCF_GRAPH_NONE; i < counts[v]; i++) {
+			if (graph->targets[i] != previous) {
+				previous = graph->targets[i];
+				graph->targets[kept++] = previous;
+			}
+		}
+	}
+	graph->starts[nnodes] = kept;
+	err = 0;
+
+done:
+	free(by_from);
+	free(by_to);
+	free(counts);
+	return (err);
+}
+
+/*
+ * Requires:
+ *   "arg" must point to a struct jcf_graph_task.
+ *
+ * Effects:
+ *   Computes the task's share of the words of a reachability query.
+ *   Forward, each node's bits are pushed to its targets, from the
+ *   highest-numbered node down, so a node has every bit that reaches
+ *   it before it is pushed.  In reverse, each node pulls its targets'
+ *   bits, from the lowest-numbered node up, so its targets are final
+ *   before they are pulled.
+ */
+static void *
+jcf_graph_reach_words(void *arg)
+{
+	struct jcf_graph_task *task = arg;
+	const struct jcf_graph *dag = task->dag;
+	uint64_t *column, bits;
+	size_t q, w, e;
+	uint32_t v;
+
+	for (w = task->first; w < task->last; w++) {
+		column = task->reach + w * dag->nnodes;
+		memset(column, 0, dag->nnodes * sizeof(*column));
+		for (q = w * 64; q < task->nsources && q < w * 64 + 64; q++)
+			column[task->sources[q]] |= UINT64_C(1) << (q % 64);
+		if (task->reverse) {
+			for (v = 0; v < dag->nnodes; v++) {
+				bits = column[v];
+				for (e = dag->starts[v]; e < dag->starts[v + 1];
+				    e++)
+					bits |= column[dag->targets[e]];
+				column[v] = bits;
+			}
+		} else {
+			for (v = dag->nnodes; v-- > 0; ) {
+				bits = column[v];
+				if (bits == 0)
+					continue;
+				for (e = dag->starts[v]; e < dag->starts[v + 1];
+				    e++)
+					column[dag->targets[e]] |= bits;
+			}
+		}
+	}
+	return (NULL);
+}
+
+void
+jcf_graph_table_init(struct jcf_graph_table *table)
+{
+	table->edges = NULL;
+	table->count = 0;
+	table->capacity = 0;
+}
+
+void
+jcf_graph_table_destroy(struct jcf_graph_table *table)
+{
+	free(table->edges);
+	jcf_graph_table_init(table);
+}
+
+int
+jcf_graph_add(struct jcf_graph_table *table, size_t file, uint32_t from,
+    uint32_t to)
+{
+	struct jcf_graph_edge *edges, *edge;
+	size_t capacity;
+
+	if (file >= UINT32_MAX)
+		return (-1);
+
+	// Grow the array of edges.
+	if (table->count == table->capacity) {
+		capacity = table->capacity > 0 ? table->capacity * 2 : 1024;
+		edges = realloc(table->edges, capacity * sizeof(*edges));
+		if (edges == NULL)
+			return (-1);
+		table->edges = edges;
+		table->capacity = capacity;
+	}
+
+	edge = &table->edges[table->count++];
+	edge->from = from;
+	edge->to = to;
+	edge->file = file;
+	return (0);
+}
+
+void
+jcf_graph_truncate(struct jcf_graph_table *table, size_t count)
+{
+	table->count = count;
+}
+
+int
+jcf_graph_merge(struct jcf_graph_table *table, struct jcf_graph_table *other)
+{
+	struct jcf_graph_edge *edges;
+	size_t capacity;
+
+	// Make room for the other table's edges.
+	if (table->capacity - table->count < other->count) {
+		capacity = table->count + other->count;
+		edges = realloc(table->edges, capacity * sizeof(*edges));
+		if (edges == NULL)
+			return (-1);
+		table->edges = edges;
+		table->capacity = capacity;
+	}
+	if (other->count > 0) {
+		memcpy(table->edges + table->count, other->edges,
+		    other->count * sizeof(*edges));
+	}
+	table->count += other->count;
+	jcf_graph_table_destroy(other);
+	return (0);
+}
+
+int
+jcf_graph_collect(struct jcf_graph *graph, uint32_t **namesp,
+    uint32_t **nodesp, const struct jcf_graph_table *table,
+    size_t nfiles, uint32_t limit)
+{
+	const struct jcf_graph_edge *edge;
+	const struct jcf_graph_edge **order = NULL;
+	uint32_t *node = NULL, *names = NULL, *from = NULL, *to = NULL;
+	uint32_t nnodes = 0;
+	size_t *starts = NULL;
+	size_t i, n = table->count;
+	int err = -1;
+
+	graph->starts = NULL;
+	graph->targets = NULL;
+	*namesp = NULL;
+	if (nodesp != NULL)
+		*nodesp = NULL;
+	order = malloc(n * sizeof(*order));
+	node = malloc((size_t)limit * sizeof(*node));
+	names = malloc((size_t)limit * sizeof(*names));
+	from = malloc(n * sizeof(*from));
+	to = malloc(n * sizeof(*to));
+	starts = calloc(nfiles + 1, sizeof(*starts));
+	if (starts == NULL || (n > 0 && (order == NULL || from == NULL ||
+	    to == NULL)) || (limit > 0 && (node == NULL || names == NULL)))
+		goto done;
+
+	/*
+	 * Put the edges in file order with a counting sort.  Each file's
+	 * edges are contiguous, so they keep the order in which they were
+	 * added.
+	 */
+	for (i = 0; i < n; i++)
+		starts[table->edges[i].file + 1]++;
+	for (i = 0; i < nfiles; i++)
+		starts[i + 1] += starts[i];
+	for (i = 0; i < n; i++) {
+		edge = &table->edges[i];
+		order[starts[edge->file]++] = edge;
+	}
+
+	// Number the nodes in the order in which they first appear.
+	memset(node, 0xff, (size_t)limit * sizeof(*node));
+	for (i = 0; i < n; i++) {
+		edge = order[i];
+		if (node[edge->from] == JCF_GRAPH_NONE) {
+			names[nnodes] = edge->from;
+			node[edge->from] = nnodes++;
+		}
+		if (node[edge->to] == JCF_GRAPH_NONE) {
+			names[nnodes] = edge->to;
+			node[edge->to] = nnodes++;
+		}
+		from[i] = node[edge->from];
+		to[i] = node[edge->to];
+	}
+	if (jcf_graph_build(graph, nnodes, from, to, n) != 0)
+		goto done;
+	*namesp = names;
+	names = NULL;
+	if (nodesp != NULL) {
+		*nodesp = node;
+		node = NULL;
+	}
+	err = 0;
+
+done:
+	free(order);
+	free(node);
+	free(names);
+	free(from);
+	free(to);
+	free(starts);
+	return (err);
+}
+
+void
+jcf_graph_destroy(struct jcf_graph *graph)
+{
+	free(graph->starts);
+	free(graph->targets);
+	graph->starts = NULL;
+	graph->targets = NULL;
+	graph->nnodes = 0;
+}
+
+int
+jcf_graph_quotient(struct jcf_graph *quotient, uint32_t nnodes,
+    const struct jcf_graph *graph, const uint32_t *map)
+{
+	uint32_t *from, *to, v;
+	size_t e, m = graph->starts[graph->nnodes];
+	int err = -1;
+
+	quotient->starts = NULL;
+	quotient->targets = NULL;
+	from = malloc(m * sizeof(*from));
+	to = malloc(m * sizeof(*to));
+	if (m == 0 || (from != NULL && to != NULL)) {
+		for (v = 0; v < graph->nnodes; v++) {
+			for (e = graph->starts[v]; e < graph->starts[v + 1];
+			    e++) {
+				from[e] = map[v];
+				to[e] = map[graph->targets[e]];
+			}
+		}
+		err = jcf_graph_build(quotient, nnodes, from, to, m);
+	}
+	free(from);
+	free(to);
+	return (err);
+}
+
+int
+jcf_graph_components(const struct jcf_graph *graph, uint32_t *component,
+    uint32_t *ncomponentsp)
+{
+	uint32_t *index, *low, *stack, *frames, *cursors;
+	uint32_t counter = 0, ncomponents = 0, top = 0, root, u, v, w;
+	size_t depth, n = graph->nnodes;
+	int err = -1;
+
+	index = malloc(n * sizeof(*index));
+	low = malloc(n * sizeof(*low));
+	stack = malloc(n * sizeof(*stack));
+	frames = malloc(n * sizeof(*frames));
+	cursors = malloc(n * sizeof(*cursors));
+	if (n > 0 && (index == NULL || low == NULL || stack == NULL ||
+	    frames == NULL || cursors == NULL))
+		goto done;
+
+	/*
+	 * Search depth first from each node that is not yet visited.  The
+	 * call stack of the recursive algorithm is kept in "frames", with
+	 * the next edge of each frame's node in "cursors".  A node is on
+	 * Tarjan's stack while it has been visited but has no component.
+	 */
+	memset(index, 0xff, n * sizeof(*index));
+	memset(component, 0xff, n * sizeof(*component));
+	for (root = 0; root < n; root++) {
+		if (index[root] != JCF_GRAPH_NONE)
+			continue;
+		index[root] = low[root] = counter++;
+		stack[top++] = root;
+		frames[0] = root;
+		cursors[0] = graph->starts[root];
+		depth = 1;
+		while (depth > 0) {
+			v = frames[depth - 1];
+			if (cursors[depth - 1] < graph->starts[v + 1]) {
+				// Follow the next edge.
+				w = graph->targets[cursors[depth - 1]++];
+				if (index[w] == JCF_GRAPH_NONE) {
+					index[w] = low[w] = counter++;
+					stack[top++] = w;
+					frames[depth] = w;
+					cursors[depth++] = graph->starts[w];
+				} else if (component[w] == JCF_GRAPH_NONE &&
+				    index[w] < low[v])
+					low[v] = index[w];
+				continue;
+			}
+
+			// Pop the node's component if it is the component's root.
+			if (low[v] == index[v]) {
+				do {
+					u = stack[--top];
+					component[u] = ncomponents;
+				} while (u != v);
+				ncomponents++;
+			}
+			depth--;
+			if (depth > 0 && low[v] < low[frames[depth - 1]])
+				low[frames[depth - 1]] = low[v];
+		}
+	}
+	*ncomponentsp = ncomponents;
+	err = 0;
+
+done:
+	free(index);
+	free(low);
+	free(stack);
+	free(frames);
+	free(cursors);
+	return (err);
+}
+
+int
+jcf_graph_reach(const struct jcf_graph *dag, bool reverse,
+    const uint32_t *sources, size_t nsources, int nthreads, uint64_t *reach)
+{
+	struct jcf_graph_task *tasks;
+	size_t nwords = (nsources + 63) / 64, per_task;
+	int i, ntasks, started;
+
+	// Give each thread a contiguous share of the words.
+	ntasks = nthreads < 1 ? 1 : nthreads;
+	if ((size_t)ntasks > nwords)
+		ntasks = nwords > 0 ? nwords : 1;
+	tasks = calloc(ntasks, sizeof(*tasks));
+	if (tasks == NULL)
+		return (-1);
+	per_task = (nwords + ntasks - 1) / ntasks;
+	for (i = 0; i < ntasks; i++) {
+		tasks[i].dag = dag;
+		tasks[i].reverse = reverse;
+		tasks[i].sources = sources;
+		tasks[i].nsources = nsources;
+		tasks[i].reach = reach;
+		tasks[i].first = i * per_task < nwords ? i * per_task : nwords;
+		tasks[i].last = tasks[i].first + per_task < nwords ?
+		    tasks[i].first + per_task : nwords;
+	}
+
+	/*
+	 * Run the first share on this thread and the others on new threads.
+	 * A share whose thread cannot be started is run here instead.
+	 */
+	for (started = 1; started < ntasks; started++) {
+		if (pthread_create(&tasks[started].thread, NULL,
+		    jcf_graph_reach_words, &tasks[started]) != 0)
+			break;
+	}
+	jcf_graph_reach_words(&tasks[0]);
+	for (i = started; i < ntasks; i++)
+		jcf_graph_reach_words(&tasks[i]);
+	for (i = 1; i < started; i++)
+		pthread_join(tasks[i].thread, NULL);
+	free(tasks);
+	return (0);
+}
@@ -0,0 +1,184 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * A dependency graph of the classes that are read.  Each class file
+ * contributes an edge from its class to every class that its constant
+ * pool names.  The edges are collected per thread, like link symbols,
+ * and are then numbered into a directed graph in compressed sparse row
+ * form: the targets of node "v" are "targets[starts[v]]" up to
+ * "targets[starts[v + 1]]".
+ *
+ * The graph's strongly connected components are the dependency cycles.
+ * Collapsing them gives an acyclic graph, over which the classes that
+ * reach, or are reached from, a set of classes are found by propagating
+ * bitsets with one bit per query, 64 queries to a word.
+ */
+
+#ifndef JCF_GRAPH_H
+#define JCF_GRAPH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Define a node number that names no node.
+#define JCF_GRAPH_NONE		UINT32_MAX
+
+// Define an edge.  An edge from a class to itself only names the class.
+struct jcf_graph_edge {
+	uint32_t	from;		// ID of the using class's name
+	uint32_t	to;		// ID of the used class's name
+	uint32_t	file;		// index of the file that it came from
+};
+
+// Define a table of the edges collected by one thread.
+struct jcf_graph_table {
+	struct jcf_graph_edge *edges;
+	size_t		count;
+	size_t		capacity;
+};
+
+// Define a directed graph in compressed sparse row form.
+struct jcf_graph {
+	uint32_t	nnodes;
+	uint32_t	*starts;	// "nnodes" + 1 offsets into "targets"
+	uint32_t	*targets;	// sorted and distinct for each node
+};
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Initializes "table" to be empty.
+ */
+void	jcf_graph_table_init(struct jcf_graph_table *table);
+
+/*
+ * Requires:
+ *   "table" must have been initialized by jcf_graph_table_init().
+ *
+ * Effects:
+ *   Frees the memory held by "table".
+ */
+void	jcf_graph_table_destroy(struct jcf_graph_table *table);
+
+/*
+ * Requires:
+ *   "table" must have been initialized by jcf_graph_table_init().  The
+ *   IDs must all come from the same intern table.
+ *
+ * Effects:
+ *   Appends an edge from the given file to "table".  Returns 0 on
+ *   success and -1 on failure.
+ */
+int	jcf_graph_add(struct jcf_graph_table *table, size_t file,
+	    uint32_t from, uint32_t to);
+
+/*
+ * Requires:
+ *   "count" must be at most "table->count".
+ *
+ * Effects:
+ *   Discards the edges after the first "count", such as those of a
+ *   class file that turned out to be malformed.
+ */
+void	jcf_graph_truncate(struct jcf_graph_table *table, size_t count);
+
+/*
+ * Requires:
+ *   "table" and "other" must have been initialized by
+ *   jcf_graph_table_init().
+ *
+ * Effects:
+ *   Moves the edges of "other" to the end of "table", leaving "other"
+ *   empty.  Returns 0 on success and -1 on failure, in which case
+ *   neither table is changed.
+ */
+int	jcf_graph_merge(struct jcf_graph_table *table,
+	    struct jcf_graph_table *other);
+
+/*
+ * Requires:
+ *   The edges of "table" must come from files with indices less than
+ *   "nfiles", the edges of each file must be contiguous, and every ID
+ *   must be less than "limit".
+ *
+ * Effects:
+ *   Builds "graph" from the edges of "table".  The nodes are numbered in
+ *   the order in which their names first appear, in order of file index
+ *   and then of addition, so the graph does not depend on how the files
+ *   were divided among threads.  Stores in "*namesp" an array, which the
+ *   caller must free(), of the ID of each node's name.  If "nodesp" is
+ *   not NULL, also stores in "*nodesp" an array, which the caller must
+ *   free(), of the node of each ID less than "limit", which is
+ *   JCF_GRAPH_NONE for an ID that names no node.  Edges from a node to
+ *   itself are dropped.  Returns 0 on success and -1 on failure.
+ */
+int	jcf_graph_collect(struct jcf_graph *graph, uint32_t **namesp,
+	    uint32_t **nodesp, const struct jcf_graph_table *table,
+	    size_t nfiles, uint32_t limit);
+
+/*
+ * Requires:
+ *   "graph" must have been built by jcf_graph_collect() or
+ *   jcf_graph_quotient(), even if that failed.
+ *
+ * Effects:
+ *   Frees the memory held by "graph".
+ */
+void	jcf_graph_destroy(struct jcf_graph *graph);
+
+/*
+ * Requires:
+ *   "map" must hold, for each node of "graph", a node of the quotient
+ *   less than "nnodes".
+ *
+ * Effects:
+ *   Builds "quotient", which has an edge from "map[u]" to "map[v]" for
+ *   each edge from "u" to "v" of "graph" for which they differ.  Mapping
+ *   classes to their packages gives the package graph, and mapping them
+ *   to their components gives the acyclic condensation.  Returns 0 on
+ *   success and -1 on failure.
+ */
+int	jcf_graph_quotient(struct jcf_graph *quotient, uint32_t nnodes,
+	    const struct jcf_graph *graph, const uint32_t *map);
+
+/*
+ * Requires:
+ *   "component" must have room for a value for each node of "graph".
+ *
+ * Effects:
+ *   Finds the strongly connected components of "graph" with Tarjan's
+ *   algorithm, which is made iterative so that long chains cannot
+ *   exhaust the stack.  Stores each node's component in "component"
+ *   and their number in "*ncomponentsp".  A component is numbered after
+ *   every component that it has an edge to, so each edge between
+ *   components goes from a higher number to a lower one.  Returns 0 on
+ *   success and -1 on failure.
+ */
+int	jcf_graph_components(const struct jcf_graph *graph,
+	    uint32_t *component, uint32_t *ncomponentsp);
+
+/*
+ * Requires:
+ *   Every edge of "dag" must go from a higher-numbered node to a lower
+ *   one, as in a condensation numbered by jcf_graph_components().
+ *   "sources" must hold "nsources" nodes of "dag".  "reach" must have
+ *   room for ((nsources + 63) / 64) * "dag->nnodes" words.
+ *
+ * Effects:
+ *   Answers "nsources" reachability queries at once.  Word "w" of node
+ *   "v" is stored at "reach[w * dag->nnodes + v]", and bit "q % 64" of
+ *   word "q / 64" is set if node "v" is reachable from "sources[q]", or,
+ *   if "reverse" is true, if "sources[q]" is reachable from "v".  Every
+ *   source reaches itself.  The nodes are visited once in topological
+ *   order per word, and the words are divided among up to "nthreads"
+ *   threads, which share nothing.  Returns 0 on success and -1 on
+ *   failure.
+ */
+int	jcf_graph_reach(const struct jcf_graph *dag, bool reverse,
+	    const uint32_t *sources, size_t nsources, int nthreads,
+	    uint64_t *reach);
+
+#endif /* JCF_GRAPH_H */
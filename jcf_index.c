@@ -0,0 +1,433 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * An inverted index of the symbols that classes reference, written to a
+ * file and mapped to answer queries.
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "jcf_index.h"
+#include "jcf_out.h"
+
+// Define a name that is being numbered, with the ID that it came from.
+struct jcf_index_name {
+	const char	*bytes;
+	size_t		length;
+	uint32_t	id;
+};
+
+static int	jcf_index_compare(const char *a, size_t alen, const char *b,
+		    size_t blen);
+static int	jcf_index_compare_names(const void *a, const void *b);
+static int	jcf_index_compare_ids(const void *a, const void *b);
+static uint32_t	*jcf_index_number(const struct jcf_graph_table *table,
+		    const struct jcf_intern *intern, uint32_t limit,
+		    bool symbols, struct jcf_index_name **namesp,
+		    uint32_t *countp);
+static void	jcf_index_varint(struct jcf_out *out, uint32_t value);
+static bool	jcf_index_fits(uint64_t offset, uint64_t length,
+		    uint64_t size);
+
+/*
+ * Requires:
+ *   "a" must point to "alen" bytes and "b" to "blen" bytes.
+ *
+ * Effects:
+ *   Compares the two names by their bytes, as unsigned, with a name
+ *   that is a prefix of the other ordered first.  Returns a negative
+ *   number, zero or a positive number as "a" is less than, equal to or
+ *   greater than "b".
+ */
+static int
+jcf_index_compare(const char *a, size_t alen, const char *b, size_t blen)
+{
+	int order;
+
+	order = memcmp(a, b, alen < blen ? alen : blen);
+	if (order != 0)
+		return (order);
+	return (alen < blen ? -1 : alen > blen);
+}
+
+/*
+ * Requires:
+ *   "a" and "b" must point to struct jcf_index_names.
+ *
+ * Effects:
+ *   Compares the names for qsort().
+ */
+static int
+jcf_index_compare_names(const void *a, const void *b)
+{
+	const struct jcf_index_name *x = a, *y = b;
+
+	return (jcf_index_compare(x->bytes, x->length, y->bytes, y->length));
+}
+
+/*
+ * Requires:
+ *   "a" and "b" must point to uint32_ts.
+ *
+ * Effects:
+ *   Compares the numbers for qsort().
+ */
+static int
+jcf_index_compare_ids(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return (x < y ? -1 : x > y);
+}
+
+/*
+ * Requires:
+ *   "table" must hold edges whose IDs are from "intern" and less than
+ *   "limit".
+ *
+ * Effects:
+ *   Numbers the distinct classes, if "symbols" is false, or symbols, if
+ *   it is true, of the edges that are not from JCF_INTERN_NONE, in the
+ *   order of their names.  Returns an array of "limit" numbers, indexed
+ *   by ID, and stores the names, in order, in "*namesp" and their count
+ *   in "*countp".  The caller must free() both arrays.  Returns NULL on
+ *   failure.
+ */
+static uint32_t *
+jcf_index_number(const struct jcf_graph_table *table,
+    const struct jcf_intern *intern, uint32_t limit, bool symbols,
+    struct jcf_index_name **namesp, uint32_t *countp)
+{
+	struct jcf_index_name *names;
+	uint32_t *numbers, count = 0, id;
+	size_t i;
+
+	numbers = malloc(((size_t)limit > 0 ? limit : 1) * sizeof(*numbers));
+	names = malloc((table->count > 0 ? table->count : 1) *
+	    sizeof(*names));
+	if (numbers == NULL || names == NULL) {
+		free(numbers);
+		free(names);
+		return (NULL);
+	}
+	memset(numbers, 0xff, (size_t)limit * sizeof(*numbers));
+	for (i = 0; i < table->count; i++) {
+		if (table->edges[i].from == JCF_INTERN_NONE)
+			continue;
+		id = symbols ? table->edges[i].to : table->edges[i].from;
+		if (numbers[id] != UINT32_MAX)
+			continue;
+		numbers[id] = 0;
+		names[count].bytes = jcf_intern_string(intern, id,
+		    &names[count].length);
+		names[count].id = id;
+		count++;
+	}
+	qsort(names, count, sizeof(*names), jcf_index_compare_names);
+	for (id = 0; id < count; id++)
+		numbers[names[id].id] = id;
+	*namesp = names;
+	*countp = count;
+	return (numbers);
+}
+
+/*
+ * Requires:
+ *   "out" must have been initialized by jcf_out_init().
+ *
+ * Effects:
+ *   Appends "value" to "out", seven bits to a byte from the lowest, with
+ *   the high bit of every byte but the last set.
+ */
+static void
+jcf_index_varint(struct jcf_out *out, uint32_t value)
+{
+	while (value >= 0x80) {
+		jcf_out_char(out, (char)(value | 0x80));
+		value >>= 7;
+	}
+	jcf_out_char(out, (char)value);
+}
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Returns true if "length" bytes at "offset" lie within "size" bytes.
+ */
+static bool
+jcf_index_fits(uint64_t offset, uint64_t length, uint64_t size)
+{
+	return (offset <= size && length <= size - offset);
+}
+
+int
+jcf_index_write(const char *path, const struct jcf_graph_table *table,
+    const struct jcf_intern *intern)
+{
+	struct jcf_index_header header;
+	struct jcf_index_class class;
+	struct jcf_index_symbol *entries = NULL;
+	struct jcf_index_name *classes = NULL, *symbols = NULL;
+	struct jcf_out postings, out;
+	uint32_t *class_numbers = NULL, *symbol_numbers = NULL;
+	uint32_t *posted = NULL, nclasses = 0, nsymbols = 0, limit, s, n;
+	size_t *starts = NULL, i, j;
+	uint64_t strings_length = 0;
+	char *tmp = NULL;
+	int err = -1, fd;
+
+	jcf_out_init(&postings, -1);
+	limit = jcf_intern_limit(intern);
+	class_numbers = jcf_index_number(table, intern, limit, false,
+	    &classes, &nclasses);
+	symbol_numbers = jcf_index_number(table, intern, limit, true,
+	    &symbols, &nsymbols);
+	if (class_numbers == NULL || symbol_numbers == NULL)
+		goto done;
+
+	// Bucket the classes of the edges by the symbol that they reference.
+	starts = calloc((size_t)nsymbols + 1, sizeof(*starts));
+	posted = malloc((table->count > 0 ? table->count : 1) *
+	    sizeof(*posted));
+	entries = malloc((nsymbols > 0 ? nsymbols : 1) * sizeof(*entries));
+	if (starts == NULL || posted == NULL || entries == NULL)
+		goto done;
+	for (i = 0; i < table->count; i++) {
+		if (table->edges[i].from != JCF_INTERN_NONE)
+			starts[symbol_numbers[table->edges[i].to] + 1]++;
+	}
+	for (s = 0; s < nsymbols; s++)
+		starts[s + 1] += starts[s];
+	for (i = 0; i < table->count; i++) {
+		if (table->edges[i].from == JCF_INTERN_NONE)
+			continue;
+		posted[starts[symbol_numbers[table->edges[i].to]]++] =
+		    class_numbers[table->edges[i].from];
+	}
+
+	/*
+	 * Encode each symbol's distinct classes in order.  The scatter left
+	 * each start at the end of its bucket, which is where the next
+	 * bucket starts.
+	 */
+	for (s = 0, i = 0; s < nsymbols; i = starts[s++]) {
+		qsort(&posted[i], starts[s] - i, sizeof(*posted),
+		    jcf_index_compare_ids);
+		entries[s].postings = postings.len;
+		for (n = 0, j = i; j < starts[s]; j++) {
+			if (j > i && posted[j] == posted[j - 1])
+				continue;
+			jcf_index_varint(&postings, n == 0 ? posted[j] :
+			    posted[j] - posted[j - 1]);
+			n++;
+		}
+		entries[s].count = n;
+		if (postings.len > UINT32_MAX)
+			goto done;
+	}
+	if (postings.err != 0)
+		goto done;
+
+	// Lay the names out, the classes' first.
+	for (i = 0; i < nclasses; i++)
+		strings_length += classes[i].length;
+	for (s = 0; s < nsymbols; s++) {
+		entries[s].offset = strings_length;
+		entries[s].length = symbols[s].length;
+		strings_length += symbols[s].length;
+	}
+	if (strings_length > UINT32_MAX)
+		goto done;
+	memset(&header, 0, sizeof(header));
+	header.magic = JCF_INDEX_MAGIC;
+	header.version = JCF_INDEX_VERSION;
+	header.nclasses = nclasses;
+	header.nsymbols = nsymbols;
+	header.classes = sizeof(header);
+	header.symbols = header.classes + (uint64_t)nclasses *
+	    sizeof(struct jcf_index_class);
+	header.strings = header.symbols + (uint64_t)nsymbols *
+	    sizeof(struct jcf_index_symbol);
+	header.strings_length = strings_length;
+	header.postings = header.strings + strings_length;
+	header.postings_length = postings.len;
+
+	// Write a temporary file and rename it over the index.
+	tmp = malloc(strlen(path) + sizeof(".tmp-XXXXXX"));
+	if (tmp == NULL)
+		goto done;
+	sprintf(tmp, "%s.tmp-XXXXXX", path);
+	if ((fd = mkstemp(tmp)) < 0)
+		goto done;
+	jcf_out_init(&out, fd);
+	jcf_out_bytes(&out, &header, sizeof(header));
+	for (i = 0, class.offset = 0; i < nclasses; i++) {
+		class.length = classes[i].length;
+		jcf_out_bytes(&out, &class, sizeof(class));
+		class.offset += class.length;
+	}
+	jcf_out_bytes(&out, entries, (size_t)nsymbols * sizeof(*entries));
+	for (i = 0; i < nclasses; i++)
+		jcf_out_bytes(&out, classes[i].bytes, classes[i].length);
+	for (s = 0; s < nsymbols; s++)
+		jcf_out_bytes(&out, symbols[s].bytes, symbols[s].length);
+	jcf_out_bytes(&out, postings.buf, postings.len);
+	if (fchmod(fd, 0644) == 0 && jcf_out_flush(&out) == 0)
+		err = 0;
+	jcf_out_destroy(&out);
+	if (close(fd) != 0 || (err == 0 && rename(tmp, path) != 0))
+		err = -1;
+	if (err != 0)
+		unlink(tmp);
+
+done:
+	jcf_out_destroy(&postings);
+	free(class_numbers);
+	free(symbol_numbers);
+	free(classes);
+	free(symbols);
+	free(starts);
+	free(posted);
+	free(entries);
+	free(tmp);
+	return (err);
+}
+
+int
+jcf_index_open(struct jcf_index *index, const char *path)
+{
+	const struct jcf_index_header *header;
+	struct stat sb;
+	void *base;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return (-1);
+	if (fstat(fd, &sb) != 0 || !S_ISREG(sb.st_mode) ||
+	    (uint64_t)sb.st_size < sizeof(*header)) {
+		close(fd);
+		return (-1);
+	}
+	base = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+		return (-1);
+
+	// Check that the tables are where they can be read in place.
+	header = base;
+	if (header->magic != JCF_INDEX_MAGIC ||
+	    header->version != JCF_INDEX_VERSION ||
+	    header->classes % sizeof(uint32_t) != 0 ||
+	    header->symbols % sizeof(uint32_t) != 0 ||
+	    !jcf_index_fits(header->classes, (uint64_t)header->nclasses *
+	    sizeof(struct jcf_index_class), sb.st_size) ||
+	    !jcf_index_fits(header->symbols, (uint64_t)header->nsymbols *
+	    sizeof(struct jcf_index_symbol), sb.st_size) ||
+	    !jcf_index_fits(header->strings, header->strings_length,
+	    sb.st_size) ||
+	    !jcf_index_fits(header->postings, header->postings_length,
+	    sb.st_size)) {
+		munmap(base, sb.st_size);
+		return (-1);
+	}
+	index->base = base;
+	index->len = sb.st_size;
+	index->header = header;
+	index->classes = (const void *)(index->base + header->classes);
+	index->symbols = (const void *)(index->base + header->symbols);
+	index->strings = (const char *)index->base + header->strings;
+	index->postings = index->base + header->postings;
+	return (0);
+}
+
+void
+jcf_index_close(struct jcf_index *index)
+{
+	munmap((void *)index->base, index->len);
+	index->base = NULL;
+	index->len = 0;
+}
+
+int
+jcf_index_find(const struct jcf_index *index, const char *symbol,
+    size_t length, struct jcf_index_cursor *cursor)
+{
+	const struct jcf_index_symbol *entry;
+	uint32_t low = 0, high = index->header->nsymbols, middle;
+	int order;
+
+	while (low < high) {
+		middle = low + (high - low) / 2;
+		entry = &index->symbols[middle];
+		if (!jcf_index_fits(entry->offset, entry->length,
+		    index->header->strings_length))
+			return (-1);
+		order = jcf_index_compare(index->strings + entry->offset,
+		    entry->length, symbol, length);
+		if (order < 0)
+			low = middle + 1;
+		else if (order > 0)
+			high = middle;
+		else {
+			if (entry->postings > index->header->postings_length)
+				return (-1);
+			cursor->index = index;
+			cursor->p = index->postings + entry->postings;
+			cursor->end = index->postings +
+			    index->header->postings_length;
+			cursor->remaining = entry->count;
+			cursor->class = 0;
+			cursor->started = false;
+			return (1);
+		}
+	}
+	return (0);
+}
+
+int
+jcf_index_next(struct jcf_index_cursor *cursor, const char **namep,
+    size_t *lengthp)
+{
+	const struct jcf_index *index = cursor->index;
+	const struct jcf_index_class *class;
+	uint64_t value = 0;
+	int shift;
+
+	if (cursor->remaining == 0)
+		return (0);
+	for (shift = 0;; shift += 7) {
+		if (cursor->p == cursor->end || shift > 28)
+			return (-1);
+		value |= (uint64_t)(*cursor->p & 0x7f) << shift;
+		if ((*cursor->p++ & 0x80) == 0)
+			break;
+	}
+
+	// After the first, each class is a difference from the last.
+	if (cursor->started) {
+		if (value == 0)
+			return (-1);
+		value += cursor->class;
+	}
+	if (value >= index->header->nclasses)
+		return (-1);
+	class = &index->classes[value];
+	if (!jcf_index_fits(class->offset, class->length,
+	    index->header->strings_length))
+		return (-1);
+	cursor->class = value;
+	cursor->started = true;
+	cursor->remaining--;
+	*namep = index->strings + class->offset;
+	*lengthp = class->length;
+	return (1);
+}
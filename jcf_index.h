@@ -0,0 +1,148 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * An inverted index of the symbols that classes reference, written to a
+ * file that is mapped, not read, to answer queries.  A symbol is either
+ * a member's key, as printed by "Dependency" lines, or the name of a
+ * class that a Class constant names.  For each symbol, the index lists
+ * the classes that reference it.
+ *
+ * The file starts with a header, which is followed by the table of the
+ * classes and the table of the symbols, each sorted by name, then by
+ * the bytes of the names, and last by the postings.  A symbol's
+ * postings are the numbers of the classes that reference it, in
+ * increasing order, each stored as its difference from the one before
+ * in a variable-length encoding of seven bits to a byte.  A symbol is
+ * found by a binary search of its table, so that opening the index does
+ * no work in proportion to its size.  The file is in host byte order.
+ */
+
+#ifndef JCF_INDEX_H
+#define JCF_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "jcf_graph.h"
+#include "jcf_intern.h"
+
+// Define the magic number, which reads "JCFX" in little-endian order.
+#define JCF_INDEX_MAGIC		0x5846434a
+
+// Define the version of the file format.
+#define JCF_INDEX_VERSION	1
+
+// Define the header of an index file.  Offsets are from its start.
+struct jcf_index_header {
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	nclasses;
+	uint32_t	nsymbols;
+	uint64_t	classes;	// offset of the class table
+	uint64_t	symbols;	// offset of the symbol table
+	uint64_t	strings;	// offset of the names
+	uint64_t	strings_length;
+	uint64_t	postings;	// offset of the postings
+	uint64_t	postings_length;
+};
+
+// Define an entry of the class table.  The offset is into the names.
+struct jcf_index_class {
+	uint32_t	offset;
+	uint32_t	length;
+};
+
+// Define an entry of the symbol table.
+struct jcf_index_symbol {
+	uint32_t	offset;		// into the names
+	uint32_t	length;
+	uint32_t	postings;	// offset into the postings
+	uint32_t	count;		// the number of classes
+};
+
+// Define an index file that has been opened.
+struct jcf_index {
+	const uint8_t	*base;
+	size_t		len;
+	const struct jcf_index_header *header;
+	const struct jcf_index_class *classes;
+	const struct jcf_index_symbol *symbols;
+	const char	*strings;
+	const uint8_t	*postings;
+};
+
+// Define a cursor over the classes that reference a symbol.
+struct jcf_index_cursor {
+	const struct jcf_index *index;
+	const uint8_t	*p;
+	const uint8_t	*end;
+	uint32_t	remaining;
+	uint32_t	class;		// the last class returned
+	bool		started;
+};
+
+/*
+ * Requires:
+ *   "table" must hold edges from the ID of a class to the ID of a symbol
+ *   that the class references, both from "intern", and no other thread
+ *   may be adding to "intern".  An edge from JCF_INTERN_NONE is ignored.
+ *
+ * Effects:
+ *   Writes an index of the edges to the file "path", replacing it
+ *   whole, through a temporary file that is renamed over it.  A class
+ *   that references a symbol more than once is listed once.  Returns 0
+ *   on success and -1 on failure.
+ */
+int	jcf_index_write(const char *path,
+	    const struct jcf_graph_table *table,
+	    const struct jcf_intern *intern);
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Maps the index file "path" into "index" and checks its header and
+ *   the bounds of its tables.  Returns 0 on success and -1 if the file
+ *   cannot be mapped or is not an index of this version.
+ */
+int	jcf_index_open(struct jcf_index *index, const char *path);
+
+/*
+ * Requires:
+ *   "index" must have been opened by jcf_index_open().
+ *
+ * Effects:
+ *   Unmaps the index file.
+ */
+void	jcf_index_close(struct jcf_index *index);
+
+/*
+ * Requires:
+ *   "index" must have been opened by jcf_index_open().  "symbol" must
+ *   point to "length" bytes.
+ *
+ * Effects:
+ *   Looks up the symbol.  If it is in the index, initializes "cursor"
+ *   over the classes that reference it and returns 1.  Returns 0 if the
+ *   symbol is not in the index, and -1 if the index is malformed.
+ */
+int	jcf_index_find(const struct jcf_index *index, const char *symbol,
+	    size_t length, struct jcf_index_cursor *cursor);
+
+/*
+ * Requires:
+ *   "cursor" must have been initialized by jcf_index_find().
+ *
+ * Effects:
+ *   Stores the name of the next class that references the symbol in
+ *   "*namep", not NUL terminated, and its length in "*lengthp".  The
+ *   name stays valid until the index is closed.  Returns 1 if there was
+ *   a next class, 0 if there were no more, and -1 if the postings are
+ *   malformed.
+ */
+int	jcf_index_next(struct jcf_index_cursor *cursor, const char **namep,
+	    size_t *lengthp);
+
+#endif /* JCF_INDEX_H */
@@ -0,0 +1,476 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * A self-contained decoder for raw DEFLATE streams (RFC 1951).
+ *
+ * Bits are consumed from a 64-bit buffer that is refilled a byte at a
+ * time, so a whole length/distance pair can usually be decoded without
+ * touching the input.  Huffman codes of up to JCF_FAST_BITS bits are
+ * decoded with a single table lookup; longer codes fall back to a
+ * canonical decode that compares against the largest code of each
+ * length.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "jcf_inflate.h"
+
+// Define the number of bits that are decoded by a single table lookup.
+#define JCF_FAST_BITS	10
+#define JCF_FAST_MASK	((1 << JCF_FAST_BITS) - 1)
+
+// Define the largest number of symbols in any DEFLATE alphabet.
+#define JCF_MAX_SYMBOLS	288
+
+/*
+ * Define a Huffman decoding table.
+ *
+ * "fast" is indexed by the next JCF_FAST_BITS bits of the stream.  A
+ * nonzero entry holds the code length in its upper bits and the symbol
+ * in its lower 9 bits.  A zero entry means that the code is longer than
+ * JCF_FAST_BITS.  The remaining arrays describe the canonical code: for
+ * each length, "maxcode" is one more than the largest code of that
+ * length, left justified in 16 bits, and "firstcode" and "firstsymbol"
+ * map a code of that length to an index into "size" and "value", which
+ * list the symbols in code order.
+ */
+struct jcf_huffman {
+	uint16_t	fast[1 << JCF_FAST_BITS];
+	uint16_t	firstcode[16];
+	int		maxcode[17];
+	uint16_t	firstsymbol[16];
+	int		nsymbols;	// number of symbols with codes
+	uint8_t		size[JCF_MAX_SYMBOLS];
+	uint16_t	value[JCF_MAX_SYMBOLS];
+};
+
+// Define a structure for holding the state of a decompression.
+struct jcf_inflate_state {
+	const uint8_t	*in;
+	const uint8_t	*in_end;
+	uint8_t		*out_start;
+	uint8_t		*out;
+	uint8_t		*out_end;
+	uint64_t	bits;		// buffered bits, next bit lowest
+	int		nbits;		// number of valid bits in "bits"
+	size_t		padding;	// bytes of zeros added past "in_end"
+	struct jcf_huffman litlen;
+	struct jcf_huffman dist;
+};
+
+// Define the base lengths and extra bits of length codes 257 to 285.
+static const uint16_t jcf_length_base[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t jcf_length_extra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+// Define the base distances and extra bits of distance codes 0 to 29.
+static const uint16_t jcf_dist_base[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193,
+	12289, 16385, 24577
+};
+static const uint8_t jcf_dist_extra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// Define the order in which code length code lengths are stored.
+static const uint8_t jcf_clen_order[19] = {
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+static int	jcf_huffman_build(struct jcf_huffman *h, const uint8_t *lengths,
+		    int count);
+static int	jcf_huffman_decode(struct jcf_inflate_state *s,
+		    const struct jcf_huffman *h);
+static int	jcf_inflate_stored(struct jcf_inflate_state *s);
+static int	jcf_inflate_dynamic_tables(struct jcf_inflate_state *s);
+static int	jcf_inflate_codes(struct jcf_inflate_state *s);
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Returns the low "bits" bits of "code" in reverse order.
+ */
+static inline unsigned
+jcf_bit_reverse(unsigned code, int bits)
+{
+	unsigned result = 0;
+
+	while (bits-- > 0) {
+		result = (result << 1) | (code & 1);
+		code >>= 1;
+	}
+	return (result);
+}
+
+/*
+ * Requires:
+ *   "s" must be a valid decompression state.
+ *
+ * Effects:
+ *   Fills the bit buffer with at least 56 bits.  Zeros are supplied
+ *   past the end of the input and counted in "padding" so that reading
+ *   past the end can be detected later.
+ */
+static inline void
+jcf_refill(struct jcf_inflate_state *s)
+{
+	while (s->nbits <= 56) {
+		if (s->in < s->in_end)
+			s->bits |= (uint64_t)*s->in++ << s->nbits;
+		else
+			s->padding++;
+		s->nbits += 8;
+	}
+}
+
+/*
+ * Requires:
+ *   "s" must be a valid decompression state and "n" must be at most 32.
+ *
+ * Effects:
+ *   Removes and returns the next "n" bits of the stream.
+ */
+static inline unsigned
+jcf_getbits(struct jcf_inflate_state *s, int n)
+{
+	unsigned value;
+
+	if (s->nbits < n)
+		jcf_refill(s);
+	value = (unsigned)(s->bits & ((UINT64_C(1) << n) - 1));
+	s->bits >>= n;
+	s->nbits -= n;
+	return (value);
+}
+
+/*
+ * Requires:
+ *   "s" must be a valid decompression state.
+ *
+ * Effects:
+ *   Returns true if more bits have been consumed than the input holds.
+ */
+static inline bool
+jcf_overrun(const struct jcf_inflate_state *s)
+{
+	return ((int64_t)s->padding * 8 > s->nbits);
+}
+
+/*
+ * Requires:
+ *   "lengths" must point to "count" code lengths, each at most 15, and
+ *   "count" must be at most JCF_MAX_SYMBOLS.
+ *
+ * Effects:
+ *   Builds the decoding table for the canonical Huffman code with the
+ *   given code lengths.  Returns 0 on success and -1 if the lengths
+ *   over-subscribe the code space.
+ */
+static int
+jcf_huffman_build(struct jcf_huffman *h, const uint8_t *lengths, int count)
+{
+	int counts[16];
+	int next_code[16];
+	unsigned code, j;
+	int i, k, len, symbol;
+
+	memset(counts, 0, sizeof(counts));
+	memset(h->fast, 0, sizeof(h->fast));
+	for (i = 0; i < count; i++)
+		counts[lengths[i]]++;
+	counts[0] = 0;
+
+	code = 0;
+	k = 0;
+	for (len = 1; len < 16; len++) {
+		next_code[len] = code;
+		h->firstcode[len] = code;
+		h->firstsymbol[len] = k;
+		code += counts[len];
+		if (counts[len] != 0 && code - 1 >= (1U << len))
+			return (-1);
+		h->maxcode[len] = code << (16 - len);
+		code <<= 1;
+		k += counts[len];
+	}
+	h->maxcode[16] = 0x10000;
+	h->nsymbols = k;
+
+	for (i = 0; i < count; i++) {
+		len = lengths[i];
+		if (len == 0)
+			continue;
+		symbol = next_code[len] - h->firstcode[len] +
+		    h->firstsymbol[len];
+		h->size[symbol] = len;
+		h->value[symbol] = i;
+		if (len <= JCF_FAST_BITS) {
+			for (j = jcf_bit_reverse(next_code[len], len);
+			    j < (1U << JCF_FAST_BITS); j += 1U << len)
+				h->fast[j] = (len << 9) | i;
+		}
+		next_code[len]++;
+	}
+	return (0);
+}
+
+/*
+ * Requires:
+ *   "s" must be a valid decompression state and "h" a built table.
+ *
+ * Effects:
+ *   Decodes and returns the next symbol of the stream.  Returns -1 if
+ *   the bits do not form a code.
+ */
+static int
+jcf_huffman_decode(struct jcf_inflate_state *s, const struct jcf_huffman *h)
+{
+	unsigned entry, k;
+	int len, symbol;
+
+	if (s->nbits < 16)
+		jcf_refill(s);
+
+	// Try the fast table first.
+	entry = h->fast[s->bits & JCF_FAST_MASK];
+	if (entry != 0) {
+		len = entry >> 9;
+		s->bits >>= len;
+		s->nbits -= len;
+		return (entry & 511);
+	}
+
+	// Otherwise, find the length of the code by comparing prefixes.
+	k = jcf_bit_reverse((unsigned)(s->bits & 0xffff), 16);
+	for (len = JCF_FAST_BITS + 1; len < 16; len++) {
+		if ((int)k < h->maxcode[len])
+			break;
+	}
+	if (len >= 16)
+		return (-1);
+	symbol = (k >> (16 - len)) - h->firstcode[len] + h->firstsymbol[len];
+	if (symbol < 0 || symbol >= h->nsymbols || h->size[symbol] != len)
+		return (-1);
+	s->bits >>= len;
+	s->nbits -= len;
+	return (h->value[symbol]);
+}
+
+/*
+ * Requires:
+ *   "s" must be a valid decompression state positioned just after the
+ *   header of a stored block.
+ *
+ * Effects:
+ *   Copies the stored block to the output.  Returns 0 on success and -1
+ *   on failure.
+ */
+static int
+jcf_inflate_stored(struct jcf_inflate_state *s)
+{
+	unsigned len, nlen;
+
+	// Discard the rest of the current byte.
+	jcf_getbits(s, s->nbits & 7);
+	len = jcf_getbits(s, 16);
+	nlen = jcf_getbits(s, 16);
+	if (jcf_overrun(s) || len != (~nlen & 0xffff))
+		return (-1);
+	if (len > (size_t)(s->out_end - s->out))
+		return (-1);
+
+	// Drain whole bytes that are still buffered, then copy directly.
+	while (len > 0 && s->nbits >= 8) {
+		*s->out++ = jcf_getbits(s, 8);
+		len--;
+	}
+	if (jcf_overrun(s))
+		return (-1);
+	if (len > 0 && (s->padding > 0 || len > (size_t)(s->in_end - s->in)))
+		return (-1);
+	memcpy(s->out, s->in, len);
+	s->out += len;
+	s->in += len;
+	return (0);
+}
+
+/*
+ * Requires:
+ *   "s" must be a valid decompression state positioned just after the
+ *   header of a dynamic block.
+ *
+ * Effects:
+ *   Reads the code lengths of the block and builds its literal/length
+ *   and distance tables.  Returns 0 on success and -1 on failure.
+ */
+static int
+jcf_inflate_dynamic_tables(struct jcf_inflate_state *s)
+{
+	struct jcf_huffman clen;
+	uint8_t lengths[286 + 32];
+	uint8_t clen_lengths[19];
+	int hlit, hdist, hclen, i, n, symbol, repeat;
+	uint8_t fill;
+
+	hlit = jcf_getbits(s, 5) + 257;
+	hdist = jcf_getbits(s, 5) + 1;
+	hclen = jcf_getbits(s, 4) + 4;
+	if (hlit > 286 || hdist > 30)
+		return (-1);
+
+	memset(clen_lengths, 0, sizeof(clen_lengths));
+	for (i = 0; i < hclen; i++)
+		clen_lengths[jcf_clen_order[i]] = jcf_getbits(s, 3);
+	if (jcf_huffman_build(&clen, clen_lengths, 19) != 0)
+		return (-1);
+
+	n = 0;
+	while (n < hlit + hdist) {
+		symbol = jcf_huffman_decode(s, &clen);
+		if (symbol < 0 || jcf_overrun(s))
+			return (-1);
+		if (symbol < 16) {
+			lengths[n++] = symbol;
+			continue;
+		}
+		if (symbol == 16) {
+			if (n == 0)
+				return (-1);
+			fill = lengths[n - 1];
+			repeat = 3 + jcf_getbits(s, 2);
+		} else if (symbol == 17) {
+			fill = 0;
+			repeat = 3 + jcf_getbits(s, 3);
+		} else {
+			fill = 0;
+			repeat = 11 + jcf_getbits(s, 7);
+		}
+		if (n + repeat > hlit + hdist)
+			return (-1);
+		memset(lengths + n, fill, repeat);
+		n += repeat;
+	}
+
+	// The end-of-block code must be present.
+	if (lengths[256] == 0)
+		return (-1);
+	if (jcf_huffman_build(&s->litlen, lengths, hlit) != 0 ||
+	    jcf_huffman_build(&s->dist, lengths + hlit, hdist) != 0)
+		return (-1);
+	return (0);
+}
+
+/*
+ * Requires:
+ *   "s" must be a valid decompression state whose tables have been
+ *   built for the current block.
+ *
+ * Effects:
+ *   Decodes literals and length/distance pairs until the end of the
+ *   block.  Returns 0 on success and -1 on failure.
+ */
+static int
+jcf_inflate_codes(struct jcf_inflate_state *s)
+{
+	const uint8_t *from;
+	int symbol, len, dist;
+
+	for (;;) {
+		symbol = jcf_huffman_decode(s, &s->litlen);
+		if (symbol < 256) {
+			if (symbol < 0 || s->out == s->out_end)
+				return (-1);
+			*s->out++ = symbol;
+			continue;
+		}
+		if (symbol == 256)
+			return (jcf_overrun(s) ? -1 : 0);
+
+		// Decode a length/distance pair and copy the match.
+		symbol -= 257;
+		if (symbol >= 29)
+			return (-1);
+		len = jcf_length_base[symbol];
+		if (jcf_length_extra[symbol] != 0)
+			len += jcf_getbits(s, jcf_length_extra[symbol]);
+		symbol = jcf_huffman_decode(s, &s->dist);
+		if (symbol < 0 || symbol >= 30)
+			return (-1);
+		dist = jcf_dist_base[symbol];
+		if (jcf_dist_extra[symbol] != 0)
+			dist += jcf_getbits(s, jcf_dist_extra[symbol]);
+		if (jcf_overrun(s) || dist > s->out - s->out_start ||
+		    len > s->out_end - s->out)
+			return (-1);
+		from = s->out - dist;
+		if (dist >= len) {
+			memcpy(s->out, from, len);
+			s->out += len;
+		} else {
+			// The match overlaps its own output.
+			while (len-- > 0)
+				*s->out++ = *from++;
+		}
+	}
+}
+
+int
+jcf_inflate(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_len)
+{
+	struct jcf_inflate_state s;
+	uint8_t lengths[288 + 32];
+	unsigned final, type;
+	int err;
+
+	s.in = in;
+	s.in_end = in + in_len;
+	s.out_start = s.out = out;
+	s.out_end = out + out_len;
+	s.bits = 0;
+	s.nbits = 0;
+	s.padding = 0;
+
+	do {
+		final = jcf_getbits(&s, 1);
+		type = jcf_getbits(&s, 2);
+		switch (type) {
+		case 0:
+			err = jcf_inflate_stored(&s);
+			break;
+		case 1:
+			// Build the fixed tables of RFC 1951 section 3.2.6.
+			memset(lengths, 8, 144);
+			memset(lengths + 144, 9, 112);
+			memset(lengths + 256, 7, 24);
+			memset(lengths + 280, 8, 8);
+			memset(lengths + 288, 5, 32);
+			if (jcf_huffman_build(&s.litlen, lengths, 288) != 0 ||
+			    jcf_huffman_build(&s.dist, lengths + 288, 32) != 0)
+				return (-1);
+			err = jcf_inflate_codes(&s);
+			break;
+		case 2:
+			err = jcf_inflate_dynamic_tables(&s);
+			if (err == 0)
+				err = jcf_inflate_codes(&s);
+			break;
+		default:
+			err = -1;
+		}
+		if (err != 0 || jcf_overrun(&s))
+			return (-1);
+	} while (!final);
+
+	return (s.out == s.out_end ? 0 : -1);
+}
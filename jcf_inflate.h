@@ -0,0 +1,27 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * A self-contained decoder for raw DEFLATE streams (RFC 1951), as found
+ * in the entries of JAR and ZIP archives.
+ */
+
+#ifndef JCF_INFLATE_H
+#define JCF_INFLATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Requires:
+ *   "in" must point to "in_len" bytes and "out" must point to at least
+ *   "out_len" bytes.
+ *
+ * Effects:
+ *   Decompresses the raw DEFLATE stream "in" into "out".  Returns 0 if
+ *   the stream is valid and decompresses to exactly "out_len" bytes and
+ *   -1 otherwise.  The contents of "out" are unspecified on failure.
+ */
+int	jcf_inflate(const uint8_t *in, size_t in_len, uint8_t *out,
+	    size_t out_len);
+
+#endif /* JCF_INFLATE_H */
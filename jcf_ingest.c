@@ -0,0 +1,573 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * Batched reading of many small files through io_uring, which is driven
+ * directly through its system calls, with a fallback to pread().
+ */
+
+// Declare statx(), whose structure the statx requests fill in.
+#define _GNU_SOURCE
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#include <linux/io_uring.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "jcf_ingest.h"
+
+// Define the kinds of requests, which are the low bits of their data.
+enum jcf_ingest_op {
+	JCF_INGEST_OPEN,
+	JCF_INGEST_READ,
+	JCF_INGEST_CLOSE,
+	JCF_INGEST_STATX
+};
+
+// Define the number of requests that each file needs.
+#define JCF_INGEST_OPS		4
+
+// Define the number of opcodes that the probe asks about.
+#define JCF_INGEST_PROBE_OPS	256
+
+/*
+ * Define an io_uring instance.  Slot "i" reads into registered buffer
+ * "i" through registered file "i", so the requests of the files in
+ * flight never need a descriptor of the process's own.
+ */
+struct jcf_ingest_ring {
+	int		fd;
+	void		*sq_map;
+	size_t		sq_map_len;
+	void		*cq_map;	// the same as "sq_map" if shared
+	size_t		cq_map_len;
+	struct io_uring_sqe *sqes;
+	size_t		sqes_len;
+	unsigned	*sq_tail;
+	unsigned	*sq_array;
+	unsigned	sq_mask;
+	unsigned	*cq_head;
+	unsigned	*cq_tail;
+	struct io_uring_cqe *cqes;
+	unsigned	cq_mask;
+	unsigned	queued;		// requests that are not yet submitted
+	unsigned	queued_files;	// files whose requests those are
+	struct statx	stats[JCF_INGEST_DEPTH];
+};
+
+static struct jcf_ingest_ring *jcf_ingest_ring_create(uint8_t *buffers);
+static void	jcf_ingest_ring_destroy(struct jcf_ingest_ring *ring);
+static bool	jcf_ingest_probe(struct jcf_ingest_ring *ring);
+static int	jcf_ingest_sync(struct jcf_ingest_ring *ring);
+static bool	jcf_ingest_direct(struct jcf_ingest_ring *ring);
+static struct io_uring_sqe *jcf_ingest_sqe(struct jcf_ingest_ring *ring,
+		    int slot, enum jcf_ingest_op op);
+static int	jcf_ingest_enter(struct jcf_ingest *ingest, unsigned wait);
+static void	jcf_ingest_reap(struct jcf_ingest *ingest);
+static int	jcf_ingest_pread(struct jcf_ingest_slot *slot);
+
+/*
+ * Requires:
+ *   "buffers" must hold JCF_INGEST_DEPTH buffers of JCF_INGEST_BUFFER
+ *   bytes each.
+ *
+ * Effects:
+ *   Creates an io_uring instance with room for the requests of every
+ *   slot, maps its rings, and registers the buffers and an empty table
+ *   of files with it.  Returns the instance, or NULL if io_uring is not
+ *   available, any step fails, or the kernel cannot run the requests
+ *   that read a file, which need direct descriptors (Linux 5.15).
+ */
+static struct jcf_ingest_ring *
+jcf_ingest_ring_create(uint8_t *buffers)
+{
+	struct jcf_ingest_ring *ring;
+	struct io_uring_params params;
+	struct iovec iov[JCF_INGEST_DEPTH];
+	int fds[JCF_INGEST_DEPTH], i;
+	uint8_t *sq, *cq;
+
+	if ((ring = calloc(1, sizeof(*ring))) == NULL)
+		return (NULL);
+	ring->sq_map = ring->cq_map = MAP_FAILED;
+	ring->sqes = MAP_FAILED;
+	memset(&params, 0, sizeof(params));
+	ring->fd = syscall(__NR_io_uring_setup, JCF_INGEST_DEPTH *
+	    JCF_INGEST_OPS, &params);
+	if (ring->fd < 0) {
+		free(ring);
+		return (NULL);
+	}
+
+	// Map the submission and completion rings and the requests.
+	ring->sq_map_len = params.sq_off.array + params.sq_entries *
+	    sizeof(unsigned);
+	ring->cq_map_len = params.cq_off.cqes + params.cq_entries *
+	    sizeof(struct io_uring_cqe);
+	if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0 &&
+	    ring->cq_map_len > ring->sq_map_len)
+		ring->sq_map_len = ring->cq_map_len;
+	ring->sq_map = mmap(NULL, ring->sq_map_len, PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (ring->sq_map == MAP_FAILED)
+		goto fail;
+	if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0)
+		ring->cq_map = ring->sq_map;
+	else {
+		ring->cq_map = mmap(NULL, ring->cq_map_len, PROT_READ |
+		    PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+		    IORING_OFF_CQ_RING);
+		if (ring->cq_map == MAP_FAILED)
+			goto fail;
+	}
+	ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED)
+		goto fail;
+	sq = ring->sq_map;
+	cq = ring->cq_map;
+	ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+	ring->sq_mask = *(unsigned *)(sq + params.sq_off.ring_mask);
+	ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+	ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+	ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+	ring->cq_mask = *(unsigned *)(cq + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+	// Register the buffers and a table of empty file slots.
+	for (i = 0; i < JCF_INGEST_DEPTH; i++) {
+		iov[i].iov_base = buffers + (size_t)i * JCF_INGEST_BUFFER;
+		iov[i].iov_len = JCF_INGEST_BUFFER;
+		fds[i] = -1;
+	}
+	if (syscall(__NR_io_uring_register, ring->fd,
+	    IORING_REGISTER_BUFFERS, iov, JCF_INGEST_DEPTH) != 0 ||
+	    syscall(__NR_io_uring_register, ring->fd,
+	    IORING_REGISTER_FILES, fds, JCF_INGEST_DEPTH) != 0)
+		goto fail;
+	if (!jcf_ingest_probe(ring) || !jcf_ingest_direct(ring))
+		goto fail;
+	return (ring);
+
+fail:
+	jcf_ingest_ring_destroy(ring);
+	return (NULL);
+}
+
+/*
+ * Requires:
+ *   "ring" must have no requests in flight.
+ *
+ * Effects:
+ *   Unmaps the rings and closes the instance, which unregisters its
+ *   buffers and files.
+ */
+static void
+jcf_ingest_ring_destroy(struct jcf_ingest_ring *ring)
+{
+	if (ring->sqes != MAP_FAILED)
+		munmap(ring->sqes, ring->sqes_len);
+	if (ring->cq_map != MAP_FAILED && ring->cq_map != ring->sq_map)
+		munmap(ring->cq_map, ring->cq_map_len);
+	if (ring->sq_map != MAP_FAILED)
+		munmap(ring->sq_map, ring->sq_map_len);
+	close(ring->fd);
+	free(ring);
+}
+
+/*
+ * Requires:
+ *   "ring" must have been set up by jcf_ingest_ring_create().
+ *
+ * Effects:
+ *   Returns true if the kernel supports every opcode that reading a file
+ *   uses and false otherwise.
+ */
+static bool
+jcf_ingest_probe(struct jcf_ingest_ring *ring)
+{
+	static const uint8_t ops[] = { IORING_OP_OPENAT,
+	    IORING_OP_READ_FIXED, IORING_OP_CLOSE, IORING_OP_STATX };
+	struct io_uring_probe *probe;
+	bool supported = false;
+	size_t i;
+
+	probe = calloc(1, sizeof(*probe) + JCF_INGEST_PROBE_OPS *
+	    sizeof(probe->ops[0]));
+	if (probe == NULL)
+		return (false);
+	if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PROBE,
+	    probe, JCF_INGEST_PROBE_OPS) != 0)
+		goto done;
+	for (i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+		if (ops[i] > probe->last_op || ops[i] >= probe->ops_len ||
+		    (probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED) == 0)
+			goto done;
+	}
+	supported = true;
+
+done:
+	free(probe);
+	return (supported);
+}
+
+/*
+ * Requires:
+ *   "ring" must have exactly one request queued and none in flight.
+ *
+ * Effects:
+ *   Submits the request, waits for it to complete, and returns its
+ *   result, or -errno if it could not be submitted.
+ */
+static int
+jcf_ingest_sync(struct jcf_ingest_ring *ring)
+{
+	struct io_uring_cqe *cqe;
+	unsigned head;
+	int n, res;
+
+	do
+		n = syscall(__NR_io_uring_enter, ring->fd, ring->queued, 1,
+		    IORING_ENTER_GETEVENTS, NULL, 0);
+	while (n < 0 && errno == EINTR);
+	if (n < 0)
+		return (-errno);
+	ring->queued = 0;
+	head = *ring->cq_head;
+	while (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+		if (syscall(__NR_io_uring_enter, ring->fd, 0, 1,
+		    IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR)
+			return (-errno);
+	}
+	cqe = &ring->cqes[head & ring->cq_mask];
+	res = cqe->res;
+	__atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+	return (res);
+}
+
+/*
+ * Requires:
+ *   "ring" must have been set up by jcf_ingest_ring_create(), with no
+ *   requests queued or in flight.
+ *
+ * Effects:
+ *   Opens "/" into file slot 0 and closes it again, to check that the
+ *   kernel opens files into direct descriptors.  A kernel that ignores
+ *   the file slot returns a descriptor of the process instead, which is
+ *   closed.  Returns true if the direct descriptor was opened and closed
+ *   and false otherwise.
+ */
+static bool
+jcf_ingest_direct(struct jcf_ingest_ring *ring)
+{
+	struct io_uring_sqe *sqe;
+	int res;
+
+	sqe = jcf_ingest_sqe(ring, 0, JCF_INGEST_OPEN);
+	sqe->opcode = IORING_OP_OPENAT;
+	sqe->fd = AT_FDCWD;
+	sqe->addr = (uintptr_t)"/";
+	sqe->open_flags = O_RDONLY | O_DIRECTORY;
+	sqe->file_index = 1;
+	if ((res = jcf_ingest_sync(ring)) != 0) {
+		if (res > 0)
+			close(res);
+		return (false);
+	}
+	sqe = jcf_ingest_sqe(ring, 0, JCF_INGEST_CLOSE);
+	sqe->opcode = IORING_OP_CLOSE;
+	sqe->file_index = 1;
+	return (jcf_ingest_sync(ring) == 0);
+}
+
+/*
+ * Requires:
+ *   The submission ring must have room for another request, which it
+ *   does while no slot has more than JCF_INGEST_OPS requests queued.
+ *
+ * Effects:
+ *   Queues a cleared request for "op" of "slot" and returns it, to be
+ *   filled in before the next submission.
+ */
+static struct io_uring_sqe *
+jcf_ingest_sqe(struct jcf_ingest_ring *ring, int slot, enum jcf_ingest_op op)
+{
+	struct io_uring_sqe *sqe;
+	unsigned tail = *ring->sq_tail, index = tail & ring->sq_mask;
+
+	sqe = &ring->sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->user_data = (uint64_t)slot * JCF_INGEST_OPS + op;
+	ring->sq_array[index] = index;
+
+	// The kernel reads the request once it sees the new tail.
+	__atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	ring->queued++;
+	return (sqe);
+}
+
+/*
+ * Requires:
+ *   "ingest" must use io_uring.
+ *
+ * Effects:
+ *   Submits the queued requests and, if "wait" is not zero, waits for at
+ *   least one completion.  Then handles every completion that is ready.
+ *   Returns 0 on success and -1 on failure.
+ */
+static int
+jcf_ingest_enter(struct jcf_ingest *ingest, unsigned wait)
+{
+	struct jcf_ingest_ring *ring = ingest->ring;
+	int n;
+
+	for (;;) {
+		n = syscall(__NR_io_uring_enter, ring->fd, ring->queued, wait,
+		    wait != 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+		if (n >= 0) {
+			ring->queued -= n;
+			if (ring->queued == 0)
+				ring->queued_files = 0;
+			break;
+		}
+		if (errno == EINTR)
+			continue;
+
+		// The kernel is short of memory for requests; reap and retry.
+		if (errno != EAGAIN && errno != EBUSY)
+			return (-1);
+		jcf_ingest_reap(ingest);
+		wait = 0;
+	}
+	jcf_ingest_reap(ingest);
+	return (0);
+}
+
+/*
+ * Requires:
+ *   "ingest" must use io_uring.
+ *
+ * Effects:
+ *   Records the result of every completed request in its slot.  A file
+ *   has been read when none of its requests is pending.
+ */
+static void
+jcf_ingest_reap(struct jcf_ingest *ingest)
+{
+	struct jcf_ingest_ring *ring = ingest->ring;
+	struct jcf_ingest_slot *slot;
+	struct io_uring_cqe *cqe;
+	unsigned head, tail;
+
+	head = *ring->cq_head;
+	tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+	for (; head != tail; head++) {
+		cqe = &ring->cqes[head & ring->cq_mask];
+		slot = &ingest->slots[cqe->user_data / JCF_INGEST_OPS];
+		slot->pending--;
+		switch (cqe->user_data % JCF_INGEST_OPS) {
+		case JCF_INGEST_READ:
+			if (cqe->res >= 0)
+				slot->len = cqe->res;
+			else
+				slot->failed = true;
+			break;
+		case JCF_INGEST_STATX:
+			if (cqe->res >= 0)
+				slot->size = ring->stats[slot -
+				    ingest->slots].stx_size;
+			else
+				slot->failed = true;
+			break;
+		case JCF_INGEST_OPEN:
+			if (cqe->res < 0)
+				slot->failed = true;
+			break;
+		default:
+			// A failure to close only leaves the file slot in use.
+			break;
+		}
+	}
+	__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/*
+ * Requires:
+ *   "slot" must have been started.
+ *
+ * Effects:
+ *   Reads the file in "slot" with open(), fstat() and pread().  Returns
+ *   0 on success and -1 on failure.
+ */
+static int
+jcf_ingest_pread(struct jcf_ingest_slot *slot)
+{
+	struct stat sb;
+	ssize_t n;
+	int fd;
+
+	if ((fd = open(slot->path, O_RDONLY | O_CLOEXEC)) < 0)
+		return (-1);
+	if (fstat(fd, &sb) != 0 || !S_ISREG(sb.st_mode) ||
+	    sb.st_size > JCF_INGEST_BUFFER) {
+		close(fd);
+		return (-1);
+	}
+	slot->size = sb.st_size;
+	while (slot->len < slot->size) {
+		n = pread(fd, slot->buf + slot->len, slot->size - slot->len,
+		    slot->len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		slot->len += n;
+	}
+	close(fd);
+	return (slot->len == slot->size ? 0 : -1);
+}
+
+int
+jcf_ingest_init(struct jcf_ingest *ingest)
+{
+	int i;
+
+	ingest->buffers = malloc((size_t)JCF_INGEST_DEPTH *
+	    JCF_INGEST_BUFFER);
+	if (ingest->buffers == NULL)
+		return (-1);
+	for (i = 0; i < JCF_INGEST_DEPTH; i++) {
+		ingest->slots[i].path = NULL;
+		ingest->slots[i].buf = ingest->buffers +
+		    (size_t)i * JCF_INGEST_BUFFER;
+	}
+	ingest->ring = jcf_ingest_ring_create(ingest->buffers);
+	return (0);
+}
+
+void
+jcf_ingest_destroy(struct jcf_ingest *ingest)
+{
+	int i;
+
+	/*
+	 * The kernel may write into the buffers until every request has
+	 * completed.
+	 */
+	if (ingest->ring != NULL) {
+		for (i = 0; i < JCF_INGEST_DEPTH; i++) {
+			while (ingest->slots[i].path != NULL &&
+			    ingest->slots[i].pending > 0 &&
+			    jcf_ingest_enter(ingest, 1) == 0)
+				;
+		}
+		jcf_ingest_ring_destroy(ingest->ring);
+	}
+	free(ingest->buffers);
+}
+
+int
+jcf_ingest_start(struct jcf_ingest *ingest, const char *path)
+{
+	struct jcf_ingest_ring *ring = ingest->ring;
+	struct jcf_ingest_slot *slot;
+	struct io_uring_sqe *sqe;
+	int i;
+
+	for (i = 0; i < JCF_INGEST_DEPTH && ingest->slots[i].path != NULL;
+	    i++)
+		;
+	if (i == JCF_INGEST_DEPTH)
+		return (-1);
+	slot = &ingest->slots[i];
+	slot->path = path;
+	slot->len = 0;
+	slot->size = 0;
+	slot->pending = 0;
+	slot->failed = false;
+	if (ring == NULL)
+		return (i);
+
+	/*
+	 * Open the file into file slot "i", read it into buffer "i", and
+	 * close it, as one chain.  The close is hard linked so that it
+	 * runs even if the read fails.  The statx runs on its own.
+	 */
+	sqe = jcf_ingest_sqe(ring, i, JCF_INGEST_OPEN);
+	sqe->opcode = IORING_OP_OPENAT;
+	sqe->fd = AT_FDCWD;
+	sqe->addr = (uintptr_t)path;
+	sqe->open_flags = O_RDONLY;	// a direct descriptor is never inherited
+	sqe->file_index = i + 1;
+	sqe->flags = IOSQE_IO_LINK;
+	sqe = jcf_ingest_sqe(ring, i, JCF_INGEST_READ);
+	sqe->opcode = IORING_OP_READ_FIXED;
+	sqe->fd = i;
+	sqe->addr = (uintptr_t)slot->buf;
+	sqe->len = JCF_INGEST_BUFFER;
+	sqe->buf_index = i;
+	sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+	sqe = jcf_ingest_sqe(ring, i, JCF_INGEST_CLOSE);
+	sqe->opcode = IORING_OP_CLOSE;
+	sqe->file_index = i + 1;
+	sqe = jcf_ingest_sqe(ring, i, JCF_INGEST_STATX);
+	sqe->opcode = IORING_OP_STATX;
+	sqe->fd = AT_FDCWD;
+	sqe->addr = (uintptr_t)path;
+	sqe->len = STATX_SIZE;
+	sqe->off = (uintptr_t)&ring->stats[i];
+	slot->pending = JCF_INGEST_OPS;
+
+	// Submit the requests of a full batch of files without waiting.
+	if (++ring->queued_files >= JCF_INGEST_BATCH &&
+	    jcf_ingest_enter(ingest, 0) != 0)
+		slot->failed = true;
+	return (i);
+}
+
+int
+jcf_ingest_wait(struct jcf_ingest *ingest, int slot, const uint8_t **bufp,
+    size_t *lenp)
+{
+	struct jcf_ingest_slot *s = &ingest->slots[slot];
+
+	if (ingest->ring == NULL) {
+		if (jcf_ingest_pread(s) != 0)
+			return (-1);
+	} else {
+		while (s->pending > 0) {
+			if (jcf_ingest_enter(ingest, 1) != 0)
+				return (-1);
+		}
+
+		/*
+		 * A file that filled its buffer may have more to read, and
+		 * one that changed between the statx and the read may be
+		 * torn.
+		 */
+		if (s->failed || s->len != s->size)
+			return (-1);
+	}
+	*bufp = s->buf;
+	*lenp = s->len;
+	return (0);
+}
+
+void
+jcf_ingest_release(struct jcf_ingest *ingest, int slot)
+{
+	// Keep a slot that the kernel may still write into.
+	while (ingest->slots[slot].pending > 0) {
+		if (jcf_ingest_enter(ingest, 1) != 0)
+			return;
+	}
+	ingest->slots[slot].path = NULL;
+}
@@ -0,0 +1,107 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * Batched reading of many small files.  Each file that is started is
+ * read whole into one of a fixed number of buffers, so that the reads
+ * of the files ahead of the one being processed are in flight while it
+ * is processed.  Where io_uring is available, each file's open, statx,
+ * read and close are submitted together, many files to a system call,
+ * into buffers and file slots that are registered with the kernel once.
+ * Otherwise, each file is read with pread() when it is waited for.
+ * Either way, no threads are added.
+ */
+
+#ifndef JCF_INGEST_H
+#define JCF_INGEST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Define the number of files that may be started and not yet released.
+#define JCF_INGEST_DEPTH	64
+
+// Define the number of files whose requests are submitted together.
+#define JCF_INGEST_BATCH	16
+
+// Define the size of a buffer, which bounds the files that are read.
+#define JCF_INGEST_BUFFER	(64 * 1024)
+
+// Define a file that has been started.
+struct jcf_ingest_slot {
+	const char	*path;		// NULL if the slot is free
+	uint8_t		*buf;		// JCF_INGEST_BUFFER bytes
+	size_t		len;		// the number of bytes read
+	uint64_t	size;		// the size of the file
+	int		pending;	// the number of requests in flight
+	bool		failed;		// whether a request failed
+};
+
+struct jcf_ingest_ring;
+
+// Define a set of files that are being read.
+struct jcf_ingest {
+	struct jcf_ingest_ring *ring;	// NULL if pread() is used
+	uint8_t		*buffers;
+	struct jcf_ingest_slot slots[JCF_INGEST_DEPTH];
+};
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Initializes "ingest", with io_uring if the kernel allows it and with
+ *   pread() otherwise.  Returns 0 on success and -1 if memory could not
+ *   be allocated.
+ */
+int	jcf_ingest_init(struct jcf_ingest *ingest);
+
+/*
+ * Requires:
+ *   "ingest" must have been initialized by jcf_ingest_init().
+ *
+ * Effects:
+ *   Waits for the requests in flight, and frees the memory and kernel
+ *   resources held by "ingest".
+ */
+void	jcf_ingest_destroy(struct jcf_ingest *ingest);
+
+/*
+ * Requires:
+ *   "ingest" must have been initialized by jcf_ingest_init().  "path"
+ *   must stay valid until its slot is released.
+ *
+ * Effects:
+ *   Starts reading the file "path" and returns the slot that it is read
+ *   into, or -1 if every slot is in use.
+ */
+int	jcf_ingest_start(struct jcf_ingest *ingest, const char *path);
+
+/*
+ * Requires:
+ *   "slot" must have been returned by jcf_ingest_start() and not have
+ *   been released.
+ *
+ * Effects:
+ *   Waits until the file in "slot" has been read, submitting any
+ *   requests that are queued.  Stores in "*bufp" and "*lenp" its
+ *   contents, which stay valid until the slot is released.  Returns 0 on
+ *   success and -1 if the file could not be read whole into the slot,
+ *   such as when it is missing or larger than a buffer, in which case
+ *   the caller should read it some other way.
+ */
+int	jcf_ingest_wait(struct jcf_ingest *ingest, int slot,
+	    const uint8_t **bufp, size_t *lenp);
+
+/*
+ * Requires:
+ *   "slot" must have been waited for by jcf_ingest_wait().
+ *
+ * Effects:
+ *   Makes "slot" free for another file once none of its requests is in
+ *   flight.
+ */
+void	jcf_ingest_release(struct jcf_ingest *ingest, int slot);
+
+#endif /* JCF_INGEST_H */
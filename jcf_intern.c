@@ -0,0 +1,325 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * A sharded string intern table.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "jcf_intern.h"
+
+// Define the size of a chunk of string storage.
+#define JCF_INTERN_CHUNK_SIZE	(256 * 1024)
+
+// Define the number of strings that a shard can hold.
+#define JCF_INTERN_MAX_COUNT	((1u << (32 - JCF_INTERN_SHARD_BITS)) - 1)
+
+/*
+ * Define a chunk of string storage.  Strings are copied into chunks,
+ * which are never moved.
+ */
+struct jcf_intern_chunk {
+	struct jcf_intern_chunk *next;
+	size_t		used;
+	size_t		size;
+	char		bytes[];
+};
+
+static uint64_t	jcf_intern_hash(const char *bytes, size_t length);
+static struct jcf_intern_string *jcf_intern_entry(
+		    const struct jcf_intern_shard *shard, uint32_t index);
+static int	jcf_intern_grow(struct jcf_intern_shard *shard);
+static uint32_t	jcf_intern_lookup(const struct jcf_intern_shard *shard,
+		    uint64_t hash, const char *bytes, size_t length,
+		    size_t *slotp);
+static const char *jcf_intern_copy(struct jcf_intern_shard *shard,
+		    const char *bytes, size_t length);
+
+/*
+ * Requires:
+ *   "bytes" must point to "length" bytes.
+ *
+ * Effects:
+ *   Returns the 64-bit FNV-1a hash of the string.
+ */
+static uint64_t
+jcf_intern_hash(const char *bytes, size_t length)
+{
+	uint64_t hash = 0xcbf29ce484222325;
+	size_t i;
+
+	for (i = 0; i < length; i++)
+		hash = (hash ^ (uint8_t)bytes[i]) * 0x100000001b3;
+	return (hash);
+}
+
+/*
+ * Requires:
+ *   "index" must be less than the number of strings in "shard", or
+ *   equal to it if the page that would hold it has been allocated.
+ *
+ * Effects:
+ *   Returns the entry of string "index" of the shard.  Page "k" holds
+ *   the indices from (256 << k) - 256 up to (512 << k) - 256, so the
+ *   page is found from the highest set bit of "index" + 256.
+ */
+static struct jcf_intern_string *
+jcf_intern_entry(const struct jcf_intern_shard *shard, uint32_t index)
+{
+	uint32_t j = index + 256;
+	int k = 31 - __builtin_clz(j) - 8;
+
+	return (&shard->pages[k][j - (256u << k)]);
+}
+
+/*
+ * Requires:
+ *   The caller must hold the shard's lock.
+ *
+ * Effects:
+ *   Doubles the shard's hash index, rehashing its strings.  Returns 0 on
+ *   success and -1 on failure.
+ */
+static int
+jcf_intern_grow(struct jcf_intern_shard *shard)
+{
+	uint64_t *slots;
+	size_t i, j, mask = shard->mask * 2 + 1;
+
+	slots = calloc(mask + 1, sizeof(*slots));
+	if (slots == NULL)
+		return (-1);
+	for (i = 0; i <= shard->mask; i++) {
+		if (shard->slots[i] == 0)
+			continue;
+
+		/*
+		 * A slot keeps the upper half of its string's hash, and the
+		 * lower half is the part that chose the shard, so the new
+		 * position comes from the stored half.
+		 */
+		for (j = (shard->slots[i] >> 32) & mask; slots[j] != 0;
+		    j = (j + 1) & mask)
+			;
+		slots[j] = shard->slots[i];
+	}
+	free(shard->slots);
+	shard->slots = slots;
+	shard->mask = mask;
+	return (0);
+}
+
+/*
+ * Requires:
+ *   The caller must hold the shard's lock.  "hash" must be the hash of
+ *   the "length" bytes that "bytes" points to.
+ *
+ * Effects:
+ *   Returns the index within the shard of the string, or JCF_INTERN_NONE
+ *   if it is not there, in which case stores in "*slotp" the empty slot
+ *   of the hash index where it would be added.
+ */
+static uint32_t
+jcf_intern_lookup(const struct jcf_intern_shard *shard, uint64_t hash,
+    const char *bytes, size_t length, size_t *slotp)
+{
+	const struct jcf_intern_string *entry;
+	uint64_t tag = hash & ~(uint64_t)0xffffffff;
+	uint32_t index;
+	size_t i;
+
+	for (i = (hash >> 32) & shard->mask; shard->slots[i] != 0;
+	    i = (i + 1) & shard->mask) {
+		if ((shard->slots[i] & ~(uint64_t)0xffffffff) != tag)
+			continue;
+		index = (shard->slots[i] & 0xffffffff) - 1;
+		entry = jcf_intern_entry(shard, index);
+		if (entry->length == length &&
+		    memcmp(entry->bytes, bytes, length) == 0)
+			return (index);
+	}
+	*slotp = i;
+	return (JCF_INTERN_NONE);
+}
+
+/*
+ * Requires:
+ *   The caller must hold the shard's lock.  "bytes" must point to
+ *   "length" bytes.
+ *
+ * Effects:
+ *   Returns a copy of the string in the shard's storage, or NULL if
+ *   memory could not be allocated.
+ */
+static const char *
+jcf_intern_copy(struct jcf_intern_shard *shard, const char *bytes,
+    size_t length)
+{
+	struct jcf_intern_chunk *chunk = shard->chunks;
+	size_t size;
+	char *copy;
+
+	if (chunk == NULL || chunk->size - chunk->used < length) {
+		size = length > JCF_INTERN_CHUNK_SIZE ? length :
+		    JCF_INTERN_CHUNK_SIZE;
+		chunk = malloc(sizeof(*chunk) + size);
+		if (chunk == NULL)
+			return (NULL);
+		chunk->next = shard->chunks;
+		chunk->used = 0;
+		chunk->size = size;
+		shard->chunks = chunk;
+	}
+	copy = chunk->bytes + chunk->used;
+	memcpy(copy, bytes, length);
+	chunk->used += length;
+	return (copy);
+}
+
+int
+jcf_intern_init(struct jcf_intern *intern)
+{
+	struct jcf_intern_shard *shard;
+	int i;
+
+	for (i = 0; i < JCF_INTERN_SHARDS; i++) {
+		shard = &intern->shards[i];
+		memset(shard, 0, sizeof(*shard));
+		pthread_mutex_init(&shard->lock, NULL);
+		shard->mask = 15;
+		shard->slots = calloc(shard->mask + 1, sizeof(*shard->slots));
+		if (shard->slots == NULL) {
+			while (i-- > 0) {
+				free(intern->shards[i].slots);
+				pthread_mutex_destroy(&intern->shards[i].lock);
+			}
+			pthread_mutex_destroy(&shard->lock);
+			return (-1);
+		}
+	}
+	return (0);
+}
+
+void
+jcf_intern_destroy(struct jcf_intern *intern)
+{
+	struct jcf_intern_shard *shard;
+	struct jcf_intern_chunk *chunk, *next;
+	int i, k;
+
+	for (i = 0; i < JCF_INTERN_SHARDS; i++) {
+		shard = &intern->shards[i];
+		for (chunk = shard->chunks; chunk != NULL; chunk = next) {
+			next = chunk->next;
+			free(chunk);
+		}
+		for (k = 0; k < JCF_INTERN_PAGES; k++)
+			free(shard->pages[k]);
+		free(shard->slots);
+		pthread_mutex_destroy(&shard->lock);
+	}
+}
+
+int
+jcf_intern_add(struct jcf_intern *intern, const char *bytes, size_t length,
+    uint32_t *idp)
+{
+	struct jcf_intern_shard *shard;
+	struct jcf_intern_string *entry;
+	uint64_t hash = jcf_intern_hash(bytes, length);
+	uint64_t tag = hash & ~(uint64_t)0xffffffff;
+	uint32_t shard_index = hash & (JCF_INTERN_SHARDS - 1);
+	uint32_t index;
+	size_t i;
+	int err = -1, k;
+
+	if (length > UINT32_MAX)
+		return (-1);
+	shard = &intern->shards[shard_index];
+	pthread_mutex_lock(&shard->lock);
+
+	// Keep the index at most half full, counting a string to be added.
+	if (2 * (shard->count + 1) > shard->mask + 1 &&
+	    jcf_intern_grow(shard) != 0)
+		goto done;
+
+	// Look the string up.
+	index = jcf_intern_lookup(shard, hash, bytes, length, &i);
+	if (index != JCF_INTERN_NONE) {
+		err = 0;
+		goto done;
+	}
+
+	// Add the string, allocating the next page when it is needed.
+	index = shard->count;
+	if (index == JCF_INTERN_MAX_COUNT)
+		goto done;
+	k = 31 - __builtin_clz(index + 256) - 8;
+	if (shard->pages[k] == NULL) {
+		shard->pages[k] = malloc((256u << k) * sizeof(*entry));
+		if (shard->pages[k] == NULL)
+			goto done;
+	}
+	entry = jcf_intern_entry(shard, index);
+	entry->bytes = jcf_intern_copy(shard, bytes, length);
+	if (entry->bytes == NULL)
+		goto done;
+	entry->length = length;
+	shard->slots[i] = tag | (index + 1);
+	shard->count++;
+	err = 0;
+
+done:
+	pthread_mutex_unlock(&shard->lock);
+	if (err == 0)
+		*idp = index << JCF_INTERN_SHARD_BITS | shard_index;
+	return (err);
+}
+
+int
+jcf_intern_find(struct jcf_intern *intern, const char *bytes, size_t length,
+    uint32_t *idp)
+{
+	struct jcf_intern_shard *shard;
+	uint64_t hash = jcf_intern_hash(bytes, length);
+	uint32_t shard_index = hash & (JCF_INTERN_SHARDS - 1);
+	uint32_t index;
+	size_t i;
+
+	if (length > UINT32_MAX)
+		return (-1);
+	shard = &intern->shards[shard_index];
+	pthread_mutex_lock(&shard->lock);
+	index = jcf_intern_lookup(shard, hash, bytes, length, &i);
+	pthread_mutex_unlock(&shard->lock);
+	if (index == JCF_INTERN_NONE)
+		return (-1);
+	*idp = index << JCF_INTERN_SHARD_BITS | shard_index;
+	return (0);
+}
+
+const char *
+jcf_intern_string(const struct jcf_intern *intern, uint32_t id,
+    size_t *lengthp)
+{
+	const struct jcf_intern_string *entry;
+
+	entry = jcf_intern_entry(&intern->shards[id &
+	    (JCF_INTERN_SHARDS - 1)], id >> JCF_INTERN_SHARD_BITS);
+	*lengthp = entry->length;
+	return (entry->bytes);
+}
+
+uint32_t
+jcf_intern_limit(const struct jcf_intern *intern)
+{
+	uint32_t count = 0;
+	int i;
+
+	for (i = 0; i < JCF_INTERN_SHARDS; i++) {
+		if (intern->shards[i].count > count)
+			count = intern->shards[i].count;
+	}
+	return (count << JCF_INTERN_SHARD_BITS);
+}
@@ -0,0 +1,133 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * A string intern table that is shared by every thread of a scan.  Each
+ * distinct string is stored once and is named by a 32-bit ID, so that
+ * records can carry IDs instead of copies of their strings and can be
+ * joined by comparing integers.
+ *
+ * The table is divided into shards by the strings' hashes, and each
+ * shard has its own lock, so threads that intern different strings
+ * rarely wait for each other.  A string's ID holds the index of its
+ * shard in its low bits and its index within the shard above them.
+ * The strings of a shard are kept in pages that are never moved, so a
+ * string can be read by its ID without taking the lock.
+ */
+
+#ifndef JCF_INTERN_H
+#define JCF_INTERN_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Define the number of shards, which must be a power of two.
+#define JCF_INTERN_SHARD_BITS	6
+#define JCF_INTERN_SHARDS	(1 << JCF_INTERN_SHARD_BITS)
+
+/*
+ * Define the number of pages of a shard.  Page "k" holds 256 << k
+ * strings, so the pages together hold every index that fits in an ID.
+ */
+#define JCF_INTERN_PAGES	(32 - JCF_INTERN_SHARD_BITS - 8 + 1)
+
+// Define an ID that names no string.
+#define JCF_INTERN_NONE		UINT32_MAX
+
+// Define a string of the table.
+struct jcf_intern_string {
+	const char	*bytes;		// not NUL terminated
+	uint32_t	length;
+};
+
+struct jcf_intern_chunk;
+
+// Define a shard of the table.
+struct jcf_intern_shard {
+	pthread_mutex_t	lock;		// protects the rest of the shard
+	uint64_t	*slots;		// hash and one more than an index
+	size_t		mask;
+	uint32_t	count;
+	struct jcf_intern_string *pages[JCF_INTERN_PAGES];
+	struct jcf_intern_chunk *chunks; // storage for the strings
+};
+
+// Define an intern table.
+struct jcf_intern {
+	struct jcf_intern_shard shards[JCF_INTERN_SHARDS];
+};
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Initializes "intern" to be empty.  Returns 0 on success and -1 on
+ *   failure.
+ */
+int	jcf_intern_init(struct jcf_intern *intern);
+
+/*
+ * Requires:
+ *   "intern" must have been initialized by jcf_intern_init(), and no
+ *   other thread may be using it.
+ *
+ * Effects:
+ *   Frees the memory held by "intern", including its strings.
+ */
+void	jcf_intern_destroy(struct jcf_intern *intern);
+
+/*
+ * Requires:
+ *   "intern" must have been initialized by jcf_intern_init().  "bytes"
+ *   must point to "length" bytes.
+ *
+ * Effects:
+ *   Stores "*idp" as the ID of the string, copying the string into the
+ *   table if it is not there already.  Equal strings always get the same
+ *   ID.  Is safe to call from several threads at once.  Returns 0 on
+ *   success and -1 on failure.
+ */
+int	jcf_intern_add(struct jcf_intern *intern, const char *bytes,
+	    size_t length, uint32_t *idp);
+
+/*
+ * Requires:
+ *   "intern" must have been initialized by jcf_intern_init().  "bytes"
+ *   must point to "length" bytes.
+ *
+ * Effects:
+ *   Stores "*idp" as the ID of the string if it is in the table, without
+ *   adding it.  Is safe to call from several threads at once.  Returns 0
+ *   if the string is in the table and -1 if it is not.
+ */
+int	jcf_intern_find(struct jcf_intern *intern, const char *bytes,
+	    size_t length, uint32_t *idp);
+
+/*
+ * Requires:
+ *   "id" must have been returned by jcf_intern_add() or
+ *   jcf_intern_find() to this thread, or to another thread that has
+ *   since synchronized with this one.
+ *
+ * Effects:
+ *   Returns the string named by "id", which is not NUL terminated, and
+ *   stores its length in "*lengthp".  The string stays valid until the
+ *   table is destroyed.
+ */
+const char *jcf_intern_string(const struct jcf_intern *intern, uint32_t id,
+	    size_t *lengthp);
+
+/*
+ * Requires:
+ *   "intern" must have been initialized by jcf_intern_init(), and no
+ *   other thread may be adding to it.
+ *
+ * Effects:
+ *   Returns a bound that every ID in the table is less than.  Because
+ *   the shards fill evenly, the bound is close to the number of
+ *   strings, so the IDs can index an array.
+ */
+uint32_t jcf_intern_limit(const struct jcf_intern *intern);
+
+#endif /* JCF_INTERN_H */
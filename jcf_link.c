@@ -0,0 +1,556 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * A link checker that joins member references against member
+ * definitions through open-addressed hash maps keyed by interned IDs,
+ * and resolves inherited members through an index of the class
+ * hierarchy.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jcf_link.h"
+
+// Define the flags kept for each symbol during a check.
+#define JCF_LINK_REFERENCED	0x01	// a definition that is referenced
+#define JCF_LINK_MISSING	0x02	// a reference that is not resolved
+
+// Define the memoized result of a lookup that is still being made.
+#define JCF_LINK_PENDING	UINT32_MAX
+
+/*
+ * Define the deepest chain of superclasses and superinterfaces that is
+ * followed.  Real hierarchies are far shallower; the limit only keeps
+ * malformed inputs from exhausting the stack.
+ */
+#define JCF_LINK_MAX_DEPTH	1024
+
+// Define the key of an empty slot of a map, which no pair of IDs forms.
+#define JCF_LINK_EMPTY		UINT64_MAX
+
+/*
+ * Define a map from pairs of 32-bit IDs, packed into one 64-bit key, to
+ * 32-bit values.
+ */
+struct jcf_link_map {
+	uint64_t	*keys;		// JCF_LINK_EMPTY if the slot is empty
+	uint32_t	*values;
+	size_t		mask;
+	size_t		count;
+};
+
+/*
+ * Define the state of a link check.  "order" holds the symbols in file
+ * order.  "definitions" maps a class name and member to one more than
+ * the position of the member's first definition.  Each class that is
+ * among the inputs has a class ID, which "classes" maps its name to and
+ * which indexes "names", "supers" and "interfaces_start".  Its
+ * superclass and superinterfaces are stored as class IDs, the interfaces
+ * in compressed rows: those of class "c" are
+ * "interfaces[interfaces_start[c]]" up to
+ * "interfaces[interfaces_start[c + 1]]".  "memo" maps a class ID and
+ * member to the result of looking the member up in the class's
+ * hierarchy.
+ */
+struct jcf_link_state {
+	const struct jcf_link_symbol **order;
+	struct jcf_link_map definitions;
+	struct jcf_link_map classes;
+	const struct jcf_link_symbol **names;	// the class symbols
+	uint32_t	*supers;
+	uint32_t	*interfaces_start;
+	uint32_t	*interfaces;
+	uint32_t	nclasses;
+	struct jcf_link_map memo;
+};
+
+static uint64_t	jcf_link_key(uint32_t first, uint32_t second);
+static int	jcf_link_map_init(struct jcf_link_map *map, size_t count);
+static void	jcf_link_map_destroy(struct jcf_link_map *map);
+static size_t	jcf_link_map_find(const struct jcf_link_map *map,
+		    uint64_t key);
+static uint32_t	jcf_link_map_get(const struct jcf_link_map *map,
+		    uint64_t key, uint32_t missing);
+static int	jcf_link_map_grow(struct jcf_link_map *map);
+static int	jcf_link_build_hierarchy(struct jcf_link_state *state,
+		    size_t n);
+static int	jcf_link_resolve(struct jcf_link_state *state, uint32_t class,
+		    uint32_t member, bool method, int depth,
+		    uint32_t *resultp);
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Returns the key of a map that is formed by the pair of IDs.
+ */
+static uint64_t
+jcf_link_key(uint32_t first, uint32_t second)
+{
+	return ((uint64_t)first << 32 | second);
+}
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Allocates an empty map that is at most half full with "count" keys.
+ *   Returns 0 on success and -1 on failure.  In either case, "map" must
+ *   later be freed by jcf_link_map_destroy().
+ */
+static int
+jcf_link_map_init(struct jcf_link_map *map, size_t count)
+{
+	size_t nslots;
+
+	for (nslots = 16; nslots < 2 * count; nslots *= 2)
+		;
+	map->keys = malloc(nslots * sizeof(*map->keys));
+	map->values = malloc(nslots * sizeof(*map->values));
+	map->mask = nslots - 1;
+	map->count = 0;
+	if (map->keys == NULL || map->values == NULL)
+		return (-1);
+	memset(map->keys, 0xff, nslots * sizeof(*map->keys));
+	return (0);
+}
+
+/*
+ * Requires:
+ *   "map" must have been initialized by jcf_link_map_init(), or zeroed.
+ *
+ * Effects:
+ *   Frees the memory held by "map".
+ */
+static void
+jcf_link_map_destroy(struct jcf_link_map *map)
+{
+	free(map->keys);
+	free(map->values);
+	map->keys = NULL;
+	map->values = NULL;
+}
+
+/*
+ * Requires:
+ *   "map" must have been initialized by jcf_link_map_init().  "key" must
+ *   not be JCF_LINK_EMPTY.
+ *
+ * Effects:
+ *   Returns the slot that holds "key", or the empty slot where it would
+ *   be inserted.  The key is mixed by a multiplication first, so that
+ *   keys that differ only in a few bits spread across the map.
+ */
+static size_t
+jcf_link_map_find(const struct jcf_link_map *map, uint64_t key)
+{
+	uint64_t hash = key * 0x9e3779b97f4a7c15;
+	size_t i;
+
+	for (i = (hash ^ hash >> 32) & map->mask;
+	    map->keys[i] != JCF_LINK_EMPTY && map->keys[i] != key;
+	    i = (i + 1) & map->mask)
+		;
+	return (i);
+}
+
+/*
+ * Requires:
+ *   "map" must have been initialized by jcf_link_map_init().
+ *
+ * Effects:
+ *   Returns the value of "key", or "missing" if the map does not hold it.
+ */
+static uint32_t
+jcf_link_map_get(const struct jcf_link_map *map, uint64_t key,
+    uint32_t missing)
+{
+	size_t slot = jcf_link_map_find(map, key);
+
+	return (map->keys[slot] != JCF_LINK_EMPTY ? map->values[slot] :
+	    missing);
+}
+
+/*
+ * Requires:
+ *   "map" must have been initialized by jcf_link_map_init().
+ *
+ * Effects:
+ *   Doubles the size of the map, rehashing its keys.  Returns 0 on
+ *   success and -1 on failure, in which case the map is unchanged.
+ */
+static int
+jcf_link_map_grow(struct jcf_link_map *map)
+{
+	struct jcf_link_map bigger;
+	size_t i, slot;
+
+	if (jcf_link_map_init(&bigger, map->mask + 1) != 0) {
+		jcf_link_map_destroy(&bigger);
+		return (-1);
+	}
+	for (i = 0; i <= map->mask; i++) {
+		if (map->keys[i] == JCF_LINK_EMPTY)
+			continue;
+		slot = jcf_link_map_find(&bigger, map->keys[i]);
+		bigger.keys[slot] = map->keys[i];
+		bigger.values[slot] = map->values[i];
+	}
+	bigger.count = map->count;
+	jcf_link_map_destroy(map);
+	*map = bigger;
+	return (0);
+}
+
+/*
+ * Requires:
+ *   "state" must hold the "n" symbols in "order".
+ *
+ * Effects:
+ *   Gives each class that is among the symbols a class ID, in file order,
+ *   and records its superclass and superinterfaces as class IDs.  A class
+ *   that an earlier file already defined is ignored, along with the
+ *   symbols that describe its parents.  A parent that is not among the
+ *   inputs is JCF_LINK_NONE.  Returns 0 on success and -1 on failure.
+ */
+static int
+jcf_link_build_hierarchy(struct jcf_link_state *state, size_t n)
+{
+	const struct jcf_link_symbol *symbol;
+	size_t i, nclasses = 0, ninterfaces = 0, slot;
+	uint32_t class, current = JCF_LINK_NONE;
+
+	for (i = 0; i < n; i++) {
+		if (state->order[i]->kind == JCF_LINK_CLASS)
+			nclasses++;
+		else if (state->order[i]->kind == JCF_LINK_INTERFACE)
+			ninterfaces++;
+	}
+	state->names = malloc(nclasses * sizeof(*state->names));
+	state->supers = malloc(nclasses * sizeof(*state->supers));
+	state->interfaces_start = malloc((nclasses + 1) *
+	    sizeof(*state->interfaces_start));
+	state->interfaces = malloc(ninterfaces * sizeof(*state->interfaces));
+	if (jcf_link_map_init(&state->classes, nclasses) != 0 ||
+	    state->interfaces_start == NULL || (nclasses > 0 &&
+	    (state->names == NULL || state->supers == NULL)) ||
+	    (ninterfaces > 0 && state->interfaces == NULL))
+		return (-1);
+
+	// Number the classes.
+	state->nclasses = 0;
+	for (i = 0; i < n; i++) {
+		symbol = state->order[i];
+		if (symbol->kind != JCF_LINK_CLASS)
+			continue;
+		slot = jcf_link_map_find(&state->classes,
+		    jcf_link_key(symbol->class, JCF_LINK_NONE));
+		if (state->classes.keys[slot] != JCF_LINK_EMPTY)
+			continue;
+		state->classes.keys[slot] = jcf_link_key(symbol->class,
+		    JCF_LINK_NONE);
+		state->classes.values[slot] = state->nclasses;
+		state->names[state->nclasses++] = symbol;
+	}
+
+	/*
+	 * Link each class to its parents.  The symbols of a class follow its
+	 * class symbol, and the classes are met in the order of their IDs,
+	 * so each class's interfaces are appended in turn.
+	 */
+	ninterfaces = 0;
+	for (i = 0; i < n; i++) {
+		symbol = state->order[i];
+		if (symbol->kind != JCF_LINK_CLASS &&
+		    symbol->kind != JCF_LINK_SUPER &&
+		    symbol->kind != JCF_LINK_INTERFACE)
+			continue;
+		class = jcf_link_map_get(&state->classes,
+		    jcf_link_key(symbol->class, JCF_LINK_NONE), JCF_LINK_NONE);
+		if (symbol->kind == JCF_LINK_CLASS) {
+			// Skip the parents of a class that is defined twice.
+			current = state->names[class] == symbol ? class :
+			    JCF_LINK_NONE;
+			if (current != JCF_LINK_NONE) {
+				state->supers[current] = JCF_LINK_NONE;
+				state->interfaces_start[current] = ninterfaces;
+			}
+		} else if (current == JCF_LINK_NONE)
+			continue;
+		else if (symbol->kind == JCF_LINK_SUPER)
+			state->supers[current] = class;
+		else if (class != JCF_LINK_NONE)
+			state->interfaces[ninterfaces++] = class;
+	}
+	state->interfaces_start[state->nclasses] = ninterfaces;
+	return (0);
+}
+
+/*
+ * Requires:
+ *   "class" must be a class ID and "member" the ID of a member.
+ *
+ * Effects:
+ *   Looks up "member" in class "class", then in its superclasses and
+ *   superinterfaces.  A method is looked for in the superclass before
+ *   the superinterfaces and a field after them, following the JVM's
+ *   resolution order.  Sets "*resultp" to one more than the position of
+ *   the declaring definition, or 0 if there is none.  Cycles and
+ *   hierarchies deeper than JCF_LINK_MAX_DEPTH resolve to nothing.
+ *   Returns 0 on success and -1 if memory could not be allocated.
+ */
+static int
+jcf_link_resolve(struct jcf_link_state *state, uint32_t class,
+    uint32_t member, bool method, int depth, uint32_t *resultp)
+{
+	uint64_t key = jcf_link_key(class, member);
+	uint32_t parents[2], result;
+	size_t i, slot;
+
+	*resultp = 0;
+	if (depth > JCF_LINK_MAX_DEPTH)
+		return (0);
+
+	// Keep the memo at most half full, counting the entry to be added.
+	if (2 * (state->memo.count + 1) > state->memo.mask + 1 &&
+	    jcf_link_map_grow(&state->memo) != 0)
+		return (-1);
+	slot = jcf_link_map_find(&state->memo, key);
+	if (state->memo.keys[slot] != JCF_LINK_EMPTY) {
+		if (state->memo.values[slot] != JCF_LINK_PENDING)
+			*resultp = state->memo.values[slot];
+		return (0);
+	}
+	state->memo.keys[slot] = key;
+	state->memo.values[slot] = JCF_LINK_PENDING;
+	state->memo.count++;
+
+	// Look for a declaration in the class itself.
+	result = jcf_link_map_get(&state->definitions,
+	    jcf_link_key(state->names[class]->class, member), 0);
+
+	/*
+	 * Look in the parents.  "parents" holds the superclass, visited
+	 * before or after the interfaces depending on the kind of member.
+	 */
+	parents[0] = method ? state->supers[class] : JCF_LINK_NONE;
+	parents[1] = method ? JCF_LINK_NONE : state->supers[class];
+	if (result == 0 && parents[0] != JCF_LINK_NONE &&
+	    jcf_link_resolve(state, parents[0], member, method, depth + 1,
+	    &result) != 0)
+		return (-1);
+	for (i = state->interfaces_start[class]; result == 0 &&
+	    i < state->interfaces_start[class + 1]; i++) {
+		if (jcf_link_resolve(state, state->interfaces[i], member,
+		    method, depth + 1, &result) != 0)
+			return (-1);
+	}
+	if (result == 0 && parents[1] != JCF_LINK_NONE &&
+	    jcf_link_resolve(state, parents[1], member, method, depth + 1,
+	    &result) != 0)
+		return (-1);
+
+	/*
+	 * Record the result.  The memo may have been grown by the lookups
+	 * in the parents, so the entry is found again.
+	 */
+	slot = jcf_link_map_find(&state->memo, key);
+	state->memo.values[slot] = result;
+	*resultp = result;
+	return (0);
+}
+
+void
+jcf_link_table_init(struct jcf_link_table *table)
+{
+	table->symbols = NULL;
+	table->count = 0;
+	table->capacity = 0;
+}
+
+void
+jcf_link_table_destroy(struct jcf_link_table *table)
+{
+	free(table->symbols);
+	jcf_link_table_init(table);
+}
+
+int
+jcf_link_add(struct jcf_link_table *table, enum jcf_link_kind kind,
+    size_t file, uint32_t class, uint32_t member, bool method)
+{
+	struct jcf_link_symbol *symbols, *symbol;
+	size_t capacity;
+
+	if (file >= UINT32_MAX)
+		return (-1);
+
+	// Grow the array of symbols.
+	if (table->count == table->capacity) {
+		capacity = table->capacity > 0 ? table->capacity * 2 : 1024;
+		symbols = realloc(table->symbols, capacity * sizeof(*symbols));
+		if (symbols == NULL)
+			return (-1);
+		table->symbols = symbols;
+		table->capacity = capacity;
+	}
+
+	symbol = &table->symbols[table->count++];
+	symbol->class = class;
+	symbol->member = member;
+	symbol->kind = kind;
+	symbol->method = method;
+	symbol->file = file;
+	return (0);
+}
+
+void
+jcf_link_truncate(struct jcf_link_table *table, size_t count)
+{
+	table->count = count;
+}
+
+int
+jcf_link_merge(struct jcf_link_table *table, struct jcf_link_table *other)
+{
+	struct jcf_link_symbol *symbols;
+	size_t capacity;
+
+	// Make room for the other table's symbols.
+	if (table->capacity - table->count < other->count) {
+		capacity = table->count + other->count;
+		symbols = realloc(table->symbols, capacity * sizeof(*symbols));
+		if (symbols == NULL)
+			return (-1);
+		table->symbols = symbols;
+		table->capacity = capacity;
+	}
+	if (other->count > 0) {
+		memcpy(table->symbols + table->count, other->symbols,
+		    other->count * sizeof(*symbols));
+	}
+	table->count += other->count;
+	jcf_link_table_destroy(other);
+	return (0);
+}
+
+int
+jcf_link_check(const struct jcf_link_table *table, size_t nfiles,
+    void (*report)(void *arg, const struct jcf_link_symbol *symbol,
+    enum jcf_link_finding finding), void *arg)
+{
+	struct jcf_link_state state;
+	const struct jcf_link_symbol *symbol;
+	uint32_t *canon = NULL, class, result;
+	uint64_t key;
+	uint8_t *flags = NULL;
+	size_t *starts = NULL;
+	size_t i, n = table->count, ndefinitions = 0, slot;
+	int err = -1;
+
+	if (n >= UINT32_MAX)
+		return (-1);
+	memset(&state, 0, sizeof(state));
+	for (i = 0; i < n; i++) {
+		if (table->symbols[i].kind == JCF_LINK_DEFINITION ||
+		    table->symbols[i].kind == JCF_LINK_EXPORT)
+			ndefinitions++;
+	}
+
+	state.order = malloc(n * sizeof(*state.order));
+	canon = malloc(n * sizeof(*canon));
+	flags = calloc(n, sizeof(*flags));
+	starts = calloc(nfiles + 1, sizeof(*starts));
+	if ((n > 0 && (state.order == NULL || canon == NULL ||
+	    flags == NULL)) || starts == NULL ||
+	    jcf_link_map_init(&state.definitions, ndefinitions) != 0 ||
+	    jcf_link_map_init(&state.memo, 0) != 0)
+		goto done;
+
+	/*
+	 * Put the symbols in file order with a counting sort.  Each file's
+	 * symbols are contiguous, so they keep the order in which they were
+	 * added.
+	 */
+	for (i = 0; i < n; i++)
+		starts[table->symbols[i].file + 1]++;
+	for (i = 0; i < nfiles; i++)
+		starts[i + 1] += starts[i];
+	for (i = 0; i < n; i++) {
+		symbol = &table->symbols[i];
+		state.order[starts[symbol->file]++] = symbol;
+	}
+
+	/*
+	 * Index the definitions.  The first definition of each member, in
+	 * file order, is the one that the others and the references resolve
+	 * to.
+	 */
+	for (i = 0; i < n; i++) {
+		symbol = state.order[i];
+		if (symbol->kind != JCF_LINK_DEFINITION &&
+		    symbol->kind != JCF_LINK_EXPORT)
+			continue;
+		key = jcf_link_key(symbol->class, symbol->member);
+		slot = jcf_link_map_find(&state.definitions, key);
+		if (state.definitions.keys[slot] == JCF_LINK_EMPTY) {
+			state.definitions.keys[slot] = key;
+			state.definitions.values[slot] = i + 1;
+		}
+		canon[i] = state.definitions.values[slot] - 1;
+	}
+	if (jcf_link_build_hierarchy(&state, n) != 0)
+		goto done;
+
+	/*
+	 * Resolve the references.  A reference that is not defined directly
+	 * is looked up in the hierarchy of the class that it names, if that
+	 * class is among the inputs.
+	 */
+	for (i = 0; i < n; i++) {
+		symbol = state.order[i];
+		if (symbol->kind != JCF_LINK_REFERENCE)
+			continue;
+		result = jcf_link_map_get(&state.definitions,
+		    jcf_link_key(symbol->class, symbol->member), 0);
+		class = jcf_link_map_get(&state.classes,
+		    jcf_link_key(symbol->class, JCF_LINK_NONE), JCF_LINK_NONE);
+		if (result == 0 && class != JCF_LINK_NONE &&
+		    jcf_link_resolve(&state, class, symbol->member,
+		    symbol->method, 0, &result) != 0)
+			goto done;
+		if (result == 0)
+			flags[i] |= JCF_LINK_MISSING;
+		else
+			flags[result - 1] |= JCF_LINK_REFERENCED;
+	}
+
+	// Report the findings in order.
+	for (i = 0; i < n; i++) {
+		symbol = state.order[i];
+		if ((flags[i] & JCF_LINK_MISSING) != 0)
+			report(arg, symbol, JCF_LINK_UNRESOLVED);
+		else if (symbol->kind == JCF_LINK_EXPORT && canon[i] == i &&
+		    (flags[i] & JCF_LINK_REFERENCED) == 0)
+			report(arg, symbol, JCF_LINK_UNREFERENCED);
+	}
+	err = 0;
+
+done:
+	free(state.order);
+	jcf_link_map_destroy(&state.definitions);
+	jcf_link_map_destroy(&state.classes);
+	jcf_link_map_destroy(&state.memo);
+	free(state.names);
+	free(state.supers);
+	free(state.interfaces_start);
+	free(state.interfaces);
+	free(canon);
+	free(flags);
+	free(starts);
+	return (err);
+}
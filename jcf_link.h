@@ -0,0 +1,146 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * A link checker for a set of classes.  Each thread collects the member
+ * references and member definitions of the classes that it processes in
+ * its own table, and the tables are merged when the threads finish.
+ * The references are then joined against a hash index of the
+ * definitions, keyed by (class, name, descriptor), to find the
+ * references that nothing defines and the exports that nothing
+ * references.
+ *
+ * A symbol names its class and its member, "name descriptor", by the
+ * IDs that an intern table gave those strings, so a symbol is a few
+ * integers however long its strings are, and the join compares IDs
+ * instead of strings.  The checker only compares IDs, so it does not
+ * need the table itself.
+ *
+ * Each class also contributes a symbol naming itself, followed by one
+ * naming its superclass and one for each superinterface.  From these the
+ * check builds an index of the class hierarchy, so that a reference such
+ * as "Sub.m ()V" resolves to the superclass or superinterface that
+ * actually declares "m ()V", as the JVM would resolve it.
+ */
+
+#ifndef JCF_LINK_H
+#define JCF_LINK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Define an enumeration of the kinds of symbols.
+enum jcf_link_kind {
+	JCF_LINK_REFERENCE,	// a Fieldref, Methodref or InterfaceMethodref
+	JCF_LINK_DEFINITION,	// a field or method that is not public
+	JCF_LINK_EXPORT,	// a public field or method
+	JCF_LINK_CLASS,		// a class, which names no member
+	JCF_LINK_SUPER,		// the superclass of the preceding class
+	JCF_LINK_INTERFACE	// a superinterface of the preceding class
+};
+
+// Define an enumeration of the findings of a link check.
+enum jcf_link_finding {
+	JCF_LINK_UNRESOLVED,	// a reference that nothing defines
+	JCF_LINK_UNREFERENCED	// an export that nothing references
+};
+
+// Define the member ID of a symbol that names only a class.
+#define JCF_LINK_NONE	UINT32_MAX
+
+// Define a symbol.
+struct jcf_link_symbol {
+	uint32_t	class;		// ID of the class's name
+	uint32_t	member;		// ID of "name descriptor", or NONE
+	uint16_t	kind;		// an enum jcf_link_kind
+	uint16_t	method;		// whether the member is a method
+	uint32_t	file;		// index of the file that it came from
+};
+
+// Define a table of the symbols collected by one thread.
+struct jcf_link_table {
+	struct jcf_link_symbol *symbols;
+	size_t		count;
+	size_t		capacity;
+};
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Initializes "table" to be empty.
+ */
+void	jcf_link_table_init(struct jcf_link_table *table);
+
+/*
+ * Requires:
+ *   "table" must have been initialized by jcf_link_table_init().
+ *
+ * Effects:
+ *   Frees the memory held by "table".
+ */
+void	jcf_link_table_destroy(struct jcf_link_table *table);
+
+/*
+ * Requires:
+ *   "table" must have been initialized by jcf_link_table_init().  The
+ *   IDs must all come from the same intern table.  "member" must be
+ *   JCF_LINK_NONE for a class, superclass or superinterface.
+ *
+ * Effects:
+ *   Appends a symbol of the given kind from the given file to "table".
+ *   "method" says whether the member is a method or a field, which
+ *   decides the order in which inherited members are searched.  Returns
+ *   0 on success and -1 on failure.
+ */
+int	jcf_link_add(struct jcf_link_table *table, enum jcf_link_kind kind,
+	    size_t file, uint32_t class, uint32_t member, bool method);
+
+/*
+ * Requires:
+ *   "count" must be at most "table->count".
+ *
+ * Effects:
+ *   Discards the symbols after the first "count", such as those of a
+ *   class file that turned out to be malformed.
+ */
+void	jcf_link_truncate(struct jcf_link_table *table, size_t count);
+
+/*
+ * Requires:
+ *   "table" and "other" must have been initialized by
+ *   jcf_link_table_init().
+ *
+ * Effects:
+ *   Moves the symbols of "other" to the end of "table", leaving "other"
+ *   empty.  Returns 0 on success and -1 on failure, in which case
+ *   neither table is changed.
+ */
+int	jcf_link_merge(struct jcf_link_table *table,
+	    struct jcf_link_table *other);
+
+/*
+ * Requires:
+ *   The symbols of "table" must come from files with indices less than
+ *   "nfiles", and the symbols of each file must be contiguous.
+ *
+ * Effects:
+ *   Resolves every reference against the definitions in the table.  A
+ *   reference that no class defines directly is looked up in the named
+ *   class's superclasses and superinterfaces, and resolves to the
+ *   nearest declaration; these lookups are memoized per class and
+ *   member.  Calls "report" for each reference that is not resolved and
+ *   for each export that is not referenced.  The calls are made in
+ *   order of file index and, within a file, in the order in which the
+ *   symbols were added, so the findings do not depend on how the files
+ *   were divided among threads.  When several files define the same
+ *   member or the same class, the one with the lowest index is the
+ *   definition, and only it can be reported.  Returns 0 on success and
+ *   -1 if memory could not be allocated.
+ */
+int	jcf_link_check(const struct jcf_link_table *table, size_t nfiles,
+	    void (*report)(void *arg, const struct jcf_link_symbol *symbol,
+	    enum jcf_link_finding finding), void *arg);
+
+#endif /* JCF_LINK_H */
@@ -0,0 +1,273 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * An in-memory table of the results of analyzed class files, indexed by
+ * an open-addressed hash table of their paths.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jcf_memo.h"
+
+static size_t	jcf_memo_lookup(const struct jcf_memo *memo, const char *path,
+		    bool *foundp);
+static int	jcf_memo_grow(struct jcf_memo *memo);
+static void	jcf_memo_clear(struct jcf_memo_entry *entry);
+
+/*
+ * Requires:
+ *   "memo" must have been initialized by jcf_memo_init() and must have
+ *   an empty slot.
+ *
+ * Effects:
+ *   Returns the slot of the file "path".  If it has an entry, sets
+ *   "*foundp" to true.  Otherwise, sets it to false, and the slot is the
+ *   empty one where the file's entry belongs.
+ */
+static size_t
+jcf_memo_lookup(const struct jcf_memo *memo, const char *path, bool *foundp)
+{
+	size_t i;
+
+	i = jcf_cache_hash(0, path, strlen(path)) & memo->mask;
+	for (; memo->slots[i] != 0; i = (i + 1) & memo->mask) {
+		if (strcmp(memo->entries[memo->slots[i] - 1].path,
+		    path) == 0) {
+			*foundp = true;
+			return (i);
+		}
+	}
+	*foundp = false;
+	return (i);
+}
+
+/*
+ * Requires:
+ *   "memo" must have been initialized by jcf_memo_init(), and its lock
+ *   must be held for writing.
+ *
+ * Effects:
+ *   Makes room for another entry, doubling the slots so that they are
+ *   never more than half full.  Returns 0 on success and -1 on failure,
+ *   in which case the table is not changed.
+ */
+static int
+jcf_memo_grow(struct jcf_memo *memo)
+{
+	struct jcf_memo_entry *entries;
+	size_t *slots, capacity, i;
+	bool found;
+
+	if (memo->count < memo->capacity)
+		return (0);
+	capacity = memo->capacity > 0 ? memo->capacity * 2 : 256;
+	entries = realloc(memo->entries, capacity * sizeof(*entries));
+	if (entries == NULL)
+		return (-1);
+	memo->entries = entries;
+	slots = calloc(capacity * 2, sizeof(*slots));
+	if (slots == NULL)
+		return (-1);
+	memo->capacity = capacity;
+
+	// Rehash every entry into the new slots.
+	free(memo->slots);
+	memo->slots = slots;
+	memo->mask = capacity * 2 - 1;
+	for (i = 0; i < memo->count; i++)
+		slots[jcf_memo_lookup(memo, entries[i].path, &found)] = i + 1;
+	return (0);
+}
+
+/*
+ * Requires:
+ *   "entry" must be an entry of a table.
+ *
+ * Effects:
+ *   Frees the entry's records and edges and makes it empty.
+ */
+static void
+jcf_memo_clear(struct jcf_memo_entry *entry)
+{
+	free(entry->records);
+	free(entry->edges);
+	entry->records = NULL;
+	entry->records_len = 0;
+	entry->edges = NULL;
+	entry->nedges = 0;
+	entry->empty = true;
+}
+
+int
+jcf_memo_init(struct jcf_memo *memo)
+{
+	memo->entries = NULL;
+	memo->count = memo->capacity = 0;
+	memo->slots = NULL;
+	memo->mask = 0;
+	memo->version = 0;
+	if (pthread_rwlock_init(&memo->lock, NULL) != 0)
+		return (-1);
+	if (jcf_memo_grow(memo) != 0) {
+		pthread_rwlock_destroy(&memo->lock);
+		free(memo->entries);
+		return (-1);
+	}
+	return (0);
+}
+
+void
+jcf_memo_destroy(struct jcf_memo *memo)
+{
+	size_t i;
+
+	for (i = 0; i < memo->count; i++) {
+		jcf_memo_clear(&memo->entries[i]);
+		free(memo->entries[i].path);
+	}
+	free(memo->entries);
+	free(memo->slots);
+	pthread_rwlock_destroy(&memo->lock);
+}
+
+bool
+jcf_memo_find(struct jcf_memo *memo, const struct jcf_cache_key *key,
+    struct jcf_out *records)
+{
+	const struct jcf_memo_entry *entry;
+	bool found;
+	size_t i;
+
+	pthread_rwlock_rdlock(&memo->lock);
+	i = jcf_memo_lookup(memo, key->path, &found);
+	if (found) {
+		entry = &memo->entries[memo->slots[i] - 1];
+		found = !entry->empty && entry->size == key->size &&
+		    entry->mtime_sec == key->mtime_sec &&
+		    entry->mtime_nsec == key->mtime_nsec &&
+		    entry->hashed == key->hashed &&
+		    (!key->hashed || entry->hash == key->hash);
+		if (found)
+			jcf_out_bytes(records, entry->records,
+			    entry->records_len);
+	}
+	pthread_rwlock_unlock(&memo->lock);
+	return (found);
+}
+
+int
+jcf_memo_store(struct jcf_memo *memo, const struct jcf_cache_key *key,
+    const void *records, size_t len, const struct jcf_graph_edge *edges,
+    size_t nedges)
+{
+	struct jcf_memo_entry *entry;
+	char *copy = NULL;
+	struct jcf_graph_edge *edges_copy = NULL;
+	bool found;
+	size_t i;
+	int err = -1;
+
+	// Copy the results before taking the lock.
+	if ((len > 0 && (copy = malloc(len)) == NULL) || (nedges > 0 &&
+	    (edges_copy = malloc(nedges * sizeof(*edges))) == NULL)) {
+		free(copy);
+		jcf_memo_forget(memo, key->path);
+		return (-1);
+	}
+	if (len > 0)
+		memcpy(copy, records, len);
+	if (nedges > 0)
+		memcpy(edges_copy, edges, nedges * sizeof(*edges));
+
+	pthread_rwlock_wrlock(&memo->lock);
+	i = jcf_memo_lookup(memo, key->path, &found);
+	if (!found) {
+		if (jcf_memo_grow(memo) != 0)
+			goto done;
+		i = jcf_memo_lookup(memo, key->path, &found);
+		entry = &memo->entries[memo->count];
+		if ((entry->path = strdup(key->path)) == NULL)
+			goto done;
+		entry->records = NULL;
+		entry->edges = NULL;
+		memo->slots[i] = ++memo->count;
+	} else
+		entry = &memo->entries[memo->slots[i] - 1];
+	jcf_memo_clear(entry);
+	entry->size = key->size;
+	entry->mtime_sec = key->mtime_sec;
+	entry->mtime_nsec = key->mtime_nsec;
+	entry->hash = key->hashed ? key->hash : 0;
+	entry->hashed = key->hashed;
+	entry->empty = false;
+	entry->records = copy;
+	entry->records_len = len;
+	entry->edges = edges_copy;
+	entry->nedges = nedges;
+	copy = NULL;
+	edges_copy = NULL;
+	memo->version++;
+	err = 0;
+
+done:
+	pthread_rwlock_unlock(&memo->lock);
+	free(copy);
+	free(edges_copy);
+	return (err);
+}
+
+void
+jcf_memo_forget(struct jcf_memo *memo, const char *path)
+{
+	bool found;
+	size_t i;
+
+	pthread_rwlock_wrlock(&memo->lock);
+	i = jcf_memo_lookup(memo, path, &found);
+	if (found && !memo->entries[memo->slots[i] - 1].empty) {
+		jcf_memo_clear(&memo->entries[memo->slots[i] - 1]);
+		memo->version++;
+	}
+	pthread_rwlock_unlock(&memo->lock);
+}
+
+int
+jcf_memo_edges(struct jcf_memo *memo, struct jcf_graph_table *table,
+    size_t *nfilesp, uint32_t *limitp, uint64_t *versionp)
+{
+	const struct jcf_memo_entry *entry;
+	uint32_t limit = 0;
+	size_t i, j;
+	int err = 0;
+
+	pthread_rwlock_rdlock(&memo->lock);
+	for (i = 0; i < memo->count && err == 0; i++) {
+		entry = &memo->entries[i];
+		for (j = 0; j < entry->nedges && err == 0; j++) {
+			if (entry->edges[j].from >= limit)
+				limit = entry->edges[j].from + 1;
+			if (entry->edges[j].to >= limit)
+				limit = entry->edges[j].to + 1;
+			err = jcf_graph_add(table, i, entry->edges[j].from,
+			    entry->edges[j].to);
+		}
+	}
+	*nfilesp = memo->count;
+	*limitp = limit;
+	*versionp = memo->version;
+	pthread_rwlock_unlock(&memo->lock);
+	return (err);
+}
+
+uint64_t
+jcf_memo_version(struct jcf_memo *memo)
+{
+	uint64_t version;
+
+	pthread_rwlock_rdlock(&memo->lock);
+	version = memo->version;
+	pthread_rwlock_unlock(&memo->lock);
+	return (version);
+}
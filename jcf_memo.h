@@ -0,0 +1,132 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * An in-memory table of the results of the class files that a server
+ * has analyzed.  Like an entry of the disk cache, an entry holds a
+ * file's records and is used while the file is unchanged, but it also
+ * holds the file's edges of the dependency graph, so that the graph of
+ * every analyzed class can be rebuilt without replaying any records.
+ * The table is shared by the server's worker threads.
+ */
+
+#ifndef JCF_MEMO_H
+#define JCF_MEMO_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "jcf_cache.h"
+#include "jcf_graph.h"
+#include "jcf_out.h"
+
+// Define an entry, which is empty if its file has been forgotten.
+struct jcf_memo_entry {
+	char		*path;
+	uint64_t	size;
+	int64_t		mtime_sec;
+	int64_t		mtime_nsec;
+	uint64_t	hash;
+	bool		hashed;
+	bool		empty;
+	char		*records;
+	size_t		records_len;
+	struct jcf_graph_edge *edges;	// whose "file" is unused
+	size_t		nedges;
+};
+
+// Define a table.  An entry's index never changes.
+struct jcf_memo {
+	pthread_rwlock_t lock;		// protects the rest of the table
+	struct jcf_memo_entry *entries;
+	size_t		count;
+	size_t		capacity;
+	size_t		*slots;		// one more than an entry's index
+	size_t		mask;
+	uint64_t	version;	// changed by every store and forget
+};
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Initializes "memo" to be empty.  Returns 0 on success and -1 on
+ *   failure.
+ */
+int	jcf_memo_init(struct jcf_memo *memo);
+
+/*
+ * Requires:
+ *   "memo" must have been initialized by jcf_memo_init(), and no other
+ *   thread may be using it.
+ *
+ * Effects:
+ *   Frees the memory held by "memo".
+ */
+void	jcf_memo_destroy(struct jcf_memo *memo);
+
+/*
+ * Requires:
+ *   "memo" must have been initialized by jcf_memo_init().  "records"
+ *   must be a memory buffer.
+ *
+ * Effects:
+ *   Looks up the file "key->path".  If its entry was stored under a key
+ *   that is equal to "key", appends the entry's records to "records"
+ *   and returns true.  Otherwise, returns false.
+ */
+bool	jcf_memo_find(struct jcf_memo *memo, const struct jcf_cache_key *key,
+	    struct jcf_out *records);
+
+/*
+ * Requires:
+ *   "memo" must have been initialized by jcf_memo_init().  "records"
+ *   must point to "len" bytes and "edges" to "nedges" edges.
+ *
+ * Effects:
+ *   Stores copies of the records and edges of the file "key->path",
+ *   replacing its entry if it has one.  Returns 0 on success and -1 on
+ *   failure, in which case the file's entry is left empty.
+ */
+int	jcf_memo_store(struct jcf_memo *memo, const struct jcf_cache_key *key,
+	    const void *records, size_t len, const struct jcf_graph_edge *edges,
+	    size_t nedges);
+
+/*
+ * Requires:
+ *   "memo" must have been initialized by jcf_memo_init().
+ *
+ * Effects:
+ *   Empties the entry of the file "path", if it has one, such as when
+ *   the file is gone or has become malformed.
+ */
+void	jcf_memo_forget(struct jcf_memo *memo, const char *path);
+
+/*
+ * Requires:
+ *   "memo" must have been initialized by jcf_memo_init().  "table" must
+ *   have been initialized by jcf_graph_table_init().
+ *
+ * Effects:
+ *   Appends the edges of every entry to "table", as coming from the
+ *   file numbered by the entry's index, so that it can be passed to
+ *   jcf_graph_collect() with "*nfilesp" files and a limit of "*limitp".
+ *   Stores the version of the table that the edges are from in
+ *   "*versionp".  Returns 0 on success and -1 on failure.
+ */
+int	jcf_memo_edges(struct jcf_memo *memo, struct jcf_graph_table *table,
+	    size_t *nfilesp, uint32_t *limitp, uint64_t *versionp);
+
+/*
+ * Requires:
+ *   "memo" must have been initialized by jcf_memo_init().
+ *
+ * Effects:
+ *   Returns the version of the table, which changes whenever an entry
+ *   is stored or forgotten.
+ */
+uint64_t jcf_memo_version(struct jcf_memo *memo);
+
+#endif /* JCF_MEMO_H */
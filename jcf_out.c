@@ -0,0 +1,146 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * A buffered output layer that writes with write() and writev().
+ */
+
+#include <sys/uio.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "jcf_out.h"
+
+int
+jcf_out_writev(int fd, struct iovec *iov, int iovcnt)
+{
+	ssize_t n;
+
+	while (iovcnt > 0) {
+		n = writev(fd, iov, iovcnt);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return (-1);
+		}
+
+		// Skip the entries that were written completely.
+		while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+			n -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (iovcnt > 0) {
+			iov->iov_base = (char *)iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+	return (0);
+}
+
+void
+jcf_out_init(struct jcf_out *out, int fd)
+{
+	out->fd = fd;
+	out->buf = NULL;
+	out->len = 0;
+	out->size = 0;
+	out->err = 0;
+}
+
+void
+jcf_out_destroy(struct jcf_out *out)
+{
+	free(out->buf);
+	out->buf = NULL;
+	out->len = 0;
+	out->size = 0;
+}
+
+int
+jcf_out_flush(struct jcf_out *out)
+{
+	struct iovec iov;
+
+	if (out->fd >= 0 && out->len > 0) {
+		iov.iov_base = out->buf;
+		iov.iov_len = out->len;
+		if (jcf_out_writev(out->fd, &iov, 1) != 0)
+			out->err = -1;
+		out->len = 0;
+	}
+	return (out->err);
+}
+
+void
+jcf_out_bytes_slow(struct jcf_out *out, const void *p, size_t len)
+{
+	struct iovec iov[2];
+	size_t size;
+	char *buf;
+
+	// Allocate a file descriptor's buffer on first use.
+	if (out->fd >= 0 && out->buf == NULL) {
+		out->buf = malloc(JCF_OUT_SIZE);
+		if (out->buf == NULL) {
+			out->err = -1;
+			return;
+		}
+		out->size = JCF_OUT_SIZE;
+		if (len <= out->size) {
+			memcpy(out->buf, p, len);
+			out->len = len;
+			return;
+		}
+	}
+
+	if (out->fd >= 0) {
+		/*
+		 * Write the buffer and the new bytes together if the new
+		 * bytes would fill most of the buffer anyway.  Otherwise,
+		 * flush the buffer and copy them in.
+		 */
+		if (len >= out->size / 2) {
+			iov[0].iov_base = out->buf;
+			iov[0].iov_len = out->len;
+			iov[1].iov_base = (void *)p;
+			iov[1].iov_len = len;
+			if (jcf_out_writev(out->fd, iov, 2) != 0)
+				out->err = -1;
+			out->len = 0;
+			return;
+		}
+		jcf_out_flush(out);
+	} else {
+		// Grow a memory buffer geometrically.
+		size = out->size > 0 ? out->size : 4096;
+		while (size - out->len < len)
+			size *= 2;
+		buf = realloc(out->buf, size);
+		if (buf == NULL) {
+			out->err = -1;
+			return;
+		}
+		out->buf = buf;
+		out->size = size;
+	}
+	memcpy(out->buf + out->len, p, len);
+	out->len += len;
+}
+
+int
+jcf_out_take(struct jcf_out *out, char **bufp, size_t *lenp)
+{
+	int err = out->err;
+
+	*bufp = out->len > 0 ? out->buf : NULL;
+	*lenp = out->len;
+	if (out->len > 0) {
+		out->buf = NULL;
+		out->size = 0;
+		out->len = 0;
+	}
+	out->err = 0;
+	return (err);
+}
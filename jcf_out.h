@@ -0,0 +1,180 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * A buffered output layer that appends raw bytes to a large buffer and
+ * writes it out with write() or writev(), without going through stdio's
+ * locking and format parsing.  A buffer is either bound to a file
+ * descriptor, in which case it is flushed whenever it fills, or kept in
+ * memory, in which case it grows until its contents are taken.
+ */
+
+#ifndef JCF_OUT_H
+#define JCF_OUT_H
+
+#include <sys/uio.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Define the size of the buffer for a file descriptor.
+#define JCF_OUT_SIZE	(256 * 1024)
+
+// Define an output buffer.
+struct jcf_out {
+	int		fd;		// -1 for a memory buffer
+	char		*buf;
+	size_t		len;
+	size_t		size;
+	int		err;		// set once a write or allocation fails
+};
+
+/*
+ * Requires:
+ *   "fd" must be an open file descriptor or -1.
+ *
+ * Effects:
+ *   Initializes "out" to write to "fd" or, if "fd" is -1, to collect its
+ *   output in memory.  No memory is allocated until the first byte is
+ *   written.
+ */
+void	jcf_out_init(struct jcf_out *out, int fd);
+
+/*
+ * Requires:
+ *   "out" must have been initialized by jcf_out_init().
+ *
+ * Effects:
+ *   Frees the buffer without flushing it.
+ */
+void	jcf_out_destroy(struct jcf_out *out);
+
+/*
+ * Requires:
+ *   "out" must have been initialized by jcf_out_init().
+ *
+ * Effects:
+ *   Writes the buffered bytes to the file descriptor, if there is one.
+ *   Returns 0 on success and -1 if this or any earlier write or
+ *   allocation failed.
+ */
+int	jcf_out_flush(struct jcf_out *out);
+
+/*
+ * Requires:
+ *   "out" must have been initialized by jcf_out_init() and "len" must be
+ *   at least the space left in the buffer.
+ *
+ * Effects:
+ *   Appends "len" bytes from "p" to "out", flushing or growing the
+ *   buffer first.  Large writes to a file descriptor are written
+ *   together with the buffer by one writev() instead of being copied.
+ *   Used by jcf_out_bytes() when the bytes do not fit.
+ */
+void	jcf_out_bytes_slow(struct jcf_out *out, const void *p, size_t len);
+
+/*
+ * Requires:
+ *   "fd" must be an open file descriptor.  "iov" must hold "iovcnt"
+ *   entries, which may be modified.
+ *
+ * Effects:
+ *   Writes all of the bytes described by "iov", retrying after short
+ *   writes and interrupted calls.  Returns 0 on success and -1 on
+ *   failure.
+ */
+int	jcf_out_writev(int fd, struct iovec *iov, int iovcnt);
+
+/*
+ * Requires:
+ *   "out" must be a memory buffer initialized by jcf_out_init().
+ *
+ * Effects:
+ *   Hands the buffered bytes to the caller, who must free() "*bufp", and
+ *   empties the buffer.  "*bufp" is NULL if nothing was buffered.
+ *   Returns 0 on success and -1 if an allocation failed since the last
+ *   call, in which case some output was lost.
+ */
+int	jcf_out_take(struct jcf_out *out, char **bufp, size_t *lenp);
+
+/*
+ * Requires:
+ *   "out" must be a memory buffer initialized by jcf_out_init().
+ *
+ * Effects:
+ *   Empties the buffer, keeping its memory for reuse.
+ */
+static inline void
+jcf_out_reset(struct jcf_out *out)
+{
+	out->len = 0;
+}
+
+/*
+ * Requires:
+ *   "out" must have been initialized by jcf_out_init().
+ *
+ * Effects:
+ *   Appends "len" bytes from "p" to "out".
+ */
+static inline void
+jcf_out_bytes(struct jcf_out *out, const void *p, size_t len)
+{
+	if (len < out->size - out->len) {
+		memcpy(out->buf + out->len, p, len);
+		out->len += len;
+	} else
+		jcf_out_bytes_slow(out, p, len);
+}
+
+/*
+ * Requires:
+ *   "out" must have been initialized by jcf_out_init().
+ *
+ * Effects:
+ *   Appends the character "c" to "out".
+ */
+static inline void
+jcf_out_char(struct jcf_out *out, char c)
+{
+	if (out->len < out->size)
+		out->buf[out->len++] = c;
+	else
+		jcf_out_bytes_slow(out, &c, 1);
+}
+
+/*
+ * Requires:
+ *   "out" must have been initialized by jcf_out_init().  "s" must be a
+ *   NUL-terminated string.
+ *
+ * Effects:
+ *   Appends the string "s", without its NUL, to "out".
+ */
+static inline void
+jcf_out_str(struct jcf_out *out, const char *s)
+{
+	jcf_out_bytes(out, s, strlen(s));
+}
+
+/*
+ * Requires:
+ *   "out" must have been initialized by jcf_out_init().
+ *
+ * Effects:
+ *   Appends the decimal representation of "value" to "out".
+ */
+static inline void
+jcf_out_u32(struct jcf_out *out, uint32_t value)
+{
+	char digits[10];
+	size_t n = sizeof(digits);
+
+	do {
+		digits[--n] = '0' + value % 10;
+		value /= 10;
+	} while (value != 0);
+	jcf_out_bytes(out, digits + n, sizeof(digits) - n);
+}
+
+#endif /* JCF_OUT_H */
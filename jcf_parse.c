@@ -0,0 +1,1445 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * A reentrant parser for Java class files.
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "jcf_out.h"
+#include "jcf_parse.h"
+#include "jcf_utf8.h"
+
+// Define the magic number that must be the first four bytes of a valid JCF.
+#define JCF_MAGIC	0xCAFEBABE
+
+// Define the size of the header of the Java class file.
+#define JCF_HEADER_SIZE	8
+
+// Define the size of the body of the Java class file.
+#define JCF_BODY_SIZE	6
+
+// Define the size of a field or method info entry, before its attributes.
+#define JCF_MEMBER_SIZE	6
+
+// Define an enumeration of the constant tags.
+enum jcf_cp_tags {
+	JCF_CONSTANT_Class = 7,
+	JCF_CONSTANT_Fieldref = 9,
+	JCF_CONSTANT_Methodref = 10,
+	JCF_CONSTANT_InterfaceMethodref = 11,
+	JCF_CONSTANT_String = 8,
+	JCF_CONSTANT_Integer = 3,
+	JCF_CONSTANT_Float = 4,
+	JCF_CONSTANT_Long = 5,
+	JCF_CONSTANT_Double = 6,
+	JCF_CONSTANT_NameAndType = 12,
+	JCF_CONSTANT_Utf8 = 1,
+	JCF_CONSTANT_MethodHandle = 15,
+	JCF_CONSTANT_MethodType = 16,
+	JCF_CONSTANT_Dynamic = 17,
+	JCF_CONSTANT_InvokeDynamic = 18,
+	JCF_CONSTANT_Module = 19,
+	JCF_CONSTANT_Package = 20
+};
+
+// Define an enumeration of the ways that a constant's body is decoded.
+enum jcf_cp_format {
+	JCF_CP_NONE,		// not decoded, such as a numeric value
+	JCF_CP_U2,		// operand1 = u2
+	JCF_CP_U2U2,		// operand1 = u2, operand2 = u2
+	JCF_CP_U1U2,		// operand1 = u1, operand2 = u2
+	JCF_CP_UTF8		// operand1 = length, bytes follow
+};
+
+/*
+ * Define the layout of each kind of constant.  "size" is the size of the
+ * constant's body after its tag, not counting the bytes of a UTF8
+ * constant, and is 0 for unknown tags.  "slots" is the number of
+ * constant pool indices that the constant occupies.  "ref1" and "ref2"
+ * are the tags of the constants that operand1 and operand2 refer to, or
+ * 0 if the operand is not a reference that is printed.  When both are
+ * printed, they are separated by "separator".  "dependency" says
+ * whether the constant is reported as a dependency.
+ */
+struct jcf_cp_kind {
+	uint8_t		size;
+	uint8_t		slots;
+	uint8_t		format;		// an enum jcf_cp_format
+	uint8_t		ref1;
+	uint8_t		ref2;
+	char		separator;
+	bool		dependency;
+};
+
+/*
+ * Define the kind of every tag.  The table covers every possible tag
+ * value, so a tag read from the file can index it directly.  The
+ * parser, the decoder, the printer, and the dependency scan are all
+ * driven by this table.
+ */
+static const struct jcf_cp_kind jcf_cp_kinds[256] = {
+	[JCF_CONSTANT_Utf8] =
+	    { 2, 1, JCF_CP_UTF8, 0, 0, '\0', false },
+	[JCF_CONSTANT_Integer] =
+	    { 4, 1, JCF_CP_NONE, 0, 0, '\0', false },
+	[JCF_CONSTANT_Float] =
+	    { 4, 1, JCF_CP_NONE, 0, 0, '\0', false },
+	[JCF_CONSTANT_Long] =
+	    { 8, 2, JCF_CP_NONE, 0, 0, '\0', false },
+	[JCF_CONSTANT_Double] =
+	    { 8, 2, JCF_CP_NONE, 0, 0, '\0', false },
+	[JCF_CONSTANT_Class] =
+	    { 2, 1, JCF_CP_U2, JCF_CONSTANT_Utf8, 0, '\0', false },
+	[JCF_CONSTANT_String] =
+	    { 2, 1, JCF_CP_U2, JCF_CONSTANT_Utf8, 0, '\0', false },
+	[JCF_CONSTANT_Fieldref] =
+	    { 4, 1, JCF_CP_U2U2, JCF_CONSTANT_Class,
+	    JCF_CONSTANT_NameAndType, '.', true },
+	[JCF_CONSTANT_Methodref] =
+	    { 4, 1, JCF_CP_U2U2, JCF_CONSTANT_Class,
+	    JCF_CONSTANT_NameAndType, '.', true },
+	[JCF_CONSTANT_InterfaceMethodref] =
+	    { 4, 1, JCF_CP_U2U2, JCF_CONSTANT_Class,
+	    JCF_CONSTANT_NameAndType, '.', true },
+	[JCF_CONSTANT_NameAndType] =
+	    { 4, 1, JCF_CP_U2U2, JCF_CONSTANT_Utf8, JCF_CONSTANT_Utf8, ' ',
+	    false },
+	[JCF_CONSTANT_MethodHandle] =
+	    { 3, 1, JCF_CP_U1U2, 0, 0, '\0', false },
+	[JCF_CONSTANT_MethodType] =
+	    { 2, 1, JCF_CP_U2, JCF_CONSTANT_Utf8, 0, '\0', false },
+	[JCF_CONSTANT_Dynamic] =
+	    { 4, 1, JCF_CP_U2U2, 0, JCF_CONSTANT_NameAndType, '\0', false },
+	[JCF_CONSTANT_InvokeDynamic] =
+	    { 4, 1, JCF_CP_U2U2, 0, JCF_CONSTANT_NameAndType, '\0', false },
+	[JCF_CONSTANT_Module] =
+	    { 2, 1, JCF_CP_U2, JCF_CONSTANT_Utf8, 0, '\0', false },
+	[JCF_CONSTANT_Package] =
+	    { 2, 1, JCF_CP_U2, JCF_CONSTANT_Utf8, 0, '\0', false }
+};
+
+/*
+ * Define an enumeration of the opcodes whose instructions vary in length
+ * or change the length of the next instruction.
+ */
+enum jcf_opcode_values {
+	JCF_OP_ILOAD = 0x15,
+	JCF_OP_ALOAD = 0x19,
+	JCF_OP_ISTORE = 0x36,
+	JCF_OP_ASTORE = 0x3a,
+	JCF_OP_IINC = 0x84,
+	JCF_OP_RET = 0xa9,
+	JCF_OP_TABLESWITCH = 0xaa,
+	JCF_OP_LOOKUPSWITCH = 0xab,
+	JCF_OP_WIDE = 0xc4
+};
+
+// Define the bit of a tag in a set of tags.
+#define JCF_TAG(tag)	(UINT32_C(1) << (tag))
+
+/*
+ * Define the layout of each instruction, as far as finding the constants
+ * that it uses.  "length" is the length of the instruction, including
+ * its opcode, or 0 if the length varies or the opcode is not defined.
+ * "tags" is the set of tags that the constant named by the instruction's
+ * first operand may have, or 0 if the instruction is not reported.
+ * "name" is the mnemonic of an instruction that is reported.
+ */
+struct jcf_opcode {
+	uint8_t		length;
+	uint32_t	tags;
+	const char	*name;
+};
+
+/*
+ * Define the layout of every opcode.  Like "jcf_cp_kinds", the table
+ * covers every possible value, so an opcode read from the code can index
+ * it directly.
+ */
+static const struct jcf_opcode jcf_opcodes[256] = {
+	[0x00 ... 0x0f] = { 1, 0, NULL },	// nop through dconst_1
+	[0x10] = { 2, 0, NULL },		// bipush
+	[0x11] = { 3, 0, NULL },		// sipush
+	[0x12] = { 2, 0, NULL },		// ldc
+	[0x13 ... 0x14] = { 3, 0, NULL },	// ldc_w, ldc2_w
+	[0x15 ... 0x19] = { 2, 0, NULL },	// iload through aload
+	[0x1a ... 0x35] = { 1, 0, NULL },	// iload_0 through saload
+	[0x36 ... 0x3a] = { 2, 0, NULL },	// istore through astore
+	[0x3b ... 0x83] = { 1, 0, NULL },	// istore_0 through lxor
+	[0x84] = { 3, 0, NULL },		// iinc
+	[0x85 ... 0x98] = { 1, 0, NULL },	// i2l through dcmpg
+	[0x99 ... 0xa8] = { 3, 0, NULL },	// ifeq through jsr
+	[0xa9] = { 2, 0, NULL },		// ret
+	[0xac ... 0xb1] = { 1, 0, NULL },	// ireturn through return
+	[0xb2] = { 3, JCF_TAG(JCF_CONSTANT_Fieldref), "getstatic" },
+	[0xb3] = { 3, JCF_TAG(JCF_CONSTANT_Fieldref), "putstatic" },
+	[0xb4] = { 3, JCF_TAG(JCF_CONSTANT_Fieldref), "getfield" },
+	[0xb5] = { 3, JCF_TAG(JCF_CONSTANT_Fieldref), "putfield" },
+	[0xb6] = { 3, JCF_TAG(JCF_CONSTANT_Methodref), "invokevirtual" },
+	[0xb7] = { 3, JCF_TAG(JCF_CONSTANT_Methodref) |
+	    JCF_TAG(JCF_CONSTANT_InterfaceMethodref), "invokespecial" },
+	[0xb8] = { 3, JCF_TAG(JCF_CONSTANT_Methodref) |
+	    JCF_TAG(JCF_CONSTANT_InterfaceMethodref), "invokestatic" },
+	[0xb9] = { 5, JCF_TAG(JCF_CONSTANT_InterfaceMethodref),
+	    "invokeinterface" },
+	[0xba] = { 5, JCF_TAG(JCF_CONSTANT_InvokeDynamic), "invokedynamic" },
+	[0xbb] = { 3, JCF_TAG(JCF_CONSTANT_Class), "new" },
+	[0xbc] = { 2, 0, NULL },		// newarray
+	[0xbd] = { 3, JCF_TAG(JCF_CONSTANT_Class), "anewarray" },
+	[0xbe ... 0xbf] = { 1, 0, NULL },	// arraylength, athrow
+	[0xc0] = { 3, JCF_TAG(JCF_CONSTANT_Class), "checkcast" },
+	[0xc1] = { 3, JCF_TAG(JCF_CONSTANT_Class), "instanceof" },
+	[0xc2 ... 0xc3] = { 1, 0, NULL },	// monitorenter, monitorexit
+	[0xc5] = { 4, JCF_TAG(JCF_CONSTANT_Class), "multianewarray" },
+	[0xc6 ... 0xc7] = { 3, 0, NULL },	// ifnull, ifnonnull
+	[0xc8 ... 0xc9] = { 5, 0, NULL }	// goto_w, jsr_w
+};
+
+/*
+ * Define a structure for an arena.  An arena is a single block of
+ * memory that is handed out in pieces by bumping "used" and is released
+ * all at once.
+ */
+struct jcf_arena {
+	uint8_t		*base;
+	size_t		size;
+	size_t		used;
+};
+
+/*
+ * Define a structure for holding the constant pool.
+ *
+ * The pool is stored as a structure of arrays, indexed by constant pool
+ * index, rather than as an array of pointers to separately allocated
+ * constants.  "tags" is a dense array of tags, which is 0 for unused
+ * slots such as the second slot of a long or double.  "offsets" holds
+ * the offset of each constant's body in the image.  The fixed-width
+ * operands of each constant are kept in the parallel arrays "operand1"
+ * and "operand2":
+ *
+ *   Class, String, MethodType            operand1 = the u2
+ *   Fieldref, Methodref,                 operand1 = class_index
+ *     InterfaceMethodref                 operand2 = name_and_type_index
+ *   NameAndType                          operand1 = name_index
+ *                                        operand2 = descriptor_index
+ *   InvokeDynamic                        operand1 = bootstrap index
+ *                                        operand2 = name_and_type_index
+ *   MethodHandle                         operand1 = reference_kind
+ *                                        operand2 = reference_index
+ *   Utf8                                 operand1 = length
+ *
+ * The bytes of a UTF8 constant are addressed by (offset, length) in the
+ * image, which serves as the pool's contiguous string blob.  Operands
+ * are decoded lazily, and the bitmap "decoded" records which constants'
+ * operands are valid.  All of the arrays are allocated from "arena".
+ */
+struct jcf_constant_pool {
+	uint16_t	count;
+	uint8_t		*tags;
+	uint32_t	*offsets;
+	uint16_t	*operand1;
+	uint16_t	*operand2;
+	uint64_t	*decoded;
+	struct jcf_arena arena;
+};
+
+/*
+ * Define a structure for holding parsing state.  One structure is
+ * reused for every class file that the parser reads.  "base" and "len"
+ * are the class file's image, and "pos" is a cursor into it that is
+ * advanced as the class file is parsed.
+ */
+struct jcf_parser {
+	const uint8_t	*base;
+	size_t		len;
+	size_t		pos;
+	struct jcf_constant_pool constant_pool;
+	uint16_t	access_flags;	// of the class
+	uint16_t	this_class;	// index of the class' Class constant
+	uint16_t	super_class;	// index of its superclass, or 0
+	uint16_t	method_name;	// of the method being read, or 0
+	uint16_t	method_descriptor;
+	unsigned int	events;		// the kinds of events to report
+	jcf_parse_callback *callback;
+	void		*arg;
+	struct jcf_out	text;		// scratch for building event text
+	struct jcf_parse_stats *stats;	// where statistics go, or NULL
+	struct timespec	lap;		// when the current phase started
+	uint64_t	lap_cycles;	// and the time-stamp counter then
+	size_t		lap_pos;	// where the current phase started
+	bool		strict;		// whether UTF8 constants are checked
+	jcf_utf8_validator *valid_utf8;	// how they are checked
+};
+
+static int	jcf_read(struct jcf_parser *jcf, void *buf, size_t len);
+static int	jcf_skip(struct jcf_parser *jcf, size_t len);
+static uint16_t	jcf_be16(const uint8_t *p);
+static uint32_t	jcf_be32(const uint8_t *p);
+static int	jcf_arena_reset(struct jcf_arena *arena, size_t size);
+static void	*jcf_arena_alloc(struct jcf_arena *arena, size_t size);
+static bool	jcf_wants(struct jcf_parser *jcf, enum jcf_parse_kind kind);
+static int	report_jcf_event(struct jcf_parser *jcf,
+		    struct jcf_parse_event *event);
+static int	report_jcf_text(struct jcf_parser *jcf,
+		    enum jcf_parse_kind kind, const char *text, size_t length);
+static int	print_jcf_constant(struct jcf_parser *jcf, struct jcf_out *out,
+		    uint16_t index, uint8_t expected_tag);
+static int	report_jcf_class(struct jcf_parser *jcf,
+		    enum jcf_parse_kind kind, uint16_t index);
+static int	report_jcf_dependency(struct jcf_parser *jcf,
+		    uint16_t index, uint8_t tag);
+static int	process_jcf_header(struct jcf_parser *jcf);
+static int	decode_jcf_constant(struct jcf_parser *jcf, uint16_t index,
+		    uint8_t expected_tag);
+static int	process_jcf_constant_pool(struct jcf_parser *jcf);
+static int	process_jcf_body(struct jcf_parser *jcf);
+static int	process_jcf_interfaces(struct jcf_parser *jcf);
+static int	process_jcf_fields(struct jcf_parser *jcf);
+static int	process_jcf_methods(struct jcf_parser *jcf);
+static int	process_jcf_fields_and_methods_helper(struct jcf_parser *jcf,
+		    bool methods);
+static int	process_jcf_attributes(struct jcf_parser *jcf);
+static uint32_t	jcf_instruction_length(const uint8_t *code, uint32_t pc,
+		    uint32_t code_length);
+static int	process_jcf_code(struct jcf_parser *jcf, uint32_t length);
+static uint64_t	jcf_parse_cycles(void);
+static void	jcf_parse_lap(struct jcf_parser *jcf,
+		    enum jcf_parse_phase phase);
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_parser with an image.
+ *   "buf" must point to at least "len" bytes.
+ *
+ * Effects:
+ *   Copies the next "len" bytes of the class file into "buf" and
+ *   advances the cursor past them.  Returns 0 on success and -1 if
+ *   fewer than "len" bytes remain.
+ */
+static int
+jcf_read(struct jcf_parser *jcf, void *buf, size_t len)
+{
+	if (len > jcf->len - jcf->pos)
+		return (-1);
+	memcpy(buf, jcf->base + jcf->pos, len);
+	jcf->pos += len;
+	return (0);
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_parser with an image.
+ *
+ * Effects:
+ *   Advances the cursor past the next "len" bytes of the class file in
+ *   constant time.  Returns 0 on success and -1 if fewer than "len"
+ *   bytes remain.
+ */
+static int
+jcf_skip(struct jcf_parser *jcf, size_t len)
+{
+	if (len > jcf->len - jcf->pos)
+		return (-1);
+	jcf->pos += len;
+	return (0);
+}
+
+/*
+ * Requires:
+ *   "p" must point to at least two bytes.
+ *
+ * Effects:
+ *   Returns the big-endian u2 at "p".
+ */
+static uint16_t
+jcf_be16(const uint8_t *p)
+{
+	return ((uint16_t)(p[0] << 8 | p[1]));
+}
+
+/*
+ * Requires:
+ *   "p" must point to at least four bytes.
+ *
+ * Effects:
+ *   Returns the big-endian u4 at "p".
+ */
+static uint32_t
+jcf_be32(const uint8_t *p)
+{
+	return ((uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+	    (uint32_t)p[2] << 8 | p[3]);
+}
+
+/*
+ * Requires:
+ *   "arena" must point to a struct jcf_arena whose "base" is either NULL
+ *   or a block previously allocated by this function.
+ *
+ * Effects:
+ *   Empties the arena and makes sure that it has a single block of at
+ *   least "size" bytes to hand out.  The existing block is reused if it
+ *   is large enough.  Returns 0 on success and -1 on failure.
+ */
+static int
+jcf_arena_reset(struct jcf_arena *arena, size_t size)
+{
+	assert(arena != NULL);
+
+	arena->used = 0;
+	if (arena->base != NULL && arena->size >= size)
+		return (0);
+	free(arena->base);
+	arena->base = malloc(size);
+	arena->size = arena->base == NULL ? 0 : size;
+	return (arena->base == NULL ? -1 : 0);
+}
+
+/*
+ * Requires:
+ *   "arena" must have been reset by jcf_arena_reset().
+ *
+ * Effects:
+ *   Returns a pointer to "size" unused bytes from the arena, or NULL if
+ *   the arena is exhausted.  The memory is only as aligned as "size"
+ *   keeps it, so callers allocate their most aligned arrays first.
+ */
+static void *
+jcf_arena_alloc(struct jcf_arena *arena, size_t size)
+{
+	void *ptr;
+
+	assert(arena != NULL);
+
+	if (size > arena->size - arena->used)
+		return (NULL);
+	ptr = arena->base + arena->used;
+	arena->used += size;
+	return (ptr);
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_parser.
+ *
+ * Effects:
+ *   Returns true if events of the given kind are to be reported.
+ */
+static bool
+jcf_wants(struct jcf_parser *jcf, enum jcf_parse_kind kind)
+{
+	return ((jcf->events & JCF_PARSE_EVENT(kind)) != 0);
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_parser that is
+ *   parsing.  "event" must have its kind and text set.
+ *
+ * Effects:
+ *   Reports the event to the callback and returns what it returns.
+ *   Fails if building the event's text ran out of memory.
+ */
+static int
+report_jcf_event(struct jcf_parser *jcf, struct jcf_parse_event *event)
+{
+	assert(jcf != NULL);
+
+	if (jcf->text.err != 0)
+		return (-1);
+	return (jcf->callback(jcf->arg, event));
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_parser that is
+ *   parsing.  "text" must point to "length" bytes.
+ *
+ * Effects:
+ *   Reports an event of the given kind with the given text and nothing
+ *   else.  Returns what the callback returns.
+ */
+static int
+report_jcf_text(struct jcf_parser *jcf, enum jcf_parse_kind kind,
+    const char *text, size_t length)
+{
+	struct jcf_parse_event event;
+
+	memset(&event, 0, sizeof(event));
+	event.kind = kind;
+	event.text = text;
+	event.length = length;
+	event.access_flags = jcf->access_flags;
+	return (report_jcf_event(jcf, &event));
+}
+
+/*
+ * Requires:
+ *   The constant pool must be initialized.
+ *
+ * Effects:
+ *   If the index is valid and points to a constant of the expected type,
+ *   this function will print the constant to "out" and return 0.  A UTF8
+ *   constant is printed as its bytes and any other constant as the
+ *   constants that it refers to, as described by its entry in
+ *   "jcf_cp_kinds".  Otherwise, -1 is returned.
+ */
+static int
+print_jcf_constant(struct jcf_parser *jcf, struct jcf_out *out,
+    uint16_t index, uint8_t expected_tag)
+{
+	const struct jcf_cp_kind *kind;
+	struct jcf_constant_pool *cp;
+
+	assert(jcf != NULL);
+
+	// Verify the index and tag and decode the constant if necessary.
+	if (decode_jcf_constant(jcf, index, expected_tag) != 0)
+		return -1;
+	cp = &jcf->constant_pool;
+
+	// Print the constant's bytes or the constants that it refers to.
+	kind = &jcf_cp_kinds[expected_tag];
+	if (kind->format == JCF_CP_UTF8) {
+		// Print the UTF8, which stays in the image.
+		jcf_out_bytes(out, jcf->base + cp->offsets[index],
+		    cp->operand1[index]);
+		return (0);
+	}
+	if (kind->ref1 == 0 && kind->ref2 == 0)
+		return (-1);
+	if (kind->ref1 != 0)
+		print_jcf_constant(jcf, out, cp->operand1[index], kind->ref1);
+	if (kind->ref1 != 0 && kind->ref2 != 0)
+		jcf_out_char(out, kind->separator);
+	if (kind->ref2 != 0)
+		print_jcf_constant(jcf, out, cp->operand2[index], kind->ref2);
+	return (0);
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_parser whose constant
+ *   pool has been read.
+ *
+ * Effects:
+ *   Reports an event of the given kind whose text is the name of the
+ *   class at "index".  The name is passed in place, without being
+ *   copied.  Returns -1 if "index" is not the index of a Class constant
+ *   and otherwise what the callback returns.
+ */
+static int
+report_jcf_class(struct jcf_parser *jcf, enum jcf_parse_kind kind,
+    uint16_t index)
+{
+	struct jcf_constant_pool *cp = &jcf->constant_pool;
+	uint16_t name;
+
+	if (decode_jcf_constant(jcf, index, JCF_CONSTANT_Class) != 0)
+		return (-1);
+
+	// A class whose name is not a UTF8 constant is printed as empty.
+	name = cp->operand1[index];
+	if (decode_jcf_constant(jcf, name, JCF_CONSTANT_Utf8) != 0)
+		return (report_jcf_text(jcf, kind, "", 0));
+	return (report_jcf_text(jcf, kind,
+	    (const char *)jcf->base + cp->offsets[name], cp->operand1[name]));
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_parser whose constant
+ *   pool has been read.  "tag" must be the tag of a member reference.
+ *
+ * Effects:
+ *   Reports a dependency event for the member reference at "index",
+ *   printed as print_jcf_constant() prints it, with the offsets of its
+ *   name and descriptor.  Returns -1 if "index" is not the index of a
+ *   constant with tag "tag" and otherwise what the callback returns.
+ */
+static int
+report_jcf_dependency(struct jcf_parser *jcf, uint16_t index, uint8_t tag)
+{
+	struct jcf_constant_pool *cp = &jcf->constant_pool;
+	struct jcf_parse_event event;
+	uint16_t name_and_type;
+
+	if (decode_jcf_constant(jcf, index, tag) != 0)
+		return (-1);
+	memset(&event, 0, sizeof(event));
+	event.kind = JCF_PARSE_DEPENDENCY;
+	event.access_flags = jcf->access_flags;
+	event.method = tag != JCF_CONSTANT_Fieldref;
+
+	// A constant that is not valid is printed as empty.
+	jcf_out_reset(&jcf->text);
+	print_jcf_constant(jcf, &jcf->text, cp->operand1[index],
+	    JCF_CONSTANT_Class);
+	jcf_out_char(&jcf->text, '.');
+	event.name_offset = jcf->text.len;
+	event.descriptor_offset = jcf->text.len;
+	name_and_type = cp->operand2[index];
+	if (decode_jcf_constant(jcf, name_and_type,
+	    JCF_CONSTANT_NameAndType) == 0) {
+		print_jcf_constant(jcf, &jcf->text,
+		    cp->operand1[name_and_type], JCF_CONSTANT_Utf8);
+		event.name_length = jcf->text.len - event.name_offset;
+		jcf_out_char(&jcf->text, ' ');
+		event.descriptor_offset = jcf->text.len;
+		print_jcf_constant(jcf, &jcf->text,
+		    cp->operand2[name_and_type], JCF_CONSTANT_Utf8);
+	}
+	event.text = jcf->text.buf;
+	event.length = jcf->text.len;
+	return (report_jcf_event(jcf, &event));
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_parser with an image.
+ *
+ * Effects:
+ *   Reads and verifies the Java class file header.  Returns 0 on
+ *   success and -1 on failure.
+ */
+static int
+process_jcf_header(struct jcf_parser *jcf)
+{
+	uint8_t info[JCF_HEADER_SIZE];
+
+	assert(jcf != NULL);
+
+	// Read the header and verify the magic number.
+	if (jcf_read(jcf, info, sizeof(info)) != 0)
+		return (-1);
+	if (jcf_be32(info) != JCF_MAGIC)
+		return (-1);
+
+	return (0);
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_parser whose constant
+ *   pool has been scanned by process_jcf_constant_pool().
+ *
+ * Effects:
+ *   If "index" is the index of a constant with tag "expected_tag",
+ *   makes sure that the constant's operands have been decoded into the
+ *   pool's operand arrays and returns 0.  Otherwise, returns -1.  The
+ *   operands are read from the image the first time that the constant
+ *   is used, and the "decoded" bitmap remembers that they have been, so
+ *   only the constants that are actually used are decoded.
+ */
+static int
+decode_jcf_constant(struct jcf_parser *jcf, uint16_t index,
+    uint8_t expected_tag)
+{
+	struct jcf_constant_pool *cp = &jcf->constant_pool;
+	const uint8_t *body;
+
+	assert(jcf != NULL);
+
+	// Verify the index and tag.  The second slot of a long or double
+	// has no tag.
+	if (index == 0 || index >= cp->count || cp->tags[index] != expected_tag)
+		return (-1);
+	if ((cp->decoded[index / 64] & (UINT64_C(1) << (index % 64))) != 0)
+		return (0);
+
+	// The pre-scan has already checked that the body is in the image.
+	body = jcf->base + cp->offsets[index];
+	switch (jcf_cp_kinds[expected_tag].format) {
+	case JCF_CP_U2:
+		cp->operand1[index] = jcf_be16(body);
+		break;
+
+	case JCF_CP_U2U2:
+		cp->operand1[index] = jcf_be16(body);
+		cp->operand2[index] = jcf_be16(body + 2);
+		break;
+
+	case JCF_CP_U1U2:
+		cp->operand1[index] = body[0];
+		cp->operand2[index] = jcf_be16(body + 1);
+		break;
+
+	default:
+		/*
+		 * UTF8 lengths are recorded by the pre-scan.  The values of
+		 * numeric constants are never used, so they are not stored.
+		 */
+		break;
+	}
+	cp->decoded[index / 64] |= UINT64_C(1) << (index % 64);
+	return (0);
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_parser with an image.
+ *   The JCF header must have already been read.
+ *
+ * Effects:
+ *   Scans the constant pool of the JCF, recording only the tag and the
+ *   offset of the body of each constant, and the length of each UTF8
+ *   constant.  The other operands are decoded on demand by
+ *   decode_jcf_constant().  Reports the dependencies if requested.
+ *   Returns 0 on success, -1 on failure, and otherwise what the
+ *   callback returned.
+ *
+ *   All of the pool's arrays are allocated as one arena, whose size
+ *   depends only on "constant_pool_count".  UTF8 bytes are not copied,
+ *   so they need no space in the arena.
+ */
+static int
+process_jcf_constant_pool(struct jcf_parser *jcf)
+{
+	int 	i; 		// counter for the for loop
+	int	err;
+	uint16_t 	constant_pool_count;
+	uint8_t 	tag; 	// tag of elements from constant pool
+	uint16_t   	length; // to get the utf8 array length
+	size_t		bitmap_size; // bytes needed for the decoded bitmap
+	const uint8_t	*base;	// the image
+	size_t		len, pos, size; // of the image, cursor, body size
+	const struct jcf_cp_kind *kind;
+	struct jcf_constant_pool *cp = &jcf->constant_pool;
+	bool		strict = jcf->strict;
+
+	assert(jcf != NULL);
+
+	// Read the constant pool count.
+	if (jcf_skip(jcf, sizeof(constant_pool_count)) != 0)
+		return (-1);
+	constant_pool_count = jcf_be16(jcf->base + jcf->pos - 2);
+	cp->count = constant_pool_count;
+
+	/*
+	 * Allocate the arrays from the arena, most aligned first.  The
+	 * bitmap is cleared so that no constant is decoded yet, and the
+	 * tags are cleared so that unused slots have no tag.
+	 */
+	bitmap_size = (constant_pool_count + 63) / 64 * sizeof(uint64_t);
+	if (jcf_arena_reset(&cp->arena, bitmap_size + constant_pool_count *
+	    (sizeof(uint32_t) + 2 * sizeof(uint16_t) + sizeof(uint8_t))) != 0) {
+		cp->count = 0;
+		return (-1);
+	}
+	cp->decoded = jcf_arena_alloc(&cp->arena, bitmap_size);
+	cp->offsets = jcf_arena_alloc(&cp->arena,
+	    constant_pool_count * sizeof(uint32_t));
+	cp->operand1 = jcf_arena_alloc(&cp->arena,
+	    constant_pool_count * sizeof(uint16_t));
+	cp->operand2 = jcf_arena_alloc(&cp->arena,
+	    constant_pool_count * sizeof(uint16_t));
+	cp->tags = jcf_arena_alloc(&cp->arena, constant_pool_count);
+	memset(cp->decoded, 0, bitmap_size);
+	memset(cp->tags, 0, constant_pool_count);
+
+	/*
+	 * Read the constant pool.  This is the hottest loop in the program,
+	 * so the cursor is kept in local variables instead of going
+	 * through jcf_read() and jcf_skip().
+	 */
+	base = jcf->base;
+	len = jcf->len;
+	pos = jcf->pos;
+	for (i = 1; i < constant_pool_count; i++) {
+
+		// Read the constant pool info tag.
+		if (pos == len)
+			return (-1);
+		tag = base[pos++];
+		kind = &jcf_cp_kinds[tag];
+
+		// Record where the constant's body starts.
+		cp->tags[i] = tag;
+		cp->offsets[i] = pos;
+
+		/*
+		 * Skip the body without decoding it.  A UTF8 constant's
+		 * length is recorded as its operand and its offset is moved
+		 * to its bytes.  The second slot of a long or double is left
+		 * without a tag.
+		 *
+		 * The size from the table is dispatched on rather than added
+		 * to "pos" directly.  That makes the next tag's position
+		 * depend on a predicted branch instead of on loading this tag
+		 * and then its table entry, which would serialize the loop.
+		 */
+		if (kind->format == JCF_CP_UTF8) {
+			if (len - pos < 2)
+				return (-1);
+			length = jcf_be16(base + pos);
+			pos += 2;
+			cp->offsets[i] = pos;
+			cp->operand1[i] = length;
+			cp->decoded[i / 64] |= UINT64_C(1) << (i % 64);
+			size = length;
+
+			// Check the encoding in strict mode.
+			if (strict && (len - pos < size ||
+			    !jcf->valid_utf8(base + pos, size)))
+				return (-1);
+		} else {
+			switch (kind->size) {
+			case 2:
+				size = 2;
+				break;
+			case 3:
+				size = 3;
+				break;
+			case 4:
+				size = 4;
+				break;
+			case 8:
+				size = 8;
+				break;
+			default:
+				// The tag is unknown.
+				return (-1);
+			}
+		}
+		if (len - pos < size)
+			return (-1);
+		pos += size;
+		i += kind->slots - 1;
+	}
+	jcf->pos = pos;
+
+	// Count the constants by tag if statistics are kept.
+	if (jcf->stats != NULL) {
+		for (i = 1; i < constant_pool_count; i++) {
+			if (cp->tags[i] != 0)
+				jcf->stats->constants[cp->tags[i]]++;
+		}
+	}
+
+	/*
+	 * Report the dependencies if requested.  This must be done after
+	 * reading the entire pool because there are no guarantees about
+	 * constants not containing references to other constants after
+	 * them in the pool.
+	 */
+	if (jcf_wants(jcf, JCF_PARSE_DEPENDENCY)) {
+		for (i = 1; i < constant_pool_count; i++) {
+			tag = cp->tags[i];
+			if (!jcf_cp_kinds[tag].dependency)
+				continue;
+			if ((err = report_jcf_dependency(jcf, i, tag)) != 0)
+				return (err);
+		}
+	}
+	return (0);
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_parser with an image.
+ *   The JCF header and constant pool must have already been read.
+ *
+ * Effects:
+ *   Reads the Java class file body and reports the class, its
+ *   superclass and the classes that it uses, if requested.  Returns 0
+ *   on success, -1 on failure, and otherwise what the callback returned.
+ */
+static int
+process_jcf_body(struct jcf_parser *jcf)
+{
+	struct jcf_constant_pool *cp = &jcf->constant_pool;
+	uint8_t body[JCF_BODY_SIZE];
+	int err, i;
+
+	assert(jcf != NULL);
+
+	// Read the body.
+	if (jcf_read(jcf, body, sizeof(body)) != 0)
+		return (-1);
+
+	// Keep this class, which names the members that the class defines.
+	jcf->access_flags = jcf_be16(body);
+	jcf->this_class = jcf_be16(body + 2);
+	jcf->super_class = jcf_be16(body + 4);
+
+	// Report the class and its superclass.  Only java/lang/Object has
+	// no superclass.
+	if (jcf_wants(jcf, JCF_PARSE_CLASS) && (err = report_jcf_class(jcf,
+	    JCF_PARSE_CLASS, jcf->this_class)) != 0)
+		return (err);
+	if (jcf_wants(jcf, JCF_PARSE_SUPER) && jcf->super_class != 0 &&
+	    (err = report_jcf_class(jcf, JCF_PARSE_SUPER,
+	    jcf->super_class)) != 0)
+		return (err);
+
+	// Report every other class that a Class constant names.
+	if (jcf_wants(jcf, JCF_PARSE_USE)) {
+		for (i = 1; i < cp->count; i++) {
+			if (cp->tags[i] != JCF_CONSTANT_Class ||
+			    i == jcf->this_class)
+				continue;
+			if ((err = report_jcf_class(jcf, JCF_PARSE_USE,
+			    i)) != 0)
+				return (err);
+		}
+	}
+
+	return (0);
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_parser with an image.
+ *   The JCF header, constant pool, and body must have already been read.
+ *
+ * Effects:
+ *   Reads the Java class file interfaces and reports them, if requested.
+ *   Returns 0 on success, -1 on failure, and otherwise what the callback
+ *   returned.
+ */
+static int
+process_jcf_interfaces(struct jcf_parser *jcf)
+{
+	int err, i;
+	uint16_t count;
+
+	assert(jcf != NULL);
+
+	// Read the interfaces count.
+	if (jcf_skip(jcf, sizeof(count)) != 0)
+		return (-1);
+	count = jcf_be16(jcf->base + jcf->pos - 2);
+
+	// Read the interfaces, or skip them if they are not reported.
+	if (!jcf_wants(jcf, JCF_PARSE_INTERFACE))
+		return (jcf_skip(jcf, 2 * (size_t)count));
+	for (i = 0; i < count; i++) {
+		if (jcf_skip(jcf, 2) != 0)
+			return (-1);
+		if ((err = report_jcf_class(jcf, JCF_PARSE_INTERFACE,
+		    jcf_be16(jcf->base + jcf->pos - 2))) != 0)
+			return (err);
+	}
+
+	return (0);
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_parser with an image.
+ *   The JCF header, constant pool, body, and interfaces must have
+ *   already been read.
+ *
+ * Effects:
+ *   Reads the Java class file fields.  Reports them, if requested.
+ *   Returns 0 on success, -1 on failure, and otherwise what the callback
+ *   returned.
+ */
+static int
+process_jcf_fields(struct jcf_parser *jcf)
+{
+	return (process_jcf_fields_and_methods_helper(jcf, false));
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_parser with an image.
+ *   The JCF header, constant pool, body, interfaces, and fields must
+ *   have already been read.
+ *
+ * Effects:
+ *   Reads the Java class file methods.  Reports them, if requested.
+ *   Returns 0 on success, -1 on failure, and otherwise what the callback
+ *   returned.
+ */
+static int
+process_jcf_methods(struct jcf_parser *jcf)
+{
+	return (process_jcf_fields_and_methods_helper(jcf, true));
+}
+
+/*
+ * Requires:
+ *   All the requirements of either process_jcf_fields or
+ *   process_jcf_methods.
+ *
+ * Effects:
+ *   Reads the Java class file fields or, if "methods" is true, methods.
+ *   Reports every member and every public member, if requested, and
+ *   then its attributes.  Returns 0 on success, -1 on failure, and
+ *   otherwise what the callback returned.
+ */
+static int
+process_jcf_fields_and_methods_helper(struct jcf_parser *jcf, bool methods)
+{
+	struct jcf_parse_event event;
+	uint8_t info[JCF_MEMBER_SIZE];
+	uint16_t count, name_index, descriptor_index;
+	bool member, exported;
+	int err, i;
+
+	assert(jcf != NULL);
+
+	// Read the count.
+	if (jcf_skip(jcf, sizeof(count)) != 0)
+		return (-1);
+	count = jcf_be16(jcf->base + jcf->pos - 2);
+
+	// Read the members.
+	memset(&event, 0, sizeof(event));
+	event.method = methods;
+	for (i = 0; i < count; i++) {
+		// Read the info.
+		if (jcf_read(jcf, info, sizeof(info)) != 0)
+			return (-1);
+		event.access_flags = jcf_be16(info);
+		name_index = jcf_be16(info + 2);
+		descriptor_index = jcf_be16(info + 4);
+
+		// Report the member's "name descriptor".
+		member = jcf_wants(jcf, JCF_PARSE_MEMBER);
+		exported = jcf_wants(jcf, JCF_PARSE_EXPORT) &&
+		    (event.access_flags & JCF_ACC_PUBLIC) != 0;
+		if (member || exported) {
+			jcf_out_reset(&jcf->text);
+			if (print_jcf_constant(jcf, &jcf->text, name_index,
+			    JCF_CONSTANT_Utf8) != 0)
+				return (-1);
+			event.name_length = jcf->text.len;
+			jcf_out_char(&jcf->text, ' ');
+			event.descriptor_offset = jcf->text.len;
+			if (print_jcf_constant(jcf, &jcf->text,
+			    descriptor_index, JCF_CONSTANT_Utf8) != 0)
+				return (-1);
+			event.text = jcf->text.buf;
+			event.length = jcf->text.len;
+		}
+		if (member) {
+			event.kind = JCF_PARSE_MEMBER;
+			if ((err = report_jcf_event(jcf, &event)) != 0)
+				return (err);
+		}
+		if (exported) {
+			event.kind = JCF_PARSE_EXPORT;
+			if ((err = report_jcf_event(jcf, &event)) != 0)
+				return (err);
+		}
+
+		// Read the attributes, which include a method's Code.
+		jcf->method_name = methods ? name_index : 0;
+		jcf->method_descriptor = descriptor_index;
+		if ((err = process_jcf_attributes(jcf)) != 0)
+			return (err);
+	}
+	jcf->method_name = 0;
+
+	return (0);
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_parser with an image.
+ *   The next part of the JCF to be read must be an attributes count,
+ *   followed by an array of attributes exactly count long.
+ *
+ * Effects:
+ *   Reads the attributes.  The body of each attribute is skipped without
+ *   being read, unless it is a method's Code and references are to be
+ *   reported.  Reports each attribute whose name is a UTF8 constant, if
+ *   requested.  Returns 0 on success, -1 on failure, and otherwise what
+ *   the callback returned.
+ */
+static int
+process_jcf_attributes(struct jcf_parser *jcf)
+{
+	struct jcf_constant_pool *cp = &jcf->constant_pool;
+	struct jcf_parse_event event;
+	uint16_t attributes_count, name_index;
+	uint32_t length;
+	const uint8_t *p;
+	bool named;
+	int err, i;
+
+	assert(jcf != NULL);
+
+	// Read the attributes count.
+	if (jcf_skip(jcf, sizeof(attributes_count)) != 0)
+		return (-1);
+	attributes_count = jcf_be16(jcf->base + jcf->pos - 2);
+
+	// Read the attributes.
+	for (i = 0; i < attributes_count; i++) {
+		// Read the attribute name index and length.
+		if (jcf_skip(jcf, 6) != 0)
+			return (-1);
+		p = jcf->base + jcf->pos - 6;
+		name_index = jcf_be16(p);
+		length = jcf_be32(p + 2);
+
+		// Report the attribute if its name is valid.
+		named = (jcf_wants(jcf, JCF_PARSE_ATTRIBUTE) ||
+		    (jcf_wants(jcf, JCF_PARSE_REFERENCE) &&
+		    jcf->method_name != 0)) &&
+		    decode_jcf_constant(jcf, name_index,
+		    JCF_CONSTANT_Utf8) == 0;
+		if (named && jcf_wants(jcf, JCF_PARSE_ATTRIBUTE)) {
+			memset(&event, 0, sizeof(event));
+			event.kind = JCF_PARSE_ATTRIBUTE;
+			event.text = (const char *)jcf->base +
+			    cp->offsets[name_index];
+			event.length = cp->operand1[name_index];
+			event.value = length;
+			if ((err = report_jcf_event(jcf, &event)) != 0)
+				return (err);
+		}
+
+		// Decode a method's code if its references were requested.
+		if (named && jcf->method_name != 0 &&
+		    jcf_wants(jcf, JCF_PARSE_REFERENCE) &&
+		    cp->operand1[name_index] == 4 &&
+		    memcmp(jcf->base + cp->offsets[name_index], "Code",
+		    4) == 0 && (err = process_jcf_code(jcf, length)) != 0)
+			return (err);
+
+		// Skip the attribute data.
+		if (jcf_skip(jcf, length) != 0)
+			return (-1);
+	}
+	return (0);
+}
+
+/*
+ * Requires:
+ *   "code" must point to "code_length" bytes, and "pc" must be less
+ *   than "code_length".
+ *
+ * Effects:
+ *   Returns the length of the instruction at "pc" whose length varies,
+ *   or 0 if it is malformed or runs past the end of the code.  The
+ *   operands of a switch are aligned to a multiple of four bytes from
+ *   the start of the code, and "wide" widens the instruction after it.
+ */
+static uint32_t
+jcf_instruction_length(const uint8_t *code, uint32_t pc, uint32_t code_length)
+{
+	uint64_t length;
+	int32_t low, high, npairs;
+	uint32_t operands = pc + 1 + (3 - pc % 4);
+
+	switch (code[pc]) {
+	case JCF_OP_TABLESWITCH:
+		// Skip the default, low, high and a jump per value.
+		if ((uint64_t)operands + 12 > code_length)
+			return (0);
+		low = jcf_be32(code + operands + 4);
+		high = jcf_be32(code + operands + 8);
+		if (low > high)
+			return (0);
+		length = operands - pc + 12 + 4 * ((int64_t)high - low + 1);
+		break;
+
+	case JCF_OP_LOOKUPSWITCH:
+		// Skip the default, the count and the match-jump pairs.
+		if ((uint64_t)operands + 8 > code_length)
+			return (0);
+		npairs = jcf_be32(code + operands + 4);
+		if (npairs < 0)
+			return (0);
+		length = operands - pc + 8 + 8 * (uint64_t)npairs;
+		break;
+
+	case JCF_OP_WIDE:
+		if (pc + 1 == code_length)
+			return (0);
+		if (code[pc + 1] == JCF_OP_IINC)
+			length = 6;
+		else if ((code[pc + 1] >= JCF_OP_ILOAD &&
+		    code[pc + 1] <= JCF_OP_ALOAD) ||
+		    (code[pc + 1] >= JCF_OP_ISTORE &&
+		    code[pc + 1] <= JCF_OP_ASTORE) ||
+		    code[pc + 1] == JCF_OP_RET)
+			length = 4;
+		else
+			return (0);
+		break;
+
+	default:
+		// The opcode is not defined.
+		return (0);
+	}
+	return (length <= code_length - pc ? length : 0);
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_parser whose image is
+ *   positioned at the data of a Code attribute of "length" bytes, and
+ *   whose "method_name" and "method_descriptor" name the method.
+ *
+ * Effects:
+ *   Decodes the method's bytecode and reports a reference for each
+ *   instruction that uses a field, method or class constant: each get,
+ *   put and invoke, and each new, anewarray, multianewarray, checkcast
+ *   and instanceof.  The event holds the method's name and descriptor,
+ *   the instruction's offset and mnemonic, and the constant.  Each
+ *   instruction's length comes from "jcf_opcodes", except for the few
+ *   whose length varies.  Does not move the image's position.  Returns
+ *   0 on success, -1 if the code is malformed, and otherwise what the
+ *   callback returned.
+ */
+static int
+process_jcf_code(struct jcf_parser *jcf, uint32_t length)
+{
+	struct jcf_constant_pool *cp = &jcf->constant_pool;
+	struct jcf_parse_event event;
+	const struct jcf_opcode *op;
+	const uint8_t *attribute, *code;
+	uint32_t code_length, pc, size;
+	size_t prefix;
+	uint16_t index;
+	uint8_t tag;
+	int err;
+
+	assert(jcf != NULL);
+
+	// Find the code, after max_stack, max_locals and code_length.
+	if (length > jcf->len - jcf->pos || length < 8)
+		return (-1);
+	attribute = jcf->base + jcf->pos;
+	code_length = jcf_be32(attribute + 4);
+	if (code_length > length - 8)
+		return (-1);
+	code = attribute + 8;
+
+	/*
+	 * Put the method's name and descriptor first in the text, and each
+	 * constant after them.  The event's pointers are set once the text
+	 * has stopped growing.
+	 */
+	jcf_out_reset(&jcf->text);
+	if (print_jcf_constant(jcf, &jcf->text, jcf->method_name,
+	    JCF_CONSTANT_Utf8) != 0)
+		return (-1);
+	jcf_out_char(&jcf->text, ' ');
+	if (print_jcf_constant(jcf, &jcf->text, jcf->method_descriptor,
+	    JCF_CONSTANT_Utf8) != 0)
+		return (-1);
+	prefix = jcf->text.len;
+	memset(&event, 0, sizeof(event));
+	event.kind = JCF_PARSE_REFERENCE;
+	event.access_flags = jcf->access_flags;
+	event.method = true;
+
+	for (pc = 0; pc < code_length; pc += size) {
+		op = &jcf_opcodes[code[pc]];
+		size = op->length;
+		if (size == 0)
+			size = jcf_instruction_length(code, pc, code_length);
+		if (size == 0 || size > code_length - pc)
+			return (-1);
+		if (op->tags == 0)
+			continue;
+
+		// Check the constant that the instruction uses.
+		index = jcf_be16(code + pc + 1);
+		tag = index < cp->count ? cp->tags[index] : 0;
+		if ((op->tags & JCF_TAG(tag)) == 0)
+			return (-1);
+
+		// Report it, keeping the method's part of the text.
+		jcf->text.len = prefix;
+		if (print_jcf_constant(jcf, &jcf->text, index, tag) != 0)
+			return (-1);
+		event.member = jcf->text.buf;
+		event.member_length = prefix;
+		event.text = jcf->text.buf + prefix;
+		event.length = jcf->text.len - prefix;
+		event.value = pc;
+		event.mnemonic = op->name;
+		if ((err = report_jcf_event(jcf, &event)) != 0)
+			return (err);
+	}
+	return (0);
+}
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Returns the processor's time-stamp counter, or zero if it has none.
+ */
+static uint64_t
+jcf_parse_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return (__rdtsc());
+#else
+	return (0);
+#endif
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_parser that is
+ *   parsing, whose "lap", "lap_cycles" and "lap_pos" are when and where
+ *   "phase" started if statistics are kept.
+ *
+ * Effects:
+ *   Ends the phase, adding its time, cycles and bytes to the statistics
+ *   if they are kept, and starts the next phase.
+ */
+static void
+jcf_parse_lap(struct jcf_parser *jcf, enum jcf_parse_phase phase)
+{
+	struct timespec now;
+	uint64_t cycles;
+
+	if (jcf->stats == NULL)
+		return;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	cycles = jcf_parse_cycles();
+	jcf->stats->cycles[phase] += cycles - jcf->lap_cycles;
+	jcf->stats->nsec[phase] += (uint64_t)(now.tv_sec -
+	    jcf->lap.tv_sec) * 1000000000 + now.tv_nsec - jcf->lap.tv_nsec;
+	jcf->stats->bytes[phase] += jcf->pos - jcf->lap_pos;
+	jcf->lap = now;
+	jcf->lap_cycles = cycles;
+	jcf->lap_pos = jcf->pos;
+}
+
+int
+jcf_parse_version(void)
+{
+	return (JCF_PARSE_VERSION);
+}
+
+struct jcf_parser *
+jcf_parser_create(void)
+{
+	struct jcf_parser *jcf;
+
+	jcf = calloc(1, sizeof(*jcf));
+	if (jcf == NULL)
+		return (NULL);
+	jcf_out_init(&jcf->text, -1);
+	jcf->valid_utf8 = jcf_utf8_select();
+	return (jcf);
+}
+
+void
+jcf_parser_stats(struct jcf_parser *jcf, struct jcf_parse_stats *stats)
+{
+	assert(jcf != NULL);
+
+	jcf->stats = stats;
+}
+
+void
+jcf_parser_strict(struct jcf_parser *jcf, bool strict)
+{
+	assert(jcf != NULL);
+
+	jcf->strict = strict;
+}
+
+void
+jcf_parser_destroy(struct jcf_parser *jcf)
+{
+	if (jcf == NULL)
+		return;
+	free(jcf->constant_pool.arena.base);
+	jcf_out_destroy(&jcf->text);
+	free(jcf);
+}
+
+int
+jcf_parse(struct jcf_parser *jcf, const void *buf, size_t len,
+    unsigned int events, jcf_parse_callback *callback, void *arg)
+{
+	// Error return: Was there an error during parsing?
+	int err;
+
+	assert(jcf != NULL);
+	assert(callback != NULL || events == 0);
+
+	jcf->base = buf;
+	jcf->len = len;
+	jcf->pos = 0;
+	jcf->events = events;
+	jcf->callback = callback;
+	jcf->arg = arg;
+	jcf->method_name = 0;
+	jcf->text.err = 0;
+	if (jcf->stats != NULL) {
+		jcf->stats->files++;
+		clock_gettime(CLOCK_MONOTONIC, &jcf->lap);
+		jcf->lap_cycles = jcf_parse_cycles();
+		jcf->lap_pos = 0;
+	}
+
+	// Process the JCF header.
+	err = process_jcf_header(jcf);
+	jcf_parse_lap(jcf, JCF_PARSE_PHASE_HEADER);
+	if (err != 0)
+		goto done;
+
+	// Process the JCF constant pool.
+	err = process_jcf_constant_pool(jcf);
+	jcf_parse_lap(jcf, JCF_PARSE_PHASE_CONSTANT_POOL);
+	if (err != 0)
+		goto done;
+
+	// Process the JCF body.
+	err = process_jcf_body(jcf);
+	jcf_parse_lap(jcf, JCF_PARSE_PHASE_HEADER);
+	if (err != 0)
+		goto done;
+
+	// Process the JCF interfaces.
+	err = process_jcf_interfaces(jcf);
+	jcf_parse_lap(jcf, JCF_PARSE_PHASE_HEADER);
+	if (err != 0)
+		goto done;
+
+	// Process the JCF fields.
+	err = process_jcf_fields(jcf);
+	jcf_parse_lap(jcf, JCF_PARSE_PHASE_FIELDS);
+	if (err != 0)
+		goto done;
+
+	// Process the JCF methods.
+	err = process_jcf_methods(jcf);
+	jcf_parse_lap(jcf, JCF_PARSE_PHASE_METHODS);
+	if (err != 0)
+		goto done;
+
+	// Process the JCF final attributes.
+	err = process_jcf_attributes(jcf);
+	jcf_parse_lap(jcf, JCF_PARSE_PHASE_ATTRIBUTES);
+	if (err != 0)
+		goto done;
+
+	// Check for extra data.
+	if (jcf->pos != jcf->len)
+		err = -1;
+
+done:
+	if (err != 0 && jcf->stats != NULL)
+		jcf->stats->failed++;
+
+	// Forget the image, which belongs to the caller.
+	jcf->constant_pool.count = 0;
+	jcf->base = NULL;
+	jcf->len = 0;
+	return (err);
+}
@@ -0,0 +1,232 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * A reentrant parser for Java class files.  A parser reads a class file
+ * from a memory buffer, performs pass 1 verification, and reports what
+ * it finds as a sequence of events to a callback, instead of printing
+ * it.  The parser keeps no global state, so each thread can use its own
+ * parser, and a parser reuses its memory from one class file to the
+ * next.  The parser never writes to stdout or stderr.
+ *
+ * The library is built as libjcf.a and libjcf.so.  Its interface only
+ * grows: new kinds of events are added at the end, and a caller only
+ * receives the kinds that it asks for.
+ */
+
+#ifndef JCF_PARSE_H
+#define JCF_PARSE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Define the version of the interface.
+#define JCF_PARSE_VERSION	5
+
+// Define an enumeration of the access flags.
+enum jcf_access_flags {
+	JCF_ACC_PUBLIC = 0x0001,
+	JCF_ACC_PRIVATE = 0x0002,
+	JCF_ACC_PROTECTED = 0x0004,
+	JCF_ACC_STATIC = 0x0008,
+	JCF_ACC_FINAL = 0x0010,
+	JCF_ACC_SYNCHRONIZED = 0x0020,
+	JCF_ACC_VOLATILE = 0x0040,
+	JCF_ACC_TRANSIENT = 0x0080,
+	JCF_ACC_NATIVE = 0x0100,
+	JCF_ACC_INTERFACE = 0x0200,
+	JCF_ACC_ABSTRACT = 0x0400,
+	JCF_ACC_STRICT = 0x0800
+};
+
+/*
+ * Define an enumeration of the kinds of events, in the order in which
+ * they are reported for a class file.  The text of each event is:
+ *
+ *   JCF_PARSE_DEPENDENCY   a field or method reference of the constant
+ *                          pool, as "class.name descriptor"
+ *   JCF_PARSE_CLASS        the name of the class
+ *   JCF_PARSE_SUPER        the name of its superclass, if it has one
+ *   JCF_PARSE_USE          the name of every other class that a Class
+ *                          constant names, in pool order
+ *   JCF_PARSE_INTERFACE    the name of each superinterface
+ *   JCF_PARSE_MEMBER       each field and then each method, as
+ *                          "name descriptor"
+ *   JCF_PARSE_EXPORT       the same for a public field or method,
+ *                          after its JCF_PARSE_MEMBER event
+ *   JCF_PARSE_ATTRIBUTE    the name of an attribute of the class or of
+ *                          a member, with its length in "value"
+ *   JCF_PARSE_REFERENCE    a constant that a method's code uses, printed
+ *                          like a dependency, with the instruction's
+ *                          offset in "value"
+ *
+ * An attribute's event follows its member's events, and the references
+ * of a method's code follow its Code attribute's event.
+ */
+enum jcf_parse_kind {
+	JCF_PARSE_DEPENDENCY,
+	JCF_PARSE_CLASS,
+	JCF_PARSE_SUPER,
+	JCF_PARSE_USE,
+	JCF_PARSE_INTERFACE,
+	JCF_PARSE_MEMBER,
+	JCF_PARSE_EXPORT,
+	JCF_PARSE_ATTRIBUTE,
+	JCF_PARSE_REFERENCE
+};
+
+// Define the bit of a kind of event in a set of kinds.
+#define JCF_PARSE_EVENT(kind)	(1u << (kind))
+
+/*
+ * Define an event.  The strings are not NUL terminated.  The text of a
+ * class name or attribute name points into the class file's buffer and
+ * is valid as long as it is.  The other strings are only valid until
+ * the callback returns.  The name and descriptor of a dependency or
+ * member are found in its text by their offsets, since either may hold
+ * spaces, and a dependency's class ends before the '.' that precedes
+ * its name.  A dependency whose NameAndType is not valid has an empty
+ * name and descriptor.  The structure grows at its end with the
+ * interface's version.
+ */
+struct jcf_parse_event {
+	enum jcf_parse_kind kind;
+	const char	*text;
+	size_t		length;		// of "text"
+	uint16_t	access_flags;	// of the class or member
+	bool		method;		// whether a member, or the member
+					// that a dependency names, is a method
+	uint32_t	value;		// attribute length or code offset
+	const char	*mnemonic;	// of a reference's instruction
+	const char	*member;	// a reference's method, as
+	size_t		member_length;	// "name descriptor"
+	size_t		name_offset;	// of a member's name in "text"
+	size_t		name_length;
+	size_t		descriptor_offset; // of its descriptor, to the end
+};
+
+/*
+ * Define a callback.  It returns 0 to continue parsing or any other
+ * value to stop.
+ */
+typedef int	jcf_parse_callback(void *arg,
+		    const struct jcf_parse_event *event);
+
+/*
+ * Define an enumeration of the phases of a parse that statistics are
+ * kept for.  The header phase includes the class' access flags,
+ * superclass and interfaces, and the fields and methods phases include
+ * their members' attributes, which leaves the class' own attributes to
+ * the attributes phase.  Each phase includes the callbacks made in it.
+ */
+enum jcf_parse_phase {
+	JCF_PARSE_PHASE_HEADER,
+	JCF_PARSE_PHASE_CONSTANT_POOL,
+	JCF_PARSE_PHASE_FIELDS,
+	JCF_PARSE_PHASE_METHODS,
+	JCF_PARSE_PHASE_ATTRIBUTES,
+	JCF_PARSE_PHASES
+};
+
+// Define the number of constant tags, one more than the largest.
+#define JCF_PARSE_TAGS		21
+
+/*
+ * Define the statistics of the class files that a parser has parsed.
+ * A class file that fails to parse counts toward the phases that it
+ * reached, and its constants are counted only if its whole constant
+ * pool was read.  The cycles are those of the processor's time-stamp
+ * counter, which are zero where there is none.  The constants are
+ * counted by tag, and the second slot of a long or double is not
+ * counted.  The structure grows at its end with the interface's
+ * version.
+ */
+struct jcf_parse_stats {
+	uint64_t	files;
+	uint64_t	failed;
+	uint64_t	nsec[JCF_PARSE_PHASES];		// monotonic time
+	uint64_t	bytes[JCF_PARSE_PHASES];	// of the class files
+	uint64_t	cycles[JCF_PARSE_PHASES];
+	uint64_t	constants[JCF_PARSE_TAGS];
+};
+
+struct jcf_parser;
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Returns JCF_PARSE_VERSION as the library was built, so that a caller
+ *   of the shared library can check that it is recent enough.
+ */
+int	jcf_parse_version(void);
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Returns a new parser, or NULL if memory could not be allocated.
+ */
+struct jcf_parser *jcf_parser_create(void);
+
+/*
+ * Requires:
+ *   "parser" must have been returned by jcf_parser_create() and must not
+ *   be parsing.
+ *
+ * Effects:
+ *   Frees the parser.
+ */
+void	jcf_parser_destroy(struct jcf_parser *parser);
+
+/*
+ * Requires:
+ *   "parser" must have been returned by jcf_parser_create() and must not
+ *   be parsing.  "stats" must be NULL or stay valid while it is used.
+ *
+ * Effects:
+ *   Makes the parser add the statistics of every class file that it
+ *   parses from now on to "stats", or stop keeping statistics if
+ *   "stats" is NULL.  Keeping them costs a few readings of the clock per
+ *   class file and a pass over the tags of its constant pool, and
+ *   nothing when they are not kept.
+ */
+void	jcf_parser_stats(struct jcf_parser *parser,
+	    struct jcf_parse_stats *stats);
+
+/*
+ * Requires:
+ *   "parser" must have been returned by jcf_parser_create() and must not
+ *   be parsing.
+ *
+ * Effects:
+ *   Makes the parser check, if "strict" is true, that every UTF8
+ *   constant is valid Modified UTF-8, and fail to parse a class file
+ *   that has one that is not.  Runs of ASCII are checked many bytes at
+ *   a time with the widest vector instructions that the processor has.
+ *   A parser is not strict until it is made so.
+ */
+void	jcf_parser_strict(struct jcf_parser *parser, bool strict);
+
+/*
+ * Requires:
+ *   "parser" must have been returned by jcf_parser_create() and must not
+ *   be used by another thread at the same time.  "buf" must point to
+ *   "len" bytes, which must not change while they are parsed.
+ *
+ * Effects:
+ *   Parses the class file in "buf", calling "callback" with "arg" for
+ *   each event of a kind in the set "events".  Only the parts of the
+ *   class file that those events need are decoded, so a class file
+ *   that is malformed in a part that is not needed may be accepted.
+ *   Returns 0 on success and -1 if the class file is malformed or
+ *   memory could not be allocated.  If the callback returns a value
+ *   other than 0, parsing stops and that value is returned.  Events may
+ *   have been reported before a failure is found.
+ */
+int	jcf_parse(struct jcf_parser *parser, const void *buf, size_t len,
+	    unsigned int events, jcf_parse_callback *callback, void *arg);
+
+#endif /* JCF_PARSE_H */
@@ -0,0 +1,620 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * A server that answers line-oriented requests over a Unix domain
+ * socket with an epoll event loop and a pool of worker threads.
+ */
+
+// Declare accept4(), which sets up accepted sockets in one call.
+#define _GNU_SOURCE
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "jcf_serve.h"
+
+// Define the number of events that are taken from epoll at once.
+#define JCF_SERVE_EVENTS	64
+
+// Define the size in which a connection's input buffer grows.
+#define JCF_SERVE_CHUNK		4096
+
+/*
+ * Define a connection.  While "busy", a worker owns the request at the
+ * start of "in", and the event loop neither reads more input nor frees
+ * the connection.  A reply is sent as "reply" and then "status".  Once
+ * "closed", the connection is only kept until the events that epoll
+ * returned with it have been skipped.
+ */
+struct jcf_serve_conn {
+	int		fd;
+	char		*in;		// received bytes that are not answered
+	size_t		in_len;
+	size_t		in_size;
+	size_t		request_len;	// of the request being handled
+	char		*reply;		// the reply being sent, or NULL
+	size_t		reply_len;
+	const char	*status;	// the status line being sent, or NULL
+	size_t		sent;		// bytes of "reply" and "status" sent
+	int		result;		// of the handler
+	bool		busy;
+	bool		eof;		// the client sends no more requests
+	bool		gone;		// the client cannot be written to
+	bool		closed;		// on the closed list, not to be used
+	struct jcf_serve_conn *next;	// in the queue, done or closed list
+	struct jcf_serve_conn *all_prev; // in the list of connections
+	struct jcf_serve_conn *all_next;
+};
+
+struct jcf_server;
+
+// Define a worker thread.
+struct jcf_serve_worker {
+	pthread_t	thread;
+	struct jcf_server *server;
+	int		index;
+};
+
+// Define a server.
+struct jcf_server {
+	jcf_serve_handler *handler;
+	void		*arg;
+	int		epfd;
+	int		listenfd;
+	int		sigfd;		// SIGINT and SIGTERM
+	int		donefd;		// an eventfd that signals replies
+	pthread_mutex_t	lock;		// protects the queue and done list
+	pthread_cond_t	work;		// signaled when a request is queued
+	struct jcf_serve_conn *queue;	// requests waiting for a worker
+	struct jcf_serve_conn *queue_tail;
+	struct jcf_serve_conn *done;	// replies waiting to be sent
+	bool		stopping;	// whether the workers should exit
+	struct jcf_serve_conn *stopper;	// whose reply stops the server
+	bool		stopped;	// whether the event loop should exit
+	struct jcf_serve_conn *conns;	// every open connection
+	struct jcf_serve_conn *closed;	// closed connections to be freed
+};
+
+static int	jcf_serve_listen(const char *path);
+static void	*jcf_serve_worker_main(void *arg);
+static int	jcf_serve_watch(struct jcf_server *server, int op,
+		    struct jcf_serve_conn *conn, uint32_t events);
+static void	jcf_serve_accept(struct jcf_server *server);
+static void	jcf_serve_close(struct jcf_server *server,
+		    struct jcf_serve_conn *conn);
+static void	jcf_serve_free(struct jcf_server *server);
+static void	jcf_serve_read(struct jcf_server *server,
+		    struct jcf_serve_conn *conn);
+static void	jcf_serve_write(struct jcf_server *server,
+		    struct jcf_serve_conn *conn);
+static void	jcf_serve_next(struct jcf_server *server,
+		    struct jcf_serve_conn *conn);
+static void	jcf_serve_replies(struct jcf_server *server);
+
+/*
+ * Requires:
+ *   "path" must be a NUL-terminated path.
+ *
+ * Effects:
+ *   Returns a nonblocking socket that listens at "path", or -1 on
+ *   failure.  A socket that is left at "path" by a server that is gone
+ *   is replaced, but one that a running server is listening on is not.
+ */
+static int
+jcf_serve_listen(const char *path)
+{
+	struct sockaddr_un addr;
+	struct stat sb;
+	int fd, probe;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return (-1);
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	// Remove a stale socket, which no one answers on.
+	if (lstat(path, &sb) == 0 && S_ISSOCK(sb.st_mode)) {
+		probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (probe < 0)
+			return (-1);
+		if (connect(probe, (struct sockaddr *)&addr,
+		    sizeof(addr)) == 0) {
+			close(probe);
+			return (-1);
+		}
+		close(probe);
+		unlink(path);
+	}
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return (-1);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+	    listen(fd, SOMAXCONN) != 0) {
+		close(fd);
+		return (-1);
+	}
+	return (fd);
+}
+
+/*
+ * Requires:
+ *   "arg" must point to a worker of a running server.
+ *
+ * Effects:
+ *   Handles queued requests until the server stops.  Each reply is put
+ *   on the done list, and the event loop is woken to send it.
+ */
+static void *
+jcf_serve_worker_main(void *arg)
+{
+	struct jcf_serve_worker *worker = arg;
+	struct jcf_server *server = worker->server;
+	struct jcf_serve_conn *conn;
+	uint64_t one = 1;
+	ssize_t n;
+
+	for (;;) {
+		pthread_mutex_lock(&server->lock);
+		while (server->queue == NULL && !server->stopping)
+			pthread_cond_wait(&server->work, &server->lock);
+		if (server->stopping) {
+			pthread_mutex_unlock(&server->lock);
+			return (NULL);
+		}
+		conn = server->queue;
+		server->queue = conn->next;
+		pthread_mutex_unlock(&server->lock);
+
+		conn->reply = NULL;
+		conn->reply_len = 0;
+		conn->result = server->handler(server->arg, worker->index,
+		    conn->in, conn->request_len, &conn->reply,
+		    &conn->reply_len);
+
+		pthread_mutex_lock(&server->lock);
+		conn->next = server->done;
+		server->done = conn;
+		pthread_mutex_unlock(&server->lock);
+		do
+			n = write(server->donefd, &one, sizeof(one));
+		while (n < 0 && errno == EINTR);
+	}
+}
+
+/*
+ * Requires:
+ *   "conn" must be an open connection of "server".
+ *
+ * Effects:
+ *   Adds, modifies or, with EPOLL_CTL_DEL, removes the connection's
+ *   interest in "events".  Returns 0 on success and -1 on failure.
+ */
+static int
+jcf_serve_watch(struct jcf_server *server, int op,
+    struct jcf_serve_conn *conn, uint32_t events)
+{
+	struct epoll_event ev;
+
+	ev.events = events;
+	ev.data.ptr = conn;
+	return (epoll_ctl(server->epfd, op, conn->fd, &ev));
+}
+
+/*
+ * Requires:
+ *   "server" must be running.
+ *
+ * Effects:
+ *   Accepts every pending connection and starts reading its requests.
+ *   A connection that cannot be set up is closed.
+ */
+static void
+jcf_serve_accept(struct jcf_server *server)
+{
+	struct jcf_serve_conn *conn;
+	int fd;
+
+	while ((fd = accept4(server->listenfd, NULL, NULL,
+	    SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+		conn = calloc(1, sizeof(*conn));
+		if (conn == NULL) {
+			close(fd);
+			continue;
+		}
+		conn->fd = fd;
+		if (jcf_serve_watch(server, EPOLL_CTL_ADD, conn,
+		    EPOLLIN) != 0) {
+			close(fd);
+			free(conn);
+			continue;
+		}
+		conn->all_next = server->conns;
+		if (server->conns != NULL)
+			server->conns->all_prev = conn;
+		server->conns = conn;
+	}
+}
+
+/*
+ * Requires:
+ *   "conn" must be an open connection of "server" that is not busy.
+ *
+ * Effects:
+ *   Closes the connection and puts it on the closed list, to be freed by
+ *   jcf_serve_free() once no event that epoll returned can name it.
+ */
+static void
+jcf_serve_close(struct jcf_server *server, struct jcf_serve_conn *conn)
+{
+	assert(!conn->busy);
+
+	if (server->stopper == conn)
+		server->stopped = true;
+	if (conn->all_prev != NULL)
+		conn->all_prev->all_next = conn->all_next;
+	else
+		server->conns = conn->all_next;
+	if (conn->all_next != NULL)
+		conn->all_next->all_prev = conn->all_prev;
+	close(conn->fd);
+	conn->closed = true;
+	conn->next = server->closed;
+	server->closed = conn;
+}
+
+/*
+ * Requires:
+ *   "server" must hold no event that names a closed connection.
+ *
+ * Effects:
+ *   Frees the connections on the closed list.
+ */
+static void
+jcf_serve_free(struct jcf_server *server)
+{
+	struct jcf_serve_conn *conn;
+
+	while ((conn = server->closed) != NULL) {
+		server->closed = conn->next;
+		free(conn->in);
+		free(conn->reply);
+		free(conn);
+	}
+}
+
+/*
+ * Requires:
+ *   "conn" must be an open connection of "server" that is idle.
+ *
+ * Effects:
+ *   Reads what the client has sent and starts on the next request.  A
+ *   client that has stopped sending is answered before it is closed.
+ */
+static void
+jcf_serve_read(struct jcf_server *server, struct jcf_serve_conn *conn)
+{
+	char *in;
+	ssize_t n;
+
+	for (;;) {
+		if (conn->in_size - conn->in_len < JCF_SERVE_CHUNK) {
+			in = realloc(conn->in, conn->in_size +
+			    JCF_SERVE_CHUNK);
+			if (in == NULL) {
+				conn->gone = true;
+				break;
+			}
+			conn->in = in;
+			conn->in_size += JCF_SERVE_CHUNK;
+		}
+		n = read(conn->fd, conn->in + conn->in_len,
+		    conn->in_size - conn->in_len);
+		if (n > 0) {
+			conn->in_len += n;
+
+			// Stop at a request, so that input is read as needed.
+			if (memchr(conn->in + conn->in_len - n, '\n', n) !=
+			    NULL)
+				break;
+			if (conn->in_len >= JCF_SERVE_MAX_REQUEST) {
+				conn->gone = true;
+				break;
+			}
+			continue;
+		}
+		if (n == 0)
+			conn->eof = true;
+		else if (errno == EINTR)
+			continue;
+		else if (errno != EAGAIN && errno != EWOULDBLOCK)
+			conn->gone = true;
+		break;
+	}
+	jcf_serve_next(server, conn);
+}
+
+/*
+ * Requires:
+ *   "conn" must be an open connection of "server" with a reply to send.
+ *
+ * Effects:
+ *   Sends as much of the reply and its status line as the socket takes
+ *   without blocking.  Once they are sent, starts on the next request.
+ */
+static void
+jcf_serve_write(struct jcf_server *server, struct jcf_serve_conn *conn)
+{
+	size_t status_len = strlen(conn->status);
+	ssize_t n;
+
+	while (conn->sent < conn->reply_len + status_len) {
+		if (conn->sent < conn->reply_len)
+			n = send(conn->fd, conn->reply + conn->sent,
+			    conn->reply_len - conn->sent, MSG_NOSIGNAL);
+		else
+			n = send(conn->fd, conn->status + conn->sent -
+			    conn->reply_len, conn->reply_len + status_len -
+			    conn->sent, MSG_NOSIGNAL);
+		if (n >= 0)
+			conn->sent += n;
+		else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			if (jcf_serve_watch(server, EPOLL_CTL_MOD, conn,
+			    EPOLLOUT) != 0)
+				break;
+			return;
+		} else if (errno != EINTR)
+			break;
+	}
+	if (conn->sent < conn->reply_len + status_len)
+		conn->gone = true;
+
+	// The reply is finished.
+	free(conn->reply);
+	conn->reply = NULL;
+	conn->status = NULL;
+	if (server->stopper == conn)
+		server->stopped = true;
+	jcf_serve_next(server, conn);
+}
+
+/*
+ * Requires:
+ *   "conn" must be an open connection of "server" that is neither busy
+ *   nor sending a reply.
+ *
+ * Effects:
+ *   Queues the next request that the connection has received for a
+ *   worker.  If there is none, waits for more input, or closes the
+ *   connection if none can come.
+ */
+static void
+jcf_serve_next(struct jcf_server *server, struct jcf_serve_conn *conn)
+{
+	char *newline;
+
+	newline = conn->gone ? NULL : memchr(conn->in, '\n', conn->in_len);
+	if (newline == NULL) {
+		if (conn->gone || conn->eof || conn->in_len >=
+		    JCF_SERVE_MAX_REQUEST || jcf_serve_watch(server,
+		    EPOLL_CTL_MOD, conn, EPOLLIN) != 0)
+			jcf_serve_close(server, conn);
+		return;
+	}
+
+	// Hand the request over without its newline, and stop reading.
+	if (jcf_serve_watch(server, EPOLL_CTL_MOD, conn, 0) != 0) {
+		jcf_serve_close(server, conn);
+		return;
+	}
+	conn->request_len = newline - conn->in;
+	if (conn->request_len > 0 && conn->in[conn->request_len - 1] == '\r')
+		conn->request_len--;
+	conn->busy = true;
+	conn->next = NULL;
+	pthread_mutex_lock(&server->lock);
+	if (server->queue == NULL)
+		server->queue = conn;
+	else
+		server->queue_tail->next = conn;
+	server->queue_tail = conn;
+	pthread_cond_signal(&server->work);
+	pthread_mutex_unlock(&server->lock);
+}
+
+/*
+ * Requires:
+ *   "server" must be running.
+ *
+ * Effects:
+ *   Takes the replies that the workers have finished and starts sending
+ *   each of them, after removing its request from the connection's
+ *   input.
+ */
+static void
+jcf_serve_replies(struct jcf_server *server)
+{
+	struct jcf_serve_conn *conn, *next;
+	char *newline;
+	uint64_t count;
+
+	if (read(server->donefd, &count, sizeof(count)) < 0)
+		return;
+	pthread_mutex_lock(&server->lock);
+	conn = server->done;
+	server->done = NULL;
+	pthread_mutex_unlock(&server->lock);
+
+	for (; conn != NULL; conn = next) {
+		next = conn->next;
+		conn->busy = false;
+		newline = memchr(conn->in, '\n', conn->in_len);
+		conn->in_len -= newline + 1 - conn->in;
+		memmove(conn->in, newline + 1, conn->in_len);
+		if (conn->result == 1 && server->stopper == NULL)
+			server->stopper = conn;
+		if (conn->gone) {
+			jcf_serve_close(server, conn);
+			continue;
+		}
+		conn->status = conn->result >= 0 ? "OK\n" : "ERROR\n";
+		conn->sent = 0;
+		jcf_serve_write(server, conn);
+	}
+}
+
+int
+jcf_serve(const char *path, int nworkers, jcf_serve_handler *handler,
+    void *arg)
+{
+	struct jcf_server server;
+	struct jcf_serve_worker *workers;
+	struct jcf_serve_conn *conn;
+	struct epoll_event events[JCF_SERVE_EVENTS], ev;
+	sigset_t signals, blocked;
+	int err = -1, i, n, started = 0;
+
+	assert(nworkers >= 1);
+
+	memset(&server, 0, sizeof(server));
+	server.handler = handler;
+	server.arg = arg;
+	server.epfd = server.sigfd = server.donefd = -1;
+	pthread_mutex_init(&server.lock, NULL);
+	pthread_cond_init(&server.work, NULL);
+
+	/*
+	 * Block the signals that stop the server before the workers are
+	 * created, so that they are only received through "sigfd".
+	 */
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signals, &blocked);
+
+	server.listenfd = jcf_serve_listen(path);
+	if (server.listenfd < 0) {
+		pthread_sigmask(SIG_SETMASK, &blocked, NULL);
+		pthread_cond_destroy(&server.work);
+		pthread_mutex_destroy(&server.lock);
+		return (-1);
+	}
+	workers = calloc(nworkers, sizeof(*workers));
+	server.epfd = epoll_create1(EPOLL_CLOEXEC);
+	server.sigfd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+	server.donefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (workers == NULL || server.epfd < 0 || server.sigfd < 0 ||
+	    server.donefd < 0)
+		goto done;
+
+	// Watch the listener, the signals and the replies.
+	ev.events = EPOLLIN;
+	ev.data.ptr = &server.listenfd;
+	if (epoll_ctl(server.epfd, EPOLL_CTL_ADD, server.listenfd, &ev) != 0)
+		goto done;
+	ev.data.ptr = &server.sigfd;
+	if (epoll_ctl(server.epfd, EPOLL_CTL_ADD, server.sigfd, &ev) != 0)
+		goto done;
+	ev.data.ptr = &server.donefd;
+	if (epoll_ctl(server.epfd, EPOLL_CTL_ADD, server.donefd, &ev) != 0)
+		goto done;
+
+	// Start the workers.
+	for (started = 0; started < nworkers; started++) {
+		workers[started].server = &server;
+		workers[started].index = started;
+		if (pthread_create(&workers[started].thread, NULL,
+		    jcf_serve_worker_main, &workers[started]) != 0)
+			break;
+	}
+	if (started == 0)
+		goto done;
+
+	// Run the event loop.
+	while (!server.stopped) {
+		n = epoll_wait(server.epfd, events, JCF_SERVE_EVENTS, -1);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			goto done;
+		for (i = 0; i < n && !server.stopped; i++) {
+			if (events[i].data.ptr == &server.listenfd)
+				jcf_serve_accept(&server);
+			else if (events[i].data.ptr == &server.sigfd)
+				server.stopped = true;
+			else if (events[i].data.ptr == &server.donefd)
+				jcf_serve_replies(&server);
+			else {
+				conn = events[i].data.ptr;
+
+				// The connection was closed in this batch.
+				if (conn->closed)
+					continue;
+				if (conn->busy) {
+					/*
+					 * The client hung up.  Stop watching
+					 * it until its request is finished.
+					 */
+					conn->gone = true;
+					epoll_ctl(server.epfd, EPOLL_CTL_DEL,
+					    conn->fd, NULL);
+					continue;
+				}
+				if (conn->reply != NULL || conn->status != NULL)
+					jcf_serve_write(&server, conn);
+				else if ((events[i].events & EPOLLIN) != 0)
+					jcf_serve_read(&server, conn);
+				else {
+					// The client hung up.
+					conn->gone = true;
+					jcf_serve_next(&server, conn);
+				}
+			}
+		}
+		jcf_serve_free(&server);
+	}
+	err = 0;
+
+done:
+	// Stop the workers, which finish the requests that they hold.
+	pthread_mutex_lock(&server.lock);
+	server.stopping = true;
+	pthread_cond_broadcast(&server.work);
+	pthread_mutex_unlock(&server.lock);
+	for (i = 0; i < started; i++)
+		pthread_join(workers[i].thread, NULL);
+	while (server.conns != NULL) {
+		server.conns->busy = false;
+		jcf_serve_close(&server, server.conns);
+	}
+	jcf_serve_free(&server);
+
+	unlink(path);
+	close(server.listenfd);
+	if (server.epfd >= 0)
+		close(server.epfd);
+	if (server.sigfd >= 0)
+		close(server.sigfd);
+	if (server.donefd >= 0)
+		close(server.donefd);
+	free(workers);
+	pthread_sigmask(SIG_SETMASK, &blocked, NULL);
+	pthread_cond_destroy(&server.work);
+	pthread_mutex_destroy(&server.lock);
+	return (err);
+}
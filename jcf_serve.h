@@ -0,0 +1,50 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * A server that answers requests over a Unix domain socket.  A request
+ * is one line of text, and its reply is the handler's output followed
+ * by a line that is either "OK" or "ERROR".  A client may send several
+ * requests on one connection; they are answered in order.
+ *
+ * One thread runs an epoll event loop that accepts connections, reads
+ * requests and writes replies without blocking.  Requests are handled
+ * by a pool of worker threads, which hand their replies back to the
+ * event loop through an eventfd, so a slow request never holds up the
+ * other connections.  The server stops on SIGINT or SIGTERM, or when a
+ * handler asks it to.
+ */
+
+#ifndef JCF_SERVE_H
+#define JCF_SERVE_H
+
+#include <stddef.h>
+
+// Define the longest request that is accepted, including its newline.
+#define JCF_SERVE_MAX_REQUEST	(1024 * 1024)
+
+/*
+ * Define a handler of requests, which runs on worker thread "worker".
+ * It stores in "*replyp" a reply of "*lengthp" bytes, which the server
+ * frees, or NULL for an empty reply.  It returns 0 on success, -1 on
+ * failure, or 1 to succeed and then stop the server.
+ */
+typedef int	jcf_serve_handler(void *arg, int worker, const char *request,
+		    size_t length, char **replyp, size_t *lengthp);
+
+/*
+ * Requires:
+ *   "path" must be a NUL-terminated path that fits in a Unix domain
+ *   socket address.  "nworkers" must be at least one.
+ *
+ * Effects:
+ *   Listens on a socket at "path", replacing a stale socket that is
+ *   there, and answers requests with "handler", called with "arg", on
+ *   "nworkers" threads until the server is stopped.  Each worker only
+ *   handles one request at a time.  Removes the socket before returning.
+ *   Returns 0 if the server stopped as asked and -1 if it could not be
+ *   started or failed.
+ */
+int	jcf_serve(const char *path, int nworkers, jcf_serve_handler *handler,
+	    void *arg);
+
+#endif /* JCF_SERVE_H */
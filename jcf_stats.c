@@ -0,0 +1,608 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * Statistics of a scan, and the wrappers of the allocator that count
+ * the program's allocations.
+ */
+
+#include <sys/time.h>
+
+#include <inttypes.h>
+#include <malloc.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "jcf_stats.h"
+
+// Define the names of the phases, and of the time outside the parse.
+static const char *const jcf_stats_phases[JCF_PARSE_PHASES] = {
+	[JCF_PARSE_PHASE_HEADER] = "header",
+	[JCF_PARSE_PHASE_CONSTANT_POOL] = "constant_pool",
+	[JCF_PARSE_PHASE_FIELDS] = "fields",
+	[JCF_PARSE_PHASE_METHODS] = "methods",
+	[JCF_PARSE_PHASE_ATTRIBUTES] = "attributes"
+};
+#define JCF_STATS_OTHER		"read"
+
+// Define the names of the constant tags.  Unused tags have none.
+static const char *const jcf_stats_tags[JCF_PARSE_TAGS] = {
+	[1] = "Utf8",
+	[3] = "Integer",
+	[4] = "Float",
+	[5] = "Long",
+	[6] = "Double",
+	[7] = "Class",
+	[8] = "String",
+	[9] = "Fieldref",
+	[10] = "Methodref",
+	[11] = "InterfaceMethodref",
+	[12] = "NameAndType",
+	[15] = "MethodHandle",
+	[16] = "MethodType",
+	[17] = "Dynamic",
+	[18] = "InvokeDynamic",
+	[19] = "Module",
+	[20] = "Package"
+};
+
+// Define the counters of the allocations.
+static atomic_bool jcf_stats_counting;
+static atomic_uint_fast64_t jcf_stats_count;
+static atomic_int_fast64_t jcf_stats_live;	// bytes
+static atomic_int_fast64_t jcf_stats_peak;
+
+void		*__real_malloc(size_t size);
+void		*__real_calloc(size_t count, size_t size);
+void		*__real_realloc(void *ptr, size_t size);
+char		*__real_strdup(const char *s);
+void		__real_free(void *ptr);
+void		*__wrap_malloc(size_t size);
+void		*__wrap_calloc(size_t count, size_t size);
+void		*__wrap_realloc(void *ptr, size_t size);
+char		*__wrap_strdup(const char *s);
+void		__wrap_free(void *ptr);
+
+static void	jcf_stats_allocated(void *ptr, int64_t freed);
+static uint64_t	jcf_stats_cycles(void);
+static void	jcf_stats_add_parse(struct jcf_parse_stats *to,
+		    const struct jcf_parse_stats *from);
+static void	jcf_stats_add_slowest(struct jcf_stats *stats,
+		    const struct jcf_stats_file *file);
+static uint64_t	jcf_stats_parse_nsec(
+		    const struct jcf_parse_stats *parse);
+static uint64_t	jcf_stats_parse_cycles(
+		    const struct jcf_parse_stats *parse);
+static uint64_t	jcf_stats_parse_bytes(
+		    const struct jcf_parse_stats *parse);
+static uint64_t	jcf_stats_constants(const struct jcf_parse_stats *parse);
+static int	jcf_stats_phase(const struct jcf_stats_file *file);
+static void	jcf_stats_json_string(FILE *fp, const char *s);
+static void	jcf_stats_json_phases(FILE *fp, uint64_t nsec,
+		    uint64_t cycles, const struct jcf_parse_stats *parse);
+
+/*
+ * Requires:
+ *   Allocations must be counted.  "ptr" must be a block that was just
+ *   allocated, or NULL if none was.
+ *
+ * Effects:
+ *   Counts the allocation of "ptr", if there was one, in place of the
+ *   "freed" bytes of the block that it replaced, and raises the peak if
+ *   the bytes that are allocated pass it.
+ */
+static void
+jcf_stats_allocated(void *ptr, int64_t freed)
+{
+	int64_t change, live, peak;
+
+	if (ptr == NULL)
+		return;
+	atomic_fetch_add_explicit(&jcf_stats_count, 1, memory_order_relaxed);
+	change = (int64_t)malloc_usable_size(ptr) - freed;
+	live = atomic_fetch_add_explicit(&jcf_stats_live, change,
+	    memory_order_relaxed) + change;
+	peak = atomic_load_explicit(&jcf_stats_peak, memory_order_relaxed);
+	while (live > peak && !atomic_compare_exchange_weak_explicit(
+	    &jcf_stats_peak, &peak, live, memory_order_relaxed,
+	    memory_order_relaxed))
+		;
+}
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Allocates "size" bytes with the real malloc(), counting the block if
+ *   allocations are counted.
+ */
+void *
+__wrap_malloc(size_t size)
+{
+	void *ptr = __real_malloc(size);
+
+	if (atomic_load_explicit(&jcf_stats_counting, memory_order_relaxed))
+		jcf_stats_allocated(ptr, 0);
+	return (ptr);
+}
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Allocates with the real calloc(), like __wrap_malloc().
+ */
+void *
+__wrap_calloc(size_t count, size_t size)
+{
+	void *ptr = __real_calloc(count, size);
+
+	if (atomic_load_explicit(&jcf_stats_counting, memory_order_relaxed))
+		jcf_stats_allocated(ptr, 0);
+	return (ptr);
+}
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Reallocates with the real realloc(), counting the new block in
+ *   place of the old one if allocations are counted.
+ */
+void *
+__wrap_realloc(void *ptr, size_t size)
+{
+	int64_t freed;
+
+	if (!atomic_load_explicit(&jcf_stats_counting, memory_order_relaxed))
+		return (__real_realloc(ptr, size));
+	freed = ptr != NULL ? (int64_t)malloc_usable_size(ptr) : 0;
+	ptr = __real_realloc(ptr, size);
+
+	// A failed reallocation leaves the old block as it was.
+	jcf_stats_allocated(ptr, freed);
+	return (ptr);
+}
+
+/*
+ * Requires:
+ *   "s" must be a string.
+ *
+ * Effects:
+ *   Copies "s" with the real strdup(), like __wrap_malloc().  The real
+ *   strdup() allocates inside the C library, where malloc() is not
+ *   wrapped.
+ */
+char *
+__wrap_strdup(const char *s)
+{
+	char *ptr = __real_strdup(s);
+
+	if (atomic_load_explicit(&jcf_stats_counting, memory_order_relaxed))
+		jcf_stats_allocated(ptr, 0);
+	return (ptr);
+}
+
+/*
+ * Requires:
+ *   "ptr" must be NULL or a block from the allocator.
+ *
+ * Effects:
+ *   Frees "ptr" with the real free(), no longer counting its bytes if
+ *   allocations are counted.
+ */
+void
+__wrap_free(void *ptr)
+{
+	if (ptr != NULL && atomic_load_explicit(&jcf_stats_counting,
+	    memory_order_relaxed)) {
+		atomic_fetch_sub_explicit(&jcf_stats_live,
+		    (int64_t)malloc_usable_size(ptr), memory_order_relaxed);
+	}
+	__real_free(ptr);
+}
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Returns the processor's time-stamp counter, or zero if it has none.
+ */
+static uint64_t
+jcf_stats_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return (__rdtsc());
+#else
+	return (0);
+#endif
+}
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Adds the parse statistics "from" to "to".
+ */
+static void
+jcf_stats_add_parse(struct jcf_parse_stats *to,
+    const struct jcf_parse_stats *from)
+{
+	int i;
+
+	to->files += from->files;
+	to->failed += from->failed;
+	for (i = 0; i < JCF_PARSE_PHASES; i++) {
+		to->nsec[i] += from->nsec[i];
+		to->bytes[i] += from->bytes[i];
+		to->cycles[i] += from->cycles[i];
+	}
+	for (i = 0; i < JCF_PARSE_TAGS; i++)
+		to->constants[i] += from->constants[i];
+}
+
+/*
+ * Requires:
+ *   "stats" must have been initialized by jcf_stats_init().
+ *
+ * Effects:
+ *   Adds "file" to the slowest files of "stats" if it is slower than one
+ *   of them or there is room, dropping the fastest if there is not.
+ */
+static void
+jcf_stats_add_slowest(struct jcf_stats *stats,
+    const struct jcf_stats_file *file)
+{
+	int i;
+
+	if (stats->nslowest == JCF_STATS_SLOWEST &&
+	    file->nsec <= stats->slowest[JCF_STATS_SLOWEST - 1].nsec)
+		return;
+	if (stats->nslowest < JCF_STATS_SLOWEST)
+		stats->nslowest++;
+	for (i = stats->nslowest - 1; i > 0 &&
+	    stats->slowest[i - 1].nsec < file->nsec; i--)
+		stats->slowest[i] = stats->slowest[i - 1];
+	stats->slowest[i] = *file;
+}
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Returns the time of every phase of "parse".
+ */
+static uint64_t
+jcf_stats_parse_nsec(const struct jcf_parse_stats *parse)
+{
+	uint64_t nsec = 0;
+	int i;
+
+	for (i = 0; i < JCF_PARSE_PHASES; i++)
+		nsec += parse->nsec[i];
+	return (nsec);
+}
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Returns the cycles of every phase of "parse".
+ */
+static uint64_t
+jcf_stats_parse_cycles(const struct jcf_parse_stats *parse)
+{
+	uint64_t cycles = 0;
+	int i;
+
+	for (i = 0; i < JCF_PARSE_PHASES; i++)
+		cycles += parse->cycles[i];
+	return (cycles);
+}
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Returns the bytes of every phase of "parse".
+ */
+static uint64_t
+jcf_stats_parse_bytes(const struct jcf_parse_stats *parse)
+{
+	uint64_t bytes = 0;
+	int i;
+
+	for (i = 0; i < JCF_PARSE_PHASES; i++)
+		bytes += parse->bytes[i];
+	return (bytes);
+}
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Returns the number of constants of "parse".
+ */
+static uint64_t
+jcf_stats_constants(const struct jcf_parse_stats *parse)
+{
+	uint64_t count = 0;
+	int i;
+
+	for (i = 0; i < JCF_PARSE_TAGS; i++)
+		count += parse->constants[i];
+	return (count);
+}
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Returns the phase of the parse of "file" that took the longest, or
+ *   JCF_PARSE_PHASES if the time outside the parse was longer.
+ */
+static int
+jcf_stats_phase(const struct jcf_stats_file *file)
+{
+	uint64_t longest;
+	int i, phase = JCF_PARSE_PHASES;
+
+	longest = file->nsec - jcf_stats_parse_nsec(&file->parse);
+	for (i = 0; i < JCF_PARSE_PHASES; i++) {
+		if (file->parse.nsec[i] > longest) {
+			longest = file->parse.nsec[i];
+			phase = i;
+		}
+	}
+	return (phase);
+}
+
+/*
+ * Requires:
+ *   "s" must be a string.
+ *
+ * Effects:
+ *   Prints "s" to "fp" as a JSON string.
+ */
+static void
+jcf_stats_json_string(FILE *fp, const char *s)
+{
+	unsigned char c;
+
+	putc('"', fp);
+	for (; (c = *s) != '\0'; s++) {
+		if (c == '"' || c == '\\')
+			fprintf(fp, "\\%c", c);
+		else if (c < 0x20)
+			fprintf(fp, "\\u%04x", c);
+		else
+			putc(c, fp);
+	}
+	putc('"', fp);
+}
+
+/*
+ * Requires:
+ *   "nsec" and "cycles" must include those of "parse".
+ *
+ * Effects:
+ *   Prints a JSON object of the time, cycles and bytes of each phase of
+ *   "parse", and of the time outside them, to "fp".
+ */
+static void
+jcf_stats_json_phases(FILE *fp, uint64_t nsec, uint64_t cycles,
+    const struct jcf_parse_stats *parse)
+{
+	int i;
+
+	fprintf(fp, "{\"%s\":{\"nsec\":%" PRIu64 ",\"cycles\":%" PRIu64 "}",
+	    JCF_STATS_OTHER, nsec - jcf_stats_parse_nsec(parse),
+	    cycles - jcf_stats_parse_cycles(parse));
+	for (i = 0; i < JCF_PARSE_PHASES; i++) {
+		fprintf(fp, ",\"%s\":{\"nsec\":%" PRIu64 ",\"cycles\":%"
+		    PRIu64 ",\"bytes\":%" PRIu64 "}", jcf_stats_phases[i],
+		    parse->nsec[i], parse->cycles[i], parse->bytes[i]);
+	}
+	putc('}', fp);
+}
+
+void
+jcf_stats_init(struct jcf_stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+}
+
+void
+jcf_stats_begin(struct jcf_stats *stats, const char *path)
+{
+	memset(&stats->file, 0, sizeof(stats->file));
+	stats->file.path = path;
+	clock_gettime(CLOCK_MONOTONIC, &stats->start);
+	stats->start_cycles = jcf_stats_cycles();
+}
+
+void
+jcf_stats_end(struct jcf_stats *stats, int err)
+{
+	struct jcf_stats_file *file = &stats->file;
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	file->cycles = jcf_stats_cycles() - stats->start_cycles;
+	file->nsec = (uint64_t)(now.tv_sec - stats->start.tv_sec) *
+	    1000000000 + now.tv_nsec - stats->start.tv_nsec;
+	file->failed = err != 0;
+	file->cached = file->parse.files == 0 && !file->failed;
+
+	stats->files++;
+	stats->failed += file->failed;
+	stats->cached += file->cached;
+	stats->nsec += file->nsec;
+	stats->cycles += file->cycles;
+	stats->output += file->output;
+	jcf_stats_add_parse(&stats->parse, &file->parse);
+	jcf_stats_add_slowest(stats, file);
+}
+
+void
+jcf_stats_merge(struct jcf_stats *to, const struct jcf_stats *from)
+{
+	int i;
+
+	to->files += from->files;
+	to->failed += from->failed;
+	to->cached += from->cached;
+	to->nsec += from->nsec;
+	to->cycles += from->cycles;
+	to->output += from->output;
+	jcf_stats_add_parse(&to->parse, &from->parse);
+	for (i = 0; i < from->nslowest; i++)
+		jcf_stats_add_slowest(to, &from->slowest[i]);
+}
+
+void
+jcf_stats_count_allocations(void)
+{
+	atomic_store(&jcf_stats_counting, true);
+}
+
+void
+jcf_stats_allocations(struct jcf_stats_allocations *allocations)
+{
+	allocations->count = atomic_load(&jcf_stats_count);
+	allocations->peak = atomic_load(&jcf_stats_peak);
+}
+
+void
+jcf_stats_print(FILE *fp, const char *program, const struct jcf_stats *stats,
+    const struct jcf_stats_allocations *allocations, uint64_t nsec)
+{
+	const struct jcf_stats_file *file;
+	uint64_t files, phase_nsec;
+	double total;
+	int i, phase;
+
+	files = stats->files > 0 ? stats->files : 1;
+	total = stats->nsec > 0 ? stats->nsec : 1;
+	fprintf(fp, "%s: stats: %" PRIu64 " files, %" PRIu64 " failed, %"
+	    PRIu64 " from the cache, in %.3f s (%.0f files/s)\n", program,
+	    stats->files, stats->failed, stats->cached, nsec / 1e9,
+	    nsec > 0 ? stats->files * 1e9 / nsec : 0.0);
+	fprintf(fp, "%s: stats: %-14s %12s %7s %14s %12s\n", program,
+	    "phase", "nsec/file", "share", "cycles/file", "bytes/file");
+	for (i = -1; i < JCF_PARSE_PHASES; i++) {
+		if (i < 0) {
+			phase_nsec = stats->nsec -
+			    jcf_stats_parse_nsec(&stats->parse);
+			fprintf(fp, "%s: stats: %-14s %12.0f %6.1f%% %14.0f "
+			    "%12s\n", program, JCF_STATS_OTHER,
+			    (double)phase_nsec / files,
+			    100.0 * phase_nsec / total, (double)(stats->cycles
+			    - jcf_stats_parse_cycles(&stats->parse)) / files,
+			    "-");
+			continue;
+		}
+		fprintf(fp, "%s: stats: %-14s %12.0f %6.1f%% %14.0f %12.0f\n",
+		    program, jcf_stats_phases[i],
+		    (double)stats->parse.nsec[i] / files,
+		    100.0 * stats->parse.nsec[i] / total,
+		    (double)stats->parse.cycles[i] / files,
+		    (double)stats->parse.bytes[i] / files);
+	}
+	fprintf(fp, "%s: stats: output: %" PRIu64 " bytes (%.0f per file)\n",
+	    program, stats->output, (double)stats->output / files);
+	fprintf(fp, "%s: stats: allocations: %" PRIu64 " (%.1f per file), "
+	    "peak %" PRIu64 " bytes\n", program, allocations->count,
+	    (double)allocations->count / files, allocations->peak);
+	fprintf(fp, "%s: stats: constants: %" PRIu64, program,
+	    jcf_stats_constants(&stats->parse));
+	for (i = 0; i < JCF_PARSE_TAGS; i++) {
+		if (stats->parse.constants[i] != 0)
+			fprintf(fp, ", %s %" PRIu64, jcf_stats_tags[i],
+			    stats->parse.constants[i]);
+	}
+	putc('\n', fp);
+	for (i = 0; i < stats->nslowest; i++) {
+		file = &stats->slowest[i];
+		phase = jcf_stats_phase(file);
+		phase_nsec = phase < JCF_PARSE_PHASES ?
+		    file->parse.nsec[phase] : file->nsec -
+		    jcf_stats_parse_nsec(&file->parse);
+		fprintf(fp, "%s: stats: slowest: %s: %" PRIu64 " nsec, %"
+		    PRIu64 " bytes, %" PRIu64 " constants, %s %.0f%%%s\n",
+		    program, file->path, file->nsec,
+		    jcf_stats_parse_bytes(&file->parse),
+		    jcf_stats_constants(&file->parse),
+		    phase < JCF_PARSE_PHASES ? jcf_stats_phases[phase] :
+		    JCF_STATS_OTHER, file->nsec > 0 ? 100.0 * phase_nsec /
+		    file->nsec : 0.0, file->failed ? ", failed" :
+		    file->cached ? ", cached" : "");
+	}
+}
+
+int
+jcf_stats_write_json(const char *path, const struct jcf_stats *stats,
+    const struct jcf_stats_allocations *allocations, uint64_t nsec,
+    int threads)
+{
+	const struct jcf_stats_file *file;
+	struct timeval tv;
+	FILE *fp;
+	int i, err = 0;
+
+	if ((fp = fopen(path, "a")) == NULL)
+		return (-1);
+	gettimeofday(&tv, NULL);
+	fprintf(fp, "{\"time\":%lld,\"threads\":%d,\"nsec\":%" PRIu64
+	    ",\"files\":%" PRIu64 ",\"failed\":%" PRIu64 ",\"cached\":%"
+	    PRIu64 ",\"file_nsec\":%" PRIu64 ",\"file_cycles\":%" PRIu64
+	    ",\"output_bytes\":%" PRIu64 ",\"allocations\":%" PRIu64
+	    ",\"peak_bytes\":%" PRIu64 ",\"phases\":", (long long)tv.tv_sec,
+	    threads, nsec, stats->files, stats->failed, stats->cached,
+	    stats->nsec, stats->cycles, stats->output, allocations->count,
+	    allocations->peak);
+	jcf_stats_json_phases(fp, stats->nsec, stats->cycles, &stats->parse);
+	fprintf(fp, ",\"constants\":{");
+	for (i = 0; i < JCF_PARSE_TAGS; i++) {
+		if (jcf_stats_tags[i] == NULL)
+			continue;
+		fprintf(fp, "%s\"%s\":%" PRIu64, i > 1 ? "," : "",
+		    jcf_stats_tags[i], stats->parse.constants[i]);
+	}
+	fprintf(fp, "},\"slowest\":[");
+	for (i = 0; i < stats->nslowest; i++) {
+		file = &stats->slowest[i];
+		fprintf(fp, "%s{\"path\":", i > 0 ? "," : "");
+		jcf_stats_json_string(fp, file->path);
+		fprintf(fp, ",\"nsec\":%" PRIu64 ",\"cycles\":%" PRIu64
+		    ",\"bytes\":%" PRIu64 ",\"constants\":%" PRIu64
+		    ",\"output_bytes\":%" PRIu64 ",\"failed\":%s,\"cached\":%s"
+		    ",\"phases\":", file->nsec, file->cycles,
+		    jcf_stats_parse_bytes(&file->parse),
+		    jcf_stats_constants(&file->parse), file->output,
+		    file->failed ? "true" : "false",
+		    file->cached ? "true" : "false");
+		jcf_stats_json_phases(fp, file->nsec, file->cycles,
+		    &file->parse);
+		putc('}', fp);
+	}
+	fprintf(fp, "]}\n");
+	if (ferror(fp))
+		err = -1;
+	if (fclose(fp) != 0)
+		err = -1;
+	return (err);
+}
@@ -0,0 +1,151 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * Statistics of a scan: how long each class file took and where the
+ * time went, what its constant pool held, and how much it printed,
+ * together with the program's allocations.  Each thread keeps its own
+ * statistics, which are merged when the scan ends, so keeping them
+ * takes no locks.  The slowest files are kept with their breakdown, so
+ * that the files that slow a scan down can be found and told apart.
+ *
+ * Allocations are counted by wrapping malloc(), calloc(), realloc(),
+ * strdup() and free() when the program is linked, and only once
+ * counting has been started.  The peak is of the bytes that were
+ * allocated through the wrappers and not yet freed, as the allocator
+ * measures its blocks.
+ */
+
+#ifndef JCF_STATS_H
+#define JCF_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "jcf_parse.h"
+
+// Define the number of the slowest files that are kept.
+#define JCF_STATS_SLOWEST	10
+
+// Define the statistics of one class file.
+struct jcf_stats_file {
+	const char	*path;		// owned by the caller
+	uint64_t	nsec;		// from opening the file to its end
+	uint64_t	cycles;
+	uint64_t	output;		// bytes of its output lines
+	bool		failed;
+	bool		cached;		// whether it was replayed
+	struct jcf_parse_stats parse;	// of its parse, if any
+};
+
+// Define the statistics of the class files that a thread processed.
+struct jcf_stats {
+	uint64_t	files;
+	uint64_t	failed;
+	uint64_t	cached;
+	uint64_t	nsec;		// of every file
+	uint64_t	cycles;
+	uint64_t	output;
+	struct jcf_parse_stats parse;	// of the files that were parsed
+	struct jcf_stats_file file;	// of the file being processed
+	struct timespec	start;		// when that file was started
+	uint64_t	start_cycles;
+	struct jcf_stats_file slowest[JCF_STATS_SLOWEST];
+	int		nslowest;	// in decreasing order of time
+};
+
+// Define the allocations that the program made.
+struct jcf_stats_allocations {
+	uint64_t	count;
+	uint64_t	peak;		// bytes
+};
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Initializes "stats" with no files.
+ */
+void	jcf_stats_init(struct jcf_stats *stats);
+
+/*
+ * Requires:
+ *   "stats" must have been initialized by jcf_stats_init().  "path" must
+ *   stay valid as long as "stats" is used.
+ *
+ * Effects:
+ *   Starts the statistics of the class file "path".  Its parse is kept
+ *   in "stats->file.parse", which should be given to the parser.
+ */
+void	jcf_stats_begin(struct jcf_stats *stats, const char *path);
+
+/*
+ * Requires:
+ *   jcf_stats_begin() must have started a file in "stats".
+ *
+ * Effects:
+ *   Ends the file, which failed if "err" is not 0, and adds its
+ *   statistics to the totals and to the slowest files if it is one.
+ */
+void	jcf_stats_end(struct jcf_stats *stats, int err);
+
+/*
+ * Requires:
+ *   "to" and "from" must have been initialized by jcf_stats_init() and
+ *   have no file started.
+ *
+ * Effects:
+ *   Adds the totals and slowest files of "from" to those of "to".
+ */
+void	jcf_stats_merge(struct jcf_stats *to, const struct jcf_stats *from);
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Starts counting the program's allocations.  Should be called before
+ *   anything that is counted has been allocated, so that no block is
+ *   freed that was not counted.
+ */
+void	jcf_stats_count_allocations(void);
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Stores in "allocations" the allocations counted so far.
+ */
+void	jcf_stats_allocations(struct jcf_stats_allocations *allocations);
+
+/*
+ * Requires:
+ *   "stats" must have no file started.  "nsec" is the time of the whole
+ *   scan.
+ *
+ * Effects:
+ *   Prints a report of the statistics to "fp", headed by "program".
+ */
+void	jcf_stats_print(FILE *fp, const char *program,
+	    const struct jcf_stats *stats,
+	    const struct jcf_stats_allocations *allocations, uint64_t nsec);
+
+/*
+ * Requires:
+ *   "stats" must have no file started.  "nsec" is the time of the whole
+ *   scan and "threads" the number of threads that it used.
+ *
+ * Effects:
+ *   Appends a summary of the statistics to the file "path" as one line
+ *   of JSON, creating the file if it does not exist, so that the runs
+ *   of a batch collect in one file.  Returns 0 on success and -1 on
+ *   failure.
+ */
+int	jcf_stats_write_json(const char *path, const struct jcf_stats *stats,
+	    const struct jcf_stats_allocations *allocations, uint64_t nsec,
+	    int threads);
+
+#endif /* JCF_STATS_H */
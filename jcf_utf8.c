@@ -0,0 +1,291 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * Validation of Modified UTF-8 strings, with ASCII fast paths for
+ * processors that have SSE2 or AVX2.
+ *
+ * Each validator first checks whether the whole string is ASCII with
+ * no NUL, which is true of almost every string in a class file.  The
+ * check reads the string in blocks, the last of which overlaps the one
+ * before it instead of leaving a tail, and combines the blocks before
+ * testing them once, so that its branches depend on the length of the
+ * string and not on its bytes.  Only a string that fails the check is
+ * checked sequence by sequence.
+ */
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include <string.h>
+
+#include "jcf_utf8.h"
+
+// Define a word with each byte set to "x".
+#define JCF_UTF8_BYTES(x)	(UINT64_C(0x0101010101010101) * (x))
+
+static uint64_t	jcf_utf8_word_mask(uint64_t word);
+static bool	jcf_utf8_ascii_short(const uint8_t *p, size_t len);
+static size_t	jcf_utf8_sequence(const uint8_t *p, size_t i, size_t len);
+static size_t	jcf_utf8_skip_words(const uint8_t *p, size_t i, size_t len);
+static bool	jcf_utf8_check(const uint8_t *p, size_t len);
+#if defined(__x86_64__)
+static bool	jcf_utf8_valid_sse2(const uint8_t *p, size_t len);
+static bool	jcf_utf8_valid_avx2(const uint8_t *p, size_t len);
+#endif
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Returns a mask of the high bits of the bytes of "word" that are not
+ *   from 0x01 to 0x7f: those whose high bit is set and those that are 0.
+ *   The lowest bit that the test for a 0 byte sets is exact, although a
+ *   borrow from it may set higher ones.
+ */
+static uint64_t
+jcf_utf8_word_mask(uint64_t word)
+{
+	return ((word | ((word - JCF_UTF8_BYTES(0x01)) & ~word)) &
+	    JCF_UTF8_BYTES(0x80));
+}
+
+/*
+ * Requires:
+ *   "p" must point to "len" bytes, and "len" must be less than 16.
+ *
+ * Effects:
+ *   Returns true if every byte is from 0x01 to 0x7f.  Eight or more
+ *   bytes are read as two words that overlap, four or more as two
+ *   halves of a word, and fewer as the first, middle and last bytes of
+ *   a word whose fourth byte is 1.
+ */
+static bool
+jcf_utf8_ascii_short(const uint8_t *p, size_t len)
+{
+	uint64_t first, last, word;
+	uint32_t low, high;
+
+	if (len >= 8) {
+		memcpy(&first, p, sizeof(first));
+		memcpy(&last, p + len - 8, sizeof(last));
+		return ((jcf_utf8_word_mask(first) |
+		    jcf_utf8_word_mask(last)) == 0);
+	}
+	if (len >= 4) {
+		memcpy(&low, p, sizeof(low));
+		memcpy(&high, p + len - 4, sizeof(high));
+		return (jcf_utf8_word_mask((uint64_t)high << 32 | low) == 0);
+	}
+	if (len == 0)
+		return (true);
+	word = (JCF_UTF8_BYTES(0x01) & ~UINT64_C(0xffffff)) | p[0] |
+	    (uint64_t)p[len / 2] << 8 | (uint64_t)p[len - 1] << 16;
+	return (jcf_utf8_word_mask(word) == 0);
+}
+
+/*
+ * Requires:
+ *   "p" must point to "len" bytes, and "i" must be less than "len".
+ *
+ * Effects:
+ *   Returns the length of the sequence that starts at byte "i", which
+ *   is one for a byte from 0x01 to 0x7f, or 0 if the sequence is not
+ *   valid.
+ */
+static size_t
+jcf_utf8_sequence(const uint8_t *p, size_t i, size_t len)
+{
+	uint8_t c = p[i];
+
+	if (c >= 0x01 && c <= 0x7f)
+		return (1);
+
+	// A two-byte sequence encodes NUL or 0x80 and up.
+	if ((c & 0xe0) == 0xc0) {
+		if (len - i < 2 || (p[i + 1] & 0xc0) != 0x80)
+			return (0);
+		if (c == 0xc1 || (c == 0xc0 && p[i + 1] != 0x80))
+			return (0);
+		return (2);
+	}
+
+	// A three-byte sequence encodes 0x800 and up, surrogates included.
+	if ((c & 0xf0) == 0xe0) {
+		if (len - i < 3 || (p[i + 1] & 0xc0) != 0x80 ||
+		    (p[i + 2] & 0xc0) != 0x80)
+			return (0);
+		if (c == 0xe0 && p[i + 1] < 0xa0)
+			return (0);
+		return (3);
+	}
+
+	// NUL, a continuation byte, or 0xf0 and above.
+	return (0);
+}
+
+/*
+ * Requires:
+ *   "p" must point to "len" bytes, and "i" must be at most "len".
+ *
+ * Effects:
+ *   Skips the bytes from 0x01 to 0x7f that start at byte "i", eight at
+ *   a time, and returns the index of the first byte that is not one of
+ *   them or of the first of the last bytes that are fewer than eight.
+ */
+static size_t
+jcf_utf8_skip_words(const uint8_t *p, size_t i, size_t len)
+{
+	uint64_t word, mask;
+
+	for (; len - i >= 8; i += 8) {
+		memcpy(&word, p + i, sizeof(word));
+		if ((mask = jcf_utf8_word_mask(word)) != 0) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+			return (i + __builtin_ctzll(mask) / 8);
+#else
+			return (i + __builtin_clzll(mask) / 8);
+#endif
+		}
+	}
+	return (i);
+}
+
+/*
+ * Requires:
+ *   "p" must point to "len" bytes.
+ *
+ * Effects:
+ *   Returns true if the bytes are valid Modified UTF-8, checking them
+ *   sequence by sequence and skipping runs of ASCII eight bytes at a
+ *   time.
+ */
+static bool
+jcf_utf8_check(const uint8_t *p, size_t len)
+{
+	size_t i = 0, n;
+
+	while (i < len) {
+		i = jcf_utf8_skip_words(p, i, len);
+		if (i == len)
+			break;
+		if ((n = jcf_utf8_sequence(p, i, len)) == 0)
+			return (false);
+		i += n;
+	}
+	return (true);
+}
+
+bool
+jcf_utf8_valid_scalar(const uint8_t *p, size_t len)
+{
+	uint64_t word, mask = 0;
+	size_t i;
+
+	if (len < 16) {
+		if (jcf_utf8_ascii_short(p, len))
+			return (true);
+		return (jcf_utf8_check(p, len));
+	}
+	for (i = 0; i + 8 < len; i += 8) {
+		memcpy(&word, p + i, sizeof(word));
+		mask |= jcf_utf8_word_mask(word);
+	}
+	memcpy(&word, p + len - 8, sizeof(word));
+	mask |= jcf_utf8_word_mask(word);
+	if (mask == 0)
+		return (true);
+	return (jcf_utf8_check(p, len));
+}
+
+#if defined(__x86_64__)
+/*
+ * Requires:
+ *   "p" must point to "len" bytes.
+ *
+ * Effects:
+ *   Returns whether the bytes are valid, like jcf_utf8_valid_scalar(),
+ *   checking for ASCII 16 bytes at a time: a byte is not ASCII with no
+ *   NUL if its high bit is set or it is equal to 0.  SSE2 is part of
+ *   every x86-64 processor.
+ */
+static bool
+jcf_utf8_valid_sse2(const uint8_t *p, size_t len)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i block, bad = zero;
+	size_t i;
+
+	if (len < 16) {
+		if (jcf_utf8_ascii_short(p, len))
+			return (true);
+		return (jcf_utf8_check(p, len));
+	}
+	for (i = 0; i + 16 < len; i += 16) {
+		block = _mm_loadu_si128((const __m128i *)(p + i));
+		bad = _mm_or_si128(bad, _mm_or_si128(block,
+		    _mm_cmpeq_epi8(block, zero)));
+	}
+	block = _mm_loadu_si128((const __m128i *)(p + len - 16));
+	bad = _mm_or_si128(bad, _mm_or_si128(block, _mm_cmpeq_epi8(block,
+	    zero)));
+	if (_mm_movemask_epi8(bad) == 0)
+		return (true);
+	return (jcf_utf8_check(p, len));
+}
+
+/*
+ * Requires:
+ *   "p" must point to "len" bytes, and the processor must have AVX2.
+ *
+ * Effects:
+ *   Returns whether the bytes are valid, like jcf_utf8_valid_sse2(),
+ *   checking for ASCII 32 bytes at a time, or as two blocks of 16 that
+ *   overlap if there are fewer than 32.
+ */
+__attribute__((target("avx2")))
+static bool
+jcf_utf8_valid_avx2(const uint8_t *p, size_t len)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i block, bad = zero;
+	__m128i first, last;
+	size_t i;
+
+	if (len < 16) {
+		if (jcf_utf8_ascii_short(p, len))
+			return (true);
+		return (jcf_utf8_check(p, len));
+	}
+	if (len < 32) {
+		first = _mm_loadu_si128((const __m128i *)p);
+		last = _mm_loadu_si128((const __m128i *)(p + len - 16));
+		block = _mm256_set_m128i(last, first);
+	} else {
+		for (i = 0; i + 32 < len; i += 32) {
+			block = _mm256_loadu_si256((const __m256i *)(p + i));
+			bad = _mm256_or_si256(bad, _mm256_or_si256(block,
+			    _mm256_cmpeq_epi8(block, zero)));
+		}
+		block = _mm256_loadu_si256((const __m256i *)(p + len - 32));
+	}
+	bad = _mm256_or_si256(bad, _mm256_or_si256(block,
+	    _mm256_cmpeq_epi8(block, zero)));
+	if (_mm256_movemask_epi8(bad) == 0)
+		return (true);
+	return (jcf_utf8_check(p, len));
+}
+#endif
+
+jcf_utf8_validator *
+jcf_utf8_select(void)
+{
+#if defined(__x86_64__)
+	if (__builtin_cpu_supports("avx2"))
+		return (jcf_utf8_valid_avx2);
+	return (jcf_utf8_valid_sse2);
+#else
+	return (jcf_utf8_valid_scalar);
+#endif
+}
@@ -0,0 +1,50 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * Validation of the Modified UTF-8 that class files encode their
+ * strings in.  A string is valid if it has no byte that is 0 or 0xf0
+ * and above, and every byte from 0x80 up is part of a two- or three-
+ * byte sequence that is not overlong, except that NUL is encoded as
+ * 0xc0 0x80.  A supplementary character is a pair of surrogates, which
+ * are encoded as three-byte sequences of their own, so four-byte
+ * sequences are never valid.  Surrogates need not be paired, because a
+ * string constant may hold any sequence of UTF-16 code units.
+ *
+ * Most strings in class files are ASCII, so each string is first
+ * checked whole for ASCII, 32 or 16 bytes at a time with AVX2 or SSE2
+ * where the processor has them and 8 at a time otherwise, and only the
+ * strings that are not ASCII are checked sequence by sequence.  They are
+ * checked where they are, with their lengths, so an encoded NUL needs
+ * no special treatment.
+ */
+
+#ifndef JCF_UTF8_H
+#define JCF_UTF8_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Define a function that checks whether a string is valid.
+typedef bool	jcf_utf8_validator(const uint8_t *p, size_t len);
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Returns the fastest validator that the processor can run.
+ */
+jcf_utf8_validator *jcf_utf8_select(void);
+
+/*
+ * Requires:
+ *   "p" must point to "len" bytes.
+ *
+ * Effects:
+ *   Returns true if the bytes are valid Modified UTF-8 and false
+ *   otherwise, checking them without SIMD instructions.
+ */
+bool	jcf_utf8_valid_scalar(const uint8_t *p, size_t len);
+
+#endif /* JCF_UTF8_H */
@@ -0,0 +1,350 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * A reader for the central directory of JAR and ZIP archives, including
+ * ZIP64 archives.  See PKWARE's APPNOTE.TXT for the format.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jcf_inflate.h"
+#include "jcf_zip.h"
+
+// Define the signatures of the records that are read.
+#define JCF_ZIP_LOCAL_SIG	0x04034b50
+#define JCF_ZIP_CENTRAL_SIG	0x02014b50
+#define JCF_ZIP_END_SIG		0x06054b50
+#define JCF_ZIP64_END_SIG	0x06064b50
+#define JCF_ZIP64_LOCATOR_SIG	0x07064b50
+
+// Define the sizes of the fixed parts of the records.
+#define JCF_ZIP_LOCAL_SIZE	30
+#define JCF_ZIP_CENTRAL_SIZE	46
+#define JCF_ZIP_END_SIZE	22
+#define JCF_ZIP64_END_SIZE	56
+#define JCF_ZIP64_LOCATOR_SIZE	20
+
+// Define the ID of the ZIP64 extended information extra field.
+#define JCF_ZIP64_EXTRA_ID	0x0001
+
+// Define the compression methods that are supported.
+#define JCF_ZIP_STORED		0
+#define JCF_ZIP_DEFLATED	8
+
+// Define the general purpose flag that marks an encrypted entry.
+#define JCF_ZIP_ENCRYPTED	0x0001
+
+static uint32_t jcf_crc_table[256];
+static pthread_once_t jcf_crc_once = PTHREAD_ONCE_INIT;
+
+static void	jcf_crc_init(void);
+static uint32_t	jcf_crc32(const uint8_t *data, size_t len);
+static int	jcf_zip_find_end(struct jcf_zip *zip, uint64_t *countp,
+		    uint64_t *cd_offsetp, uint64_t *cd_sizep);
+static int	jcf_zip_read_zip64_extra(const uint8_t *extra, size_t len,
+		    struct jcf_zip_entry *entry, bool size_max,
+		    bool compressed_size_max, bool offset_max);
+
+/*
+ * Requires:
+ *   "p" must point to at least 2, 4, or 8 bytes, respectively.
+ *
+ * Effects:
+ *   Returns the little-endian integer at "p".
+ */
+static inline uint16_t
+jcf_le16(const uint8_t *p)
+{
+	return (p[0] | (uint16_t)p[1] << 8);
+}
+
+static inline uint32_t
+jcf_le32(const uint8_t *p)
+{
+	return (p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+	    (uint32_t)p[3] << 24);
+}
+
+static inline uint64_t
+jcf_le64(const uint8_t *p)
+{
+	return (jcf_le32(p) | (uint64_t)jcf_le32(p + 4) << 32);
+}
+
+/*
+ * Requires:
+ *   Nothing.
+ *
+ * Effects:
+ *   Builds the table for the reflected CRC-32 used by ZIP.
+ */
+static void
+jcf_crc_init(void)
+{
+	uint32_t c;
+	int i, k;
+
+	for (i = 0; i < 256; i++) {
+		c = i;
+		for (k = 0; k < 8; k++)
+			c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+		jcf_crc_table[i] = c;
+	}
+}
+
+/*
+ * Requires:
+ *   "data" must point to "len" bytes.
+ *
+ * Effects:
+ *   Returns the CRC-32 of the data.
+ */
+static uint32_t
+jcf_crc32(const uint8_t *data, size_t len)
+{
+	uint32_t c = 0xffffffff;
+
+	pthread_once(&jcf_crc_once, jcf_crc_init);
+	while (len-- > 0)
+		c = jcf_crc_table[(c ^ *data++) & 0xff] ^ (c >> 8);
+	return (c ^ 0xffffffff);
+}
+
+/*
+ * Requires:
+ *   "zip" must hold the archive's bytes.
+ *
+ * Effects:
+ *   Finds the end of central directory record, and the ZIP64 record if
+ *   the archive has one, and returns the number of entries and the
+ *   offset and size of the central directory.  Returns 0 on success and
+ *   -1 on failure.
+ */
+static int
+jcf_zip_find_end(struct jcf_zip *zip, uint64_t *countp, uint64_t *cd_offsetp,
+    uint64_t *cd_sizep)
+{
+	const uint8_t *end, *locator, *end64;
+	size_t pos, stop;
+	uint64_t end64_offset;
+
+	if (zip->len < JCF_ZIP_END_SIZE)
+		return (-1);
+
+	// The record is followed by a comment of at most 65535 bytes.
+	pos = zip->len - JCF_ZIP_END_SIZE;
+	stop = pos > 65535 ? pos - 65535 : 0;
+	for (;;) {
+		end = zip->base + pos;
+		if (jcf_le32(end) == JCF_ZIP_END_SIG &&
+		    pos + JCF_ZIP_END_SIZE + jcf_le16(end + 20) == zip->len)
+			break;
+		if (pos == stop)
+			return (-1);
+		pos--;
+	}
+
+	// Archives that span several disks are not supported.
+	if (jcf_le16(end + 4) != 0 || jcf_le16(end + 6) != 0)
+		return (-1);
+	*countp = jcf_le16(end + 10);
+	*cd_sizep = jcf_le32(end + 12);
+	*cd_offsetp = jcf_le32(end + 16);
+
+	// A ZIP64 locator, if any, immediately precedes the record.
+	if (pos < JCF_ZIP64_LOCATOR_SIZE)
+		return (0);
+	locator = end - JCF_ZIP64_LOCATOR_SIZE;
+	if (jcf_le32(locator) != JCF_ZIP64_LOCATOR_SIG)
+		return (0);
+	end64_offset = jcf_le64(locator + 8);
+	if (end64_offset > zip->len - JCF_ZIP64_LOCATOR_SIZE -
+	    JCF_ZIP_END_SIZE || zip->len - JCF_ZIP64_LOCATOR_SIZE -
+	    JCF_ZIP_END_SIZE - end64_offset < JCF_ZIP64_END_SIZE)
+		return (-1);
+	end64 = zip->base + end64_offset;
+	if (jcf_le32(end64) != JCF_ZIP64_END_SIG ||
+	    jcf_le32(end64 + 16) != 0 || jcf_le32(end64 + 20) != 0)
+		return (-1);
+	*countp = jcf_le64(end64 + 32);
+	*cd_sizep = jcf_le64(end64 + 40);
+	*cd_offsetp = jcf_le64(end64 + 48);
+	return (0);
+}
+
+/*
+ * Requires:
+ *   "extra" must point to the "len" bytes of a central directory entry's
+ *   extra field.
+ *
+ * Effects:
+ *   Replaces each of the entry's 32-bit fields that is marked as
+ *   overflowing with its 64-bit value from the ZIP64 extra field.
+ *   Returns 0 on success and -1 on failure.
+ */
+static int
+jcf_zip_read_zip64_extra(const uint8_t *extra, size_t len,
+    struct jcf_zip_entry *entry, bool size_max, bool compressed_size_max,
+    bool offset_max)
+{
+	size_t pos, field_len, need;
+
+	for (pos = 0; pos + 4 <= len; pos += 4 + field_len) {
+		field_len = jcf_le16(extra + pos + 2);
+		if (pos + 4 + field_len > len)
+			return (-1);
+		if (jcf_le16(extra + pos) != JCF_ZIP64_EXTRA_ID)
+			continue;
+		need = 8 * (size_max + compressed_size_max + offset_max);
+		if (field_len < need)
+			return (-1);
+		extra += pos + 4;
+		if (size_max) {
+			entry->size = jcf_le64(extra);
+			extra += 8;
+		}
+		if (compressed_size_max) {
+			entry->compressed_size = jcf_le64(extra);
+			extra += 8;
+		}
+		if (offset_max)
+			entry->offset = jcf_le64(extra);
+		return (0);
+	}
+	return (size_max || compressed_size_max || offset_max ? -1 : 0);
+}
+
+int
+jcf_zip_open(struct jcf_zip *zip, const uint8_t *base, size_t len)
+{
+	struct jcf_zip_entry *entry;
+	const uint8_t *p, *cd_end;
+	uint64_t count, cd_offset, cd_size, i;
+	size_t name_len, extra_len, comment_len;
+
+	zip->base = base;
+	zip->len = len;
+	zip->entries = NULL;
+	zip->count = 0;
+
+	if (jcf_zip_find_end(zip, &count, &cd_offset, &cd_size) != 0)
+		return (-1);
+	if (cd_offset > len || cd_size > len - cd_offset ||
+	    count > cd_size / JCF_ZIP_CENTRAL_SIZE)
+		return (-1);
+	zip->entries = malloc((count > 0 ? count : 1) * sizeof(*zip->entries));
+	if (zip->entries == NULL)
+		return (-1);
+
+	p = base + cd_offset;
+	cd_end = p + cd_size;
+	for (i = 0; i < count; i++) {
+		if (cd_end - p < JCF_ZIP_CENTRAL_SIZE ||
+		    jcf_le32(p) != JCF_ZIP_CENTRAL_SIG)
+			goto failed;
+		name_len = jcf_le16(p + 28);
+		extra_len = jcf_le16(p + 30);
+		comment_len = jcf_le16(p + 32);
+		if ((size_t)(cd_end - p) < JCF_ZIP_CENTRAL_SIZE + name_len +
+		    extra_len + comment_len)
+			goto failed;
+
+		entry = &zip->entries[i];
+		entry->method = jcf_le16(p + 10);
+		entry->crc = jcf_le32(p + 16);
+		entry->compressed_size = jcf_le32(p + 20);
+		entry->size = jcf_le32(p + 24);
+		entry->offset = jcf_le32(p + 42);
+		entry->name = (const char *)p + JCF_ZIP_CENTRAL_SIZE;
+		entry->name_length = name_len;
+		if ((jcf_le16(p + 8) & JCF_ZIP_ENCRYPTED) != 0)
+			entry->method = 0xffff;	// never supported
+		if (jcf_zip_read_zip64_extra(p + JCF_ZIP_CENTRAL_SIZE +
+		    name_len, extra_len, entry, entry->size == 0xffffffff,
+		    entry->compressed_size == 0xffffffff,
+		    entry->offset == 0xffffffff) != 0)
+			goto failed;
+		p += JCF_ZIP_CENTRAL_SIZE + name_len + extra_len + comment_len;
+	}
+	zip->count = count;
+	return (0);
+
+failed:
+	free(zip->entries);
+	zip->entries = NULL;
+	return (-1);
+}
+
+void
+jcf_zip_close(struct jcf_zip *zip)
+{
+	free(zip->entries);
+	zip->entries = NULL;
+	zip->count = 0;
+}
+
+int
+jcf_zip_extract(const struct jcf_zip *zip, size_t index, uint8_t **bufferp,
+    size_t *buffer_sizep, const uint8_t **datap, size_t *lenp)
+{
+	const struct jcf_zip_entry *entry = &zip->entries[index];
+	const uint8_t *local, *data;
+	uint8_t *buffer;
+	uint64_t skip;
+
+	// Find the data from the entry's local header.
+	if (entry->offset > zip->len ||
+	    zip->len - entry->offset < JCF_ZIP_LOCAL_SIZE)
+		return (-1);
+	local = zip->base + entry->offset;
+	if (jcf_le32(local) != JCF_ZIP_LOCAL_SIG)
+		return (-1);
+	skip = JCF_ZIP_LOCAL_SIZE + (uint64_t)jcf_le16(local + 26) +
+	    jcf_le16(local + 28);
+	if (zip->len - entry->offset < skip ||
+	    zip->len - entry->offset - skip < entry->compressed_size)
+		return (-1);
+	data = local + skip;
+
+	switch (entry->method) {
+	case JCF_ZIP_STORED:
+		if (entry->compressed_size != entry->size)
+			return (-1);
+		*datap = data;
+		*lenp = entry->size;
+		break;
+	case JCF_ZIP_DEFLATED:
+		if (entry->size > SIZE_MAX / 2)
+			return (-1);
+		if (*buffer_sizep < entry->size || *bufferp == NULL) {
+			buffer = realloc(*bufferp, entry->size > 0 ?
+			    entry->size : 1);
+			if (buffer == NULL)
+				return (-1);
+			*bufferp = buffer;
+			*buffer_sizep = entry->size > 0 ? entry->size : 1;
+		}
+		if (jcf_inflate(data, entry->compressed_size, *bufferp,
+		    entry->size) != 0)
+			return (-1);
+		*datap = *bufferp;
+		*lenp = entry->size;
+		break;
+	default:
+		return (-1);
+	}
+	if (jcf_crc32(*datap, *lenp) != entry->crc)
+		return (-1);
+	return (0);
+}
+
+bool
+jcf_zip_entry_has_suffix(const struct jcf_zip_entry *entry, const char *suffix)
+{
+	size_t len = strlen(suffix);
+
+	return (entry->name_length >= len &&
+	    memcmp(entry->name + entry->name_length - len, suffix, len) == 0);
+}
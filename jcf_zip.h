@@ -0,0 +1,84 @@
+/*
+ * COMP 321 Project 3: Linking
+ *
+ * A reader for the central directory of JAR and ZIP archives.  The
+ * archive is accessed entirely in memory: stored entries are returned
+ * in place and deflated entries are inflated into a caller-supplied
+ * buffer that can be reused from one entry to the next.
+ */
+
+#ifndef JCF_ZIP_H
+#define JCF_ZIP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Define an entry of an archive's central directory.
+struct jcf_zip_entry {
+	const char	*name;		// in the central directory, not NUL
+	uint16_t	name_length;	// terminated
+	uint16_t	method;
+	uint32_t	crc;
+	uint64_t	compressed_size;
+	uint64_t	size;
+	uint64_t	offset;		// of the local header
+};
+
+// Define an archive.
+struct jcf_zip {
+	const uint8_t	*base;
+	size_t		len;
+	struct jcf_zip_entry *entries;
+	size_t		count;
+};
+
+/*
+ * Requires:
+ *   "base" must point to the "len" bytes of an archive, which must
+ *   remain valid until jcf_zip_close() is called.
+ *
+ * Effects:
+ *   Reads the archive's central directory into "zip".  Returns 0 on
+ *   success and -1 if the archive is malformed or uses unsupported
+ *   features, such as spanning or encryption.
+ */
+int	jcf_zip_open(struct jcf_zip *zip, const uint8_t *base, size_t len);
+
+/*
+ * Requires:
+ *   "zip" must have been opened by jcf_zip_open().
+ *
+ * Effects:
+ *   Frees the memory held by "zip".  The archive bytes are not touched.
+ */
+void	jcf_zip_close(struct jcf_zip *zip);
+
+/*
+ * Requires:
+ *   "zip" must have been opened by jcf_zip_open() and "index" must be
+ *   less than "zip->count".  "*bufferp" must be NULL or a malloc()ed
+ *   block of "*buffer_sizep" bytes.
+ *
+ * Effects:
+ *   Sets "*datap" and "*lenp" to the uncompressed contents of the entry.
+ *   A stored entry is returned in place.  A deflated entry is inflated
+ *   into "*bufferp", which is grown with realloc() as needed and should
+ *   be passed back in for the next entry.  The contents are checked
+ *   against the entry's CRC.  Returns 0 on success and -1 on failure.
+ */
+int	jcf_zip_extract(const struct jcf_zip *zip, size_t index,
+	    uint8_t **bufferp, size_t *buffer_sizep, const uint8_t **datap,
+	    size_t *lenp);
+
+/*
+ * Requires:
+ *   "entry" must be an entry of an open archive.
+ *
+ * Effects:
+ *   Returns true if the entry's name ends with "suffix".
+ */
+bool	jcf_zip_entry_has_suffix(const struct jcf_zip_entry *entry,
+	    const char *suffix);
+
+#endif /* JCF_ZIP_H */
@@ -1,848 +1,2873 @@
 /*
  * COMP 321 Project 3: Linking
  * 
- * This program reads a single Java Class File and prints out its
+ * This program reads Java Class Files and prints out their
  * dependencies and exports, as requested by command-line flags.
  * 
  */
 
-#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 
 #include <assert.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "csapp.h"
 
-// Define the magic number that must be the first four bytes of a valid JCF.
-#define JCF_MAGIC	0xCAFEBABE
+#include "jcf_bin.h"
+#include "jcf_cache.h"
+#include "jcf_graph.h"
+#include "jcf_index.h"
+#include "jcf_ingest.h"
+#include "jcf_intern.h"
+#include "jcf_link.h"
+#include "jcf_memo.h"
+#include "jcf_out.h"
+#include "jcf_parse.h"
+#include "jcf_serve.h"
+#include "jcf_stats.h"
+#include "jcf_zip.h"
+
+// Define where the bytes of an image came from.
+enum jcf_image_kind {
+	JCF_IMAGE_MAPPED,	// mmap()ed from a file
+	JCF_IMAGE_READ,		// read into a malloc()ed buffer
+	JCF_IMAGE_BORROWED	// owned by someone else, such as an archive
+};
 
-/* 
- * Define the header of the Java class file.
- * The __attribute__((packed)) after the structure definition tells the
- * compiler to not add any padding to the structure for alignment.  This
- * allows this structure to be read directly from a packed file.
- */
-struct jcf_header {
-	uint32_t	magic;
-	uint16_t	minor_version;
-	uint16_t	major_version;
-} __attribute__((packed));
-
-// Define the body of the Java class file.
-struct jcf_body {
-	uint16_t	access_flags;
-	uint16_t	this_class;
-	uint16_t	super_class;
-} __attribute__((packed));
-
-// Define an enumeration of the constant tags.
-enum jcf_cp_tags {
-	JCF_CONSTANT_Class = 7,
-	JCF_CONSTANT_Fieldref = 9,
-	JCF_CONSTANT_Methodref = 10,
-	JCF_CONSTANT_InterfaceMethodref = 11,
-	JCF_CONSTANT_String = 8,
-	JCF_CONSTANT_Integer = 3,
-	JCF_CONSTANT_Float = 4,
-	JCF_CONSTANT_Long = 5,
-	JCF_CONSTANT_Double = 6,
-	JCF_CONSTANT_NameAndType = 12,
-	JCF_CONSTANT_Utf8 = 1,
-	JCF_CONSTANT_MethodHandle = 15,
-	JCF_CONSTANT_MethodType = 16,
-	JCF_CONSTANT_InvokeDynamic = 18
+/*
+ * Define a structure for holding the image of a class file.  The image
+ * is either mapped from the file or, if the file cannot be mapped,
+ * read into a malloc()ed buffer in a single pass.  The image of an
+ * archive entry is borrowed from the archive or from the buffer that
+ * it was inflated into.
+ */
+struct jcf_image {
+	const uint8_t	*base;
+	size_t		len;
+	enum jcf_image_kind kind;
 };
 
-// Define an enumeration of the access flags.
-enum jcf_access_flags {
-	JCF_ACC_PUBLIC = 0x0001,
-	JCF_ACC_PRIVATE = 0x0002,
-	JCF_ACC_PROTECTED = 0x0004,
-	JCF_ACC_STATIC = 0x0008,
-	JCF_ACC_FINAL = 0x0010,
-	JCF_ACC_SYNCHRONIZED = 0x0020,
-	JCF_ACC_VOLATILE = 0x0040,
-	JCF_ACC_TRANSIENT = 0x0080,
-	JCF_ACC_NATIVE = 0x0100,
-	JCF_ACC_INTERFACE = 0x0200,
-	JCF_ACC_ABSTRACT = 0x0400,
-	JCF_ACC_STRICT = 0x0800
+/*
+ * Define an enumeration of the kinds of results that are recorded for
+ * the cache.  A record is the kind, as one byte, followed by the
+ * length of its text, as four bytes in host byte order, and the text.
+ * The text of a line is what follows "Kind - ", the text of a link
+ * symbol is its key, the text of a graph record is a class name, and
+ * the text of an index record is a symbol that the class references.
+ */
+enum jcf_record_kind {
+	JCF_RECORD_DEPENDENCY,
+	JCF_RECORD_EXPORT,
+	JCF_RECORD_ATTRIBUTE,
+	JCF_RECORD_REFERENCE,
+	JCF_RECORD_FINGERPRINT,
+	JCF_RECORD_CLASS,	// the class, which the uses that follow are from
+	JCF_RECORD_USE,		// a class that the class names
+	JCF_RECORD_SYMBOL,	// a symbol for the index
+	JCF_RECORD_LINK		// plus the symbol's enum jcf_link_kind, with
+				// whether it is a method before its key
 };
 
 /*
- * Define the generic constant pool info structure.
- * This structure should be thought of as an abstract class that never
- * should be allocated directly. 
- *
- * The zero length array "info" in this structure is a special design
- * pattern in C that allows for variable length structures.  This is
- * done by casting another structure to this general type or by
- * allocating (sizeof(struct foo) + array_len) bytes.  This causes
- * memory to be allocated for the array, which can then be accessed
- * normally.
+ * Define the version of the records, which is part of the options that
+ * the cache is keyed by, so that entries in an older format are not
+ * found.
  */
-struct jcf_cp_info {
-	uint8_t		tag;
-	uint8_t		info[0];
-} __attribute__((packed));
+#define JCF_RECORD_VERSION	7
+
+// Define the most threads that -j accepts.
+#define JCF_THREADS_MAX		1024
+
+// Define the names of the kinds of output lines.
+static const char *const jcf_record_names[] = {
+	[JCF_RECORD_DEPENDENCY] = "Dependency",
+	[JCF_RECORD_EXPORT] = "Export",
+	[JCF_RECORD_ATTRIBUTE] = "Attribute",
+	[JCF_RECORD_REFERENCE] = "Reference",
+	[JCF_RECORD_FINGERPRINT] = "Fingerprint"
+};
 
-/* 
- * Define the generic constant pool info structure for all constants
- * that have a single u2.
+/*
+ * Define a structure for holding processing state.  One structure is
+ * reused for every class file that is processed.
  */
-struct jcf_cp_info_1u2 {
-	uint8_t		tag;
-	uint16_t	u2;
-} __attribute__((packed));
+struct jcf_state {
+	struct jcf_image image;
+	struct jcf_out	out;		// where output lines are printed
+	const char	*filename;	// prefix for output lines, or NULL
+	bool		depends_flag;
+	bool		exports_flag;
+	bool		verbose_flag;
+	bool		strict_flag;	// whether UTF8 constants are checked
+	bool		binary_flag;	// whether -d and -e lines are binary
+	bool		fingerprint_flag;
+	uint64_t	fingerprint;	// of the class' public API so far
+	const char	*attributes;	// comma separated names to keep, or NULL
+	struct jcf_parser *parser;
+	unsigned int	events;		// the kinds of events to parse for
+	const char	*class_name;	// of the class, in the image
+	size_t		class_length;
+	uint8_t		*inflate_buffer; // reused for deflated archive entries
+	size_t		inflate_size;
+	struct jcf_link_table *link;	// where symbols are collected, or NULL
+	struct jcf_graph_table *graph;	// where edges are collected, or NULL
+	uint32_t	graph_class;	// ID of the class whose edges these are
+	struct jcf_graph_table *index;	// indexed symbols, or NULL
+	struct jcf_intern *intern;	// names the symbols and graph's nodes
+	size_t		file;		// index of the current input
+	struct jcf_out	key;		// scratch for building keys and lines
+	struct jcf_cache *cache;	// where results are cached, or NULL
+	struct jcf_out	record;		// the current file's records
+	bool		recording;	// whether to add to "record"
+	bool		serving;	// whether errors go to "out"
+	struct jcf_stats *stats;	// where statistics go, or NULL
+	struct jcf_out	binary;		// the current file's binary lines
+	struct jcf_bin_writer *bin;	// where they are written, or NULL
+};
 
-/* 
- * Define the generic constant pool info structure for all constants
- * that have two u2s.
+// Define a structure for holding an open JAR or ZIP archive.
+struct jcf_archive {
+	struct jcf_image image;
+	struct jcf_zip	zip;
+};
+
+/*
+ * Define a structure for holding a class file to process.  If "archive"
+ * is not NULL, the class file is entry "entry" of that archive.
  */
-struct jcf_cp_info_2u2 {
-	uint8_t		tag;
-	struct {
-		uint16_t	u2_1;
-		uint16_t	u2_2;
-	} __attribute__((packed)) body;
-} __attribute__((packed));
+struct jcf_input {
+	char		*path;
+	struct jcf_archive *archive;
+	size_t		entry;
+};
 
-/* 
- * Define the generic constant pool info structure for all constants
- * that have one u1 and one u2.
+/*
+ * Define a structure for holding the list of class files to process.
+ * The list owns the archives that its inputs refer to.
  */
-struct jcf_cp_info_1u1_1u2 {
-	uint8_t		tag;
-	struct {
-		uint8_t		u1;
-		uint16_t	u2;
-	} __attribute__((packed)) body;
-} __attribute__((packed));
+struct jcf_inputs {
+	struct jcf_input *items;
+	size_t		count;
+	size_t		capacity;
+	struct jcf_archive **archives;
+	size_t		narchives;
+};
 
-/* 
- * Define the generic constant pool info structure for all constants
- * that have a single u4.
+/*
+ * Define a structure for holding the output of one class file that was
+ * processed by a worker thread until it can be printed in order.
  */
-struct jcf_cp_info_1u4 {
-	uint8_t		tag;
-	uint32_t	u4;
-} __attribute__((packed));
+struct jcf_result {
+	char		*output;
+	size_t		length;
+	char		*binary;	// its binary lines, as records
+	size_t		binary_length;
+	int		err;
+	bool		done;
+};
 
-/* 
- * Define the generic constant pool info structure for all constants
- * that have two u2s.
- */
-struct jcf_cp_info_2u4 {
-	uint8_t		tag;
-	struct {
-		uint32_t u4_1;
-		uint32_t u4_2;
-	} __attribute__((packed)) body;
-} __attribute__((packed));
-
-// Define the constant pool info for classes.
-struct jcf_cp_class_info {
-	uint8_t		tag;
-	uint16_t	name_index;
-} __attribute__((packed));
-
-/*
- * Define the constant pool info for all reference constants.
- * These are any of the following constants: JCF_CONSTANT_Fieldref,
- * JCF_CONSTANT_Methodref, and JCF_CONSTANT_InterfaceMethodref.
- */
-struct jcf_cp_ref_info {
-	uint8_t		tag;
-	uint16_t	class_index;
-	uint16_t	name_and_type_index;
-} __attribute__((packed));
-
-// Define the constant pool info for name and type tuples.
-struct jcf_cp_nameandtype_info {
-	uint8_t		tag;
-	uint16_t	name_index;
-	uint16_t	descriptor_index;
-} __attribute__((packed));
-
-/*
- * Define the constant pool info for UTF8 strings.
- * 
- * This structure should be created by allocating
- * (sizeof(struct jcf_cp_utf8_info) + array_len) bytes.
- */
-struct jcf_cp_utf8_info {
-	uint8_t		tag;
-	uint16_t	length;
-	uint8_t		bytes[0];
-} __attribute__((packed));
-
-// Define a field info entry for the class.
-struct jcf_field_info {
-	uint16_t	access_flags;
-	uint16_t	name_index;
-	uint16_t	descriptor_index;
-} __attribute__((packed));
-
-// Define a method info entry for the class.
-struct jcf_method_info {
-	uint16_t	access_flags;
-	uint16_t	name_index;
-	uint16_t	descriptor_index;
-} __attribute__((packed));
-
-
-
-// Define a structure for holding the constant pool.
-struct jcf_constant_pool {
-	uint16_t	count;
-	struct jcf_cp_info **pool;
+struct jcf_scan;
+
+/*
+ * Define a structure for holding a worker thread.  Each worker has its
+ * own processing state and output buffer.  Its deque holds the indices
+ * of the class files that it has yet to process: the worker takes from
+ * the head, in increasing order, and idle workers steal from the tail.
+ */
+struct jcf_worker {
+	pthread_t	thread;
+	struct jcf_scan	*scan;
+	struct jcf_state jcf;		// whose output is kept in memory
+	pthread_mutex_t	lock;		// protects the deque
+	size_t		*deque;
+	size_t		head;
+	size_t		tail;
+	struct jcf_link_table link;	// the symbols of the worker's files
+	struct jcf_graph_table graph;	// the edges of the worker's files
+	struct jcf_graph_table index;	// the worker's indexed symbols
+	struct jcf_stats stats;		// of the worker's files
 };
 
-// Define a structure for holding processing state.
-struct jcf_state {
-	FILE		*f;
-	bool		depends_flag;
-	bool		exports_flag;
-	bool		verbose_flag;
-	struct jcf_constant_pool constant_pool;
+/*
+ * Define a structure for holding what is needed to report the findings
+ * of a link check.
+ */
+struct jcf_link_report {
+	struct jcf_state *jcf;
+	const struct jcf_inputs *inputs;
+	bool		batch_flag;
+};
+
+// Define a structure for holding the state of a parallel scan.
+struct jcf_scan {
+	struct jcf_inputs *inputs;
+	struct jcf_result *results;
+	struct jcf_worker *workers;
+	int		nworkers;
+	bool		batch_flag;
+	pthread_mutex_t	lock;		// protects the results
+	pthread_cond_t	done;		// signaled when a result is done
+};
+
+/*
+ * Define a structure for holding the state of a server.  Each worker
+ * thread has its own processing state, whose output is its reply, and
+ * its own table of the edges of the file that it is analyzing.  The
+ * results of every analyzed file are kept in "memo".  The dependency
+ * graph of the analyzed classes, with its components and condensation,
+ * is rebuilt when a query finds that "memo" has changed since it was
+ * last built, and is then shared by every query until it changes again.
+ */
+struct jcf_daemon {
+	struct jcf_state *states;
+	struct jcf_graph_table *tables;
+	int		nworkers;
+	struct jcf_memo	memo;
+	pthread_rwlock_t lock;		// protects the graph
+	bool		indexed;	// whether the graph has been built
+	uint64_t	version;	// of "memo" that the graph is of
+	struct jcf_graph graph;
+	uint32_t	*names;
+	uint32_t	*node;		// of each ID less than "limit"
+	uint32_t	limit;
+	uint32_t	*component;
+	uint32_t	ncomponents;
+	struct jcf_graph dag;
 };
 
 // Declare the local function prototypes.
-static void	readjcf_error(void);
-static int	print_jcf_constant(struct jcf_state *jcf,
-		    uint16_t index, uint8_t expected_tag);
-static int	process_jcf_header(struct jcf_state *jcf);
-static int	process_jcf_constant_pool(struct jcf_state *jcf);
-static void	destroy_jcf_constant_pool(struct jcf_constant_pool *pool);
-static int	process_jcf_body(struct jcf_state *jcf);
-static int	process_jcf_interfaces(struct jcf_state *jcf);
-static int	process_jcf_fields(struct jcf_state *jcf);
-static int	process_jcf_methods(struct jcf_state *jcf);
-static int	process_jcf_fields_and_methods_helper(struct jcf_state *jcf);
-static int	process_jcf_attributes(struct jcf_state *jcf);
+static void	readjcf_error(const char *filename);
+static void	print_jcf_error(struct jcf_state *jcf);
+static int	jcf_image_open(struct jcf_image *image, const char *filename);
+static void	jcf_image_close(struct jcf_image *image);
+static bool	jcf_attribute_requested(struct jcf_state *jcf,
+		    const char *name, size_t len);
+static void	print_jcf_prefix(struct jcf_state *jcf, const char *kind);
+static void	print_jcf_line(struct jcf_state *jcf,
+		    enum jcf_record_kind kind, const char *text, size_t len);
+static void	print_jcf_member(struct jcf_state *jcf,
+		    enum jcf_record_kind kind,
+		    const struct jcf_parse_event *event);
+static void	record_jcf_result(struct jcf_state *jcf, unsigned int kind,
+		    const char *text, size_t len);
+static int	replay_jcf_records(struct jcf_state *jcf);
+static int	read_jcf_member(enum jcf_record_kind kind, const char *text,
+		    size_t len, struct jcf_parse_event *event);
+static void	record_jcf_binary(struct jcf_state *jcf,
+		    enum jcf_record_kind kind,
+		    const struct jcf_parse_event *event);
+static void	write_jcf_binary(struct jcf_bin_writer *bin, const char *path,
+		    const char *buf, size_t len);
+static int	link_jcf_key(struct jcf_state *jcf, enum jcf_link_kind kind,
+		    const char *key, size_t len, bool method);
+static int	link_jcf_symbol(struct jcf_state *jcf,
+		    enum jcf_link_kind kind, const char *key, size_t len,
+		    bool method);
+static void	report_jcf_link(void *arg, const struct jcf_link_symbol *symbol,
+		    enum jcf_link_finding finding);
+static int	check_jcf_links(struct jcf_state *jcf,
+		    const struct jcf_inputs *inputs, bool batch_flag);
+static int	graph_jcf_key(struct jcf_state *jcf,
+		    enum jcf_record_kind kind, const char *key, size_t len);
+static int	graph_jcf_use(struct jcf_state *jcf, const char *name,
+		    size_t len);
+static int	index_jcf_symbol(struct jcf_state *jcf, const char *key,
+		    size_t len);
+static void	index_jcf_class(struct jcf_state *jcf, size_t start);
+static int	query_jcf_index(const char *path, char **symbols,
+		    int nsymbols);
+static void	fingerprint_jcf(struct jcf_state *jcf,
+		    enum jcf_parse_kind kind, uint16_t access_flags,
+		    const char *text, size_t len);
+static int	print_jcf_fingerprint(struct jcf_state *jcf);
+static void	print_jcf_name(struct jcf_state *jcf, uint32_t id);
+static int	print_jcf_cycles(struct jcf_state *jcf, const char *kind,
+		    uint32_t nnodes, const uint32_t *names,
+		    const uint32_t *component, uint32_t ncomponents);
+static int	print_jcf_package_cycles(struct jcf_state *jcf,
+		    const struct jcf_graph *graph, const uint32_t *names);
+static int	print_jcf_dependents(struct jcf_state *jcf,
+		    const struct jcf_graph *graph, const uint32_t *names,
+		    const uint32_t *node, uint32_t limit,
+		    const uint32_t *component, const struct jcf_graph *dag,
+		    const char *queries, int nthreads);
+static int	check_jcf_graph(struct jcf_state *jcf,
+		    const struct jcf_inputs *inputs, bool cycles_flag,
+		    const char *queries, int nthreads);
+static int	process_jcf_event(void *arg,
+		    const struct jcf_parse_event *event);
+static int	process_jcf_image(struct jcf_state *jcf);
+static int	open_jcf_input(struct jcf_state *jcf,
+		    const struct jcf_input *input);
+static int	jcf_input_key(const struct jcf_input *input,
+		    struct jcf_cache_key *key);
+static int	process_jcf_cached(struct jcf_state *jcf,
+		    const struct jcf_input *input);
+static int	process_jcf_input(struct jcf_state *jcf,
+		    const struct jcf_input *input);
+static int	jcf_inputs_add(struct jcf_inputs *inputs, const char *path);
+static int	jcf_inputs_add_dir(struct jcf_inputs *inputs,
+		    const char *dirname);
+static int	jcf_inputs_add_list(struct jcf_inputs *inputs,
+		    const char *listname);
+static int	jcf_inputs_add_archive(struct jcf_inputs *inputs,
+		    const char *path);
+static int	jcf_inputs_append(struct jcf_inputs *inputs, const char *path,
+		    struct jcf_archive *archive, size_t entry);
+static bool	jcf_has_suffix(const char *name, const char *suffix);
+static void	jcf_inputs_destroy(struct jcf_inputs *inputs);
+static int	jcf_compare_names(const void *a, const void *b);
+static bool	jcf_worker_take(struct jcf_worker *worker, size_t *indexp);
+static bool	jcf_worker_steal(struct jcf_worker *worker, size_t *indexp);
+static void	*jcf_worker_main(void *arg);
+static int	process_jcf_inputs(struct jcf_state *jcf,
+		    struct jcf_inputs *inputs, bool batch_flag);
+static int	process_jcf_inputs_parallel(struct jcf_state *jcf,
+		    struct jcf_inputs *inputs, bool batch_flag, int nworkers);
+static int	serve_jcf_input(struct jcf_daemon *daemon,
+		    struct jcf_state *jcf, const struct jcf_input *input);
+static int	serve_jcf_analyze(struct jcf_daemon *daemon,
+		    struct jcf_state *jcf, char *paths);
+static int	index_jcf_graph(struct jcf_daemon *daemon);
+static int	serve_jcf_graph(struct jcf_daemon *daemon,
+		    struct jcf_state *jcf, const char *queries);
+static int	serve_jcf_request(void *arg, int worker, const char *request,
+		    size_t length, char **replyp, size_t *lengthp);
+static int	serve_jcf(struct jcf_state *jcf, struct jcf_inputs *inputs,
+		    const char *path, int nworkers);
 
 /*
  * Requires:
  *   Nothing.
  *
  * Effects:
- *   Prints a formatted error message to stderr.
+ *   Prints a formatted error message to stderr.  If "filename" is not
+ *   NULL, the message names the file.
  */
 static void
-readjcf_error(void)
+readjcf_error(const char *filename)
 {
+	if (filename != NULL)
+		fprintf(stderr, "%s: ", filename);
 	fprintf(stderr, "ERROR: Unable to process file!\n");
 }
 
 /*
  * Requires:
- *   The constant pool must be initialized.
+ *   The "jcf" argument must be a valid struct jcf_state.
  *
  * Effects:
- *   If the index is valid and points to a constant of the expected type,
- *   this function will print the constant and return 0.  Otherwise, -1
- *   is returned.
+ *   Prints the error message for the current file.  Output that is
+ *   bound for a file descriptor is flushed first, so that the message
+ *   follows the file's output lines as it would if stdout were not
+ *   buffered.  A server prints the message in its reply instead.
  */
-static int
-print_jcf_constant(struct jcf_state *jcf, uint16_t index,uint8_t expected_tag)
+static void
+print_jcf_error(struct jcf_state *jcf)
 {
-    	/* 
-	 * "Info" should be a pointer that points to one jcf_cp_info struct inside the constant_pool.
-    	 * As for which one, specifically, you would have to index into the const_pool array.
-	 */
-    
-    	struct jcf_cp_info *info; 
-
-    	assert(jcf != NULL);
-	
-    	// Verify the index.
-    	if (index > 0 && index < jcf->constant_pool.count) {
-        	info = jcf->constant_pool.pool[index];
-	} else
-        	return -1;
-
-    	// Verify the tag.
-    	if (info->tag != expected_tag)
-        	return -1;
-
-	struct jcf_cp_class_info *class_info;
-	struct jcf_cp_nameandtype_info *nameAndType_info;
-	struct jcf_cp_ref_info *ref_info;
-	struct jcf_cp_utf8_info *utf8_info;;
-
-	// Print the constant. 
-	switch (info->tag) {
-	case JCF_CONSTANT_Class:
-		// Print the class.
-		class_info = (struct jcf_cp_class_info*) info;
-		print_jcf_constant(jcf, class_info->name_index, JCF_CONSTANT_Utf8);
-		break;
-		
-	case JCF_CONSTANT_Fieldref:
-	case JCF_CONSTANT_Methodref:
-	case JCF_CONSTANT_InterfaceMethodref:
-		/* 
-		* Print the reference, with the Class and NameAndType
-		* separated by a '.'.
-		*/
-		ref_info = (struct jcf_cp_ref_info*) info;
-		print_jcf_constant(jcf, ref_info->class_index, JCF_CONSTANT_Class);
-		printf(".");
-		print_jcf_constant(jcf, ref_info->name_and_type_index, JCF_CONSTANT_NameAndType);
-		break;
-	
-	case JCF_CONSTANT_NameAndType:
-		// Print the name and type.
-		nameAndType_info = (struct jcf_cp_nameandtype_info*) info;
-		print_jcf_constant(jcf, nameAndType_info->name_index, JCF_CONSTANT_Utf8);
-		printf(" ");
-		print_jcf_constant(jcf, nameAndType_info->descriptor_index, JCF_CONSTANT_Utf8);
-		break;
-		
-	case JCF_CONSTANT_Utf8:
-		// Print the UTF8.
-		utf8_info = (struct jcf_cp_utf8_info*)info;
-		printf("%s", utf8_info->bytes);
-		break;
-		
-	default:
-		// Ignore all other constants.
-		return (-1);
-		break;
-	}	
-	return (0);
+	assert(jcf != NULL);
+
+	if (jcf->serving) {
+		if (jcf->filename != NULL) {
+			jcf_out_str(&jcf->out, jcf->filename);
+			jcf_out_bytes(&jcf->out, ": ", 2);
+		}
+		jcf_out_str(&jcf->out, "ERROR: Unable to process file!\n");
+		return;
+	}
+	jcf_out_flush(&jcf->out);
+	readjcf_error(jcf->filename);
 }
 
 /*
  * Requires:
- *   The "jcf" argument must be a valid struct jcf_state.  "jcf.f" must
- *   be a valid open file.
+ *   "image" must point to a struct jcf_image.
  *
  * Effects:
- *   Reads and verifies the Java class file header from file "jcf.f".
+ *   Makes the entire contents of the file "filename" available through
+ *   "image".  The file is mapped if possible.  Otherwise, it is read
+ *   into memory all at once.
  *   Returns 0 on success and -1 on failure.
  */
 static int
-process_jcf_header(struct jcf_state *jcf)
+jcf_image_open(struct jcf_image *image, const char *filename)
 {
-	struct jcf_header info;
+	struct stat sb;
+	uint8_t *buf, *newbuf;
+	size_t cap;
+	ssize_t n;
+	int fd;
 
-	assert(jcf != NULL);
+	assert(image != NULL);
 
-	// Read the header.
-	if (fread(&info, sizeof(info), 1, jcf->f) != 1)
+	image->base = NULL;
+	image->len = 0;
+	image->kind = JCF_IMAGE_READ;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return (-1);
+	if (fstat(fd, &sb) != 0) {
+		close(fd);
 		return (-1);
-	
-	info.magic = ntohl(info.magic);
-	info.minor_version = ntohs(info.minor_version);
-	info.major_version = ntohs(info.major_version);
+	}
+
+	// Map regular files.  The mapping outlives the descriptor.
+	if (S_ISREG(sb.st_mode) && sb.st_size > 0) {
+		buf = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (buf != MAP_FAILED) {
+			close(fd);
+			image->base = buf;
+			image->len = sb.st_size;
+			image->kind = JCF_IMAGE_MAPPED;
+			return (0);
+		}
+	}
 
-	// Verify the magic number.
-	if (info.magic != JCF_MAGIC)
+	/*
+	 * Otherwise, read the whole file into a buffer, growing it as
+	 * needed because the size of a pipe or device is not known.
+	 */
+	cap = S_ISREG(sb.st_mode) && sb.st_size > 0 ? sb.st_size : 8192;
+	buf = malloc(cap);
+	if (buf == NULL) {
+		close(fd);
 		return (-1);
+	}
+	for (;;) {
+		if (image->len == cap) {
+			cap *= 2;
+			newbuf = realloc(buf, cap);
+			if (newbuf == NULL)
+				break;
+			buf = newbuf;
+		}
+		n = read(fd, buf + image->len, cap - image->len);
+		if (n == 0) {
+			close(fd);
+			image->base = buf;
+			return (0);
+		}
+		if (n < 0)
+			break;
+		image->len += n;
+	}
+	free(buf);
+	close(fd);
+	image->len = 0;
+	return (-1);
+}
 
-	return (0);
+/*
+ * Requires:
+ *   "image" must have been successfully opened by jcf_image_open() or
+ *   be a borrowed image.
+ *
+ * Effects:
+ *   Releases the memory holding the class file image, unless it is
+ *   borrowed.
+ */
+static void
+jcf_image_close(struct jcf_image *image)
+{
+	assert(image != NULL);
+
+	if (image->kind == JCF_IMAGE_MAPPED)
+		munmap((void *)image->base, image->len);
+	else if (image->kind == JCF_IMAGE_READ)
+		free((void *)image->base);
+	image->base = NULL;
+	image->len = 0;
 }
 
+
 /*
  * Requires:
- *   The "jcf" argument must be a valid struct jcf_state.  "jcf.f" must
- *   be a valid open file.  The JCF header must have already been read.
+ *   The "jcf" argument must be a valid struct jcf_state.
  *
  * Effects:
- *   Reads and stores the constant pool from the JCF.  Prints the
- *   dependencies if requested.  Returns 0 on success and -1 on failure.
- *   This function allocates memory that must be destroyed later, even if
- *   the function fails.
+ *   Starts an output line of the given kind.  When several class files
+ *   are processed, the line starts with the name of the current file.
  */
+static void
+print_jcf_prefix(struct jcf_state *jcf, const char *kind)
+{
+	assert(jcf != NULL);
 
-static int
-process_jcf_constant_pool(struct jcf_state *jcf)
+	if (jcf->filename != NULL) {
+		jcf_out_str(&jcf->out, jcf->filename);
+		jcf_out_bytes(&jcf->out, ": ", 2);
+	}
+	jcf_out_str(&jcf->out, kind);
+	jcf_out_bytes(&jcf->out, " - ", 3);
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_state.  "text" must
+ *   point to "len" bytes.
+ *
+ * Effects:
+ *   Prints an output line of the given kind with the given text, and
+ *   records it if the current file's results are being recorded.  Its
+ *   bytes are counted if statistics are kept.
+ */
+static void
+print_jcf_line(struct jcf_state *jcf, enum jcf_record_kind kind,
+    const char *text, size_t len)
 {
-	int 	i; 		// counter for the for loop
-	uint16_t 	constant_pool_count;
-	uint8_t 	tag; 	// tag of elements from constant pool
-	uint16_t   	length; // to get the utf8 array length
+	assert(jcf != NULL);
+
+	print_jcf_prefix(jcf, jcf_record_names[kind]);
+	jcf_out_bytes(&jcf->out, text, len);
+	jcf_out_char(&jcf->out, '\n');
+	if (jcf->stats != NULL) {
+		jcf->stats->file.output += (jcf->filename != NULL ?
+		    strlen(jcf->filename) + 2 : 0) +
+		    strlen(jcf_record_names[kind]) + 3 + len + 1;
+	}
+	if (jcf->recording)
+		record_jcf_result(jcf, kind, text, len);
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_state.  "kind" must
+ *   be JCF_RECORD_DEPENDENCY or JCF_RECORD_EXPORT, and "event" a
+ *   dependency or export, with the offsets of its name and descriptor.
+ *
+ * Effects:
+ *   Prints the event's line like print_jcf_line().  If the lines are
+ *   binary, keeps it in "jcf.binary" instead, and records it with the
+ *   offsets before its text, so that a replay can keep it too.
+ */
+static void
+print_jcf_member(struct jcf_state *jcf, enum jcf_record_kind kind,
+    const struct jcf_parse_event *event)
+{
+	uint32_t offsets[3], length;
 
 	assert(jcf != NULL);
-	assert(jcf->constant_pool.pool == NULL);
 
-	// Read the constant pool count.
+	if (!jcf->binary_flag) {
+		print_jcf_line(jcf, kind, event->text, event->length);
+		return;
+	}
+	record_jcf_binary(jcf, kind, event);
+	if (jcf->recording) {
+		offsets[0] = event->name_offset;
+		offsets[1] = event->name_length;
+		offsets[2] = event->descriptor_offset;
+		length = sizeof(offsets) + event->length;
+		jcf_out_char(&jcf->record, kind);
+		jcf_out_bytes(&jcf->record, &length, sizeof(length));
+		jcf_out_bytes(&jcf->record, offsets, sizeof(offsets));
+		jcf_out_bytes(&jcf->record, event->text, event->length);
+	}
+}
 
-	if (fread(&constant_pool_count, sizeof(constant_pool_count), 1, jcf->f) != 1)
-		return (-1);
-	
-	constant_pool_count = ntohs(constant_pool_count);
-	jcf->constant_pool.count = constant_pool_count;
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_state.  "kind" must
+ *   be an enum jcf_record_kind, plus a link kind for JCF_RECORD_LINK.
+ *   "text" must point to "len" bytes.
+ *
+ * Effects:
+ *   Appends a record of the given kind and text to "jcf.record".
+ */
+static void
+record_jcf_result(struct jcf_state *jcf, unsigned int kind,
+    const char *text, size_t len)
+{
+	uint32_t length = len;
 
-	// Allocate memory to the constant pool array of pointers.
-	jcf->constant_pool.pool = malloc(constant_pool_count * sizeof(struct jcf_cp_info *));
-	
-	struct jcf_cp_info_2u2 *info_2u2;
-	struct jcf_cp_info_1u2 *info_1u2;
-	struct jcf_cp_info_1u4 *info_1u4;
-	struct jcf_cp_info_2u4 *info_2u4;
-	struct jcf_cp_utf8_info *info_utf8;
-	struct jcf_cp_info_1u1_1u2 *info_1u2u;
+	assert(jcf != NULL);
 
-	// Read the constant pool.
-	for (i = 1; i < constant_pool_count; i++) {
+	jcf_out_char(&jcf->record, kind);
+	jcf_out_bytes(&jcf->record, &length, sizeof(length));
+	jcf_out_bytes(&jcf->record, text, len);
+}
 
-		// Read the constant pool info tag.
-		if (fread(&tag, sizeof(tag), 1, jcf->f) != 1) {
-			fprintf(stderr, "size of tag is incorrect\n");
-			return (-1);
-		}
-	
-		// Process the rest of the constant info.
-		switch (tag) {
-		case JCF_CONSTANT_String:
-		case JCF_CONSTANT_Class:
-		case JCF_CONSTANT_MethodType:
-
-			// allocate memory for the specific strucutre in the cp array
-			jcf->constant_pool.pool[i] = malloc(sizeof(struct jcf_cp_info_1u2*));
-
-			// allocate memoery for the actual structure.
-			info_1u2 = (struct jcf_cp_info_1u2 *)malloc(sizeof(struct jcf_cp_info_1u2));
-	
-			// Read a constant that conatains one u2.
-			if (fread(&info_1u2->u2, sizeof(info_1u2->u2), 1, jcf->f) != 1) {
-				fprintf(stderr, "size of info_1u2->u2 is incorrect\n");
-				return (-1);
-			}
+/*
+ * Requires:
+ *   "kind" must be JCF_RECORD_DEPENDENCY or JCF_RECORD_EXPORT.  "text"
+ *   must point to the "len" bytes of a record that print_jcf_member()
+ *   recorded for binary lines.
+ *
+ * Effects:
+ *   Stores in "*event" the dependency or export that the record holds.
+ *   Returns 0 on success and -1 if the offsets do not lie within the
+ *   record's text.
+ */
+static int
+read_jcf_member(enum jcf_record_kind kind, const char *text, size_t len,
+    struct jcf_parse_event *event)
+{
+	uint32_t offsets[3];
 
-			info_1u2->u2 = ntohs(info_1u2->u2);
-			info_1u2->tag = tag;
-			jcf->constant_pool.pool[i] = (struct jcf_cp_info *)info_1u2;
-			break;
+	if (len < sizeof(offsets))
+		return (-1);
+	memcpy(offsets, text, sizeof(offsets));
+	memset(event, 0, sizeof(*event));
+	event->text = text + sizeof(offsets);
+	event->length = len - sizeof(offsets);
+	event->name_offset = offsets[0];
+	event->name_length = offsets[1];
+	event->descriptor_offset = offsets[2];
+
+	// A dependency's class ends before the '.' that precedes its name.
+	if ((kind == JCF_RECORD_DEPENDENCY && event->name_offset == 0) ||
+	    event->name_offset > event->length ||
+	    event->name_length > event->length - event->name_offset ||
+	    event->descriptor_offset > event->length)
+		return (-1);
+	return (0);
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_state.  "kind" must
+ *   be JCF_RECORD_DEPENDENCY or JCF_RECORD_EXPORT, and the class that
+ *   is being processed must be known for an export.  "event" must be a
+ *   dependency or export, with the offsets of its name and descriptor.
+ *
+ * Effects:
+ *   Appends the line to "jcf.binary" as a record of its kind, the
+ *   lengths of its class, name and descriptor, and their bytes.  The
+ *   class of an export is the class that is being processed.
+ */
+static void
+record_jcf_binary(struct jcf_state *jcf, enum jcf_record_kind kind,
+    const struct jcf_parse_event *event)
+{
+	uint32_t lengths[3];
+	const char *class;
+
+	assert(jcf != NULL);
 
-		case JCF_CONSTANT_Fieldref:
-		case JCF_CONSTANT_Methodref:
-		case JCF_CONSTANT_InterfaceMethodref:
-		case JCF_CONSTANT_NameAndType:
-		case JCF_CONSTANT_InvokeDynamic:
+	if (kind == JCF_RECORD_EXPORT) {
+		class = jcf->class_name;
+		lengths[0] = jcf->class_length;
+	} else {
+		class = event->text;
+		lengths[0] = event->name_offset - 1;
+	}
+	lengths[1] = event->name_length;
+	lengths[2] = event->length - event->descriptor_offset;
+	jcf_out_char(&jcf->binary, kind);
+	jcf_out_bytes(&jcf->binary, lengths, sizeof(lengths));
+	jcf_out_bytes(&jcf->binary, class, lengths[0]);
+	jcf_out_bytes(&jcf->binary, event->text + event->name_offset,
+	    lengths[1]);
+	jcf_out_bytes(&jcf->binary, event->text + event->descriptor_offset,
+	    lengths[2]);
+}
 
-			// Read a constant that contains two u2's.
+/*
+ * Requires:
+ *   "bin" must have been started by jcf_bin_create().  "buf" must point
+ *   to "len" bytes of records that record_jcf_binary() appended for the
+ *   class file "path".
+ *
+ * Effects:
+ *   Writes a binary record for each of the records, interning its
+ *   class, name and descriptor.  A failure is reported by
+ *   jcf_bin_finish().
+ */
+static void
+write_jcf_binary(struct jcf_bin_writer *bin, const char *path,
+    const char *buf, size_t len)
+{
+	struct jcf_bin_record record;
+	const char *p, *end, *class, *name, *descriptor;
+	uint32_t lengths[3];
+
+	if (len == 0 || jcf_bin_intern(bin, path, strlen(path),
+	    &record.file) != 0)
+		return;
+	for (p = buf, end = buf + len; p < end; p = descriptor + lengths[2]) {
+		record.kind = *p == JCF_RECORD_EXPORT ? JCF_BIN_EXPORT :
+		    JCF_BIN_DEPENDENCY;
+		memcpy(lengths, p + 1, sizeof(lengths));
+		class = p + 1 + sizeof(lengths);
+		name = class + lengths[0];
+		descriptor = name + lengths[1];
+		if (jcf_bin_intern(bin, class, lengths[0],
+		    &record.class) != 0 ||
+		    jcf_bin_intern(bin, name, lengths[1], &record.name) != 0 ||
+		    jcf_bin_intern(bin, descriptor, lengths[2],
+		    &record.descriptor) != 0)
+			return;
+		jcf_bin_add(bin, &record);
+	}
+}
 
-			// Allocate space in the constant pool array.
-			jcf->constant_pool.pool[i] = malloc(sizeof(struct jcf_cp_info_2u2*)); 
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_state.  "jcf.record"
+ *   must hold the records of a file that were found in the cache.
+ *
+ * Effects:
+ *   Prints the output lines and collects the link symbols, graph edges
+ *   and indexed symbols that the records describe, as processing the
+ *   file would have.  Returns 0 on success and -1 if the records are
+ *   malformed, in which case nothing is printed or collected, or if a
+ *   symbol could not be collected.
+ */
+static int
+replay_jcf_records(struct jcf_state *jcf)
+{
+	struct jcf_parse_event event;
+	const char *p, *end;
+	uint32_t length;
+	size_t nindexed = jcf->index != NULL ? jcf->index->count : 0;
+	int pass;
 
-			// Allocate new space for strucuture.
-			info_2u2 = (struct jcf_cp_info_2u2 *) malloc(sizeof(struct jcf_cp_info_2u2));
+	assert(jcf != NULL);
 
-			// Read the body.
-			if (fread(&info_2u2->body, sizeof(info_2u2->body), 1, jcf->f) != 1) {
-				fprintf(stderr, "size of info_2u2->u2 is incorrect\n");
+	/*
+	 * Check every record before acting on any of them, so that a
+	 * malformed entry can be ignored.
+	 */
+	for (pass = 0; pass < 2; pass++) {
+		p = jcf->record.buf;
+		end = p + jcf->record.len;
+		while (p < end) {
+			if (end - p < 1 + (ptrdiff_t)sizeof(length))
 				return (-1);
-			}
-				
-			info_2u2->body.u2_1 = ntohs(info_2u2->body.u2_1);
-			info_2u2->body.u2_2 = ntohs(info_2u2->body.u2_2);
-			info_2u2->tag = tag;
-
-			jcf->constant_pool.pool[i] = (struct jcf_cp_info *)info_2u2;   
-			break;   
-		
-		case JCF_CONSTANT_Integer:
-		case JCF_CONSTANT_Float:
-
-			// Allocate memory for the specific strucutre in the cp array.
-			jcf->constant_pool.pool[i] = malloc(sizeof(struct jcf_cp_info_1u4*));
-
-			// Allocate memoery for the actual structure.
-			info_1u4 = (struct jcf_cp_info_1u4 *)malloc(sizeof(struct jcf_cp_info_1u4));
-	
-			// Read a constant that contains one u4.
-			if (fread(&info_1u4->u4, sizeof(info_1u4->u4), 1, jcf->f) != 1)
+			memcpy(&length, p + 1, sizeof(length));
+			if ((size_t)(end - p) - 1 - sizeof(length) < length ||
+			    (uint8_t)*p > JCF_RECORD_LINK + JCF_LINK_INTERFACE)
 				return (-1);
-			
-			info_1u4->u4 = ntohl(info_1u4->u4);
-			info_1u4->tag = tag;
-			jcf->constant_pool.pool[i] = (struct jcf_cp_info *)info_1u4;    
-			break;
-
-		case JCF_CONSTANT_Long:
-		case JCF_CONSTANT_Double:
-			
-			/* 
-			* Read a constant that contains two u4's and
-			* occupies two indices in the constant pool. 
-			*/
 
-			// Allocate memory for both parts of 2 u4.
-			jcf->constant_pool.pool[i] = malloc(sizeof(struct jcf_cp_info_2u4*));
+			// A binary line's record holds its member's offsets.
+			if (jcf->binary_flag && (uint8_t)*p <=
+			    JCF_RECORD_EXPORT) {
+				if (read_jcf_member((uint8_t)*p, p + 1 +
+				    sizeof(length), length, &event) != 0)
+					return (-1);
+				if (pass == 1)
+					print_jcf_member(jcf, (uint8_t)*p,
+					    &event);
+			} else if (pass == 1 &&
+			    (uint8_t)*p < JCF_RECORD_CLASS) {
+				print_jcf_line(jcf, (uint8_t)*p,
+				    p + 1 + sizeof(length), length);
+			} else if (pass == 1 && (uint8_t)*p ==
+			    JCF_RECORD_SYMBOL) {
+				if (jcf->index != NULL && index_jcf_symbol(jcf,
+				    p + 1 + sizeof(length), length) != 0)
+					return (-1);
+			} else if (pass == 1 && (uint8_t)*p < JCF_RECORD_LINK) {
+				if ((uint8_t)*p == JCF_RECORD_CLASS) {
+					jcf->class_name = p + 1 +
+					    sizeof(length);
+					jcf->class_length = length;
+				}
+				if ((jcf->graph != NULL || jcf->index !=
+				    NULL) && graph_jcf_key(jcf, (uint8_t)*p,
+				    p + 1 + sizeof(length), length) != 0)
+					return (-1);
+			} else if ((uint8_t)*p >= JCF_RECORD_LINK) {
+				if (length == 0)
+					return (-1);
+				if (pass == 1 && jcf->link != NULL &&
+				    link_jcf_key(jcf, (uint8_t)*p -
+				    JCF_RECORD_LINK, p + 2 + sizeof(length),
+				    length - 1, p[1 + sizeof(length)]) != 0)
+					return (-1);
+			}
+			p += 1 + sizeof(length) + length;
+		}
+	}
+	if (jcf->index != NULL)
+		index_jcf_class(jcf, nindexed);
+	return (0);
+}
 
-			// Allocate memoery for the actual structure of 2u4.
-			info_2u4 = (struct jcf_cp_info_2u4 *)malloc(sizeof(struct jcf_cp_info_2u4));
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_state with a non-NULL
+ *   "link" table.  "key" must point to "len" bytes.  "method" must be
+ *   false for a class.
+ *
+ * Effects:
+ *   Adds a symbol of the given kind to the link table.  The key of a
+ *   member is split at its first '.' into the class name and the name
+ *   and descriptor, which are interned separately, so that the link
+ *   check can find a member's class and can look the member up in other
+ *   classes by comparing IDs.  Neither a class name nor a member name
+ *   may hold a '.'.  The key of a class is interned whole.  Returns 0
+ *   on success and -1 on failure.
+ */
+static int
+link_jcf_key(struct jcf_state *jcf, enum jcf_link_kind kind,
+    const char *key, size_t len, bool method)
+{
+	const char *dot = NULL;
+	uint32_t class, member = JCF_LINK_NONE;
 
-			// Read the 2u4.
-			if (fread(&info_2u4->body, sizeof(info_2u4->body), 1, jcf->f) != 1)
-				return (-1);
+	assert(jcf != NULL);
+	assert(jcf->link != NULL);
 
-			info_2u4->body.u4_1 = ntohl(info_2u4->body.u4_1);
-			info_2u4->body.u4_2 = ntohl(info_2u4->body.u4_2);
-			info_2u4->tag=tag;
+	if (kind == JCF_LINK_REFERENCE || kind == JCF_LINK_DEFINITION ||
+	    kind == JCF_LINK_EXPORT)
+		dot = memchr(key, '.', len);
+	if (jcf_intern_add(jcf->intern, key, dot != NULL ? (size_t)(dot -
+	    key) : len, &class) != 0)
+		return (-1);
+	if (dot != NULL) {
+		dot++;
+		if (jcf_intern_add(jcf->intern, dot, key + len - dot,
+		    &member) != 0)
+			return (-1);
+	}
+	return (jcf_link_add(jcf->link, kind, jcf->file, class, member,
+	    method));
+}
 
-			// Point array to strucutre.
-			jcf->constant_pool.pool[i] = (struct jcf_cp_info *)info_2u4; 
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_state with a non-NULL
+ *   "link" table.  "key" must point to "len" bytes.  "method" must be
+ *   whether a member is a method, as the parser reported it, and false
+ *   for a class.
+ *
+ * Effects:
+ *   Adds the symbol "key" of the given kind to the link table, and
+ *   records it, with whether it is a method, if the current file's
+ *   results are being recorded.  Returns 0 on success and -1 on
+ *   failure.
+ */
+static int
+link_jcf_symbol(struct jcf_state *jcf, enum jcf_link_kind kind,
+    const char *key, size_t len, bool method)
+{
+	uint32_t length = 1 + len;
 
-			i++;        
-			// We need to increase the index because long and doubles are stored accros two indices.
-		
-			break;
+	assert(jcf != NULL);
+	assert(jcf->link != NULL);
 
-		case JCF_CONSTANT_Utf8:
-			// Read a UTF8 constant.
+	if (jcf->recording) {
+		jcf_out_char(&jcf->record, JCF_RECORD_LINK + kind);
+		jcf_out_bytes(&jcf->record, &length, sizeof(length));
+		jcf_out_char(&jcf->record, method);
+		jcf_out_bytes(&jcf->record, key, len);
+	}
+	return (link_jcf_key(jcf, kind, key, len, method));
+}
 
-			// Allocate memory for the specific strucutre in the cp array.
-			jcf->constant_pool.pool[i] = malloc(sizeof(struct jcf_cp_utf8_info*));
-		
-			// Read the length first.
-			if (fread(&length , sizeof(length), 1, jcf->f) != 1) {
-				fprintf(stderr, "size of info_utf8.length is incorrect\n");
-				return (-1);
-			}
+/*
+ * Requires:
+ *   "arg" must point to a struct jcf_link_report.
+ *
+ * Effects:
+ *   Prints a finding of the link check as an "Unresolved" or
+ *   "Unreferenced" line.  The line names the file that the symbol came
+ *   from when several class files are processed.
+ */
+static void
+report_jcf_link(void *arg, const struct jcf_link_symbol *symbol,
+    enum jcf_link_finding finding)
+{
+	struct jcf_link_report *report = arg;
+	struct jcf_state *jcf = report->jcf;
+	const char *name;
+	size_t len;
+
+	jcf->filename = report->batch_flag ?
+	    report->inputs->items[symbol->file].path : NULL;
+	print_jcf_prefix(jcf, finding == JCF_LINK_UNRESOLVED ?
+	    "Unresolved" : "Unreferenced");
+	name = jcf_intern_string(jcf->intern, symbol->class, &len);
+	jcf_out_bytes(&jcf->out, name, len);
+	if (symbol->member != JCF_LINK_NONE) {
+		name = jcf_intern_string(jcf->intern, symbol->member, &len);
+		jcf_out_char(&jcf->out, '.');
+		jcf_out_bytes(&jcf->out, name, len);
+	}
+	jcf_out_char(&jcf->out, '\n');
+}
 
-			// Flip lenght and allocate memory of length+1 for the bytes array and null termination.
-			length = ntohs(length);
-			info_utf8 = malloc(sizeof(struct jcf_cp_utf8_info) + length + 1);
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_state whose "link"
+ *   table holds the symbols of "inputs".
+ *
+ * Effects:
+ *   Joins the references in the link table against its definitions and
+ *   prints the references that are not resolved and the exports that
+ *   are not referenced.  Returns 0 on success and -1 on failure.
+ */
+static int
+check_jcf_links(struct jcf_state *jcf, const struct jcf_inputs *inputs,
+    bool batch_flag)
+{
+	struct jcf_link_report report;
 
-			// Store the values.
-			info_utf8->length = length;	
-			info_utf8->tag = tag;
+	assert(jcf != NULL);
+	assert(jcf->link != NULL);
+
+	report.jcf = jcf;
+	report.inputs = inputs;
+	report.batch_flag = batch_flag;
+	if (jcf_link_check(jcf->link, inputs->count, report_jcf_link,
+	    &report) != 0) {
+		readjcf_error(NULL);
+		return (-1);
+	}
+	return (0);
+}
 
-			// Read the bytes.
-			if (fread(&info_utf8->bytes, sizeof(info_utf8->bytes[0]), info_utf8->length, jcf->f) != info_utf8->length)
-				return (-1);
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_state with a non-NULL
+ *   "graph" or "index" table.  "kind" must be JCF_RECORD_CLASS or, if
+ *   there is a "graph" table, JCF_RECORD_USE.  "key" must point to
+ *   "len" bytes.
+ *
+ * Effects:
+ *   Interns the class name "key" and adds it to the dependency graph,
+ *   if there is one, either as the class that the following uses are
+ *   from or as a class that it uses.  The class is also the one that
+ *   the file's indexed symbols are referenced by.  Records it if the
+ *   current file's results are being recorded.  Returns 0 on success
+ *   and -1 on failure.
+ */
+static int
+graph_jcf_key(struct jcf_state *jcf, enum jcf_record_kind kind,
+    const char *key, size_t len)
+{
+	uint32_t id;
 
-			// Null terminate the array.
-			info_utf8->bytes[length] = '\0';
-			
-			// Store and cast in cp array.
-			jcf->constant_pool.pool[i] = (struct jcf_cp_info *)info_utf8;
-			info_utf8->length = length + 1;
-			break;
+	assert(jcf != NULL);
+	assert(jcf->graph != NULL || jcf->index != NULL);
 
-		case JCF_CONSTANT_MethodHandle:
-			// Read a constant that contains one u1 and one u2.      
+	if (jcf->recording)
+		record_jcf_result(jcf, kind, key, len);
+	if (jcf_intern_add(jcf->intern, key, len, &id) != 0)
+		return (-1);
+	if (kind == JCF_RECORD_CLASS)
+		jcf->graph_class = id;
+	if (jcf->graph == NULL)
+		return (0);
+	return (jcf_graph_add(jcf->graph, jcf->file, jcf->graph_class, id));
+}
 
-			// Allocate memory for the specific strucutre in the cp array.
-			jcf->constant_pool.pool[i] = malloc(sizeof(struct jcf_cp_info_1u1_1u2*));
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_state with a non-NULL
+ *   "graph" or "index" table.  The class that is being parsed must have
+ *   been added to the graph, if there is one.  "name" must point to
+ *   "len" bytes.
+ *
+ * Effects:
+ *   Adds an edge from the class to the class "name", which a Class
+ *   constant names, and indexes the name as a symbol that the class
+ *   references.  That includes the superclass, the interfaces and the
+ *   class of every field and method reference.  An array class stands
+ *   for its element class, and an array of a primitive type is left
+ *   out.  Returns 0 on success and -1 on failure.
+ */
+static int
+graph_jcf_use(struct jcf_state *jcf, const char *name, size_t len)
+{
+	assert(jcf != NULL);
+	assert(jcf->graph != NULL || jcf->index != NULL);
 
-			// Allocate memoery for the actual structure.
-			info_1u2u = (struct jcf_cp_info_1u1_1u2 *)malloc(sizeof(struct jcf_cp_info_1u1_1u2));
+	// Reduce an array descriptor to its element class.
+	if (len > 0 && name[0] == '[') {
+		while (len > 0 && name[0] == '[') {
+			name++;
+			len--;
+		}
+		if (len < 2 || name[0] != 'L' || name[len - 1] != ';')
+			return (0);
+		name++;
+		len -= 2;
+	}
+	if (jcf->graph != NULL && graph_jcf_key(jcf, JCF_RECORD_USE, name,
+	    len) != 0)
+		return (-1);
+	if (jcf->index != NULL)
+		return (index_jcf_symbol(jcf, name, len));
+	return (0);
+}
 
-			if (fread(&info_1u2u->body, sizeof(info_1u2u->body), 1, jcf->f) != 1)
-				return (-1);
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_state with a non-NULL
+ *   "index" table.  "key" must point to "len" bytes.
+ *
+ * Effects:
+ *   Interns the symbol "key", which the class that is being processed
+ *   references, and adds it to the index table.  The class is not known
+ *   until the file's dependencies have been seen, so it is filled in by
+ *   index_jcf_class() once the file is done.  Records the symbol if the
+ *   current file's results are being recorded.  Returns 0 on success
+ *   and -1 on failure.
+ */
+static int
+index_jcf_symbol(struct jcf_state *jcf, const char *key, size_t len)
+{
+	uint32_t id;
+
+	assert(jcf != NULL);
+	assert(jcf->index != NULL);
+
+	if (jcf->recording)
+		record_jcf_result(jcf, JCF_RECORD_SYMBOL, key, len);
+	if (jcf_intern_add(jcf->intern, key, len, &id) != 0)
+		return (-1);
+	return (jcf_graph_add(jcf->index, jcf->file, JCF_INTERN_NONE, id));
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_state with a non-NULL
+ *   "index" table, whose class file has been processed successfully.
+ *   "start" must be the number of edges in the table before the file.
+ *
+ * Effects:
+ *   Makes the file's class the one that references each symbol that
+ *   the file added to the index table.
+ */
+static void
+index_jcf_class(struct jcf_state *jcf, size_t start)
+{
+	size_t i;
+
+	assert(jcf != NULL);
+	assert(jcf->index != NULL);
+
+	for (i = start; i < jcf->index->count; i++)
+		jcf->index->edges[i].from = jcf->graph_class;
+}
+
+/*
+ * Requires:
+ *   "symbols" must point to "nsymbols" strings.
+ *
+ * Effects:
+ *   Opens the index file "path" and prints a "Referenced" line naming
+ *   the symbol and the class for each class that references each of
+ *   the symbols.  A symbol that is not in the index prints nothing.
+ *   Prints an error message and returns -1 if the index cannot be
+ *   opened or is malformed.  Returns 0 on success.
+ */
+static int
+query_jcf_index(const char *path, char **symbols, int nsymbols)
+{
+	struct jcf_index index;
+	struct jcf_index_cursor cursor;
+	struct jcf_out out;
+	const char *name;
+	size_t length;
+	int err = 0, found, i;
+
+	if (jcf_index_open(&index, path) != 0) {
+		readjcf_error(path);
+		return (-1);
+	}
+	jcf_out_init(&out, STDOUT_FILENO);
+	for (i = 0; i < nsymbols && err == 0; i++) {
+		found = jcf_index_find(&index, symbols[i], strlen(symbols[i]),
+		    &cursor);
+		while (found > 0 && (found = jcf_index_next(&cursor, &name,
+		    &length)) > 0) {
+			jcf_out_str(&out, "Referenced - ");
+			jcf_out_str(&out, symbols[i]);
+			jcf_out_char(&out, ' ');
+			jcf_out_bytes(&out, name, length);
+			jcf_out_char(&out, '\n');
+		}
+		if (found < 0) {
+			jcf_out_flush(&out);
+			readjcf_error(path);
+			err = -1;
+		}
+	}
+	if (jcf_out_flush(&out) != 0)
+		err = -1;
+	jcf_out_destroy(&out);
+	jcf_index_close(&index);
+	return (err);
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_state whose class file
+ *   is being parsed.  "text" must point to "len" bytes.
+ *
+ * Effects:
+ *   Adds a part of the class' public API to its fingerprint: the class
+ *   itself, its superclass, a superinterface or a public member, with
+ *   the access flags that matter to its users.  Each part is hashed on
+ *   its own, with its kind and flags as the seed, and the hashes are
+ *   added, so the fingerprint does not depend on the order of the
+ *   members or of the interfaces.
+ */
+static void
+fingerprint_jcf(struct jcf_state *jcf, enum jcf_parse_kind kind,
+    uint16_t access_flags, const char *text, size_t len)
+{
+	assert(jcf != NULL);
+
+	jcf->fingerprint += jcf_cache_hash((uint64_t)kind << 16 |
+	    access_flags, text, len);
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_state whose class file
+ *   has just been parsed successfully, with its name still in the image.
+ *
+ * Effects:
+ *   Prints a "Fingerprint" line naming the class and its fingerprint, in
+ *   hexadecimal.  The sum of the parts' hashes is hashed once more, so
+ *   that every bit of the fingerprint depends on every part.  Returns 0
+ *   on success and -1 on failure.
+ */
+static int
+print_jcf_fingerprint(struct jcf_state *jcf)
+{
+	char digits[2 * sizeof(uint64_t) + 1];
+
+	assert(jcf != NULL);
+
+	snprintf(digits, sizeof(digits), "%016" PRIx64,
+	    jcf_cache_hash(0, &jcf->fingerprint, sizeof(jcf->fingerprint)));
+	jcf_out_reset(&jcf->key);
+	jcf_out_bytes(&jcf->key, jcf->class_name, jcf->class_length);
+	jcf_out_char(&jcf->key, ' ');
+	jcf_out_str(&jcf->key, digits);
+	if (jcf->key.err != 0)
+		return (-1);
+	print_jcf_line(jcf, JCF_RECORD_FINGERPRINT, jcf->key.buf,
+	    jcf->key.len);
+	return (0);
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_state with a non-NULL
+ *   "intern" table that holds "id".
+ *
+ * Effects:
+ *   Prints the class or package name "id".  The unnamed package, whose
+ *   name is empty, is printed as "<unnamed>".
+ */
+static void
+print_jcf_name(struct jcf_state *jcf, uint32_t id)
+{
+	const char *name;
+	size_t len;
+
+	assert(jcf != NULL);
+
+	name = jcf_intern_string(jcf->intern, id, &len);
+	if (len == 0)
+		jcf_out_str(&jcf->out, "<unnamed>");
+	else
+		jcf_out_bytes(&jcf->out, name, len);
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_state.  "names" must
+ *   hold the ID of each of "nnodes" nodes' names and "component" each
+ *   node's component, of which there are "ncomponents".
+ *
+ * Effects:
+ *   Prints a line of the given kind for each component of more than one
+ *   node, which is a dependency cycle, listing its nodes.  The cycles are
+ *   printed in order of their first node, and their nodes in order.
+ *   Returns 0 on success and -1 on failure.
+ */
+static int
+print_jcf_cycles(struct jcf_state *jcf, const char *kind, uint32_t nnodes,
+    const uint32_t *names, const uint32_t *component, uint32_t ncomponents)
+{
+	uint32_t *starts, *members, c, i, v;
+
+	assert(jcf != NULL);
+
+	// Gather the nodes of each component with a counting sort.
+	starts = calloc((size_t)ncomponents + 1, sizeof(*starts));
+	members = malloc((size_t)nnodes * sizeof(*members));
+	if (starts == NULL || (nnodes > 0 && members == NULL)) {
+		free(starts);
+		free(members);
+		return (-1);
+	}
+	for (v = 0; v < nnodes; v++)
+		starts[component[v] + 1]++;
+	for (c = 0; c < ncomponents; c++)
+		starts[c + 1] += starts[c];
+	for (v = 0; v < nnodes; v++)
+		members[starts[component[v]]++] = v;
+
+	/*
+	 * "starts[c]" is now where component "c + 1" begins.  Print each
+	 * cycle when its first node is met, then mark it as printed.
+	 */
+	for (v = 0; v < nnodes; v++) {
+		c = component[v];
+		i = c > 0 ? starts[c - 1] : 0;
+		if (starts[c] - i < 2 || members[i] != v)
+			continue;
+		jcf->filename = NULL;
+		print_jcf_prefix(jcf, kind);
+		for (; i < starts[c]; i++) {
+			print_jcf_name(jcf, names[members[i]]);
+			jcf_out_char(&jcf->out, i + 1 < starts[c] ? ' ' : '\n');
+		}
+	}
+	free(starts);
+	free(members);
+	return (0);
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_state with a non-NULL
+ *   "intern" table.  "names" must hold the ID of the name of each node
+ *   of "graph".
+ *
+ * Effects:
+ *   Collapses the class graph into the graph of the classes' packages,
+ *   numbered in order of their first class, and prints its cycles as
+ *   "Package cycle" lines.  Returns 0 on success and -1 on failure.
+ */
+static int
+print_jcf_package_cycles(struct jcf_state *jcf, const struct jcf_graph *graph,
+    const uint32_t *names)
+{
+	struct jcf_graph packages;
+	const char *name, *slash;
+	uint32_t *package, *number, *package_names = NULL, *component = NULL;
+	uint32_t limit = 0, npackages = 0, ncomponents, v;
+	size_t len;
+	int err = -1;
+
+	assert(jcf != NULL);
+
+	// Intern each class's package, which is its name up to the last '/'.
+	packages.starts = NULL;
+	packages.targets = NULL;
+	package = malloc((size_t)graph->nnodes * sizeof(*package));
+	if (graph->nnodes > 0 && package == NULL)
+		return (-1);
+	for (v = 0; v < graph->nnodes; v++) {
+		name = jcf_intern_string(jcf->intern, names[v], &len);
+		for (slash = name + len; slash > name && slash[-1] != '/';
+		    slash--)
+			;
+		if (jcf_intern_add(jcf->intern, name, slash > name ?
+		    (size_t)(slash - 1 - name) : 0, &package[v]) != 0)
+			goto done;
+		if (package[v] >= limit)
+			limit = package[v] + 1;
+	}
+
+	/*
+	 * Number the packages and map each class to its package's number.
+	 * The bound on their IDs is found from the IDs themselves, because
+	 * other threads of a server may be adding to the intern table.
+	 */
+	number = malloc((size_t)limit * sizeof(*number));
+	package_names = malloc((size_t)graph->nnodes * sizeof(*package_names));
+	if ((limit > 0 && number == NULL) || (graph->nnodes > 0 &&
+	    package_names == NULL)) {
+		free(number);
+		goto done;
+	}
+	memset(number, 0xff, (size_t)limit * sizeof(*number));
+	for (v = 0; v < graph->nnodes; v++) {
+		if (number[package[v]] == UINT32_MAX) {
+			package_names[npackages] = package[v];
+			number[package[v]] = npackages++;
+		}
+		package[v] = number[package[v]];
+	}
+	free(number);
+
+	// Find and print the cycles among the packages.
+	component = malloc((size_t)npackages * sizeof(*component));
+	if ((npackages > 0 && component == NULL) ||
+	    jcf_graph_quotient(&packages, npackages, graph, package) != 0 ||
+	    jcf_graph_components(&packages, component, &ncomponents) != 0 ||
+	    print_jcf_cycles(jcf, "Package cycle", npackages, package_names,
+	    component, ncomponents) != 0)
+		goto done;
+	err = 0;
+
+done:
+	jcf_graph_destroy(&packages);
+	free(package);
+	free(package_names);
+	free(component);
+	return (err);
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_state with a non-NULL
+ *   "intern" table.  "names" must hold the ID of the name of each node
+ *   of "graph", "node" the node of each ID less than "limit", as
+ *   jcf_graph_collect() stores them, and "component" each node's
+ *   component, as numbered by jcf_graph_components().  "dag" must be
+ *   the quotient of "graph" by "component".  "queries" must be a comma
+ *   separated list of class names.
+ *
+ * Effects:
+ *   Prints an "Invalidates" line for each class that depends, directly
+ *   or not, on a class in "queries", naming the queried class and the
+ *   dependent.  The queries are answered together over the acyclic
+ *   graph of the components, on up to "nthreads" threads.  A queried
+ *   class that is not in the graph has no dependents.  Returns 0 on
+ *   success and -1 on failure.
+ */
+static int
+print_jcf_dependents(struct jcf_state *jcf, const struct jcf_graph *graph,
+    const uint32_t *names, const uint32_t *node, uint32_t limit,
+    const uint32_t *component, const struct jcf_graph *dag,
+    const char *queries, int nthreads)
+{
+	const char *name, *end;
+	uint32_t *nodes, *sources = NULL, id, ncomponents = dag->nnodes, v;
+	uint64_t *reach = NULL;
+	size_t nqueries = 1, nsources = 0, q, w;
+	int err = -1;
+
+	assert(jcf != NULL);
+
+	// Find the node of each queried class.
+	for (name = queries; *name != '\0'; name++) {
+		if (*name == ',')
+			nqueries++;
+	}
+	nodes = malloc(nqueries * sizeof(*nodes));
+	sources = calloc(nqueries, sizeof(*sources));
+	if (nodes == NULL || sources == NULL) {
+		free(nodes);
+		free(sources);
+		return (-1);
+	}
+	for (name = queries; *name != '\0'; name = end) {
+		end = strchr(name, ',');
+		if (end == NULL)
+			end = name + strlen(name);
+		if (end > name && jcf_intern_find(jcf->intern, name,
+		    end - name, &id) == 0 && id < limit &&
+		    (v = node[id]) != JCF_GRAPH_NONE) {
+			nodes[nsources] = v;
+			sources[nsources++] = component[v];
+		}
+		if (*end == ',')
+			end++;
+	}
+
+	// Find the components that reach each queried class's component.
+	reach = malloc((nsources + 63) / 64 * ncomponents * sizeof(*reach));
+	if ((nsources > 0 && ncomponents > 0 && reach == NULL) ||
+	    jcf_graph_reach(dag, true, sources, nsources, nthreads,
+	    reach) != 0)
+		goto done;
+
+	jcf->filename = NULL;
+	for (q = 0; q < nsources; q++) {
+		w = q / 64 * ncomponents;
+		for (v = 0; v < graph->nnodes; v++) {
+			if (v == nodes[q] ||
+			    ((reach[w + component[v]] >> (q % 64)) & 1) == 0)
+				continue;
+			print_jcf_prefix(jcf, "Invalidates");
+			print_jcf_name(jcf, names[nodes[q]]);
+			jcf_out_char(&jcf->out, ' ');
+			print_jcf_name(jcf, names[v]);
+			jcf_out_char(&jcf->out, '\n');
+		}
+	}
+	err = 0;
+
+done:
+	free(nodes);
+	free(sources);
+	free(reach);
+	return (err);
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_state whose "graph"
+ *   table holds the edges of "inputs".
+ *
+ * Effects:
+ *   Builds the dependency graph of the classes that were read, and of
+ *   every class that they name.  If "cycles_flag" is true, prints the
+ *   cycles among the classes and among their packages.  If "queries" is
+ *   not NULL, prints the classes that depend on each class that it
+ *   lists.  Returns 0 on success and -1 on failure.
+ */
+static int
+check_jcf_graph(struct jcf_state *jcf, const struct jcf_inputs *inputs,
+    bool cycles_flag, const char *queries, int nthreads)
+{
+	struct jcf_graph graph, dag;
+	uint32_t *names, *node, *component = NULL, ncomponents, limit;
+	int err = -1;
+
+	assert(jcf != NULL);
+	assert(jcf->graph != NULL);
+
+	dag.starts = NULL;
+	dag.targets = NULL;
+	limit = jcf_intern_limit(jcf->intern);
+	if (jcf_graph_collect(&graph, &names, &node, jcf->graph,
+	    inputs->count, limit) != 0)
+		goto done;
+	component = malloc((size_t)graph.nnodes * sizeof(*component));
+	if ((graph.nnodes > 0 && component == NULL) ||
+	    jcf_graph_components(&graph, component, &ncomponents) != 0)
+		goto done;
+	if (cycles_flag && (print_jcf_cycles(jcf, "Cycle", graph.nnodes,
+	    names, component, ncomponents) != 0 ||
+	    print_jcf_package_cycles(jcf, &graph, names) != 0))
+		goto done;
+	if (queries != NULL && (jcf_graph_quotient(&dag, ncomponents, &graph,
+	    component) != 0 || print_jcf_dependents(jcf, &graph, names, node,
+	    limit, component, &dag, queries, nthreads) != 0))
+		goto done;
+	err = 0;
+
+done:
+	if (err != 0)
+		readjcf_error(NULL);
+	jcf_graph_destroy(&graph);
+	jcf_graph_destroy(&dag);
+	free(names);
+	free(node);
+	free(component);
+	return (err);
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_state with a non-NULL
+ *   "attributes" list.  "name" must point to "len" bytes.
+ *
+ * Effects:
+ *   Returns true if the attribute name "name" is one of the comma
+ *   separated names in "jcf.attributes" and false otherwise.
+ */
+static bool
+jcf_attribute_requested(struct jcf_state *jcf, const char *name, size_t len)
+{
+	const char *entry, *end;
+
+	assert(jcf != NULL);
+	assert(jcf->attributes != NULL);
+
+	// Compare the name against each entry of the list.
+	for (entry = jcf->attributes; *entry != '\0'; entry = end) {
+		end = strchr(entry, ',');
+		if (end == NULL)
+			end = entry + strlen(entry);
+		if ((size_t)(end - entry) == len &&
+		    memcmp(entry, name, len) == 0)
+			return (true);
+		if (*end == ',')
+			end++;
+	}
+	return (false);
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_state that is not
+ *   processing another file.
+ *
+ * Effects:
+ *   Opens the image of the class file "input", which is either a file
+ *   or an archive entry.  A deflated entry is inflated into the state's
+ *   inflate buffer, which is reused from one entry to the next.  Prints
+ *   an error message and returns -1 on failure.  Returns 0 on success.
+ */
+static int
+open_jcf_input(struct jcf_state *jcf, const struct jcf_input *input)
+{
+	const uint8_t *data;
+	size_t len;
+
+	assert(jcf != NULL);
+	assert(input != NULL);
+
+	if (input->archive == NULL) {
+		if (jcf_image_open(&jcf->image, input->path) != 0) {
+			print_jcf_error(jcf);
+			return (-1);
+		}
+		return (0);
+	}
+	if (jcf_zip_extract(&input->archive->zip, input->entry,
+	    &jcf->inflate_buffer, &jcf->inflate_size, &data, &len) != 0) {
+		print_jcf_error(jcf);
+		return (-1);
+	}
+	jcf->image.base = data;
+	jcf->image.len = len;
+	jcf->image.kind = JCF_IMAGE_BORROWED;
+	return (0);
+}
+
+/*
+ * Requires:
+ *   "input" must be an input of a valid struct jcf_inputs.
+ *
+ * Effects:
+ *   Stores in "key" what identifies the contents of the class file
+ *   "input" without reading it: the size and modification time of a
+ *   file, or the size and CRC of an archive entry.  Returns 0 on success
+ *   and -1 if the file cannot be examined.
+ */
+static int
+jcf_input_key(const struct jcf_input *input, struct jcf_cache_key *key)
+{
+	const struct jcf_zip_entry *entry;
+	struct stat sb;
+
+	assert(input != NULL);
+
+	key->path = input->path;
+	if (input->archive != NULL) {
+		entry = &input->archive->zip.entries[input->entry];
+		key->size = entry->size;
+		key->mtime_sec = 0;
+		key->mtime_nsec = 0;
+		key->hash = entry->crc;
+		key->hashed = true;
+	} else if (stat(input->path, &sb) == 0) {
+		key->size = sb.st_size;
+		key->mtime_sec = sb.st_mtim.tv_sec;
+		key->mtime_nsec = sb.st_mtim.tv_nsec;
+		key->hash = 0;
+		key->hashed = false;
+	} else
+		return (-1);
+	return (0);
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_state with a non-NULL
+ *   "cache" that is not processing another file.
+ *
+ * Effects:
+ *   Processes the class file "input" through the cache.  If the cache
+ *   holds the results of an unchanged copy of the file, they are
+ *   replayed without the file being parsed, or even read if its size
+ *   and modification time are enough to show that it is unchanged.
+ *   Otherwise, the file is processed and its results are stored in the
+ *   cache, unless it is malformed.  An archive entry is known by its
+ *   size and CRC, which come from the archive's directory.  Prints an
+ *   error message and returns -1 on failure.  Returns 0 on success.
+ */
+static int
+process_jcf_cached(struct jcf_state *jcf, const struct jcf_input *input)
+{
+	struct jcf_cache_key key;
+	enum jcf_cache_status status;
+	bool opened = false;
+	int err;
+
+	assert(jcf != NULL);
+	assert(jcf->cache != NULL);
+
+	if (jcf_input_key(input, &key) != 0) {
+		print_jcf_error(jcf);
+		return (-1);
+	}
+
+	// Look the file up, hashing its contents if its time has changed.
+	jcf_out_reset(&jcf->record);
+	status = jcf_cache_find(jcf->cache, &key, &jcf->record);
+	if (status == JCF_CACHE_VERIFY) {
+		if (open_jcf_input(jcf, input) != 0)
+			return (-1);
+		opened = true;
+		key.size = jcf->image.len;
+		key.hash = jcf_cache_hash(0, jcf->image.base, jcf->image.len);
+		key.hashed = true;
+		status = jcf_cache_find(jcf->cache, &key, &jcf->record);
+
+		/*
+		 * Store the entry again under the new time, so that the
+		 * next lookup need not read the file.
+		 */
+		if (status == JCF_CACHE_HIT) {
+			jcf_image_close(&jcf->image);
+			opened = false;
+			jcf_cache_store(jcf->cache, &key, jcf->record.buf,
+			    jcf->record.len);
+		}
+	}
+	if (status == JCF_CACHE_HIT && jcf->record.err == 0 &&
+	    replay_jcf_records(jcf) == 0)
+		return (0);
+
+	// Process the file, recording its results.
+	if (!opened && open_jcf_input(jcf, input) != 0)
+		return (-1);
+	if (input->archive == NULL) {
+		key.size = jcf->image.len;
+		key.hash = jcf_cache_hash(0, jcf->image.base, jcf->image.len);
+		key.hashed = true;
+	}
+	jcf_out_reset(&jcf->record);
+	jcf->recording = true;
+	err = process_jcf_image(jcf);
+	jcf->recording = false;
+	if (err == 0 && jcf->record.err == 0) {
+		jcf_cache_store(jcf->cache, &key, jcf->record.buf,
+		    jcf->record.len);
+	}
+	jcf->record.err = 0;
+	return (err);
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_state that is not
+ *   processing another file.
+ *
+ * Effects:
+ *   Processes the class file "input", which is either a file or an
+ *   archive entry, through the cache if there is one.  Prints an error
+ *   message and returns -1 on failure.  Returns 0 on success.
+ */
+static int
+process_jcf_input(struct jcf_state *jcf, const struct jcf_input *input)
+{
+	assert(jcf != NULL);
+	assert(input != NULL);
+
+	if (jcf->cache != NULL)
+		return (process_jcf_cached(jcf, input));
+	if (open_jcf_input(jcf, input) != 0)
+		return (-1);
+	return (process_jcf_image(jcf));
+}
+
+/*
+ * Requires:
+ *   "arg" must point to a valid struct jcf_state whose class file is
+ *   being parsed.
+ *
+ * Effects:
+ *   Acts on an event of the parse: prints the lines that were requested
+ *   and collects the link symbols, graph edges and indexed symbols.  The
+ *   key of a member for the link check is prefixed with "class." for
+ *   this class, like a reference to the member would be.  Returns 0 on
+ *   success and -1 on failure, which stops the parse.
+ */
+static int
+process_jcf_event(void *arg, const struct jcf_parse_event *event)
+{
+	struct jcf_state *jcf = arg;
+
+	switch (event->kind) {
+	case JCF_PARSE_DEPENDENCY:
+		if (jcf->depends_flag)
+			print_jcf_member(jcf, JCF_RECORD_DEPENDENCY, event);
+		if (jcf->link != NULL && link_jcf_symbol(jcf,
+		    JCF_LINK_REFERENCE, event->text, event->length,
+		    event->method) != 0)
+			return (-1);
+		if (jcf->index != NULL)
+			return (index_jcf_symbol(jcf, event->text,
+			    event->length));
+		return (0);
+
+	case JCF_PARSE_CLASS:
+		jcf->class_name = event->text;
+		jcf->class_length = event->length;
+		if (jcf->fingerprint_flag) {
+			// ACC_SUPER is set by every modern compiler.
+			fingerprint_jcf(jcf, event->kind, event->access_flags &
+			    ~JCF_ACC_SYNCHRONIZED, event->text, event->length);
+		}
+
+		// A binary export names its class, which a replay must know.
+		if (jcf->recording && jcf->binary_flag && jcf->graph == NULL &&
+		    jcf->index == NULL)
+			record_jcf_result(jcf, JCF_RECORD_CLASS, event->text,
+			    event->length);
+		if (jcf->link != NULL && link_jcf_symbol(jcf, JCF_LINK_CLASS,
+		    event->text, event->length, false) != 0)
+			return (-1);
+		if (jcf->graph != NULL || jcf->index != NULL)
+			return (graph_jcf_key(jcf, JCF_RECORD_CLASS,
+			    event->text, event->length));
+		return (0);
+
+	case JCF_PARSE_SUPER:
+		if (jcf->fingerprint_flag)
+			fingerprint_jcf(jcf, event->kind, 0, event->text,
+			    event->length);
+		if (jcf->link != NULL)
+			return (link_jcf_symbol(jcf, JCF_LINK_SUPER,
+			    event->text, event->length, false));
+		return (0);
+
+	case JCF_PARSE_USE:
+		return (graph_jcf_use(jcf, event->text, event->length));
+
+	case JCF_PARSE_INTERFACE:
+		if (jcf->fingerprint_flag)
+			fingerprint_jcf(jcf, event->kind, 0, event->text,
+			    event->length);
+		if (jcf->link != NULL)
+			return (link_jcf_symbol(jcf, JCF_LINK_INTERFACE,
+			    event->text, event->length, false));
+		return (0);
+
+	case JCF_PARSE_MEMBER:
+		jcf_out_reset(&jcf->key);
+		jcf_out_bytes(&jcf->key, jcf->class_name, jcf->class_length);
+		jcf_out_char(&jcf->key, '.');
+		jcf_out_bytes(&jcf->key, event->text, event->length);
+		if (jcf->key.err != 0)
+			return (-1);
+		return (link_jcf_symbol(jcf,
+		    (event->access_flags & JCF_ACC_PUBLIC) != 0 ?
+		    JCF_LINK_EXPORT : JCF_LINK_DEFINITION, jcf->key.buf,
+		    jcf->key.len, event->method));
+
+	case JCF_PARSE_EXPORT:
+		if (jcf->exports_flag)
+			print_jcf_member(jcf, JCF_RECORD_EXPORT, event);
+
+		/*
+		 * Whether a method is synchronized, native or strict does not
+		 * change how it is called.
+		 */
+		if (jcf->fingerprint_flag) {
+			fingerprint_jcf(jcf, event->kind, event->access_flags &
+			    ~(event->method ? JCF_ACC_SYNCHRONIZED |
+			    JCF_ACC_NATIVE | JCF_ACC_STRICT : 0), event->text,
+			    event->length);
+		}
+		return (0);
+
+	case JCF_PARSE_ATTRIBUTE:
+		if (!jcf_attribute_requested(jcf, event->text, event->length))
+			return (0);
+		jcf_out_reset(&jcf->key);
+		jcf_out_bytes(&jcf->key, event->text, event->length);
+		jcf_out_char(&jcf->key, ' ');
+		jcf_out_u32(&jcf->key, event->value);
+		break;
+
+	case JCF_PARSE_REFERENCE:
+		jcf_out_reset(&jcf->key);
+		jcf_out_bytes(&jcf->key, event->member, event->member_length);
+		jcf_out_char(&jcf->key, ' ');
+		jcf_out_u32(&jcf->key, event->value);
+		jcf_out_char(&jcf->key, ' ');
+		jcf_out_str(&jcf->key, event->mnemonic);
+		jcf_out_char(&jcf->key, ' ');
+		jcf_out_bytes(&jcf->key, event->text, event->length);
+		break;
+
+	default:
+		return (0);
+	}
+
+	// Print the line that was built in the key.
+	if (jcf->key.err != 0)
+		return (-1);
+	print_jcf_line(jcf, event->kind == JCF_PARSE_ATTRIBUTE ?
+	    JCF_RECORD_ATTRIBUTE : JCF_RECORD_REFERENCE, jcf->key.buf,
+	    jcf->key.len);
+	return (0);
+}
+
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_state whose image has
+ *   just been opened.
+ *
+ * Effects:
+ *   Performs pass 1 verification of the class file in the image, and
+ *   prints the class' dependencies and exports, if requested.  Closes
+ *   the image.  Prints an error message and returns -1 on failure.
+ *   Returns 0 on success.
+ */
+static int
+process_jcf_image(struct jcf_state *jcf)
+{
+	// Error return: Was there an error during processing?
+	int err;
+
+	// The number of symbols and edges collected before this class file.
+	size_t nsymbols = jcf->link != NULL ? jcf->link->count : 0;
+	size_t nedges = jcf->graph != NULL ? jcf->graph->count : 0;
+	size_t nindexed = jcf->index != NULL ? jcf->index->count : 0;
+
+	assert(jcf != NULL);
+
+	jcf->fingerprint = 0;
+	err = jcf_parse(jcf->parser, jcf->image.base, jcf->image.len,
+	    jcf->events, process_jcf_event, jcf);
+
+	// The class' name is in the image, so it is printed before closing.
+	if (err == 0 && jcf->fingerprint_flag)
+		err = print_jcf_fingerprint(jcf);
+	jcf_image_close(&jcf->image);
+	if (err != 0) {
+		// Forget the symbols of a malformed class file.
+		if (jcf->link != NULL)
+			jcf_link_truncate(jcf->link, nsymbols);
+		if (jcf->graph != NULL)
+			jcf_graph_truncate(jcf->graph, nedges);
+		if (jcf->index != NULL)
+			jcf_graph_truncate(jcf->index, nindexed);
+		print_jcf_error(jcf);
+		return (-1);
+	}
+	if (jcf->index != NULL)
+		index_jcf_class(jcf, nindexed);
+	return (0);
+}
+
+/*
+ * Requires:
+ *   "inputs" must be a valid struct jcf_inputs.  "archive" must be NULL
+ *   or an archive owned by "inputs".
+ *
+ * Effects:
+ *   Appends an input with a copy of "path" to the inputs.  Returns 0 on
+ *   success and -1 on failure.
+ */
+static int
+jcf_inputs_append(struct jcf_inputs *inputs, const char *path,
+    struct jcf_archive *archive, size_t entry)
+{
+	struct jcf_input *items, *input;
+	size_t capacity;
+
+	assert(inputs != NULL);
+
+	if (inputs->count == inputs->capacity) {
+		capacity = inputs->capacity == 0 ? 64 : inputs->capacity * 2;
+		items = realloc(inputs->items, capacity * sizeof(*items));
+		if (items == NULL)
+			return (-1);
+		inputs->items = items;
+		inputs->capacity = capacity;
+	}
+	input = &inputs->items[inputs->count];
+	if ((input->path = strdup(path)) == NULL)
+		return (-1);
+	input->archive = archive;
+	input->entry = entry;
+	inputs->count++;
+	return (0);
+}
+
+/*
+ * Requires:
+ *   "name" and "suffix" must be strings.
+ *
+ * Effects:
+ *   Returns true if "name" ends with "suffix".
+ */
+static bool
+jcf_has_suffix(const char *name, const char *suffix)
+{
+	size_t name_len = strlen(name), suffix_len = strlen(suffix);
+
+	return (name_len >= suffix_len &&
+	    strcmp(name + name_len - suffix_len, suffix) == 0);
+}
+
+/*
+ * Requires:
+ *   "inputs" must be a valid struct jcf_inputs.
+ *
+ * Effects:
+ *   Opens the JAR or ZIP archive "path" and adds each of its entries
+ *   whose name ends in ".class", in central directory order.  Each
+ *   entry is named "path!/entry".  The archive stays open until the
+ *   inputs are destroyed.  Prints an error message and returns -1 on
+ *   failure.  Returns 0 on success.
+ */
+static int
+jcf_inputs_add_archive(struct jcf_inputs *inputs, const char *path)
+{
+	struct jcf_archive *archive, **archives;
+	struct jcf_zip_entry *entry;
+	char *name;
+	size_t i, len;
+	int err = 0;
+
+	assert(inputs != NULL);
+
+	archives = realloc(inputs->archives, (inputs->narchives + 1) *
+	    sizeof(*archives));
+	if (archives == NULL) {
+		readjcf_error(path);
+		return (-1);
+	}
+	inputs->archives = archives;
+	if ((archive = malloc(sizeof(*archive))) == NULL) {
+		readjcf_error(path);
+		return (-1);
+	}
+	if (jcf_image_open(&archive->image, path) != 0) {
+		free(archive);
+		readjcf_error(path);
+		return (-1);
+	}
+	if (jcf_zip_open(&archive->zip, archive->image.base,
+	    archive->image.len) != 0) {
+		jcf_image_close(&archive->image);
+		free(archive);
+		readjcf_error(path);
+		return (-1);
+	}
+	inputs->archives[inputs->narchives++] = archive;
+
+	for (i = 0; i < archive->zip.count && err == 0; i++) {
+		entry = &archive->zip.entries[i];
+		if (!jcf_zip_entry_has_suffix(entry, ".class"))
+			continue;
+		len = strlen(path) + 2 + entry->name_length;
+		if ((name = malloc(len + 1)) == NULL) {
+			err = -1;
+			break;
+		}
+		snprintf(name, len + 1, "%s!/%.*s", path,
+		    (int)entry->name_length, entry->name);
+		err = jcf_inputs_append(inputs, name, archive, i);
+		free(name);
+	}
+	if (err != 0)
+		readjcf_error(path);
+	return (err);
+}
+
+/*
+ * Requires:
+ *   "inputs" must be a valid struct jcf_inputs.
+ *
+ * Effects:
+ *   Adds "path" to the inputs.  If "path" is a directory, every file
+ *   whose name ends in ".class" beneath it is added instead, in sorted
+ *   order so that the output does not depend on the order of the
+ *   directory entries.  If "path" names a JAR or ZIP archive, its class
+ *   file entries are added instead.  Prints an error message and returns -1 on
+ *   failure.  Returns 0 on success.
+ */
+static int
+jcf_inputs_add(struct jcf_inputs *inputs, const char *path)
+{
+	struct stat sb;
+
+	assert(inputs != NULL);
+
+	if (stat(path, &sb) == 0 && S_ISDIR(sb.st_mode))
+		return (jcf_inputs_add_dir(inputs, path));
+	if (jcf_has_suffix(path, ".jar") || jcf_has_suffix(path, ".zip"))
+		return (jcf_inputs_add_archive(inputs, path));
+	if (jcf_inputs_append(inputs, path, NULL, 0) != 0) {
+		readjcf_error(path);
+		return (-1);
+	}
+	return (0);
+}
+
+/*
+ * Requires:
+ *   Both arguments must point to struct jcf_inputs.
+ *
+ * Effects:
+ *   Compares the paths of two inputs for qsort().
+ */
+static int
+jcf_compare_names(const void *a, const void *b)
+{
+	return (strcmp(((const struct jcf_input *)a)->path,
+	    ((const struct jcf_input *)b)->path));
+}
+
+/*
+ * Requires:
+ *   "inputs" must be a valid struct jcf_inputs.
+ *
+ * Effects:
+ *   Recursively adds the class files beneath the directory "dirname".
+ *   Prints an error message and returns -1 if any part of the directory
+ *   cannot be read.  Returns 0 on success.
+ */
+static int
+jcf_inputs_add_dir(struct jcf_inputs *inputs, const char *dirname)
+{
+	struct jcf_inputs entries = { NULL, 0, 0, NULL, 0 };
+	struct dirent *dirent;
+	struct stat sb;
+	DIR *dir;
+	char *path;
+	size_t i, len;
+	int err = 0;
+
+	assert(inputs != NULL);
+
+	if ((dir = opendir(dirname)) == NULL) {
+		readjcf_error(dirname);
+		return (-1);
+	}
+	while ((dirent = readdir(dir)) != NULL) {
+		if (strcmp(dirent->d_name, ".") == 0 ||
+		    strcmp(dirent->d_name, "..") == 0)
+			continue;
+		if (jcf_inputs_append(&entries, dirent->d_name, NULL, 0) != 0) {
+			err = -1;
+			break;
+		}
+	}
+	closedir(dir);
+	qsort(entries.items, entries.count, sizeof(*entries.items),
+	    jcf_compare_names);
+
+	for (i = 0; i < entries.count && err == 0; i++) {
+		len = strlen(dirname) + 1 + strlen(entries.items[i].path);
+		if ((path = malloc(len + 1)) == NULL) {
+			err = -1;
+			break;
+		}
+		snprintf(path, len + 1, "%s/%s", dirname, entries.items[i].path);
+		if (stat(path, &sb) != 0)
+			err = -1;
+		else if (S_ISDIR(sb.st_mode))
+			err = jcf_inputs_add_dir(inputs, path);
+		else if (jcf_has_suffix(path, ".class"))
+			err = jcf_inputs_append(inputs, path, NULL, 0);
+		free(path);
+	}
+	jcf_inputs_destroy(&entries);
+	if (err != 0)
+		readjcf_error(dirname);
+	return (err);
+}
+
+/*
+ * Requires:
+ *   "inputs" must be a valid struct jcf_inputs.
+ *
+ * Effects:
+ *   Adds every class file or directory named in the list "listname",
+ *   one name per line.  The list "-" is read from stdin.  Empty lines
+ *   are ignored.  Returns 0 if every name was added successfully and -1
+ *   otherwise.
+ */
+static int
+jcf_inputs_add_list(struct jcf_inputs *inputs, const char *listname)
+{
+	FILE *list;
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t len;
+	int err = 0;
+
+	assert(inputs != NULL);
+
+	if (strcmp(listname, "-") == 0)
+		list = stdin;
+	else if ((list = fopen(listname, "r")) == NULL) {
+		readjcf_error(listname);
+		return (-1);
+	}
+	while ((len = getline(&line, &size, list)) != -1) {
+		// Strip the line terminator.
+		while (len > 0 && (line[len - 1] == '\n' ||
+		    line[len - 1] == '\r'))
+			line[--len] = '\0';
+		if (len == 0)
+			continue;
+		if (jcf_inputs_add(inputs, line) != 0)
+			err = -1;
+	}
+	if (ferror(list)) {
+		readjcf_error(listname);
+		err = -1;
+	}
+	free(line);
+	if (list != stdin)
+		fclose(list);
+	return (err);
+}
 
-			info_1u2u->body.u2 = ntohs(info_1u2u->body.u2);
-			info_1u2u->body.u2 = ntohs(info_1u2u->body.u2);
-			info_1u2u->tag = tag;
-			jcf->constant_pool.pool[i] = (struct jcf_cp_info *)info_1u2u;   
-			break;
-			
-		default:
-			return (-1);
-		}   
-	}
-
-    /* 
-        * Print the dependencies if requested.  This must be done after
-        * reading the entire pool because there are no guarantees about
-        * constants not containing references to other constants after
-        * them in the pool. 
-    */
-	if (jcf->depends_flag) {
-		uint8_t tag;
-		struct jcf_cp_info *info;
-		for (int b = 1; b < jcf->constant_pool.count; b++) {
-			info = jcf->constant_pool.pool[b];
-			tag = info->tag;
-
-			switch (tag) {
-			case JCF_CONSTANT_Fieldref:
-			 	printf("Dependency - ");
-				if (print_jcf_constant(jcf, b, JCF_CONSTANT_Fieldref) != 0)
-					return (-1);
-				printf("\n");	
-			 	break;
+/*
+ * Requires:
+ *   "inputs" must be a valid struct jcf_inputs.
+ *
+ * Effects:
+ *   Frees the memory held by the inputs.
+ */
+static void
+jcf_inputs_destroy(struct jcf_inputs *inputs)
+{
+	size_t i;
+
+	assert(inputs != NULL);
+
+	for (i = 0; i < inputs->count; i++)
+		free(inputs->items[i].path);
+	free(inputs->items);
+	inputs->items = NULL;
+	inputs->count = inputs->capacity = 0;
+	for (i = 0; i < inputs->narchives; i++) {
+		jcf_zip_close(&inputs->archives[i]->zip);
+		jcf_image_close(&inputs->archives[i]->image);
+		free(inputs->archives[i]);
+	}
+	free(inputs->archives);
+	inputs->archives = NULL;
+	inputs->narchives = 0;
+}
 
-       			case JCF_CONSTANT_Methodref:
-			 	printf("Dependency - ");
-				if (print_jcf_constant(jcf, b, JCF_CONSTANT_Methodref) != 0)
-					return (-1);
-				printf("\n");	
-			 	break;
-
-       			case JCF_CONSTANT_InterfaceMethodref:
-			 	printf("Dependency - ");
-				if (print_jcf_constant(jcf, b, JCF_CONSTANT_InterfaceMethodref) != 0)
-						return (-1);
-				printf("\n");		
-				break;
+/*
+ * Requires:
+ *   The "jcf" argument must be a valid struct jcf_state.
+ *
+ * Effects:
+ *   Processes every class file in "inputs", in order, on the calling
+ *   thread.  Without a cache, the files that are up to JCF_INGEST_DEPTH
+ *   places ahead of the one being processed are read in batches while
+ *   it is processed.  A file that cannot be read that way, such as an
+ *   archive entry or a large file, is opened as usual.  The statistics
+ *   of each file are kept if the state has them, from when the file is
+ *   waited for.  Returns 0 if every file was processed successfully and
+ *   -1 otherwise.
+ */
+static int
+process_jcf_inputs(struct jcf_state *jcf, struct jcf_inputs *inputs,
+    bool batch_flag)
+{
+	struct jcf_ingest ingest;
+	int window[JCF_INGEST_DEPTH];	// the slot of each file ahead
+	bool ingesting;
+	size_t i, next = 0;
+	int err = 0, file_err, slot = -1;
 
-			case JCF_CONSTANT_MethodHandle:
-			case JCF_CONSTANT_Utf8:
-			case JCF_CONSTANT_Class:
-			case JCF_CONSTANT_String:
-			case JCF_CONSTANT_Integer:
-			case JCF_CONSTANT_Float:
-				break;
+	assert(jcf != NULL);
+	assert(inputs != NULL);
+
+	// A cache may not need to read the files at all.
+	ingesting = jcf->cache == NULL && inputs->count > 1 &&
+	    jcf_ingest_init(&ingest) == 0;
+	for (i = 0; i < inputs->count; i++) {
+		jcf->filename = batch_flag ? inputs->items[i].path : NULL;
+		jcf->file = i;
+		if (ingesting) {
+			for (; next < inputs->count && next < i +
+			    JCF_INGEST_DEPTH; next++) {
+				window[next % JCF_INGEST_DEPTH] =
+				    inputs->items[next].archive != NULL ? -1 :
+				    jcf_ingest_start(&ingest,
+				    inputs->items[next].path);
+			}
+			slot = window[i % JCF_INGEST_DEPTH];
+		}
+		if (jcf->stats != NULL)
+			jcf_stats_begin(jcf->stats, inputs->items[i].path);
+		if (slot >= 0 && jcf_ingest_wait(&ingest, slot,
+		    &jcf->image.base, &jcf->image.len) == 0) {
+			jcf->image.kind = JCF_IMAGE_BORROWED;
+			file_err = process_jcf_image(jcf);
+		} else
+			file_err = process_jcf_input(jcf, &inputs->items[i]);
+		if (jcf->stats != NULL)
+			jcf_stats_end(jcf->stats, file_err);
+		if (file_err != 0)
+			err = -1;
+
+		// Write the file's binary lines.
+		if (jcf->bin != NULL) {
+			if (jcf->binary.err != 0) {
+				readjcf_error(NULL);
+				err = -1;
+			} else {
+				write_jcf_binary(jcf->bin,
+				    inputs->items[i].path, jcf->binary.buf,
+				    jcf->binary.len);
+			}
+			jcf_out_reset(&jcf->binary);
+			jcf->binary.err = 0;
+		}
+		if (slot >= 0)
+			jcf_ingest_release(&ingest, slot);
+	}
+	if (ingesting)
+		jcf_ingest_destroy(&ingest);
+	return (err);
+}
 
-			case JCF_CONSTANT_Long:
-			case JCF_CONSTANT_Double:
-				b++;
-				break;
+/*
+ * Requires:
+ *   "worker" must be a worker of a running scan.
+ *
+ * Effects:
+ *   Takes the lowest index from the worker's own deque.  Returns true
+ *   if an index was stored in "*indexp" and false if the deque is empty.
+ */
+static bool
+jcf_worker_take(struct jcf_worker *worker, size_t *indexp)
+{
+	bool found = false;
 
-			case JCF_CONSTANT_NameAndType:	
-			case JCF_CONSTANT_MethodType:
-			case JCF_CONSTANT_InvokeDynamic:
-				break;
+	pthread_mutex_lock(&worker->lock);
+	if (worker->head < worker->tail) {
+		*indexp = worker->deque[worker->head++];
+		found = true;
+	}
+	pthread_mutex_unlock(&worker->lock);
+	return (found);
+}
 
-			default:
-            			return(-1);
-			}		
-		}			
+/*
+ * Requires:
+ *   "worker" must be a worker of a running scan.
+ *
+ * Effects:
+ *   Steals the highest index from another worker's deque, trying each
+ *   of the other workers in turn.  Stealing from the tail leaves each
+ *   victim the indices that the output is waiting for soonest.  Returns
+ *   true if an index was stored in "*indexp" and false if every deque is
+ *   empty.  Because no work is added once the scan starts, an empty
+ *   result means that the worker is finished.
+ */
+static bool
+jcf_worker_steal(struct jcf_worker *worker, size_t *indexp)
+{
+	struct jcf_scan *scan = worker->scan;
+	struct jcf_worker *victim;
+	bool found = false;
+	int i, self;
+
+	self = worker - scan->workers;
+	for (i = 1; i < scan->nworkers && !found; i++) {
+		victim = &scan->workers[(self + i) % scan->nworkers];
+		pthread_mutex_lock(&victim->lock);
+		if (victim->head < victim->tail) {
+			*indexp = victim->deque[--victim->tail];
+			found = true;
+		}
+		pthread_mutex_unlock(&victim->lock);
 	}
-	return (0);
+	return (found);
 }
 
 /*
  * Requires:
- *   The "pool" argument must be a valid JCF constant pool.
+ *   "arg" must point to a worker of a running scan.
  *
  * Effects:
- *   Frees the memory allocated to store the constant pool.
+ *   Processes class files until there is no work left to take or steal.
+ *   The output of each file is collected in the worker's memory buffer,
+ *   whose contents are then handed to the scan's result for that file
+ *   without being copied.
  */
-static void
-destroy_jcf_constant_pool(struct jcf_constant_pool *pool)
+static void *
+jcf_worker_main(void *arg)
 {
-	assert(pool != NULL);
-	assert(pool->pool != NULL);
+	struct jcf_worker *worker = arg;
+	struct jcf_scan *scan = worker->scan;
+	struct jcf_result *result;
+	size_t index;
+	int err;
 
-	// Free each jcp_cp_info. 
-	for (int i = 1; i < pool->count; i++) {
-		if ((pool->pool[i]->tag == 6) || (pool->pool[i]->tag == 5)) {
-			free(pool->pool[i]);
-			i++;
-		} else
-			free(pool->pool[i]);
+	while (jcf_worker_take(worker, &index) ||
+	    jcf_worker_steal(worker, &index)) {
+		worker->jcf.filename = scan->batch_flag ?
+		    scan->inputs->items[index].path : NULL;
+		worker->jcf.file = index;
+		if (worker->jcf.stats != NULL) {
+			jcf_stats_begin(worker->jcf.stats,
+			    scan->inputs->items[index].path);
+		}
+		err = process_jcf_input(&worker->jcf,
+		    &scan->inputs->items[index]);
+		if (worker->jcf.stats != NULL)
+			jcf_stats_end(worker->jcf.stats, err);
+
+		// Take the output out of the buffer.
+		result = &scan->results[index];
+		if (jcf_out_take(&worker->jcf.out, &result->output,
+		    &result->length) != 0)
+			err = -1;
+		if (jcf_out_take(&worker->jcf.binary, &result->binary,
+		    &result->binary_length) != 0)
+			err = -1;
+
+		pthread_mutex_lock(&scan->lock);
+		result->err = err;
+		result->done = true;
+		pthread_cond_broadcast(&scan->done);
+		pthread_mutex_unlock(&scan->lock);
 	}
-	// Free the pool array.
-	free(pool->pool);
+	return (NULL);
 }
 
 /*
  * Requires:
- *   The "jcf" argument must be a valid struct jcf_state.  "jcf.f" must
- *   be a valid open file.  The JCF header and constant pool must have
- *   already been read.
+ *   The "jcf" argument must be a valid struct jcf_state, which is used
+ *   as a template for each worker's state.  "nworkers" must be at least
+ *   one.
  *
  * Effects:
- *   Reads the Java class file body from file "jcf.f".  Returns 0 on
- *   success.
+ *   Processes every class file in "inputs" on "nworkers" threads.  The
+ *   files are dealt out to the workers' deques round robin, so that the
+ *   lowest indices are processed first, and idle workers steal work.
+ *   The calling thread prints each file's output as soon as it and the
+ *   output of every file before it are done, so the output is the same
+ *   as that of process_jcf_inputs() whatever the number of threads.
+ *   Each worker keeps its own statistics, if the state has them, which
+ *   are added to the state's once the workers are done.  Returns 0 if
+ *   every file was processed successfully and -1 otherwise.
  */
 static int
-process_jcf_body(struct jcf_state *jcf)
+process_jcf_inputs_parallel(struct jcf_state *jcf, struct jcf_inputs *inputs,
+    bool batch_flag, int nworkers)
 {
-	struct jcf_body body;
+	struct jcf_scan scan;
+	struct jcf_worker *worker;
+	struct jcf_result *result;
+	size_t i, per_worker;
+	int err = 0, started, w;
 
 	assert(jcf != NULL);
-
-	// Read the body.
-	if (fread(&body, sizeof(body), 1, jcf->f) != 1)
+	assert(inputs != NULL);
+	assert(nworkers >= 1);
+
+	if ((size_t)nworkers > inputs->count)
+		nworkers = inputs->count > 0 ? inputs->count : 1;
+	scan.inputs = inputs;
+	scan.nworkers = nworkers;
+	scan.batch_flag = batch_flag;
+	scan.results = calloc(inputs->count, sizeof(*scan.results));
+	scan.workers = calloc(nworkers, sizeof(*scan.workers));
+	if ((scan.results == NULL && inputs->count > 0) ||
+	    scan.workers == NULL) {
+		free(scan.results);
+		free(scan.workers);
+		readjcf_error(NULL);
 		return (-1);
+	}
+	pthread_mutex_init(&scan.lock, NULL);
+	pthread_cond_init(&scan.done, NULL);
+
+	// Set up each worker's state, buffer, and share of the files.
+	per_worker = (inputs->count + nworkers - 1) / nworkers;
+	for (w = 0; w < nworkers; w++) {
+		worker = &scan.workers[w];
+		worker->scan = &scan;
+		worker->jcf = *jcf;
+		worker->jcf.parser = jcf_parser_create();
+		if (worker->jcf.parser != NULL)
+			jcf_parser_strict(worker->jcf.parser, jcf->strict_flag);
+		worker->jcf.inflate_buffer = NULL;
+		worker->jcf.inflate_size = 0;
+		jcf_out_init(&worker->jcf.out, -1);
+		jcf_out_init(&worker->jcf.key, -1);
+		jcf_out_init(&worker->jcf.record, -1);
+		jcf_out_init(&worker->jcf.binary, -1);
+		worker->jcf.bin = NULL;
+		jcf_link_table_init(&worker->link);
+		if (jcf->link != NULL)
+			worker->jcf.link = &worker->link;
+		jcf_graph_table_init(&worker->graph);
+		if (jcf->graph != NULL)
+			worker->jcf.graph = &worker->graph;
+		jcf_graph_table_init(&worker->index);
+		if (jcf->index != NULL)
+			worker->jcf.index = &worker->index;
+		jcf_stats_init(&worker->stats);
+		worker->jcf.stats = NULL;
+		if (jcf->stats != NULL && worker->jcf.parser != NULL) {
+			worker->jcf.stats = &worker->stats;
+			jcf_parser_stats(worker->jcf.parser,
+			    &worker->stats.file.parse);
+		}
+		worker->deque = malloc((per_worker + 1) * sizeof(*worker->deque));
+		pthread_mutex_init(&worker->lock, NULL);
+		worker->head = worker->tail = 0;
+		if (worker->jcf.parser == NULL || worker->deque == NULL) {
+			err = -1;
+			continue;
+		}
+		for (i = w; i < inputs->count; i += nworkers)
+			worker->deque[worker->tail++] = i;
+	}
 
-	body.access_flags = ntohs(body.access_flags);
-	body.this_class = ntohs(body.this_class);
-	body.super_class = ntohs(body.super_class);
+	// Start the workers.
+	for (started = 0; started < nworkers && err == 0; started++) {
+		if (pthread_create(&scan.workers[started].thread, NULL,
+		    jcf_worker_main, &scan.workers[started]) != 0)
+			break;
+	}
+	if (started == 0)
+		err = -1;
 
-	return (0);
+	// Print the results in order as they become available.
+	for (i = 0; i < inputs->count && err == 0; i++) {
+		result = &scan.results[i];
+		pthread_mutex_lock(&scan.lock);
+		while (!result->done)
+			pthread_cond_wait(&scan.done, &scan.lock);
+		pthread_mutex_unlock(&scan.lock);
+		if (result->output != NULL)
+			jcf_out_bytes(&jcf->out, result->output,
+			    result->length);
+		if (jcf->bin != NULL && result->binary != NULL) {
+			write_jcf_binary(jcf->bin, inputs->items[i].path,
+			    result->binary, result->binary_length);
+		}
+		free(result->output);
+		free(result->binary);
+		result->output = NULL;
+		result->binary = NULL;
+		if (result->err != 0)
+			err = -1;
+	}
+	for (; i < inputs->count; i++) {
+		pthread_mutex_lock(&scan.lock);
+		while (started > 0 && !scan.results[i].done)
+			pthread_cond_wait(&scan.done, &scan.lock);
+		pthread_mutex_unlock(&scan.lock);
+		free(scan.results[i].output);
+		free(scan.results[i].binary);
+	}
+
+	// Tear down the workers.
+	for (w = 0; w < started; w++)
+		pthread_join(scan.workers[w].thread, NULL);
+	for (w = 0; w < nworkers; w++) {
+		worker = &scan.workers[w];
+		jcf_out_destroy(&worker->jcf.out);
+		jcf_out_destroy(&worker->jcf.key);
+		jcf_out_destroy(&worker->jcf.record);
+		jcf_out_destroy(&worker->jcf.binary);
+
+		// Collect the worker's symbols for the link check.
+		if (jcf->link != NULL && jcf_link_merge(jcf->link,
+		    &worker->link) != 0)
+			err = -1;
+		jcf_link_table_destroy(&worker->link);
+
+		// Collect the worker's edges for the dependency graph.
+		if (jcf->graph != NULL && jcf_graph_merge(jcf->graph,
+		    &worker->graph) != 0)
+			err = -1;
+		jcf_graph_table_destroy(&worker->graph);
+
+		// Collect the worker's symbols for the index.
+		if (jcf->index != NULL && jcf_graph_merge(jcf->index,
+		    &worker->index) != 0)
+			err = -1;
+		jcf_graph_table_destroy(&worker->index);
+
+		// Collect the worker's statistics.
+		if (jcf->stats != NULL)
+			jcf_stats_merge(jcf->stats, &worker->stats);
+		free(worker->deque);
+		pthread_mutex_destroy(&worker->lock);
+		jcf_parser_destroy(worker->jcf.parser);
+		free(worker->jcf.inflate_buffer);
+	}
+	pthread_cond_destroy(&scan.done);
+	pthread_mutex_destroy(&scan.lock);
+	free(scan.workers);
+	free(scan.results);
+	if (err != 0 && started == 0)
+		readjcf_error(NULL);
+	return (err);
 }
 
 /*
  * Requires:
- *   The "jcf" argument must be a valid struct jcf_state.  "jcf.f" must
- *   be a valid open file.  The JCF header, constant pool, and body must
- *   have already been read.
+ *   "jcf" must be the state of one of the server's workers, or of the
+ *   thread that starts the server.
  *
  * Effects:
- *   Reads the Java class file interfaces from file "jcf.f".  Returns
- *   0 on success.
+ *   Prints the results of the class file "input" as processing it would.
+ *   If the server has the results of an unchanged copy of the file, they
+ *   are replayed from memory.  Otherwise, the file is processed, through
+ *   the cache if there is one, and its records and edges are kept by the
+ *   server.  A file that is gone or malformed is forgotten.  Returns 0
+ *   on success and -1 on failure.
  */
 static int
-process_jcf_interfaces(struct jcf_state *jcf)
+serve_jcf_input(struct jcf_daemon *daemon, struct jcf_state *jcf,
+    const struct jcf_input *input)
 {
-	int i;
-	uint16_t count;
-	uint16_t indexes;
+	struct jcf_cache_key key;
+	struct jcf_graph_table *graph = jcf->graph;
+	int err;
 
+	assert(daemon != NULL);
 	assert(jcf != NULL);
+	assert(graph != NULL);
 
-	// Read the interfaces count.
-
-	if (fread(&count, sizeof(count), 1, jcf->f) != 1)
+	if (jcf_input_key(input, &key) != 0) {
+		jcf_memo_forget(&daemon->memo, input->path);
+		print_jcf_error(jcf);
 		return (-1);
+	}
 
-	count = ntohs(count);
-
-	for (i = 0; i < count; i++) {
-
-		// Read the info.
-		if (fread(&indexes, sizeof(indexes), 1, jcf->f) != 1)
-			return (-1);
-		indexes = ntohs(indexes);	
+	// Replay the results that the server already has.
+	jcf_out_reset(&jcf->record);
+	if (jcf_memo_find(&daemon->memo, &key, &jcf->record) &&
+	    jcf->record.err == 0) {
+		jcf->graph = NULL;
+		err = replay_jcf_records(jcf);
+		jcf->graph = graph;
+		if (err == 0)
+			return (0);
 	}
+	jcf->record.err = 0;
 
+	/*
+	 * Process the file, recording its results.  Through the cache, the
+	 * records are left behind whether or not the cache had them.
+	 */
+	jcf_graph_truncate(graph, 0);
+	jcf_out_reset(&jcf->record);
+	jcf->recording = jcf->cache == NULL;
+	err = process_jcf_input(jcf, input);
+	jcf->recording = false;
+	if (err != 0 || jcf->record.err != 0) {
+		jcf_memo_forget(&daemon->memo, input->path);
+		jcf->record.err = 0;
+		return (err);
+	}
+	jcf_memo_store(&daemon->memo, &key, jcf->record.buf, jcf->record.len,
+	    graph->edges, graph->count);
 	return (0);
 }
 
-
 /*
  * Requires:
- *   The "jcf" argument must be a valid struct jcf_state.  "jcf.f" must
- *   be a valid open file.  The JCF header, constant pool, body, and
- *   interfaces must have already been read.  The JCF constant pool in
- *   "jcf" must be initialized.
+ *   "jcf" must be the state of one of the server's workers.  "paths"
+ *   must be a list of paths separated by white space, which is changed.
  *
  * Effects:
- *   Reads the Java class file fields from file "jcf.f".  Prints the
- *   exported fields, if requested.  Returns 0 on success and -1 on
- *   failure.
+ *   Answers an "analyze" request by printing the results of every class
+ *   file that "paths" names, as a run with those arguments would, with
+ *   each line naming its file.  Returns 0 if every file was processed
+ *   successfully and -1 otherwise.
  */
 static int
-process_jcf_fields(struct jcf_state *jcf)
-{	
-	return (process_jcf_fields_and_methods_helper(jcf));
+serve_jcf_analyze(struct jcf_daemon *daemon, struct jcf_state *jcf,
+    char *paths)
+{
+	struct jcf_inputs inputs = { NULL, 0, 0, NULL, 0 };
+	char *path, *save;
+	size_t i;
+	int err = 0;
+
+	for (path = strtok_r(paths, " \t", &save); path != NULL;
+	    path = strtok_r(NULL, " \t", &save)) {
+		if (jcf_inputs_add(&inputs, path) != 0) {
+			jcf->filename = path;
+			print_jcf_error(jcf);
+			err = -1;
+		}
+	}
+	for (i = 0; i < inputs.count; i++) {
+		jcf->filename = inputs.items[i].path;
+		if (serve_jcf_input(daemon, jcf, &inputs.items[i]) != 0)
+			err = -1;
+	}
+	jcf_inputs_destroy(&inputs);
+	return (err);
 }
 
 /*
  * Requires:
- *   The "jcf" argument must be a valid struct jcf_state.  "jcf.f" must
- *   be a valid open file.  The JCF header, constant pool, body,
- *   interfaces, and fields must have already been read.  The JCF
- *   constant pool in "jcf" must be initialized.
+ *   The caller must not hold the server's lock.
  *
  * Effects:
- *   Reads the Java class file methods from file "jcf.f".  Prints the
- *   exported methods, if requested.  Returns 0 on success and -1 on
- *   failure.
+ *   Rebuilds the dependency graph of the analyzed classes if they have
+ *   changed since it was built.  Returns 0 on success and -1 on failure,
+ *   in which case the server has no graph.
  */
 static int
-process_jcf_methods(struct jcf_state *jcf)
+index_jcf_graph(struct jcf_daemon *daemon)
 {
-	return (process_jcf_fields_and_methods_helper(jcf));
+	struct jcf_graph_table table;
+	uint64_t version;
+	uint32_t limit;
+	size_t nfiles;
+	int err = 0;
+
+	pthread_rwlock_wrlock(&daemon->lock);
+	if (daemon->indexed &&
+	    daemon->version == jcf_memo_version(&daemon->memo)) {
+		pthread_rwlock_unlock(&daemon->lock);
+		return (0);
+	}
+	if (daemon->indexed) {
+		jcf_graph_destroy(&daemon->graph);
+		jcf_graph_destroy(&daemon->dag);
+		free(daemon->names);
+		free(daemon->node);
+		free(daemon->component);
+		daemon->indexed = false;
+	}
+	daemon->dag.starts = NULL;
+	daemon->dag.targets = NULL;
+	daemon->names = NULL;
+	daemon->node = NULL;
+	daemon->component = NULL;
+
+	jcf_graph_table_init(&table);
+	if (jcf_memo_edges(&daemon->memo, &table, &nfiles, &limit,
+	    &version) != 0 || jcf_graph_collect(&daemon->graph,
+	    &daemon->names, &daemon->node, &table, nfiles, limit) != 0)
+		err = -1;
+	daemon->limit = limit;
+	jcf_graph_table_destroy(&table);
+	if (err == 0) {
+		daemon->component = malloc((size_t)daemon->graph.nnodes *
+		    sizeof(*daemon->component));
+		if ((daemon->graph.nnodes > 0 && daemon->component == NULL) ||
+		    jcf_graph_components(&daemon->graph, daemon->component,
+		    &daemon->ncomponents) != 0 ||
+		    jcf_graph_quotient(&daemon->dag, daemon->ncomponents,
+		    &daemon->graph, daemon->component) != 0)
+			err = -1;
+	}
+	if (err == 0) {
+		daemon->indexed = true;
+		daemon->version = version;
+	} else {
+		jcf_graph_destroy(&daemon->graph);
+		jcf_graph_destroy(&daemon->dag);
+		free(daemon->names);
+		free(daemon->node);
+		free(daemon->component);
+	}
+	pthread_rwlock_unlock(&daemon->lock);
+	return (err);
 }
 
 /*
  * Requires:
- *   All the requirements of either process_jcf_fields or
- *   process_jcf_methods.
+ *   "jcf" must be the state of one of the server's workers.
  *
  * Effects:
- *   Reads the Java class file fields or methods from file "jcf.f".
- *   Prints the exports, if requested.  Returns 0 on success and -1 on
- *   failure.
+ *   Answers a query about the dependency graph of the analyzed classes.
+ *   If "queries" is NULL, prints the cycles among the classes and among
+ *   their packages.  Otherwise, prints the classes that depend on each
+ *   class in the comma separated list "queries".  Returns 0 on success
+ *   and -1 on failure.
  */
 static int
-process_jcf_fields_and_methods_helper(struct jcf_state *jcf)
-{	
-	int i;
-	struct jcf_field_info info;
-	uint16_t count;
+serve_jcf_graph(struct jcf_daemon *daemon, struct jcf_state *jcf,
+    const char *queries)
+{
+	int err = -1;
 
-	assert(jcf != NULL);
-	
-	// Read the count.
-	if (fread(&count, sizeof(count), 1, jcf->f) != 1)
-		return (-1);
-	count = ntohs(count);
-	
-	// Read the methods.
-	for (i = 0; i < count; i++) {
-		// Read the info.
-		if (fread(&info, sizeof(info), 1, jcf->f) != 1)
-			return (-1);
-		info.access_flags = ntohs(info.access_flags);
-		info.name_index = ntohs(info.name_index);
-		info.descriptor_index = ntohs(info.descriptor_index);
-
-
-		   // checks if the flags are on
-		if (jcf->exports_flag &&
-		    info.access_flags & JCF_ACC_PUBLIC) {
-			printf("Export - ");
-			// calls the prints 
-			if (print_jcf_constant(jcf, info.name_index,
-			    JCF_CONSTANT_Utf8) != 0)
-				return (-1);
-			printf(" ");
-			if (print_jcf_constant(jcf, info.descriptor_index,
-			    JCF_CONSTANT_Utf8) != 0)
-				return (-1);
-			printf("\n");
-		}
+	if (index_jcf_graph(daemon) != 0)
+		return (-1);
 
-		// Read the attributes.
-		if (process_jcf_attributes(jcf) != 0)
-			return (-1);
+	/*
+	 * Answer from the graph as it is now, even if another request has
+	 * changed the analyzed classes since it was rebuilt.
+	 */
+	pthread_rwlock_rdlock(&daemon->lock);
+	if (daemon->indexed && queries == NULL) {
+		if (print_jcf_cycles(jcf, "Cycle", daemon->graph.nnodes,
+		    daemon->names, daemon->component,
+		    daemon->ncomponents) == 0 &&
+		    print_jcf_package_cycles(jcf, &daemon->graph,
+		    daemon->names) == 0)
+			err = 0;
+	} else if (daemon->indexed) {
+		err = print_jcf_dependents(jcf, &daemon->graph, daemon->names,
+		    daemon->node, daemon->limit, daemon->component,
+		    &daemon->dag, queries, 1);
 	}
+	pthread_rwlock_unlock(&daemon->lock);
+	return (err);
+}
 
-	return (0);
+/*
+ * Requires:
+ *   "arg" must point to the server's struct jcf_daemon, and "worker"
+ *   must be the index of the calling worker.
+ *
+ * Effects:
+ *   Answers one request, which is a word followed by its arguments:
+ *
+ *     analyze <path>...         prints the results of the class files
+ *     dependents <class>[,...]  prints the classes that depend on them
+ *     cycles                    prints the dependency cycles
+ *     shutdown                  stops the server
+ *
+ *   The reply holds the output lines, in a buffer that the caller must
+ *   free().  Returns 0 on success, 1 to stop the server, and -1 on
+ *   failure or if the request is not understood.
+ */
+static int
+serve_jcf_request(void *arg, int worker, const char *request, size_t length,
+    char **replyp, size_t *lengthp)
+{
+	struct jcf_daemon *daemon = arg;
+	struct jcf_state *jcf = &daemon->states[worker];
+	char *line, *command, *rest;
+	int err = -1;
+
+	if ((line = malloc(length + 1)) == NULL)
+		return (-1);
+	memcpy(line, request, length);
+	line[length] = '\0';
+	command = line + strspn(line, " \t");
+	rest = command + strcspn(command, " \t");
+	if (*rest != '\0')
+		*rest++ = '\0';
+	rest += strspn(rest, " \t");
+
+	jcf_out_reset(&jcf->out);
+	if (strcmp(command, "analyze") == 0)
+		err = serve_jcf_analyze(daemon, jcf, rest);
+	else if (strcmp(command, "dependents") == 0 && *rest != '\0')
+		err = serve_jcf_graph(daemon, jcf, rest);
+	else if (strcmp(command, "cycles") == 0 && *rest == '\0')
+		err = serve_jcf_graph(daemon, jcf, NULL);
+	else if (strcmp(command, "shutdown") == 0 && *rest == '\0')
+		err = 1;
+	free(line);
+	if (jcf_out_take(&jcf->out, replyp, lengthp) != 0)
+		err = -1;
+	return (err);
 }
 
 /*
  * Requires:
- *   The "jcf" argument must be a valid struct jcf_state.  "jcf.f" must
- *   be a valid open file.  The next part of the JCF to be read must be
- *   an attributes count, followed by an array of attributes exactly
- *   count long.
+ *   The "jcf" argument must be a valid struct jcf_state, with a "graph"
+ *   table and no "link" table, which is used as a template for each
+ *   worker's state.  "nworkers" must be at least one.
  *
  * Effects:
- *   Reads the attributes.  Returns 0 on success and -1 on failure.
+ *   Analyzes the class files in "inputs", without printing their output
+ *   lines, and then answers requests on the Unix domain socket "path"
+ *   with "nworkers" threads until the server is stopped.  Returns 0 on
+ *   success and -1 if the server failed or a file could not be read.
  */
 static int
-process_jcf_attributes(struct jcf_state *jcf)
+serve_jcf(struct jcf_state *jcf, struct jcf_inputs *inputs, const char *path,
+    int nworkers)
 {
-	int i;
-	int j;
-	uint16_t	attributes_count;
-	uint16_t	attribute_name_index;
-	uint32_t	attribute_length;
-	uint8_t		info_len;
+	struct jcf_daemon daemon;
+	struct jcf_state *state;
+	size_t i;
+	int err = 0, w;
 
 	assert(jcf != NULL);
-
-	// Read the attributes count.
-	if (fread(&attributes_count, sizeof(attributes_count), 1, jcf->f) != 1)
+	assert(jcf->graph != NULL);
+	assert(jcf->link == NULL);
+	assert(nworkers >= 1);
+
+	memset(&daemon, 0, sizeof(daemon));
+	daemon.nworkers = nworkers;
+	daemon.states = calloc(nworkers, sizeof(*daemon.states));
+	daemon.tables = calloc(nworkers, sizeof(*daemon.tables));
+	if (daemon.states == NULL || daemon.tables == NULL ||
+	    jcf_memo_init(&daemon.memo) != 0) {
+		free(daemon.states);
+		free(daemon.tables);
+		readjcf_error(NULL);
 		return (-1);
-	attributes_count = ntohs(attributes_count);
+	}
+	pthread_rwlock_init(&daemon.lock, NULL);
+
+	// Set up each worker's state, whose output is its reply.
+	for (w = 0; w < nworkers; w++) {
+		state = &daemon.states[w];
+		*state = *jcf;
+		state->parser = jcf_parser_create();
+		if (state->parser != NULL)
+			jcf_parser_strict(state->parser, jcf->strict_flag);
+		state->inflate_buffer = NULL;
+		state->inflate_size = 0;
+		jcf_out_init(&state->out, -1);
+		jcf_out_init(&state->key, -1);
+		jcf_out_init(&state->record, -1);
+		jcf_graph_table_init(&daemon.tables[w]);
+		state->graph = &daemon.tables[w];
+		state->serving = true;
+		if (state->parser == NULL)
+			err = -1;
+	}
 
-	// Read the attributes.
-	for (i = 0; i < attributes_count; i++) {
-		// Read the attribute name index.
-		if (fread(&attribute_name_index, sizeof(attribute_name_index), 1, jcf->f) != 1)
-			return (-1);
-		attribute_name_index = ntohs(attribute_name_index);
+	// Warm the server with the inputs, reporting errors to stderr.
+	state = &daemon.states[0];
+	state->serving = false;
+	for (i = 0; i < inputs->count && err == 0; i++) {
+		state->filename = inputs->items[i].path;
+		if (serve_jcf_input(&daemon, state, &inputs->items[i]) != 0)
+			err = -1;
+		jcf_out_reset(&state->out);
+	}
+	state->serving = true;
 
-		// Read the attribute length.
-		if (fread(&attribute_length, sizeof(attribute_length), 1, jcf->f) != 1)
-			return (-1);
-		attribute_length = ntohl(attribute_length);
+	if (err == 0 && jcf_serve(path, nworkers, serve_jcf_request,
+	    &daemon) != 0) {
+		readjcf_error(path);
+		err = -1;
+	}
 
-		// Read the attribute data.
-		for (j = 0; j < (int)attribute_length; j++) {
-			if (fread(&info_len, sizeof(info_len), 1, jcf->f) != 1)
-				return (-1);
-		}	
+	// Tear down the workers and the graph.
+	for (w = 0; w < nworkers; w++) {
+		state = &daemon.states[w];
+		jcf_out_destroy(&state->out);
+		jcf_out_destroy(&state->key);
+		jcf_out_destroy(&state->record);
+		jcf_graph_table_destroy(&daemon.tables[w]);
+		jcf_parser_destroy(state->parser);
+		free(state->inflate_buffer);
 	}
-	return (0);
+	if (daemon.indexed) {
+		jcf_graph_destroy(&daemon.graph);
+		jcf_graph_destroy(&daemon.dag);
+		free(daemon.names);
+		free(daemon.node);
+		free(daemon.component);
+	}
+	pthread_rwlock_destroy(&daemon.lock);
+	jcf_memo_destroy(&daemon.memo);
+	free(daemon.states);
+	free(daemon.tables);
+	return (err);
 }
 
 /* 
@@ -850,8 +2875,33 @@ process_jcf_attributes(struct jcf_state *jcf)
  *   Nothing.
  *
  * Effects:
- *   Reads the Java class file and performs pass 1 verification.  Also
- *   prints the class' dependencies and exports, if requested.
+ *   Reads each Java class file named on the command line and performs
+ *   pass 1 verification.  Also prints the class' dependencies and
+ *   exports, if requested.  An argument of the form "@file" names a
+ *   file listing class files one per line, and "-" reads such a list
+ *   from stdin.  Directories are searched recursively for class files,
+ *   and the class files in JAR and ZIP archives are read in place.
+ *   With "-j", the class files are processed by several threads.  With
+ *   "-l", the member references of all of the classes are checked
+ *   against their member definitions once every class has been read.
+ *   With "-c", the results of each class file are cached in the named
+ *   directory and reused while the file is unchanged.  With "-g" and
+ *   "-i", the classes' dependency graph is built once every class has
+ *   been read, and its cycles and the dependents of the named classes
+ *   are printed.  With "-m", the references that each method's code
+ *   makes are printed.  With "-s" or "--serve", the class files are
+ *   analyzed and then requests are answered on the named Unix domain
+ *   socket from the results kept in memory.  With "-x", an index of the
+ *   symbols that the classes reference is written to the named file,
+ *   and with "-q", the arguments are instead symbols whose referencing
+ *   classes are looked up in the named index.  With "-v", statistics of
+ *   where the time of the scan went are printed to stderr, and with
+ *   "--stats", a summary of them is appended to the named file as a
+ *   line of JSON.  With "-V" or "--strict", a class file whose UTF8
+ *   constants are not all valid Modified UTF-8 is rejected.  With "-b",
+ *   the lines that "-d" and "-e" print are written to the named file in
+ *   a binary form instead.  With "-f", a fingerprint of each class'
+ *   public API is printed.
  */
 int
 main(int argc, char **argv)
@@ -862,7 +2912,48 @@ main(int argc, char **argv)
 	int c;			// Option character
 
 	// Error return: Was there an error during processing?
-	int err;
+	int err = 0;
+
+	// Batch flag: Should output lines name their files?
+	bool batch_flag;
+
+	// Define the list of class files to process.
+	struct jcf_inputs inputs = { NULL, 0, 0, NULL, 0 };
+
+	// Define the tables of symbols and edges, and their names.
+	struct jcf_link_table link;
+	struct jcf_graph_table graph;
+	struct jcf_graph_table index;
+	struct jcf_intern intern;
+
+	// Define the writer of the binary lines.
+	struct jcf_bin_writer bin;
+
+	// Define the cache of results, and the options that shape them.
+	struct jcf_cache cache;
+	uint64_t options;
+
+	// Define the statistics of the scan, and when it started.
+	struct jcf_stats stats;
+	struct jcf_stats_allocations allocations;
+	struct timespec start, now;
+	uint64_t nsec;
+
+	// Thread count: How many threads should process the class files?
+	int nthreads = 1;
+	long threads;
+	char *end;
+
+	/*
+	 * Define the long options.  All but "--stats" have short
+	 * equivalents, and it is returned as 'S', which is not one.
+	 */
+	static const struct option longopts[] = {
+		{ "serve", required_argument, NULL, 's' },
+		{ "strict", no_argument, NULL, 'V' },
+		{ "stats", required_argument, NULL, 'S' },
+		{ NULL, 0, NULL, 0 }
+	};
 
 	extern int optind;	// Option index
 
@@ -872,11 +2963,65 @@ main(int argc, char **argv)
 	// Option flags: Were these options on the command line?
 	bool depends_flag = false;
 	bool exports_flag = false;
+	bool fingerprint_flag = false;
+	bool cycles_flag = false;
+	bool link_flag = false;
+	bool methods_flag = false;
+	bool strict_flag = false;
 	bool verbose_flag = false;
 
+	/*
+	 * Option arguments: The attributes to keep, cache directory, and
+	 * classes whose dependents to print, if any.
+	 */
+	const char *attributes = NULL;
+	const char *cache_dir = NULL;
+	const char *queries = NULL;
+
+	// Socket path: Where should requests be answered, if anywhere?
+	const char *socket_path = NULL;
+
+	// Index paths: Where should an index be written, or queried?
+	const char *index_path = NULL;
+	const char *query_path = NULL;
+
+	// Statistics path: Where should a summary be written, if anywhere?
+	const char *stats_path = NULL;
+
+	// Binary path: Where should binary lines be written, if anywhere?
+	const char *binary_path = NULL;
+
 	// Process the command line arguments.
-	while ((c = getopt(argc, argv, "dev")) != -1) {
+	while ((c = getopt_long(argc, argv, "a:b:c:defgi:j:lmq:s:vVx:",
+	    longopts, NULL)) != -1) {
 		switch (c) {
+		case 'a':
+			// Print the named attributes.
+			if (attributes != NULL) {
+				// A flag can only appear once.
+				abort_flag = true;
+			} else {
+				attributes = optarg;
+			}
+			break;
+		case 'b':
+			// Write the lines in a binary form to the named file.
+			if (binary_path != NULL) {
+				// A flag can only appear once.
+				abort_flag = true;
+			} else {
+				binary_path = optarg;
+			}
+			break;
+		case 'c':
+			// Cache the results in the named directory.
+			if (cache_dir != NULL) {
+				// A flag can only appear once.
+				abort_flag = true;
+			} else {
+				cache_dir = optarg;
+			}
+			break;
 		case 'd':
 			// Print depends.
 			if (depends_flag) {
@@ -895,6 +3040,88 @@ main(int argc, char **argv)
 				exports_flag = true;
 			}
 			break;
+		case 'f':
+			// Print the fingerprint of each class' public API.
+			if (fingerprint_flag) {
+				// A flag can only appear once.
+				abort_flag = true;
+			} else {
+				fingerprint_flag = true;
+			}
+			break;
+		case 'l':
+			// Check the links between the classes.
+			if (link_flag) {
+				// A flag can only appear once.
+				abort_flag = true;
+			} else {
+				link_flag = true;
+			}
+			break;
+		case 'g':
+			// Print the dependency cycles.
+			if (cycles_flag) {
+				// A flag can only appear once.
+				abort_flag = true;
+			} else {
+				cycles_flag = true;
+			}
+			break;
+		case 'i':
+			// Print the classes that depend on the named classes.
+			if (queries != NULL) {
+				// A flag can only appear once.
+				abort_flag = true;
+			} else {
+				queries = optarg;
+			}
+			break;
+		case 'j':
+			// Use several threads.
+			errno = 0;
+			threads = strtol(optarg, &end, 10);
+			if (*end != '\0' || errno == ERANGE || threads < 1 ||
+			    threads > JCF_THREADS_MAX)
+				abort_flag = true;
+			else
+				nthreads = threads;
+			break;
+		case 'm':
+			// Print the references made by each method's code.
+			if (methods_flag) {
+				// A flag can only appear once.
+				abort_flag = true;
+			} else {
+				methods_flag = true;
+			}
+			break;
+		case 'q':
+			// Look the arguments up in the named index.
+			if (query_path != NULL) {
+				// A flag can only appear once.
+				abort_flag = true;
+			} else {
+				query_path = optarg;
+			}
+			break;
+		case 's':
+			// Answer requests on the named socket.
+			if (socket_path != NULL) {
+				// A flag can only appear once.
+				abort_flag = true;
+			} else {
+				socket_path = optarg;
+			}
+			break;
+		case 'S':
+			// Append a summary of the statistics to the named file.
+			if (stats_path != NULL) {
+				// A flag can only appear once.
+				abort_flag = true;
+			} else {
+				stats_path = optarg;
+			}
+			break;
 		case 'v':
 			// Be verbose.
 			if (verbose_flag) {
@@ -904,80 +3131,292 @@ main(int argc, char **argv)
 				verbose_flag = true;
 			}
 			break;
+		case 'V':
+			// Check that UTF8 constants are valid Modified UTF-8.
+			if (strict_flag) {
+				// A flag can only appear once.
+				abort_flag = true;
+			} else {
+				strict_flag = true;
+			}
+			break;
+		case 'x':
+			// Write an index of the referenced symbols.
+			if (index_path != NULL) {
+				// A flag can only appear once.
+				abort_flag = true;
+			} else {
+				index_path = optarg;
+			}
+			break;
 		case '?':
 			// An error character was returned by getopt().
 			abort_flag = true;
 		}
 	}
-	if (abort_flag || optind == argc || argc > optind + 1) {
-		fprintf(stderr, "usage: %s [-d] [-e] [-v] <input filename>\n",
-		    argv[0]);
+
+	/*
+	 * A server answers questions about the graph and the links as they
+	 * are asked, and may start without inputs.
+	 */
+	if (socket_path != NULL && (cycles_flag || link_flag ||
+	    queries != NULL || index_path != NULL || stats_path != NULL))
+		abort_flag = true;
+
+	// A query of an index reads no class files.
+	if (query_path != NULL && (attributes != NULL || cache_dir != NULL ||
+	    depends_flag || exports_flag || fingerprint_flag || cycles_flag ||
+	    queries != NULL || nthreads != 1 || link_flag || methods_flag ||
+	    socket_path != NULL || strict_flag || verbose_flag ||
+	    index_path != NULL || stats_path != NULL))
+		abort_flag = true;
+
+	/*
+	 * The binary lines are those that "-d" and "-e" print, and a server
+	 * prints its lines in its replies.
+	 */
+	if (binary_path != NULL && ((!depends_flag && !exports_flag) ||
+	    socket_path != NULL || query_path != NULL))
+		abort_flag = true;
+	if (abort_flag || (optind == argc && socket_path == NULL)) {
+		fprintf(stderr, "usage: %s [-a <attribute>[,...]] "
+		    "[-b <file>] [-c <cache>] [-d] [-e] [-f] [-g] "
+		    "[-i <class>[,...]] [-j <threads>] [-l] [-m] "
+		    "[-s <socket>] [-v] [-V] [-x <index>] [--stats <file>] "
+		    "<input>...\n"
+		    "       %s -q <index> <symbol>...\n", argv[0], argv[0]);
 	        return (1); // Indicate an error.
 	}
+	if (query_path != NULL) {
+		if (query_jcf_index(query_path, argv + optind,
+		    argc - optind) != 0)
+			return (1); // Indicate an error.
+		return (0);
+	}
+
+	/*
+	 * Keep statistics of a scan that is verbose or summarized, counting
+	 * the allocations from the start, before any input is collected.
+	 * A server's statistics are not kept.
+	 */
+	jcf.stats = NULL;
+	if ((verbose_flag || stats_path != NULL) && socket_path == NULL) {
+		jcf_stats_count_allocations();
+		jcf_stats_init(&stats);
+		jcf.stats = &stats;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	// Collect the class files, expanding lists and directories.
+	for (c = optind; c < argc; c++) {
+		if (argv[c][0] == '@') {
+			if (jcf_inputs_add_list(&inputs, argv[c] + 1) != 0)
+				err = -1;
+		} else if (strcmp(argv[c], "-") == 0) {
+			if (jcf_inputs_add_list(&inputs, "-") != 0)
+				err = -1;
+		} else if (jcf_inputs_add(&inputs, argv[c]) != 0)
+			err = -1;
+	}
+
+	/*
+	 * Output lines name their files unless exactly one class file was
+	 * named directly on the command line.
+	 */
+	batch_flag = !(argc == optind + 1 && inputs.count == 1 &&
+	    inputs.items[0].archive == NULL &&
+	    strcmp(inputs.items[0].path, argv[optind]) == 0);
 
 	// Initialize the jcf_state structure.
-	jcf.f = NULL;
+	jcf_out_init(&jcf.out, STDOUT_FILENO);
+	jcf.filename = NULL;
 	jcf.depends_flag = depends_flag;
 	jcf.exports_flag = exports_flag;
 	jcf.verbose_flag = verbose_flag;
-	jcf.constant_pool.count = 0;
-	jcf.constant_pool.pool = NULL;
-
-	// Open the class file.
-	jcf.f = fopen(argv[optind], "r");
-	if (jcf.f == NULL) {
-		readjcf_error();
+	jcf.strict_flag = strict_flag;
+	jcf.binary_flag = binary_path != NULL;
+	jcf.fingerprint_flag = fingerprint_flag;
+	jcf.attributes = attributes;
+	jcf.parser = jcf_parser_create();
+	if (jcf.parser == NULL) {
+		readjcf_error(NULL);
+		jcf_inputs_destroy(&inputs);
 		return (1); // Indicate an error.
 	}
+	if (jcf.stats != NULL)
+		jcf_parser_stats(jcf.parser, &jcf.stats->file.parse);
+	jcf_parser_strict(jcf.parser, strict_flag);
+	jcf.class_name = NULL;
+	jcf.class_length = 0;
+	jcf.inflate_buffer = NULL;
+	jcf.inflate_size = 0;
+	jcf_link_table_init(&link);
+	jcf_graph_table_init(&graph);
+	jcf_graph_table_init(&index);
+	jcf.link = NULL;
+	jcf.graph = NULL;
+	jcf.graph_class = 0;
+	jcf.index = NULL;
+	jcf.intern = NULL;
+	if (link_flag || cycles_flag || queries != NULL ||
+	    socket_path != NULL || index_path != NULL) {
+		if (jcf_intern_init(&intern) != 0) {
+			readjcf_error(NULL);
+			jcf_parser_destroy(jcf.parser);
+			jcf_inputs_destroy(&inputs);
+			return (1); // Indicate an error.
+		}
+		if (link_flag)
+			jcf.link = &link;
+		if (cycles_flag || queries != NULL || socket_path != NULL)
+			jcf.graph = &graph;
+		if (index_path != NULL)
+			jcf.index = &index;
+		jcf.intern = &intern;
+	}
 
-	// Process the JCF header.
-	err = process_jcf_header(&jcf);
-	if (err != 0)
-		goto failed;
-
-	// Process the JCF constant pool.
-	err = process_jcf_constant_pool(&jcf);
-	if (err != 0)
-		goto failed;
+	// Ask the parser for only the events that the options need.
+	jcf.events = 0;
+	if (depends_flag || link_flag || jcf.index != NULL)
+		jcf.events |= JCF_PARSE_EVENT(JCF_PARSE_DEPENDENCY);
+	if (link_flag) {
+		jcf.events |= JCF_PARSE_EVENT(JCF_PARSE_CLASS) |
+		    JCF_PARSE_EVENT(JCF_PARSE_SUPER) |
+		    JCF_PARSE_EVENT(JCF_PARSE_INTERFACE) |
+		    JCF_PARSE_EVENT(JCF_PARSE_MEMBER);
+	}
+	if (jcf.graph != NULL || jcf.index != NULL) {
+		jcf.events |= JCF_PARSE_EVENT(JCF_PARSE_CLASS) |
+		    JCF_PARSE_EVENT(JCF_PARSE_USE);
+	}
+	if (exports_flag)
+		jcf.events |= JCF_PARSE_EVENT(JCF_PARSE_EXPORT);
+	if (exports_flag && binary_path != NULL)
+		jcf.events |= JCF_PARSE_EVENT(JCF_PARSE_CLASS);
+	if (fingerprint_flag) {
+		jcf.events |= JCF_PARSE_EVENT(JCF_PARSE_CLASS) |
+		    JCF_PARSE_EVENT(JCF_PARSE_SUPER) |
+		    JCF_PARSE_EVENT(JCF_PARSE_INTERFACE) |
+		    JCF_PARSE_EVENT(JCF_PARSE_EXPORT);
+	}
+	if (attributes != NULL)
+		jcf.events |= JCF_PARSE_EVENT(JCF_PARSE_ATTRIBUTE);
+	if (methods_flag)
+		jcf.events |= JCF_PARSE_EVENT(JCF_PARSE_REFERENCE);
+	jcf.file = 0;
+	jcf_out_init(&jcf.key, -1);
+	jcf_out_init(&jcf.record, -1);
+	jcf.recording = false;
+	jcf.serving = false;
+	jcf_out_init(&jcf.binary, -1);
+	jcf.bin = NULL;
+
+	/*
+	 * Open the cache.  Its entries are only used by runs with the same
+	 * options, because the options decide what the results hold.
+	 */
+	jcf.cache = NULL;
+	if (cache_dir != NULL) {
+		options = jcf_cache_hash(depends_flag | exports_flag << 1 |
+		    link_flag << 2 | (jcf.graph != NULL) << 3 |
+		    methods_flag << 4 | (jcf.index != NULL) << 5 |
+		    strict_flag << 6 | (binary_path != NULL) << 7 |
+		    fingerprint_flag << 8 | JCF_RECORD_VERSION << 16,
+		    attributes != NULL ? attributes : "",
+		    attributes != NULL ? strlen(attributes) : 0);
+		if (jcf_cache_open(&cache, cache_dir, options) == 0)
+			jcf.cache = &cache;
+		else {
+			readjcf_error(cache_dir);
+			err = -1;
+		}
+	}
 
-	// Process the JCF body.
-	err = process_jcf_body(&jcf);
-	if (err != 0)
-		goto failed;
+	// Start the binary file, which is written as the lines are.
+	if (binary_path != NULL) {
+		if (jcf_bin_create(&bin, binary_path) == 0)
+			jcf.bin = &bin;
+		else {
+			readjcf_error(binary_path);
+			err = -1;
+		}
+	}
 
-	// Process the JCF interfaces.
-	err = process_jcf_interfaces(&jcf);
-	if (err != 0)
-		goto failed;
+	// Process each class file, reusing the state.
+	if (socket_path != NULL) {
+		if (serve_jcf(&jcf, &inputs, socket_path, nthreads) != 0)
+			err = -1;
+	} else if (nthreads > 1) {
+		if (process_jcf_inputs_parallel(&jcf, &inputs, batch_flag,
+		    nthreads) != 0)
+			err = -1;
+	} else if (process_jcf_inputs(&jcf, &inputs, batch_flag) != 0)
+		err = -1;
 
-	// Process the JCF fields.
-	err = process_jcf_fields(&jcf);
-	if (err != 0)
-		goto failed;
+	// Check the links between the classes that were read.
+	if (link_flag && check_jcf_links(&jcf, &inputs, batch_flag) != 0)
+		err = -1;
 
-	// Process the JCF methods.
-	err = process_jcf_methods(&jcf);
-	if (err != 0)
-		goto failed;
+	// Build the dependency graph and answer the questions about it.
+	if ((cycles_flag || queries != NULL) && check_jcf_graph(&jcf, &inputs,
+	    cycles_flag, queries, nthreads) != 0)
+		err = -1;
 
-	// Process the JCF final attributes.
-	err = process_jcf_attributes(&jcf);
-	if (err != 0)
-		goto failed;
+	// Write the index of the symbols that the classes reference.
+	if (index_path != NULL && jcf_index_write(index_path, &index,
+	    &intern) != 0) {
+		readjcf_error(index_path);
+		err = -1;
+	}
 
-	// Check for extra data.
-	if (fgetc(jcf.f) != EOF) {
+	// Finish the binary file with its string table.
+	if (jcf.bin != NULL && jcf_bin_finish(&bin) != 0) {
+		readjcf_error(binary_path);
 		err = -1;
-		goto failed;
 	}
 
-failed:
-	if (jcf.constant_pool.pool != NULL)
-		destroy_jcf_constant_pool(&jcf.constant_pool);
-	fclose(jcf.f);
-	if (err != 0) {
-		readjcf_error();
-		return (1); // Indicate an error.
+	// Write out whatever output is still buffered.
+	if (jcf_out_flush(&jcf.out) != 0)
+		err = -1;
+
+	// Report where the time went.
+	if (jcf.stats != NULL) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		nsec = (uint64_t)(now.tv_sec - start.tv_sec) * 1000000000 +
+		    now.tv_nsec - start.tv_nsec;
+		jcf_stats_allocations(&allocations);
+		if (verbose_flag)
+			jcf_stats_print(stderr, argv[0], &stats, &allocations,
+			    nsec);
+		if (stats_path != NULL && jcf_stats_write_json(stats_path,
+		    &stats, &allocations, nsec, nthreads) != 0) {
+			readjcf_error(stats_path);
+			err = -1;
+		}
 	}
+	jcf_out_destroy(&jcf.out);
+	jcf_out_destroy(&jcf.key);
+	jcf_out_destroy(&jcf.record);
+	jcf_out_destroy(&jcf.binary);
+	jcf_link_table_destroy(&link);
+	jcf_graph_table_destroy(&graph);
+	jcf_graph_table_destroy(&index);
+	if (jcf.intern != NULL)
+		jcf_intern_destroy(&intern);
+
+	// Report how well the cache did.
+	if (jcf.cache != NULL) {
+		if (verbose_flag) {
+			fprintf(stderr, "%s: cache: %zu hits, %zu misses\n",
+			    argv[0], atomic_load(&cache.hits),
+			    atomic_load(&cache.misses));
+		}
+		jcf_cache_close(&cache);
+	}
+	jcf_parser_destroy(jcf.parser);
+	free(jcf.inflate_buffer);
+	jcf_inputs_destroy(&inputs);
+	if (err != 0)
+		return (1); // Indicate an error.
 	return (0);
 }